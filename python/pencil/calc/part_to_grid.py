@@ -7,6 +7,7 @@ def part_to_grid(
     sim=False,
     extent=False,
     fill_gaps=False,
+    scheme="ngp",
 ):
     """Bins quantity based on position data xp and yp to 1024^2 bins like a histrogram.
     This method is not using TSC.
@@ -20,9 +21,11 @@ def part_to_grid(
         - extent:       [[xmin, xmax],[ymin, ymax]] or set false and instead give a sim
                         set extent manually e.g. if you want to include ghost zones
         - fill_gaps     interpolate empty grid cells
+        - scheme:       particle weights, 'ngp' (nearest grid point), 'cic' (cloud in cell)
+                        or 'tsc' (triangular shaped cloud)
 
     Returns: arr, xgrid, ygrid
-        - arr:          2d array with binned values
+        - arr:          2d array with the weighted mean of quantity per bin, NaN in empty bins
         - x-/ygrid:     linspace of used x/y grid
         - zgrid:        if zp != False
 
@@ -40,7 +43,7 @@ def part_to_grid(
     if extent == False and sim == False:
         sim = get_sim()
 
-    if quantity == False:
+    if type(quantity) == type(False) and quantity == False:
         quantity = xp / xp
 
     if extent == False:
@@ -57,12 +60,6 @@ def part_to_grid(
                 [grid.z[0] - grid.dz / 2, grid.z[-1] + grid.dz / 2],
             ]
 
-    if type(zp) == type(False) and zp == False:
-        arr = np.zeros((2, Nbins[0], Nbins[1]))
-    else:
-        arr = np.zeros((3, Nbins[0], Nbins[1], Nbins[2]))
-
-    arr[:] = np.NAN
     xgrid = (
         np.linspace(extent[0][0], extent[0][1], num=Nbins[0] + 1)[:-1]
         + np.linspace(extent[0][0], extent[0][1], num=Nbins[0] + 1)[1:]
@@ -72,31 +69,13 @@ def part_to_grid(
         + np.linspace(extent[1][0], extent[1][1], num=Nbins[1] + 1)[1:]
     ) / 2
     if type(zp) == type(False) and zp == False:
-        for x, y, q in zip(xp, yp, quantity):
-            idx = np.argmin(np.abs(x - xgrid))
-            idy = np.argmin(np.abs(y - ygrid))
-            if np.isnan(arr[0, idx, idy]):
-                arr[0, idx, idy] = 0
-                arr[1, idx, idy] = 0
-            arr[0, idx, idy] += q
-            arr[1, idx, idy] += 1
-
+        arr = deposit([xp, yp], quantity, extent, Nbins[:2], scheme)
     else:
         zgrid = (
             np.linspace(extent[2][0], extent[2][1], num=Nbins[2] + 1)[:-1]
             + np.linspace(extent[2][0], extent[2][1], num=Nbins[2] + 1)[1:]
         ) / 2
-        for x, y, z, q in zip(xp, yp, zp, quantity):
-            idx = np.argmin(np.abs(x - xgrid))
-            idy = np.argmin(np.abs(y - ygrid))
-            idz = np.argmin(np.abs(z - zgrid))
-            if np.isnan(arr[0, idx, idy, idz]):
-                arr[0, idx, idy, idz] = 0
-                arr[1, idx, idy, idz] = 0
-            arr[0, idx, idy, idz] += q
-            arr[1, idx, idy, idz] += 1
-
-    arr = arr[0] / arr[1]
+        arr = deposit([xp, yp, zp], quantity, extent, Nbins[:3], scheme)
 
     if fill_gaps == True:
         arr = fill_gaps_in_grid(arr, key=np.NAN)
@@ -105,3 +84,68 @@ def part_to_grid(
         return arr, xgrid, ygrid
     else:
         return arr, xgrid, ygrid, zgrid
+
+
+def deposit(positions, quantity, extent, Nbins, scheme="ngp"):
+    """Weighted mean of quantity per bin, with the NGP, CIC or TSC weights of the particles.
+
+    Instead of a loop over the particles, the weighted sums are accumulated with
+    np.bincount over the flattened bin index (a segmented sum in one pass), once
+    per neighbour of the particle weight stencil. Particles and stencil points
+    outside extent go to the bins at the edge.
+
+    Args:
+        - positions:    list of the position arrays, one per direction
+        - quantity:     array of the quantity to bin
+        - extent:       [[xmin, xmax], ...] for the directions in positions
+        - Nbins:        number of bins per direction
+        - scheme:       'ngp', 'cic' or 'tsc'
+
+    Returns: arr with shape Nbins, NaN in bins without particles
+    """
+
+    import itertools
+    import numpy as np
+
+    shape = tuple(Nbins)
+    quantity = np.asarray(quantity, dtype=float).ravel()
+
+    # Per direction, the bins and weights of every particle for each stencil point.
+    stencils = []
+    for pos, (lo, hi), n in zip(positions, extent, shape):
+        # position in units of the bin width, bin centres at the integers
+        s = (np.asarray(pos, dtype=float).ravel() - lo) / ((hi - lo) / n) - 0.5
+        if scheme == "ngp":
+            i = np.floor(s + 0.5)
+            points = [(i, np.ones_like(s))]
+        elif scheme == "cic":
+            i = np.floor(s)
+            d = s - i
+            points = [(i, 1 - d), (i + 1, d)]
+        elif scheme == "tsc":
+            i = np.floor(s + 0.5)
+            d = s - i
+            points = [
+                (i - 1, 0.5 * (0.5 - d) ** 2),
+                (i, 0.75 - d**2),
+                (i + 1, 0.5 * (0.5 + d) ** 2),
+            ]
+        else:
+            raise ValueError("deposit: unknown scheme '{}'".format(scheme))
+        stencils.append(
+            [(np.clip(i, 0, n - 1).astype(np.intp), w) for i, w in points]
+        )
+
+    ncells = int(np.prod(shape))
+    sum_q = np.zeros(ncells)
+    sum_w = np.zeros(ncells)
+    for point in itertools.product(*stencils):
+        index = np.ravel_multi_index([i for i, _ in point], shape)
+        weight = np.prod([w for _, w in point], axis=0)
+        sum_q += np.bincount(index, weights=weight * quantity, minlength=ncells)
+        sum_w += np.bincount(index, weights=weight, minlength=ncells)
+
+    arr = np.full(ncells, np.nan)
+    filled = sum_w > 0
+    arr[filled] = sum_q[filled] / sum_w[filled]
+    return arr.reshape(shape)
@@ -267,3 +267,92 @@ class Stream(object):
                 field_z.ev(xx[2], xx[1], xx[0]),
             ]
         )[:, 0]
+
+
+def trace_streamlines(field, params, seeds, time):
+    """
+    trace_streamlines(field, params, seeds, time)
+
+    Trace the streamlines from many seed points at once with the classical
+    Runge-Kutta scheme of 4th order and trilinear interpolation. All seeds
+    advance together, so that every step is a few vectorized array
+    operations instead of one interpolation per point and step as in Stream.
+    Only the grid cells around the current points are read, so field may be
+    a memory-mapped array.
+
+    Parameters
+    ----------
+    field : ndarray
+        Vector field with shape [3, nz, ny, nx], as for Stream.
+
+    params : TracersParameterClass
+        Grid parameters (dx, dy, dz, Ox, Oy, Oz, nx, ny, nz, Lx, Ly, Lz,
+        periodic_x, periodic_y, periodic_z), as for Stream.
+
+    seeds : ndarray
+        Starting points with shape [n_seeds, 3].
+
+    time : ndarray
+        Times at which the traces are returned; the steps of the scheme
+        are the differences between them.
+
+    Returns
+    -------
+    ndarray of shape [n_seeds, len(time), 3] with the traces. Points after
+    a trace has left a non-periodic direction of the domain are NaN.
+    """
+
+    import numpy as np
+
+    dxyz = np.array([params.dx, params.dy, params.dz])
+    oxyz = np.array([params.Ox, params.Oy, params.Oz])
+    nxyz = np.array([params.nx, params.ny, params.nz])
+    lxyz = np.array([params.Lx, params.Ly, params.Lz])
+    periodic = np.array([params.periodic_x, params.periodic_y, params.periodic_z])
+
+    def interpolate(xx):
+        # Trilinear interpolation at the points xx [n, 3]; periodic
+        # directions are wrapped, the others are clamped to the boundary.
+        s = (xx - oxyz) / dxyz
+        i0 = np.floor(s).astype(int)
+        w = s - i0
+        i1 = i0 + 1
+        for p in range(3):
+            if periodic[p]:
+                i0[:, p] %= nxyz[p]
+                i1[:, p] %= nxyz[p]
+            else:
+                i0[:, p] = np.clip(i0[:, p], 0, nxyz[p] - 1)
+                i1[:, p] = np.clip(i1[:, p], 0, nxyz[p] - 1)
+        corners = [(i0, 1 - w), (i1, w)]
+        result = np.zeros_like(xx)
+        for ix, wx in corners:
+            for iy, wy in corners:
+                for iz, wz in corners:
+                    weight = wx[:, 0] * wy[:, 1] * wz[:, 2]
+                    values = field[:, iz[:, 2], iy[:, 1], ix[:, 0]]
+                    result += weight[:, np.newaxis] * values.T
+        return result
+
+    xx = np.array(seeds, dtype=float).reshape(-1, 3)
+    tracers = np.full([xx.shape[0], len(time), 3], np.nan)
+    tracers[:, 0, :] = xx
+    active = np.ones(xx.shape[0], dtype=bool)
+    for it in range(1, len(time)):
+        h = time[it] - time[it - 1]
+        x = xx[active]
+        k1 = interpolate(x)
+        k2 = interpolate(x + 0.5 * h * k1)
+        k3 = interpolate(x + 0.5 * h * k2)
+        k4 = interpolate(x + h * k3)
+        x = x + h / 6 * (k1 + 2 * k2 + 2 * k3 + k4)
+        inside = np.all(
+            periodic | ((x >= oxyz) & (x <= oxyz + lxyz)), axis=1
+        )
+        xx[active] = x
+        tracers[active, it, :] = np.where(inside[:, np.newaxis], x, np.nan)
+        active[np.flatnonzero(active)[~inside]] = False
+        if not active.any():
+            break
+
+    return tracers
@@ -7,3 +7,4 @@ from .arrays3d_to_vtk import arrays3d_to_vtk
 from .particles_to_vtk import particles_to_vtk, ParticlesVtk
 from .create_h5 import create_aver_sph, fvars
 from .pc2vtk import var2vtk, slices2vtk  # , aver2vtk, power2vtk
+from .var2vtkhdf import var2vtkhdf
@@ -0,0 +1,215 @@
+# var2vtkhdf.py
+#
+# Parallel conversion of VAR files into the VTK-HDF format.
+"""
+Contains the routine for converting a snapshot into a chunked VTK-HDF
+(ImageData) file, which ParaView (5.10 and later) reads lazily, and
+optionally into downsampled copies of it for an interactive overview.
+The processor files are memory-mapped (see pencil.read.varmmap) and each
+processor block is extracted by its own worker process, so only one block
+per worker is ever held in memory.
+"""
+
+import os
+import numpy as np
+
+
+def _extract_block(proc, ivars, nghost, strides, dtype):
+    """
+    Interior of one processor block, sampled with every stride of strides.
+    Returns a list with one (start, data) per stride, start being the first
+    point of the block on the grid of that level and data f[nvar, nz, ny, nx].
+    """
+
+    f = proc.f()
+    blocks = []
+    for stride in strides:
+        sel = []
+        start = []
+        for i in range(3):
+            nint = proc.mloc[i] - 2 * nghost[i]
+            # First interior point of the block which lies on the coarse grid.
+            first = (-proc.offset[i]) % stride
+            sel.append(slice(nghost[i] + first, nghost[i] + nint, stride))
+            start.append((proc.offset[i] + first) // stride)
+        data = np.ascontiguousarray(f[sel[0], sel[1], sel[2]][..., ivars].T, dtype=dtype)
+        blocks.append((tuple(start), data))
+    proc.close()
+    return blocks
+
+
+def var2vtkhdf(
+    var_file="",
+    datadir="data",
+    ivar=-1,
+    variables=None,
+    destination="work",
+    levels=1,
+    precision="f",
+    compression=None,
+    nworkers=None,
+    quiet=True,
+):
+    """
+    Convert a snapshot from PencilCode format into VTK-HDF, in parallel.
+
+    call signature::
+
+      var2vtkhdf(var_file='', datadir='data', ivar=-1, variables=None,
+                 destination='work', levels=1, precision='f',
+                 compression=None, nworkers=None, quiet=True)
+
+    Write the interior of *var_file* as VTK-HDF ImageData into
+    *destination*.vtkhdf, chunked by processor block. With *levels* > 1,
+    also write copies sampled at every 2nd, 4th, ... point into
+    *destination*_level1.vtkhdf, *destination*_level2.vtkhdf, ...
+    Only equidistant grids can be represented as ImageData.
+
+    Keyword arguments:
+
+      *var_file*:
+        Name of the VAR file. If not specified, use var.dat.
+
+      *datadir*:
+        Directory where the data is stored.
+
+      *ivar*:
+        Index of the VAR file, if var_file is not specified.
+
+      *variables*:
+        List of variables which should be written, by name as in index.pro;
+        vectors as e.g. 'uu' for ux, uy, uz. If None all.
+
+      *destination*:
+        Destination file name without extension.
+
+      *levels*:
+        Number of levels written, the full resolution being the first.
+
+      *precision*:
+        Precision of the output, 'f' or 'd'.
+
+      *compression*:
+        HDF5 compression filter of the datasets, e.g. 'gzip'.
+
+      *nworkers*:
+        Number of processes extracting processor blocks concurrently.
+        Default: number of processors of the machine.
+
+      *quiet*:
+        Flag for switching off output.
+    """
+
+    import h5py
+    from concurrent.futures import ProcessPoolExecutor, wait, FIRST_COMPLETED
+    from pencil import read
+
+    datadir = os.path.expanduser(datadir)
+    var = read.varmmap(var_file=var_file, datadir=datadir, ivar=ivar, quiet=quiet)
+    grid = read.grid(datadir=datadir, trim=True, quiet=True)
+    dtype = np.float64 if precision == "d" else np.float32
+
+    # Variables to write: name -> 0-based indices of their components.
+    fields = {}
+    if variables is None:
+        names = sorted(
+            (v, k) for k, v in var.index.__dict__.items() if isinstance(v, int) and v <= var.nvar
+        )
+        names = [k for v, k in names]
+        for name in names:
+            if len(name) == 2 and name[1] == "x" and name[0] + "y" in names and name[0] + "z" in names:
+                fields[name[0] * 2] = var._var_indices([name[0] + c for c in "xyz"])
+            elif not (len(name) == 2 and name[1] in "yz" and name[0] * 2 in fields):
+                fields[name] = var._var_indices(name)
+    else:
+        if isinstance(variables, str):
+            variables = [variables]
+        for name in variables:
+            if not hasattr(var.index, name) and len(name) == 2 and name[0] == name[1]:
+                fields[name] = var._var_indices([name[0] + c for c in "xyz"])
+            else:
+                fields[name] = var._var_indices(name)
+    ivars = sorted(set(i for components in fields.values() for i in components))
+    # Position of each component in the blocks returned by the workers.
+    slot = {iv: n for n, iv in enumerate(ivars)}
+
+    strides = [2**level for level in range(max(levels, 1))]
+    ngrid = (var.nxgrid, var.nygrid, var.nzgrid)
+    origin = (grid.x[0], grid.y[0], grid.z[0])
+    spacing = (grid.dx, grid.dy, grid.dz)
+    nblock = tuple(p - 2 * g for p, g in zip(var.procs[0].mloc, var.nghost))
+
+    tgrid = var.procs[0].grid()
+    time = tgrid[0] if tgrid is not None else grid.t
+
+    file_names = []
+    files = []
+    datasets = []
+    for level, stride in enumerate(strides):
+        file_name = destination + (".vtkhdf" if level == 0 else "_level{0}.vtkhdf".format(level))
+        file_names.append(file_name)
+        hf = h5py.File(file_name, "w")
+        files.append(hf)
+        npoints = [-(-n // stride) for n in ngrid]
+        chunk = tuple(min(-(-b // stride), n) for b, n in zip(nblock, npoints))[::-1]
+
+        root = hf.create_group("VTKHDF")
+        root.attrs["Version"] = np.array([1, 0], dtype=np.int64)
+        vtk_type = "ImageData".encode("ascii")
+        root.attrs.create("Type", vtk_type, dtype=h5py.string_dtype("ascii", len(vtk_type)))
+        root.attrs["WholeExtent"] = np.array(
+            [0, npoints[0] - 1, 0, npoints[1] - 1, 0, npoints[2] - 1], dtype=np.int64
+        )
+        root.attrs["Origin"] = np.array(origin, dtype=np.float64)
+        root.attrs["Spacing"] = np.array([d * stride for d in spacing], dtype=np.float64)
+        root.attrs["Direction"] = np.eye(3).flatten()
+        root.create_group("FieldData").create_dataset("time", data=[time])
+
+        point_data = root.create_group("PointData")
+        level_datasets = {}
+        for name, components in fields.items():
+            if len(components) == 1:
+                shape, chunks = tuple(npoints[::-1]), chunk
+            else:
+                shape, chunks = tuple(npoints[::-1]) + (3,), chunk + (3,)
+            level_datasets[name] = point_data.create_dataset(
+                name, shape, dtype=dtype, chunks=chunks, compression=compression
+            )
+        datasets.append(level_datasets)
+
+    def write_blocks(blocks):
+        for level, (start, data) in enumerate(blocks):
+            sel = tuple(slice(s, s + n) for s, n in zip(start[::-1], data.shape[1:]))
+            for name, components in fields.items():
+                if len(components) == 1:
+                    datasets[level][name][sel] = data[slot[components[0]]]
+                else:
+                    datasets[level][name][sel] = np.moveaxis(
+                        data[[slot[c] for c in components]], 0, 3
+                    )
+
+    # Bound the number of extracted blocks waiting to be written.
+    nworkers = nworkers or os.cpu_count() or 1
+    procs = var.procs
+    var.procs = []
+    try:
+        with ProcessPoolExecutor(max_workers=nworkers) as pool:
+            pending = set()
+            for iproc, proc in enumerate(procs):
+                pending.add(pool.submit(_extract_block, proc, ivars, var.nghost, strides, dtype))
+                if len(pending) >= 2 * nworkers:
+                    done, pending = wait(pending, return_when=FIRST_COMPLETED)
+                    for future in done:
+                        write_blocks(future.result())
+                if not quiet and (iproc + 1) % nworkers == 0:
+                    print("var2vtkhdf: {0} of {1} blocks".format(iproc + 1, len(procs)))
+            for future in pending:
+                write_blocks(future.result())
+    finally:
+        for hf in files:
+            hf.close()
+        for proc in procs:
+            proc.close()
+
+    if not quiet:
+        print("var2vtkhdf: wrote {0}".format(", ".join(file_names)))
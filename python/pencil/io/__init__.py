@@ -9,6 +9,7 @@ from .debug_breakpoint import debug_breakpoint
 from .timestamp import timestamp
 from .pc_hdf5 import *
 from .snapshot import *
+from .shared_farray import SharedFarray, PublishedFarray
 
 try:
     from .fort2h5 import *
@@ -0,0 +1,202 @@
+"""
+In-situ access to the f-array which a running simulation keeps in POSIX
+shared memory (shared_mem_name in run.in), without copying and without
+blocking the simulation.
+
+The segment holds f in Fortran order followed by a header with a seqlock
+counter, see src/shared_mem_layout.h: the counter is odd while the
+simulation modifies f. Data read between two equal, even values of the
+counter are consistent.
+
+PublishedFarray reads the double-buffered publication segment
+(shared_mem_publish_name), which always holds a complete time step.
+"""
+
+import mmap
+import os
+
+import numpy as np
+
+__all__ = ["SharedFarray", "PublishedFarray"]
+
+_MAGIC = 0x48534350
+_PUBLISH_MAGIC = 0x42504350
+_VERSION = 1
+_header_dtype = np.dtype(
+    [
+        ("magic", "<u4"),
+        ("version", "<u4"),
+        ("real_size", "<u4"),
+        ("dims", "<u4", (4,)),
+        ("padding", "<u4"),
+        ("seq", "<u8"),
+        ("t", "<f8"),
+        ("it", "<i8"),
+    ]
+)
+
+_publish_header_dtype = np.dtype(
+    [
+        ("magic", "<u4"),
+        ("version", "<u4"),
+        ("real_size", "<u4"),
+        ("dims", "<u4", (4,)),
+        ("current", "<u4"),
+        ("slot", [("seq", "<u8"), ("t", "<f8"), ("it", "<i8")], (2,)),
+    ]
+)
+
+
+def _map_segment(name, header_dtype, magic):
+    path = os.path.join("/dev/shm", name.lstrip("/"))
+    with open(path, "rb") as fd:
+        segment = mmap.mmap(fd.fileno(), 0, prot=mmap.PROT_READ)
+    header_offset = len(segment) - header_dtype.itemsize
+    header = np.ndarray((), dtype=header_dtype, buffer=segment, offset=header_offset)
+    if header["magic"] != magic or header["version"] != _VERSION:
+        raise ValueError("{} is not a Pencil Code f-array (version {})".format(path, _VERSION))
+    dtype = {4: np.float32, 8: np.float64}[int(header["real_size"])]
+    shape = tuple(int(n) for n in header["dims"])
+    return segment, header, header_offset, dtype, shape
+
+
+class SharedFarray(object):
+    """
+    SharedFarray(name)
+
+    Maps the shared-memory f-array of a running simulation read-only.
+
+    Parameters
+    ----------
+    name : string
+        shared_mem_name of the run.
+
+    Attributes
+    ----------
+    f : ndarray
+        Zero-copy view of the f-array, shape (mx, my, mz, mfarray), Fortran
+        order. Its contents change while the simulation advances; check with
+        read_begin and valid, or use snapshot.
+
+    Examples
+    --------
+    >>> shm = pc.io.SharedFarray("pencil_f")
+    >>> while True:
+    ...     seq = shm.read_begin()
+    ...     emax = (shm.f[..., 0] ** 2).max()
+    ...     if shm.valid(seq):
+    ...         break
+    >>> f, t, it = shm.snapshot()
+    """
+
+    def __init__(self, name):
+        self._map, self._header, _, dtype, shape = _map_segment(name, _header_dtype, _MAGIC)
+        self.f = np.ndarray(shape, dtype=dtype, buffer=self._map, order="F")
+
+    def read_begin(self):
+        """Waits until f is not being modified and returns the version to pass to valid."""
+        while True:
+            seq = int(self._header["seq"])
+            if seq % 2 == 0:
+                return seq
+            os.sched_yield()
+
+    def valid(self, seq):
+        """Whether what was read from f since read_begin returned seq is consistent."""
+        return int(self._header["seq"]) == seq
+
+    def snapshot(self, out=None, max_tries=0):
+        """
+        Copies f consistently. Returns (f, t, it); None if max_tries > 0
+        copies failed.
+        """
+        if out is None:
+            out = np.empty_like(self.f, order="F")
+        tries = 0
+        while max_tries == 0 or tries < max_tries:
+            seq = self.read_begin()
+            out[...] = self.f
+            t, it = float(self._header["t"]), int(self._header["it"])
+            if self.valid(seq):
+                return out, t, it
+            tries += 1
+        return None
+
+    def close(self):
+        self.f = None
+        self._header = None
+        self._map.close()
+
+
+class PublishedFarray(object):
+    """
+    PublishedFarray(name)
+
+    Maps the publication segment of a running simulation read-only. Of its
+    two copies of f, the simulation overwrites only the one not published
+    last, so a reader sees a complete time step unless it takes longer than
+    two publication intervals.
+
+    Parameters
+    ----------
+    name : string
+        shared_mem_publish_name of the run.
+
+    Examples
+    --------
+    >>> pub = pc.io.PublishedFarray("pencil_pub")
+    >>> f, t, it, token = pub.latest()
+    >>> emax = (f[..., 0] ** 2).max()
+    >>> ok = pub.valid(token)
+    >>> f, t, it = pub.snapshot()
+    """
+
+    def __init__(self, name):
+        self._map, self._header, header_offset, dtype, shape = _map_segment(
+            name, _publish_header_dtype, _PUBLISH_MAGIC
+        )
+        self._copies = [
+            np.ndarray(shape, dtype=dtype, buffer=self._map, offset=i * header_offset // 2, order="F")
+            for i in range(2)
+        ]
+
+    def latest(self):
+        """
+        Zero-copy view of the copy published last, with its t and it, and a
+        token for valid. None if nothing has been published yet.
+        """
+        while True:
+            current = int(self._header["current"])
+            slot = self._header["slot"][current]
+            seq = int(slot["seq"])
+            if seq % 2 == 1:
+                continue
+            t, it = float(slot["t"]), int(slot["it"])
+            if not self.valid((current, seq)):
+                continue
+            if it < 0:
+                return None
+            return self._copies[current], t, it, (current, seq)
+
+    def valid(self, token):
+        """Whether the copy returned by latest together with token is still intact."""
+        current, seq = token
+        return int(self._header["slot"][current]["seq"]) == seq
+
+    def snapshot(self, out=None):
+        """Copies the latest complete time step. Returns (f, t, it), None if nothing is published yet."""
+        while True:
+            latest = self.latest()
+            if latest is None:
+                return None
+            f, t, it, token = latest
+            if out is None:
+                out = np.empty_like(f, order="F")
+            out[...] = f
+            if self.valid(token):
+                return out, t, it
+
+    def close(self):
+        self._copies = None
+        self._header = None
+        self._map.close()
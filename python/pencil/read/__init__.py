@@ -13,11 +13,15 @@ from .dims import dim
 from .params import param
 from .grids import grid
 from .varfile import var
+from .varmmap import varmmap
 from .allslices import slices
+from .slicestream import slicestream
 from .averages import aver
+from .avermmap import avermmap
 from .pvarfile import pvar
 from .phiaverages import phiaver
 from .varraw import varraw
+from .gputimings import gputimings
 
 # idl workarounds
 from .pstalk import pstalk
@@ -0,0 +1,372 @@
+# avermmap.py
+#
+# Lazy access to the average files of a run.
+"""
+Contains a reader for the 1D (xy, xz, yz) and 2D (y, z) averages which
+indexes the time records of the files once instead of parsing them, and
+returns per variable an array of shape [t, ...] which reads the data only
+when it is indexed. Binary files are memory-mapped; for the formatted
+1D averages the record offsets are cached next to the file
+(<plane>averages.idx.npz), so a later call only indexes the records
+appended since.
+"""
+
+import os
+import numpy as np
+
+
+def avermmap(*args, **kwargs):
+    """
+    avermmap(plane_list=None, datadir="data", simdir=".", nthreads=None, cache=True, quiet=True)
+
+    Map the average files of a run without reading them. The data are read
+    when indexing the array of a variable, e.g. av.xy.uxmz[-100:].
+
+    Parameters
+    ----------
+     plane_list : string or list of string
+         Planes of the averages, 'xy', 'xz', 'yz', 'y', 'z'.
+         Default: those for which an <plane>aver.in exists in simdir.
+
+     datadir : string
+         Directory where the data is stored.
+
+     simdir : string
+         Simulation directory containing the .in files.
+
+     nthreads : int
+         Number of threads reading the processor files of the y and z
+         averages concurrently. Default: min(32, number of processors
+         of the machine + 4).
+
+     cache : bool
+         Write the index of the formatted averages next to the file.
+
+     quiet : bool
+         Flag for switching off output.
+
+    Returns
+    -------
+    AverMmap
+        Instance of the pencil.read.avermmap.AverMmap class, with one
+        attribute per plane holding t and the variables.
+
+    Examples
+    --------
+    Plot the last 1000 profiles of one variable of a long run, without
+    reading the others:
+    >>> av = pc.read.avermmap("xy")
+    >>> plt.plot(av.xy.t[-1000:], av.xy.bxmz[-1000:, 10])
+
+    Time average of a z average over the second half of the run:
+    >>> uxmxy = av.z.uxmxy[av.z.t.size // 2 :].mean(axis=0)
+    """
+
+    aver_tmp = AverMmap()
+    aver_tmp.read(*args, **kwargs)
+    return aver_tmp
+
+
+class _LazyAver(object):
+    """
+    Array of shape (nt,) + space of one variable, read on indexing.
+    Only the time records selected by the first index are loaded.
+    """
+
+    def __init__(self, nt, space, dtype, load):
+        self.shape = (nt,) + tuple(space)
+        self.ndim = len(self.shape)
+        self.dtype = np.dtype(dtype)
+        self._load = load
+
+    def __len__(self):
+        return self.shape[0]
+
+    def __getitem__(self, key):
+        if not isinstance(key, tuple):
+            key = (key,)
+        if key and key[0] is Ellipsis:
+            key = (slice(None),) + key
+        tsel = np.arange(self.shape[0])[key[0] if key else slice(None)]
+        data = self._load(np.atleast_1d(tsel))
+        if np.ndim(tsel) == 0:
+            data = data[0]
+        return data[(slice(None),) * (np.ndim(tsel) > 0) + key[1:]]
+
+    def __array__(self, dtype=None):
+        data = self[:]
+        return data if dtype is None else data.astype(dtype)
+
+
+def _record_dtype(nc, space, dtype):
+    """Time and data record of a sequential Fortran file, with 4-byte markers."""
+    return np.dtype(
+        [
+            ("m0", np.int32),
+            ("t", dtype),
+            ("m1", np.int32),
+            ("m2", np.int32),
+            ("data", dtype, (nc,) + tuple(space)),
+            ("m3", np.int32),
+        ]
+    )
+
+
+def _map_binary(file_name, nc, space, dtype):
+    """
+    Memory-map the records of a binary average file. The records have a
+    fixed size, so the index is computed from the file size; a header
+    record in front and an incomplete last record are skipped.
+    """
+
+    itemsize = np.dtype(dtype).itemsize
+    record = _record_dtype(nc, space, dtype)
+    size = os.path.getsize(file_name)
+    start = 0
+    if size >= 4:
+        marker = int(np.fromfile(file_name, dtype=np.int32, count=1)[0])
+        if marker != itemsize:
+            start = 4 + marker + 4
+    nt = max(size - start, 0) // record.itemsize
+    if nt == 0:
+        return np.zeros(0, dtype=record)
+    mm = np.memmap(file_name, dtype=record, mode="r", offset=start, shape=(nt,))
+    data_bytes = record["data"].itemsize
+    if mm["m0"][0] != itemsize or mm["m2"][0] != data_bytes or mm["m3"][-1] != data_bytes:
+        raise ValueError(
+            "avermmap: {} does not have records of {} variables of shape {}".format(
+                file_name, nc, tuple(space)
+            )
+        )
+    return mm
+
+
+def _index_text(file_name, lines_per_record, cache):
+    """
+    Offsets of the records (time line and data lines) of a formatted average
+    file and the times, continuing from the cached index if the file grew.
+    """
+
+    cache_name = file_name[: -len(".dat")] + ".idx.npz" if file_name.endswith(".dat") else file_name + ".idx.npz"
+    size = os.path.getsize(file_name)
+    offsets = [0]
+    times = []
+    if os.path.exists(cache_name):
+        try:
+            with np.load(cache_name) as cached:
+                if int(cached["lines_per_record"]) == lines_per_record and cached["offsets"][-1] <= size:
+                    offsets = list(cached["offsets"])
+                    times = list(cached["t"])
+                    if int(cached["size"]) == size:
+                        return np.array(offsets, dtype=np.int64), np.array(times)
+        except (OSError, KeyError, ValueError):
+            offsets = [0]
+            times = []
+
+    with open(file_name, "rb") as f:
+        f.seek(offsets[-1])
+        pos = offsets[-1]
+        iline = 0
+        for line in f:
+            if iline == 0:
+                t = float(line)
+            pos += len(line)
+            iline += 1
+            if iline == lines_per_record:
+                # Only complete records are indexed.
+                offsets.append(pos)
+                times.append(t)
+                iline = 0
+
+    offsets = np.array(offsets, dtype=np.int64)
+    times = np.array(times)
+    if cache:
+        try:
+            with open(cache_name, "wb") as f:
+                np.savez(f, size=size, lines_per_record=lines_per_record, offsets=offsets, t=times)
+        except OSError:
+            pass
+    return offsets, times
+
+
+class _Plane(object):
+    """
+    Used to store the averages in a particular plane.
+    """
+
+    def keys(self):
+        for i in self.__dict__.keys():
+            print(i)
+
+
+class AverMmap(object):
+    """
+    AverMmap -- lazily read Pencil Code averages.
+    """
+
+    def __init__(self):
+        """
+        Fill members with default values.
+        """
+
+        self.nthreads = None
+        self._maps = []
+
+    def keys(self):
+        for i in self.__dict__.keys():
+            if not i.startswith("_"):
+                print(i)
+
+    def read(self, plane_list=None, datadir="data", simdir=".", nthreads=None, cache=True, quiet=True):
+        """
+        read(plane_list=None, datadir="data", simdir=".", nthreads=None, cache=True, quiet=True)
+
+        Index the average files of the planes, see avermmap.
+        """
+
+        from pencil import read
+
+        datadir = os.path.expanduser(datadir)
+        simdir = os.path.expanduser(simdir)
+        param = read.param(datadir=datadir, quiet=True, conflicts_quiet=True)
+        if param.io_strategy.rstrip("/") == "HDF5":
+            raise NotImplementedError(
+                "avermmap: HDF5 averages are read lazily by h5py already, use read.aver."
+            )
+        dim = read.dim(datadir)
+        dtype = np.float64 if dim.precision == "D" else np.float32
+        self.nthreads = nthreads
+
+        if plane_list is None:
+            plane_list = [
+                p
+                for p in ["xy", "xz", "yz", "y", "z"]
+                if os.path.exists(os.path.join(simdir, p + "aver.in"))
+            ]
+        elif isinstance(plane_list, str):
+            plane_list = [plane_list]
+
+        for plane in plane_list:
+            with open(os.path.join(simdir, plane + "aver.in")) as f:
+                variables = [v.strip() for v in f if v[0] != "#" and not v.isspace()]
+            if plane in ("xy", "xz", "yz"):
+                nw = {"xy": dim.nz, "xz": dim.ny, "yz": dim.nx}[plane]
+                ext_object = self._map_1d(
+                    os.path.join(datadir, plane + "averages.dat"), variables, nw, dtype, cache
+                )
+            elif plane in ("y", "z"):
+                ext_object = self._map_2d(plane, datadir, variables, dim, dtype)
+            else:
+                raise ValueError("avermmap: unknown plane {}".format(plane))
+            setattr(self, plane, ext_object)
+            if not quiet:
+                print(
+                    "avermmap: {} averages, {} variables at {} times".format(
+                        plane, len(variables), ext_object.t.size
+                    )
+                )
+
+    def _map_1d(self, file_name, variables, nw, dtype, cache):
+        """xy, xz or yz averages: arrays [t, nw] per variable."""
+
+        nc = len(variables)
+        ext_object = _Plane()
+        # A record marker holds zero bytes, the formatted files never do.
+        head = np.fromfile(file_name, dtype=np.uint8, count=4)
+        if head.size == 4 and np.any(head == 0):
+            # Written with lwrite_avg1d_binary
+            mm = _map_binary(file_name, nc, (nw,), dtype)
+            self._maps.append(mm)
+            ext_object.t = np.array(mm["t"])
+            for ivar, var in enumerate(variables):
+                setattr(ext_object, var, mm["data"][:, ivar])
+            return ext_object
+
+        # Formatted: a time line and 8 values per line.
+        offsets, t = _index_text(file_name, 1 + -(-nc * nw // 8), cache)
+        ext_object.t = t
+
+        def load_records(tsel):
+            records = np.empty((tsel.size, nc, nw), dtype=dtype)
+            with open(file_name, "rb") as f:
+                for n, it in enumerate(tsel):
+                    f.seek(offsets[it])
+                    values = f.read(offsets[it + 1] - offsets[it]).decode().split()[1:]
+                    records[n] = np.array(values, dtype=np.float64).reshape(nc, nw)
+            return records
+
+        for ivar, var in enumerate(variables):
+            setattr(
+                ext_object,
+                var,
+                _LazyAver(t.size, (nw,), dtype, lambda tsel, ivar=ivar: load_records(tsel)[:, ivar]),
+            )
+        return ext_object
+
+    def _map_2d(self, plane, datadir, variables, dim, dtype):
+        """
+        y or z averages: arrays [t, nx, nz] or [t, nx, ny] per variable,
+        assembled from the processor files by a pool of threads.
+        """
+
+        from concurrent.futures import ThreadPoolExecutor
+        from pencil import read
+
+        nc = len(variables)
+        if plane == "z":
+            procs = range(dim.nprocx * dim.nprocy)
+            nu, nv = dim.nx, dim.ny
+        else:
+            procs = [
+                ipx + dim.nprocx * dim.nprocy * ipz
+                for ipz in range(dim.nprocz)
+                for ipx in range(dim.nprocx)
+            ]
+            nu, nv = dim.nx, dim.nz
+
+        def map_proc(proc):
+            proc_dim = read.dim(datadir, proc)
+            if plane == "z":
+                pnu, pnv = proc_dim.nx, proc_dim.ny
+                u0, v0 = proc_dim.ipx * proc_dim.nx, proc_dim.ipy * proc_dim.ny
+            else:
+                pnu, pnv = proc_dim.nx, proc_dim.nz
+                u0, v0 = proc_dim.ipx * proc_dim.nx, proc_dim.ipz * proc_dim.nz
+            file_name = os.path.join(datadir, "proc{0}".format(proc), plane + "averages.dat")
+            mm = _map_binary(file_name, nc, (pnv, pnu), dtype)
+            return mm, (slice(u0, u0 + pnu), slice(v0, v0 + pnv))
+
+        with ThreadPoolExecutor(max_workers=self.nthreads) as pool:
+            maps = list(pool.map(map_proc, procs))
+        self._maps.extend(mm for mm, sel in maps)
+
+        # The processors may have written different numbers of records
+        # if the run was stopped while writing.
+        nt = min(mm.size for mm, sel in maps)
+        ext_object = _Plane()
+        ext_object.t = np.array(maps[0][0]["t"][:nt])
+
+        def load(tsel, ivar):
+            out = np.empty((tsel.size, nu, nv), dtype=dtype)
+
+            def copy_proc(proc_map):
+                mm, (usel, vsel) = proc_map
+                out[:, usel, vsel] = mm["data"][tsel, ivar].swapaxes(1, 2)
+
+            with ThreadPoolExecutor(max_workers=self.nthreads) as pool:
+                list(pool.map(copy_proc, maps))
+            return out
+
+        for ivar, var in enumerate(variables):
+            setattr(
+                ext_object,
+                var,
+                _LazyAver(nt, (nu, nv), dtype, lambda tsel, ivar=ivar: load(tsel, ivar)),
+            )
+        return ext_object
+
+    def close(self):
+        for mm in self._maps:
+            if hasattr(mm, "_mmap") and mm._mmap is not None:
+                mm._mmap.close()
+        self._maps = []
@@ -0,0 +1,170 @@
+# gputimings.py
+"""
+Contains the class holding the GPU timings written with lgpu_timings=T
+(data/gpu_timings.dat) and the comparison of two sets of them, e.g. of a
+sample run before and after a change of the code.
+"""
+
+from pencil.util import copy_docstring
+
+
+class GpuTimings(object):
+    """
+    GpuTimings -- holds the per-rank timings of the profiled GPU regions.
+    """
+
+    def __init__(self):
+        """
+        Fill members with default values.
+        """
+
+        # region -> {'calls', 'min', 'mean', 'max'[, 'energy']}, lists over the ranks;
+        # energy [J] only if built with ENERGY_METERING=on
+        self.regions = {}
+        # substep -> {'exchange', 'rhs', 'hidden_min', 'hidden_max'}, lists over the ranks
+        self.overlap = {}
+
+    def keys(self):
+        for i in self.__dict__.keys():
+            print(i)
+
+    def read(self, datadir="data", file_name="gpu_timings.dat"):
+        """
+        read(datadir='data', file_name='gpu_timings.dat')
+
+        Read the timings of the GPU regions, written at the end of a run
+        with lgpu_timings=T in gpu_run_pars.
+
+        Parameters
+        ----------
+        datadir : string
+            Directory where the data is stored.
+
+        file_name : string
+            Name of the timings file, or of a JSON file written by to_json.
+
+        Returns
+        -------
+        Object with the timings per region (regions) and the overlap of
+        the halo exchange per substep (overlap).
+        """
+
+        import json
+        import os
+
+        file_name = os.path.expanduser(os.path.join(datadir, file_name))
+        if file_name.endswith(".json"):
+            with open(file_name, "r") as f:
+                data = json.load(f)
+            self.regions = data["regions"]
+            self.overlap = data.get("overlap", {})
+            return
+
+        self.regions = {}
+        self.overlap = {}
+        with open(file_name, "r") as f:
+            for line in f:
+                # The names (some with blanks) fill the first 25 columns.
+                if not line.strip() or line.startswith("#"):
+                    continue
+                name, words = line[:25].split(), line[25:].split()
+                if name[0] == "substep":
+                    entry = self.overlap.setdefault(
+                        name[1],
+                        {"exchange": [], "rhs": [], "hidden_min": [], "hidden_max": []},
+                    )
+                    for key, value in zip(
+                        ["exchange", "rhs", "hidden_min", "hidden_max"], words[1:5]
+                    ):
+                        entry[key].append(float(value))
+                else:
+                    entry = self.regions.setdefault(
+                        " ".join(name), {"calls": [], "min": [], "mean": [], "max": []}
+                    )
+                    entry["calls"].append(int(words[1]))
+                    for key, value in zip(["min", "mean", "max", "energy"], words[2:6]):
+                        entry.setdefault(key, []).append(float(value))
+
+    def slowest(self, region):
+        """
+        Mean time per call of the slowest rank in region, which sets the
+        pace of the run.
+        """
+
+        return max(self.regions[region]["mean"])
+
+    def imbalance(self, region):
+        """
+        Mean time per call of every rank in region relative to the slowest
+        one. Values well below 1 on some ranks (e.g. on the newer GPUs of a
+        mixed cluster) are the time lost to the uniform decomposition.
+        """
+
+        slowest = self.slowest(region)
+        return [time / slowest if slowest > 0 else 1.0 for time in self.regions[region]["mean"]]
+
+    def to_json(self, file_name, **metadata):
+        """
+        to_json(file_name, **metadata)
+
+        Write the timings to file_name as JSON, together with the keyword
+        arguments as metadata (e.g. revision='...', sample='...').
+        """
+
+        import json
+
+        with open(file_name, "w") as f:
+            json.dump(
+                {"metadata": metadata, "regions": self.regions, "overlap": self.overlap},
+                f,
+                indent=1,
+            )
+
+    def compare(self, reference, tolerance=0.1, quiet=False):
+        """
+        compare(reference, tolerance=0.1, quiet=False)
+
+        Compare the mean time per call of the slowest rank in every region
+        with that of reference (a GpuTimings object).
+
+        Parameters
+        ----------
+        reference : GpuTimings
+            Timings to compare with, e.g. of the previous revision.
+
+        tolerance : float
+            Relative slowdown beyond which a region counts as regressed.
+
+        quiet : bool
+            Do not print the comparison table.
+
+        Returns
+        -------
+        List of (region, time, reference time) of the regressed regions.
+        """
+
+        regressions = []
+        if not quiet:
+            print("{0:25s} {1:>14s} {2:>14s} {3:>8s}".format("region", "mean[s]", "reference[s]", "ratio"))
+        for region in sorted(self.regions):
+            if region not in reference.regions:
+                continue
+            time = self.slowest(region)
+            ref_time = reference.slowest(region)
+            ratio = time / ref_time if ref_time > 0 else float("inf")
+            if ratio > 1 + tolerance:
+                regressions.append((region, time, ref_time))
+            if not quiet:
+                print(
+                    "{0:25s} {1:14.6e} {2:14.6e} {3:8.3f}{4}".format(
+                        region, time, ref_time, ratio, "  <--" if ratio > 1 + tolerance else ""
+                    )
+                )
+        return regressions
+
+
+@copy_docstring(GpuTimings.read)
+def gputimings(*args, **kwargs):
+    gputimings_tmp = GpuTimings()
+    gputimings_tmp.read(*args, **kwargs)
+    return gputimings_tmp
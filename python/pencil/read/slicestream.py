@@ -0,0 +1,280 @@
+# slicestream.py
+#
+# Lazy, memory-mapped access to binary slice files.
+"""
+Contains a reader for the binary (non-HDF5) slice files which memory-maps
+them instead of loading all frames. Frames are decoded only when accessed,
+so a movie or a time series of a slice can be processed in constant memory.
+"""
+
+import os
+import numpy as np
+
+from .varmmap import _read_proc_dim
+
+
+def slicestream(*args, **kwargs):
+    """
+    slicestream(field, extension, datadir="data", proc=-1, old_file=False,
+                nthreads=None)
+
+    Map the slice files of one field and plane, either the assembled file
+    data/slice_<field>.<extension> (as collected by pc_collectallmovies) or,
+    if that does not exist, those in all proc* directories.
+
+    Parameters
+    ----------
+     field : string
+         Name of the field, e.g. 'uu1' or 'lnrho'.
+
+     extension : string
+         Slice plane, e.g. 'xy', 'xy2', 'xz' or 'yz'.
+
+     datadir : string
+         Directory where the data is stored.
+
+     proc : int
+         Processor to be read. If -1, assemble the frames from all of them.
+
+     old_file : bool
+         Flag for reading the old file format without slice position.
+
+     nthreads : int
+         Number of threads assembling and prefetching frames.
+
+    Returns
+    -------
+    SliceStream
+        Lazy array of shape (nt, vsize, hsize).
+
+    Examples
+    --------
+    >>> uz = pc.read.slicestream("uu3", "xy")
+    >>> print(uz.shape, uz.t[-1])
+    >>> last = uz[-1]
+    >>> for t, frame in uz.frames(step=10):
+    ...     plt.imshow(frame)
+    """
+
+    return SliceStream(*args, **kwargs)
+
+
+class _SliceFile(object):
+    """
+    One slice file, mapped as an array of fixed-size Fortran records
+    (data(hsize,vsize), time[, pos]), and where its plane lies in the
+    assembled one.
+    """
+
+    def __init__(self, file_name, hsize, vsize, hoffset, voffset, dtype, old_file):
+        nextra = 1 if old_file else 2
+        self.record = np.dtype(
+            [
+                ("head", np.int32),
+                ("data", dtype, (vsize, hsize)),
+                ("extra", dtype, (nextra,)),
+                ("tail", np.int32),
+            ]
+        )
+        self.nt = os.path.getsize(file_name) // self.record.itemsize
+        self.hslice = slice(hoffset, hoffset + hsize)
+        self.vslice = slice(voffset, voffset + vsize)
+        self.map = None
+        if self.nt > 0:
+            self.map = np.memmap(file_name, dtype=self.record, mode="r", shape=(self.nt,))
+            marker = int(self.map[0]["head"])
+            if marker != self.record.itemsize - 8:
+                raise ValueError(
+                    "{}: record length {} does not match a {}x{} plane".format(
+                        file_name, marker, hsize, vsize
+                    )
+                )
+
+    def prefetch(self, start, stop):
+        """Advise the kernel to read frames start:stop ahead."""
+        import mmap
+
+        if self.map is None or not hasattr(mmap, "MADV_WILLNEED"):
+            return
+        offset = start * self.record.itemsize
+        length = (stop - start) * self.record.itemsize
+        page = mmap.ALLOCATIONGRANULARITY
+        aligned = offset - offset % page
+        try:
+            self.map._mmap.madvise(mmap.MADV_WILLNEED, aligned, length + offset - aligned)
+        except (AttributeError, ValueError, OSError):
+            pass
+
+
+class SliceStream(object):
+    """
+    SliceStream -- memory-mapped Pencil Code slice series.
+    """
+
+    def __init__(self, field, extension, datadir="data", proc=-1, old_file=False, nthreads=None):
+        """
+        Map the slice files, see slicestream.
+        """
+
+        from concurrent.futures import ThreadPoolExecutor
+        from pencil import read
+        from pencil.math import natural_sort
+
+        datadir = os.path.expanduser(datadir)
+        param = read.param(datadir=datadir, quiet=True, conflicts_quiet=True)
+        if param.io_strategy.rstrip("/") == "HDF5":
+            raise NotImplementedError(
+                "slicestream: HDF5 slices are read per frame by h5py already, use read.slices."
+            )
+        dim = read.dim(datadir)
+        dtype = np.float64 if dim.precision == "D" else np.float32
+        self.field = field
+        self.extension = extension
+        self.nthreads = nthreads
+        self.dtype = dtype
+
+        axes = self._axes(extension)
+        nglobal = (dim.nx, dim.ny, dim.nz)
+        nghost = (dim.nghostx, dim.nghosty, dim.nghostz)
+        self.hsize, self.vsize = nglobal[axes[0]], nglobal[axes[1]]
+
+        file_name = "slice_" + field + "." + extension
+        if proc < 0 and os.path.exists(os.path.join(datadir, file_name)):
+            self.files = [
+                _SliceFile(
+                    os.path.join(datadir, file_name),
+                    self.hsize, self.vsize, 0, 0, dtype, old_file,
+                )
+            ]
+        else:
+            if proc < 0:
+                proc_dirs = natural_sort(
+                    [
+                        s
+                        for s in os.listdir(datadir)
+                        if s.startswith("proc") and os.path.isdir(os.path.join(datadir, s))
+                    ]
+                )
+            else:
+                proc_dirs = ["proc" + str(proc)]
+
+            def open_proc(directory):
+                name = os.path.join(datadir, directory, file_name)
+                if not os.path.exists(name):
+                    return None
+                mloc, ip = _read_proc_dim(os.path.join(datadir, directory, "dim.dat"))
+                nloc = [mloc[i] - 2 * nghost[i] for i in range(3)]
+                if proc >= 0:
+                    ip = (0, 0, 0)
+                return _SliceFile(
+                    name,
+                    nloc[axes[0]],
+                    nloc[axes[1]],
+                    ip[axes[0]] * nloc[axes[0]],
+                    ip[axes[1]] * nloc[axes[1]],
+                    dtype,
+                    old_file,
+                )
+
+            with ThreadPoolExecutor(max_workers=nthreads) as pool:
+                self.files = [f for f in pool.map(open_proc, proc_dirs) if f is not None]
+            if proc >= 0 and self.files:
+                self.hsize = self.files[0].hslice.stop
+                self.vsize = self.files[0].vslice.stop
+        if not self.files:
+            raise FileNotFoundError("slicestream: no files {} in {}".format(file_name, datadir))
+
+        # A run may still be appending: use the frames complete in all files.
+        self.nt = min(f.nt for f in self.files)
+        self.shape = (self.nt, self.vsize, self.hsize)
+        self._t = None
+
+    @staticmethod
+    def _axes(extension):
+        """Horizontal and vertical axis (0=x, 1=y, 2=z) of the slice plane."""
+        plane = extension.lower().rstrip("0123456789")
+        if plane == "xy":
+            return 0, 1
+        if plane == "xz":
+            return 0, 2
+        if plane == "yz":
+            return 1, 2
+        raise ValueError("slicestream: unsupported extension {}".format(extension))
+
+    def __len__(self):
+        return self.nt
+
+    @property
+    def t(self):
+        """Times of all frames; reads one value per frame."""
+        if self.nt == 0:
+            return np.array([], dtype=self.dtype)
+        if self._t is None:
+            self._t = np.array(self.files[0].map["extra"][: self.nt, 0])
+        return self._t
+
+    @property
+    def position(self):
+        """Position of the slice plane, None for the old file format."""
+        extra = self.files[0].map["extra"]
+        return float(extra[0, 1]) if extra.shape[1] > 1 else None
+
+    def _frames(self, times, out):
+        """Assemble the frames with indices times into out[len(times), vsize, hsize]."""
+        from concurrent.futures import ThreadPoolExecutor
+
+        def copy_file(f):
+            out[:, f.vslice, f.hslice] = f.map["data"][times]
+
+        if len(self.files) == 1:
+            copy_file(self.files[0])
+        else:
+            with ThreadPoolExecutor(max_workers=self.nthreads) as pool:
+                list(pool.map(copy_file, self.files))
+        return out
+
+    def __getitem__(self, key):
+        """
+        Frames are indexed like an array of shape (nt, vsize, hsize); only
+        the frames selected by the first index are read.
+        """
+        if not isinstance(key, tuple):
+            key = (key,)
+        tkey, rest = key[0], key[1:]
+        if isinstance(tkey, (int, np.integer)):
+            if tkey < 0:
+                tkey += self.nt
+            if not 0 <= tkey < self.nt:
+                raise IndexError("slicestream: frame {} out of range".format(key[0]))
+            frame = self._frames([tkey], np.empty((1, self.vsize, self.hsize), self.dtype))[0]
+            return frame[rest] if rest else frame
+        times = np.arange(self.nt)[tkey]
+        frames = self._frames(times, np.empty((len(times), self.vsize, self.hsize), self.dtype))
+        return frames[(slice(None),) + rest] if rest else frames
+
+    def frames(self, start=0, stop=None, step=1, prefetch=8):
+        """
+        frames(start=0, stop=None, step=1, prefetch=8)
+
+        Iterate over (t, frame), keeping only the frame being returned in
+        memory. The next prefetch frames are read ahead in the background.
+        """
+        from concurrent.futures import ThreadPoolExecutor
+
+        times = range(*slice(start, stop, step).indices(self.nt))
+        t = self.t
+        with ThreadPoolExecutor(max_workers=max(len(self.files), 1) if self.nthreads is None else self.nthreads) as pool:
+            for i in range(0, len(times), max(prefetch, 1)):
+                ahead = times[i + prefetch : i + 2 * prefetch]
+                if len(ahead) > 0:
+                    for f in self.files:
+                        pool.submit(f.prefetch, min(ahead), max(ahead) + 1)
+                for it in times[i : i + prefetch]:
+                    yield t[it], self[it]
+
+    def close(self):
+        for f in self.files:
+            if f.map is not None and f.map._mmap is not None:
+                f.map._mmap.close()
+            f.map = None
+        self.files = []
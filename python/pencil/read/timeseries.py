@@ -36,10 +36,13 @@ class TimeSeries(object):
         unique_clean=False,
         time_range=None,
         precision="f",
+        cache=False,
+        cache_dir=None,
     ):
         """
         read(file_name='time_series.dat', datadir='data',
-             quiet=False, comment_char='#', sim=None, unique_clean=False)
+             quiet=False, comment_char='#', sim=None, unique_clean=False,
+             cache=False, cache_dir=None)
 
         Read Pencil Code time series data.
 
@@ -70,6 +73,18 @@ class TimeSeries(object):
 
         precision : float
           "f" (single,default) or "d" (double) or "h" (half).
+
+        cache : bool
+          Keep the parsed lines in file_name.cache.npz next to the time
+          series, together with the byte offset up to which it has been
+          read, and parse only the lines appended since the last call.
+          The cache is rebuilt if the header line changed or the file was
+          truncated, replaced or rewritten. If it cannot be written, the
+          time series is read without it.
+
+        cache_dir : string
+          Directory for the cache instead of datadir, e.g. if that is not
+          writable.
         """
 
         import numpy as np
@@ -85,8 +100,51 @@ class TimeSeries(object):
                 datadir = sim.datadir
 
         datadir = os.path.expanduser(datadir)
-        with open(os.path.join(datadir, file_name), "r") as infile:
-            lines = infile.readlines()
+        file_path = os.path.join(datadir, file_name)
+        if cache_dir:
+            cache_name = os.path.abspath(file_path).strip(os.sep).replace(os.sep, "_")
+            cache_path = os.path.join(os.path.expanduser(cache_dir), cache_name + ".cache.npz")
+        else:
+            cache_path = file_path + ".cache.npz"
+        with open(file_path, "rb") as infile:
+            header = infile.readline()
+            stat = os.fstat(infile.fileno())
+            cached = None
+            if cache and os.path.exists(cache_path):
+                try:
+                    with np.load(cache_path) as npz:
+                        cached = dict(npz)
+                except (OSError, ValueError):
+                    pass
+            if cached is not None:
+                # Only appending keeps the cache valid: the file is the same
+                # and the lines read before still end at the cached offset.
+                # Size and mtime cannot tell a rewrite within the same clock
+                # tick, so the last cached line is compared instead.
+                try:
+                    valid = (
+                        cached["header"].item() == header
+                        and int(cached["ino"]) == stat.st_ino
+                        and int(cached["offset"]) <= stat.st_size
+                        and cached["data"].dtype == np.dtype(precision)
+                    )
+                    if valid:
+                        last = cached["last"].item()
+                        infile.seek(int(cached["offset"]) - len(last))
+                        valid = infile.read(len(last)) == last
+                except KeyError:
+                    valid = False
+                if not valid:
+                    cached = None
+            offset = int(cached["offset"]) if cached is not None else 0
+            infile.seek(offset)
+            text = infile.read()
+        if cache:
+            # Only complete lines; one being written is taken next time.
+            text = text[: text.rfind(b"\n") + 1]
+        lines = text.decode().splitlines(keepends=True)
+        if cached is not None:
+            self.keys = [str(key) for key in cached["keys"]]
 
         nlines_init = len(lines)
         data = np.zeros((nlines_init, len(self.keys)),dtype=precision)
@@ -111,6 +169,32 @@ class TimeSeries(object):
         # Clean up data.
         data = np.resize(data, (nlines, len(self.keys)))
 
+        if cached is not None:
+            # New columns in the appended part are zero in the cached rows.
+            old = cached["data"]
+            ncols = max(old.shape[1], data.shape[1])
+            old = np.pad(old, ((0, 0), (0, ncols - old.shape[1])))
+            data = np.pad(data, ((0, 0), (0, ncols - data.shape[1])))
+            data = np.concatenate((old, data))[:, : len(self.keys)]
+            nlines = data.shape[0]
+        if cache and (text or cached is None):
+            tmp_path = cache_path + ".tmp.npz"
+            last = text[text.rfind(b"\n", 0, len(text) - 1) + 1 :]
+            try:
+                np.savez(
+                    tmp_path,
+                    header=np.array(header),
+                    offset=offset + len(text),
+                    ino=stat.st_ino,
+                    last=np.array(last),
+                    keys=np.array(self.keys),
+                    data=data,
+                )
+                os.replace(tmp_path, cache_path)
+            except OSError as e:
+                if not quiet:
+                    print("Cannot write the cache {0}: {1}".format(cache_path, e))
+
         if not quiet:
             print("Read {0} lines.".format(nlines))
 
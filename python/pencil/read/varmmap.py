@@ -0,0 +1,393 @@
+# varmmap.py
+#
+# Lazy, memory-mapped access to the VAR files of a run.
+# NB: like varfile.py, arrays returned are C-ordered: f[nvar, nz, ny, nx]
+"""
+Contains a reader for VAR files which memory-maps the file of every processor
+instead of reading it, so that only the parts of the snapshot which are
+actually asked for (a sub-volume, a few variables) are ever read from disk.
+The processor files are copied into the global array by a pool of threads.
+"""
+
+import os
+import numpy as np
+
+
+def varmmap(*args, **kwargs):
+    """
+    varmmap(var_file="", datadir="data", ivar=-1, nthreads=None, quiet=True)
+
+    Map a VAR file of a run with the default (io_dist) or collective IO
+    strategy without reading it. The data are read when calling get, or
+    when accessing a variable by name.
+
+    Parameters
+    ----------
+     var_file : string
+         Name of the VAR file. If not specified, use var.dat.
+
+     datadir : string
+         Directory where the data is stored.
+
+     ivar : int
+         Index of the VAR file, if var_file is not specified.
+
+     nthreads : int
+         Number of threads copying processor files concurrently.
+         Default: min(32, number of processors of the machine + 4).
+
+     quiet : bool
+         Flag for switching off output.
+
+    Returns
+    -------
+    VarMmap
+        Instance of the pencil.read.varmmap.VarMmap class.
+
+    Examples
+    --------
+    Read the z component of the velocity in the lower half of the box,
+    without ghost zones and without touching the other variables:
+    >>> var = pc.read.varmmap()
+    >>> uz = var.get("uz", irange_z=(0, var.nzgrid // 2), trim=True)[0]
+
+    Read all variables of a few x-y planes:
+    >>> f = var.get(irange_z=(10, 12))
+    """
+
+    var_tmp = VarMmap()
+    var_tmp.read(*args, **kwargs)
+    return var_tmp
+
+
+def _read_proc_dim(file_name):
+    """Local mx,my,mz and processor coordinates from a proc*/dim.dat."""
+    with open(file_name, "r") as dim_file:
+        lines = dim_file.readlines()
+    mloc = tuple(map(int, lines[0].split()[:3]))
+    ip = tuple(map(int, lines[3].split()[:3]))
+    return mloc, ip
+
+
+class _ProcFile(object):
+    """
+    One processor's part of the snapshot: f(mx,my,mz,nvar) mapped from its
+    first Fortran record, and where it lies in the global array.
+    """
+
+    def __init__(self, file_name, mloc, ip, nloc, nghost, dtype):
+        self.file_name = file_name
+        self.mloc = mloc
+        self.ip = ip
+        self.offset = tuple(ip[i] * nloc[i] for i in range(3))
+        element_bytes = np.dtype(dtype).itemsize
+        f_bytes = mloc[0] * mloc[1] * mloc[2] * element_bytes
+        marker = np.fromfile(file_name, dtype=np.int32, count=1)
+        if marker.size == 0:
+            raise ValueError("{} is empty".format(file_name))
+        if marker[0] > 0 and marker[0] % f_bytes == 0:
+            # Sequential Fortran file: record marker, f, marker, grid record
+            self.header = 4
+            self.nvar = int(marker[0]) // f_bytes
+            self.grid_offset = 4 + int(marker[0]) + 4 + 4
+        else:
+            # Direct access (collective IO): f without record markers
+            self.header = 0
+            self.nvar = os.path.getsize(file_name) // f_bytes
+            self.grid_offset = None
+        self.dtype = dtype
+        self.map = None
+
+        # Cells this processor contributes: ghost zones only at the
+        # outer boundaries, otherwise those of the neighbour left to it
+        # are kept, as in varfile.py.
+        self.own = []
+        for i in range(3):
+            lo = 0 if ip[i] == 0 else nghost[i]
+            self.own.append((self.offset[i] + lo, self.offset[i] + mloc[i]))
+
+    def f(self):
+        """The mapped f, shape (mx,my,mz,nvar) in Fortran order."""
+        if self.map is None:
+            self.map = np.memmap(
+                self.file_name,
+                dtype=self.dtype,
+                mode="r",
+                offset=self.header,
+                shape=self.mloc + (self.nvar,),
+                order="F",
+            )
+        return self.map
+
+    def grid(self):
+        """t, x, y, z from the second record, None for direct-access files."""
+        if self.grid_offset is None:
+            return None
+        mx, my, mz = self.mloc
+        raw = np.memmap(
+            self.file_name,
+            dtype=self.dtype,
+            mode="r",
+            offset=self.grid_offset,
+            shape=(1 + mx + my + mz,),
+        )
+        return (
+            float(raw[0]),
+            np.array(raw[1 : mx + 1]),
+            np.array(raw[mx + 1 : mx + my + 1]),
+            np.array(raw[mx + my + 1 :]),
+        )
+
+    def overlap(self, irange):
+        """
+        Global and local slices of the part of irange this processor
+        contributes, None if none.
+        """
+        glob = []
+        loc = []
+        for i in range(3):
+            lo = max(irange[i][0], self.own[i][0])
+            hi = min(irange[i][1], self.own[i][1])
+            if lo >= hi:
+                return None
+            glob.append(slice(lo - irange[i][0], hi - irange[i][0]))
+            loc.append(slice(lo - self.offset[i], hi - self.offset[i]))
+        return glob, loc
+
+    def close(self):
+        if self.map is not None:
+            if hasattr(self.map, "_mmap") and self.map._mmap is not None:
+                self.map._mmap.close()
+            self.map = None
+
+
+class VarMmap(object):
+    """
+    VarMmap -- memory-mapped Pencil Code VAR file.
+    """
+
+    def __init__(self):
+        """
+        Fill members with default values.
+        """
+
+        self.t = None
+        self.nvar = 0
+        self.mxgrid = self.mygrid = self.mzgrid = 0
+        self.nxgrid = self.nygrid = self.nzgrid = 0
+        self.nghost = (0, 0, 0)
+        self.index = None
+        self.dtype = None
+        self.procs = []
+        self.nthreads = None
+
+    def keys(self):
+        for i in self.__dict__.keys():
+            print(i)
+
+    def read(self, var_file="", datadir="data", ivar=-1, nthreads=None, quiet=True):
+        """
+        read(var_file="", datadir="data", ivar=-1, nthreads=None, quiet=True)
+
+        Map the processor files of a VAR file, see varmmap.
+        """
+
+        from concurrent.futures import ThreadPoolExecutor
+        from pencil import read
+        from pencil.math import natural_sort
+
+        datadir = os.path.expanduser(datadir)
+        dim = read.dim(datadir)
+        param = read.param(datadir=datadir, quiet=True, conflicts_quiet=True)
+        self.index = read.index(datadir=datadir)
+        self.nthreads = nthreads
+
+        io_strategy = param.io_strategy.rstrip("/")
+        if io_strategy == "HDF5":
+            raise NotImplementedError(
+                "varmmap: HDF5 snapshots are read lazily by h5py already, use read.var."
+            )
+
+        if not var_file:
+            var_file = "var.dat" if ivar < 0 else "VAR" + str(ivar)
+
+        dtype = np.float64 if dim.precision == "D" else np.float32
+        self.mxgrid, self.mygrid, self.mzgrid = dim.mx, dim.my, dim.mz
+        self.nxgrid, self.nygrid, self.nzgrid = dim.nx, dim.ny, dim.nz
+        self.nghost = (dim.nghostx, dim.nghosty, dim.nghostz)
+        nloc = (
+            dim.nx // max(dim.nprocx, 1),
+            dim.ny // max(dim.nprocy, 1),
+            dim.nz // max(dim.nprocz, 1),
+        )
+
+        if param.lcollective_io:
+            self.procs = [
+                _ProcFile(
+                    os.path.join(datadir, "allprocs", var_file),
+                    (dim.mx, dim.my, dim.mz),
+                    (0, 0, 0),
+                    nloc,
+                    self.nghost,
+                    dtype,
+                )
+            ]
+        else:
+            proc_dirs = natural_sort(
+                [
+                    s
+                    for s in os.listdir(datadir)
+                    if s.startswith("proc") and os.path.isdir(os.path.join(datadir, s))
+                ]
+            )
+
+            def open_proc(directory):
+                mloc, ip = _read_proc_dim(os.path.join(datadir, directory, "dim.dat"))
+                return _ProcFile(
+                    os.path.join(datadir, directory, var_file),
+                    mloc,
+                    ip,
+                    nloc,
+                    self.nghost,
+                    dtype,
+                )
+
+            with ThreadPoolExecutor(max_workers=nthreads) as pool:
+                self.procs = list(pool.map(open_proc, proc_dirs))
+
+        nvars = set(p.nvar for p in self.procs)
+        if len(nvars) != 1:
+            raise ValueError("varmmap: processor files of {} differ in size".format(var_file))
+        self.nvar = nvars.pop()
+        self.dtype = dtype
+
+        if not quiet:
+            print(
+                "varmmap: mapped {} files of {} with {} variables".format(
+                    len(self.procs), var_file, self.nvar
+                )
+            )
+
+    def _var_indices(self, var):
+        """0-based f-array indices of var (names, 1-based index numbers or None for all)."""
+        if var is None:
+            return list(range(self.nvar))
+        if isinstance(var, (str, int, np.integer)):
+            var = [var]
+        ivars = []
+        for v in var:
+            if isinstance(v, str):
+                if not hasattr(self.index, v):
+                    raise KeyError("varmmap: unknown variable {}".format(v))
+                v = getattr(self.index, v)
+            if v < 1 or v > self.nvar:
+                raise IndexError("varmmap: variable {} is not in the file".format(v))
+            ivars.append(int(v) - 1)
+        return ivars
+
+    def _irange(self, irange, n, m, nghost, trim):
+        """Global half-open index range including ghost zones."""
+        if trim:
+            lo, hi = (0, n) if irange is None else irange
+            lo, hi = max(lo, 0) + nghost, min(hi, n) + nghost
+        else:
+            lo, hi = (0, m) if irange is None else irange
+            lo, hi = max(lo, 0), min(hi, m)
+        if lo >= hi:
+            raise ValueError("varmmap: empty index range {}".format(irange))
+        return lo, hi
+
+    def get(self, var=None, irange_x=None, irange_y=None, irange_z=None, trim=False, out=None):
+        """
+        get(var=None, irange_x=None, irange_y=None, irange_z=None, trim=False, out=None)
+
+        Read (a part of) the snapshot. Only the processor files overlapping
+        the requested range are touched, and of those only the pages holding
+        the requested variables and cells.
+
+        Parameters
+        ----------
+         var : string, int or list of these
+             Variables by name (as in index.pro) or 1-based index; all if None.
+
+         irange_[xyz] : 2-tuple of int
+             Half-open index range; counted from the first interior point
+             if trim, otherwise from the first ghost point.
+
+         trim : bool
+             Exclude the ghost zones.
+
+         out : ndarray
+             Array to store the data in, of the shape returned.
+
+        Returns
+        -------
+        ndarray
+            f[nvar, nz, ny, nx] of the selection.
+        """
+
+        from concurrent.futures import ThreadPoolExecutor
+
+        ivars = self._var_indices(var)
+        irange = (
+            self._irange(irange_x, self.nxgrid, self.mxgrid, self.nghost[0], trim),
+            self._irange(irange_y, self.nygrid, self.mygrid, self.nghost[1], trim),
+            self._irange(irange_z, self.nzgrid, self.mzgrid, self.nghost[2], trim),
+        )
+        shape = (len(ivars),) + tuple(hi - lo for lo, hi in irange[::-1])
+        if out is None:
+            out = np.empty(shape, dtype=self.dtype)
+        elif out.shape != shape:
+            raise ValueError("varmmap: out has shape {}, need {}".format(out.shape, shape))
+
+        # Contiguous variable ranges are read with a single slice.
+        if ivars == list(range(ivars[0], ivars[-1] + 1)):
+            vsel = slice(ivars[0], ivars[-1] + 1)
+        else:
+            vsel = ivars
+
+        def copy_proc(p):
+            ov = p.overlap(irange)
+            if ov is None:
+                return
+            glob, loc = ov
+            # The Fortran-ordered map transposed is f[nvar, nz, ny, nx].
+            out[:, glob[2], glob[1], glob[0]] = p.f().T[vsel, loc[2], loc[1], loc[0]]
+
+        with ThreadPoolExecutor(max_workers=self.nthreads) as pool:
+            list(pool.map(copy_proc, self.procs))
+        return out
+
+    def __getattr__(self, name):
+        """Variables can be read by name, e.g. var.lnrho or var.uu."""
+        if name.startswith("_") or name in ("index", "procs"):
+            raise AttributeError(name)
+        index = self.__dict__.get("index")
+        if index is not None:
+            if hasattr(index, name):
+                return self.get(name)[0]
+            if len(name) == 2 and name[0] == name[1] and all(hasattr(index, name[0] + c) for c in "xyz"):
+                return self.get([name[0] + c for c in "xyz"])
+        raise AttributeError(name)
+
+    def grid(self):
+        """t and the global x, y, z (including ghost zones) from the processor files."""
+        x = np.zeros(self.mxgrid, dtype=self.dtype)
+        y = np.zeros(self.mygrid, dtype=self.dtype)
+        z = np.zeros(self.mzgrid, dtype=self.dtype)
+        t = None
+        for p in self.procs:
+            g = p.grid()
+            if g is None:
+                return None
+            t = g[0]
+            for coord, loc, i in ((x, g[1], 0), (y, g[2], 1), (z, g[3], 2)):
+                lo, hi = p.own[i]
+                coord[lo:hi] = loc[lo - p.offset[i] : hi - p.offset[i]]
+        self.t = t
+        return t, x, y, z
+
+    def close(self):
+        for p in self.procs:
+            p.close()
+        self.procs = []
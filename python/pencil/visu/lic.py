@@ -11,6 +11,8 @@ def lic(
     PDF=False,
     FIG_BACKGROUND="white",
     DEBUG=True,
+    num_threads=0,
+    bilinear=False,
 ):
     """Plotting a vector field in Line Integral Convolution style.
 
@@ -22,6 +24,8 @@ def lic(
         kernellen:          ??? whats this good for?
         DPI:                set dpi
         size:               in inches
+        num_threads:        OpenMP threads for the convolution, 0: one per CPU
+        bilinear:           interpolate the texture along the streamlines
     """
     import numpy as np
     import pylab as plt
@@ -58,7 +62,14 @@ def lic(
     kernel = kernel.astype(np.float32)
 
     ######## do lic
-    image = lic_internal.line_integral_convolution(vectorfield, texture, kernel)
+    # The new options are passed only if set, so that modules compiled from an
+    # older lic_internal.pyx keep working with the defaults.
+    options = {}
+    if num_threads != 0:
+        options["num_threads"] = num_threads
+    if bilinear:
+        options["bilinear"] = bilinear
+    image = lic_internal.line_integral_convolution(vectorfield, texture, kernel, **options)
 
     ######## plotting
     fig = plt.figure(
@@ -1,9 +1,12 @@
+# cython: boundscheck=False, wraparound=False, cdivision=True
 
 import numpy as np
 cimport numpy as np
+from cython.parallel cimport prange
+from libc.math cimport floor
 
 cdef void _advance(float vx, float vy,
-        int* x, int* y, float*fx, float*fy, int w, int h):
+        int* x, int* y, float*fx, float*fy, int w, int h) nogil:
     cdef float tx, ty
     if vx>=0:
         tx = (1-fx[0])/vx
@@ -39,53 +42,91 @@ cdef void _advance(float vx, float vy,
         y[0]=h-1 # FIXME: other boundary conditions?
 
 
-#np.ndarray[float, ndim=2] 
+cdef inline float _sample(float[:, :] texture, int x, int y, float fx, float fy,
+        int w, int h, bint bilinear) nogil:
+    # texture at the position (x+fx, y+fy) on the streamline, either of the
+    # pixel it is in or interpolated between the four nearest pixel centres
+    cdef float sx, sy, ax, ay
+    cdef int x0, y0, x1, y1
+    if not bilinear:
+        return texture[x,y]
+    sx = x+fx-0.5
+    sy = y+fy-0.5
+    x0 = <int>floor(sx)
+    y0 = <int>floor(sy)
+    ax = sx-x0
+    ay = sy-y0
+    x1 = min(max(x0+1,0),w-1)
+    y1 = min(max(y0+1,0),h-1)
+    x0 = min(max(x0,0),w-1)
+    y0 = min(max(y0,0),h-1)
+    return (1-ay)*((1-ax)*texture[x0,y0] + ax*texture[x1,y0]) \
+          + ay *((1-ax)*texture[x0,y1] + ax*texture[x1,y1])
+
+
+cdef float _convolve(float[:, :, :] vectors, float[:, :] texture, float[:] kernel,
+        int i, int j, int w, int h, bint bilinear) nogil:
+    # convolution along the streamline through pixel (i,j), forwards and backwards;
+    # all state is local, so the pixels can be done by different threads
+    cdef int k, x, y
+    cdef int kernellen = kernel.shape[0]
+    cdef float fx, fy, result
+
+    x = j
+    y = i
+    fx = 0.5
+    fy = 0.5
+
+    k = kernellen//2
+    result = kernel[k]*_sample(texture, x, y, fx, fy, w, h, bilinear)
+    while k<kernellen-1:
+        _advance(vectors[y,x,0],vectors[y,x,1],
+                &x, &y, &fx, &fy, w, h)
+        k+=1
+        result += kernel[k]*_sample(texture, x, y, fx, fy, w, h, bilinear)
+
+    x = j
+    y = i
+    fx = 0.5
+    fy = 0.5
+
+    while k>0:
+        _advance(-vectors[y,x,0],-vectors[y,x,1],
+                &x, &y, &fx, &fy, w, h)
+        k-=1
+        result += kernel[k]*_sample(texture, x, y, fx, fy, w, h, bilinear)
+
+    return result
+
+
 def line_integral_convolution(
-        np.ndarray[float, ndim=3] vectors,
-        np.ndarray[float, ndim=2] texture,
-        np.ndarray[float, ndim=1] kernel):
-    cdef int i,j,k,x,y
-    cdef int h,w,kernellen
-    cdef int t
-    cdef float fx, fy, tx, ty
-    cdef np.ndarray[float, ndim=2] result
+        float[:, :, :] vectors,
+        float[:, :] texture,
+        float[:] kernel,
+        int num_threads=0,
+        bint bilinear=False):
+    """
+    Line integral convolution of texture along the streamlines of vectors
+    (shape [h,w,2]), weighted by kernel. The rows are shared among
+    num_threads OpenMP threads (0: one per CPU). With bilinear=True the
+    texture is interpolated at the streamline positions instead of being
+    taken from the pixel they are in.
+    """
+    cdef int i, j, h, w
+    cdef float[:, :] result_view
 
     h = vectors.shape[0]
     w = vectors.shape[1]
-    t = vectors.shape[2]
-    kernellen = kernel.shape[0]
-    if t!=2:
-        raise ValueError("Vectors must have two components (not %d)" % t)
+    if vectors.shape[2]!=2:
+        raise ValueError("Vectors must have two components (not %d)" % vectors.shape[2])
+    if num_threads<=0:
+        import os
+        num_threads = os.cpu_count() or 1
     result = np.zeros((h,w),dtype=np.float32)
+    result_view = result
 
-    for i in range(h):
+    for i in prange(h, nogil=True, schedule="dynamic", num_threads=num_threads):
         for j in range(w):
-            x = j
-            y = i
-            fx = 0.5
-            fy = 0.5
-            
-            k = kernellen//2
-            #print i, j, k, x, y
-            result[i,j] += kernel[k]*texture[x,y]
-            while k<kernellen-1:
-                _advance(vectors[y,x,0],vectors[y,x,1],
-                        &x, &y, &fx, &fy, w, h)
-                k+=1
-                #print i, j, k, x, y
-                result[i,j] += kernel[k]*texture[x,y]
-
-            x = j
-            y = i
-            fx = 0.5
-            fy = 0.5
-            
-            while k>0:
-                _advance(-vectors[y,x,0],-vectors[y,x,1],
-                        &x, &y, &fx, &fy, w, h)
-                k-=1
-                #print i, j, k, x, y
-                result[i,j] += kernel[k]*texture[x,y]
-                    
-    return result
+            result_view[i,j] = _convolve(vectors, texture, kernel, i, j, w, h, bilinear)
 
+    return result
@@ -7,7 +7,11 @@ setup(
     cmdclass={"build_ext": build_ext},
     ext_modules=[
         Extension(
-            "lic_internal", ["lic_internal.pyx"], include_dirs=[numpy.get_include()]
+            "lic_internal",
+            ["lic_internal.pyx"],
+            include_dirs=[numpy.get_include()],
+            extra_compile_args=["-O3", "-fopenmp"],
+            extra_link_args=["-fopenmp"],
         )
     ],
 )
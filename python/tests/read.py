@@ -6,6 +6,8 @@
 
 import numpy as np
 import os
+import shutil
+import tempfile
 from typing import Any, Tuple
 
 from test_utils import (
@@ -21,6 +23,11 @@ from pencil.read.dims import dim
 from pencil.read.varfile import var
 from pencil.read.params import param
 from pencil.read.powers import power
+from pencil.read.varmmap import varmmap
+from pencil.read.allslices import slices
+from pencil.read.slicestream import slicestream
+from pencil.read.averages import aver
+from pencil.read.avermmap import avermmap
 
 
 DATA_DIR = os.path.realpath(
@@ -28,6 +35,12 @@ DATA_DIR = os.path.realpath(
         __file__, *[os.path.pardir] * 3, "tests", "input", "serial-1"
     )  # ../../tests/input/serial-1
 )
+# Slices and averages of a small run, see its README
+DATA_DIR_2 = os.path.realpath(
+    os.path.join(
+        __file__, *[os.path.pardir] * 3, "tests", "input", "serial-2"
+    )  # ../../tests/input/serial-2
+)
 
 
 def data_file(file_name: str) -> str:
@@ -63,6 +76,54 @@ def test_read_time_series() -> None:
     _assert_close(time_series.urms[3], 0.26, "urms[3]")
     _assert_close(time_series.ecrmax[3], 1.835, "ecrmax[3]")
 
+    # With cache=True, a re-read after lines were appended parses only
+    # those, and has to give the same as a fresh read.
+    with tempfile.TemporaryDirectory() as tmp_dir:
+        file_name = os.path.join(tmp_dir, "time_series.dat")
+        shutil.copy(data_file("time-series-1.dat"), file_name)
+        ts(file_name, quiet=True, cache=True)
+        assert_true(
+            os.path.exists(file_name + ".cache.npz"), "time series cache not written"
+        )
+        with open(file_name, "a") as f:
+            f.write("   200    2.020  1.05E-02  2.410E-01  1.000E+00  1.061E+00  1.702E+00\n")
+            f.write("   250    2.561  1.08E-02  2.233E-01  1.000E+00  1.060E+00  1.650E+00\n")
+        cached = ts(file_name, quiet=True, cache=True)
+        fresh = ts(file_name, quiet=True)
+        assert_equal(cached.keys, fresh.keys)
+        for key in fresh.keys:
+            assert_true(
+                np.array_equal(getattr(cached, key), getattr(fresh, key)),
+                "cached time_series.{}: expected {}, got {}".format(
+                    key, getattr(fresh, key), getattr(cached, key)
+                ),
+            )
+        _assert_close(cached.it[-1], 250, "it[-1]")
+
+        # A rewritten file (e.g. a restarted run) must not reuse the cache,
+        # also if it is as long as the cached part.
+        lines = open(data_file("time-series-1.dat")).readlines()
+        with open(file_name, "w") as f:
+            f.writelines(lines[:-1])
+            f.write("   150    1.600  1.05E-02  2.410E-01  1.000E+00  1.061E+00  1.702E+00\n")
+            f.write("   300    3.000  1.05E-02  2.410E-01  1.000E+00  1.061E+00  1.702E+00\n")
+            f.write("   350    3.500  1.05E-02  2.410E-01  1.000E+00  1.061E+00  1.702E+00\n")
+        cached = ts(file_name, quiet=True, cache=True)
+        fresh = ts(file_name, quiet=True)
+        for key in fresh.keys:
+            assert_true(
+                np.array_equal(getattr(cached, key), getattr(fresh, key)),
+                "rewritten time_series.{}: expected {}, got {}".format(
+                    key, getattr(fresh, key), getattr(cached, key)
+                ),
+            )
+
+        # With cache_dir, the cache goes there.
+        cache_dir = os.path.join(tmp_dir, "cache")
+        os.mkdir(cache_dir)
+        ts(file_name, quiet=True, cache=True, cache_dir=cache_dir)
+        assert_equal(len(os.listdir(cache_dir)), 1)
+
 
 def test_read_dim() -> None:
     """Read dim.dat file."""
@@ -164,3 +225,61 @@ def test_read_power() -> None:
             np.allclose(expect, actual),
             "power.{}: expected {}, got {}".format(key, expect, actual),
         )
+
+
+def test_read_varmmap() -> None:
+    """Read var.dat lazily and compare with the full read."""
+    data = var("var.dat", DATA_DIR, proc=0, quiet=True)
+    mapped = varmmap("var.dat", DATA_DIR, quiet=True)
+    interior = data.f[:, 3:-3, 3:-3, 3:-3]
+
+    full = mapped.get(trim=True)
+    _assert_equal_tuple(full.shape, interior.shape)
+    assert_true(np.array_equal(full, interior), "varmmap: full snapshot differs")
+
+    # Two variables in a sub-volume
+    sub = mapped.get(["uy", "lnrho"], irange_x=(1, 3), irange_y=(2, 6), irange_z=(0, 2), trim=True)
+    expect = interior[[1, 3], 0:2, 2:6, 1:3]
+    _assert_equal_tuple(sub.shape, expect.shape)
+    assert_true(np.array_equal(sub, expect), "varmmap: sub-volume differs")
+    mapped.close()
+
+
+def test_read_slicestream() -> None:
+    """Read slices lazily and compare with read.slices."""
+    expected = slices(field="uu1", extension="xy", datadir=DATA_DIR_2, proc=0, quiet=True)
+    stream = slicestream("uu1", "xy", datadir=DATA_DIR_2)
+    _assert_equal_tuple(stream.shape, expected.xy.uu1.shape)
+    assert_true(np.array_equal(stream.t, expected.t), "slicestream: times differ")
+    assert_true(np.array_equal(stream[:], expected.xy.uu1), "slicestream: frames differ")
+    assert_true(np.array_equal(stream[-1], expected.xy.uu1[-1]), "slicestream: last frame differs")
+    for it, (t, frame) in enumerate(stream.frames(step=2, prefetch=2)):
+        assert_true(
+            t == expected.t[2 * it] and np.array_equal(frame, expected.xy.uu1[2 * it]),
+            "slicestream: frame {} differs".format(2 * it),
+        )
+    stream.close()
+
+
+def test_read_avermmap() -> None:
+    """Read xy and z averages lazily and compare with read.aver."""
+    expected = aver(datadir=DATA_DIR_2, simdir=DATA_DIR_2, plane_list=["xy", "z"], quiet=True)
+    mapped = avermmap(["xy", "z"], datadir=DATA_DIR_2, simdir=DATA_DIR_2, cache=False)
+
+    # The xy averages are formatted, hence parsed differently.
+    assert_true(np.allclose(mapped.xy.t, expected.xy.t), "avermmap: xy times differ")
+    for key in ["uxmz", "uymz", "u2mz"]:
+        expect = getattr(expected.xy, key)
+        actual = getattr(mapped.xy, key)
+        _assert_equal_tuple(actual.shape, expect.shape)
+        assert_true(np.allclose(actual[:], expect), "avermmap: xy.{} differs".format(key))
+        assert_true(np.allclose(actual[-2:, 1:5], expect[-2:, 1:5]), "avermmap: xy.{}[-2:] differs".format(key))
+
+    assert_true(np.array_equal(mapped.z.t, expected.z.t), "avermmap: z times differ")
+    for key in ["uxmxy", "uymxy"]:
+        expect = getattr(expected.z, key)
+        actual = getattr(mapped.z, key)
+        _assert_equal_tuple(actual.shape, expect.shape)
+        assert_true(np.array_equal(actual[:], expect), "avermmap: z.{} differs".format(key))
+        assert_true(np.array_equal(actual[3], expect[3]), "avermmap: z.{}[3] differs".format(key))
+    mapped.close()
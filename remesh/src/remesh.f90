@@ -80,7 +80,7 @@ program remesh
 
 ! SC: added axtra dimension in x direction to 'f' array
   real, dimension (mmx_grid,mmy_grid,mmz_grid,mvar) :: f
-  real, dimension (:,:,:,:,:), allocatable :: ff
+  real, dimension (:,:,:,:), allocatable :: ff
   real, dimension (mmx_grid) :: rx,rdx_1,rdx_tilde
   real, dimension (mmy_grid) :: ry,rdy_1,rdy_tilde
   real, dimension (mmz_grid) :: rz,rdz_1,rdz_tilde
@@ -101,7 +101,7 @@ program remesh
   integer(kind=ikind8) :: mmw=mmx*mmy*mmz, mmw_grid=mmx_grid*mmy_grid*mmz_grid, mwcoll=mxcoll*mycoll*mzcoll
 
   call mpicomm_init
-  if (lroot) print*,'Per process memory for arrays f:',mmw_grid*mvar,', ff:',mmw*mvar*mprocs, &
+  if (lroot) print*,'Per process memory for arrays f:',mmw_grid*mvar,', ff:',mmw*mvar, &
              ', acoll:',mvar*mwcoll,' (Multiply with number of bytes per element!)'
 
   if (divx<=0) then
@@ -331,9 +331,9 @@ yinyang_loop: &
     do iyy=0,0   !ncpus,ncpus   !suppressed yinyang-loop for now
     do icpu=icpu0,icpu1
 !
-! Serialize reading of chunks by the processes.
+! Serialize reading of chunks by the processes: nreaders of them read at a time.
 !
-      if (iproc>0) call mpirecv_logical(lok,iproc-1,iproc-1,comm=MPI_COMM_WORLD)
+      if (iproc>=nreaders) call mpirecv_logical(lok,iproc-nreaders,iproc-nreaders,comm=MPI_COMM_WORLD)
 
       call find_proc_coords_general(icpu,layout_rem(1),layout_rem(2),layout_rem(3),ipx,ipy,ipz)
       !ipx = modulo(icpu, nprocx)
@@ -460,9 +460,9 @@ yinyang_loop: &
       i1z=i1z+nz; i2z=i2z+nz;
       enddo    ! end collection loop
 
-      if (iproc<nprocs-1) then
+      if (iproc<nprocs-nreaders) then
         ires=c_usleep(400000)         ! 0.4 sec appropr. for LUMI
-        call mpisend_logical(lok,iproc+1,iproc,comm=MPI_COMM_WORLD)
+        call mpisend_logical(lok,iproc+nreaders,iproc,comm=MPI_COMM_WORLD)
       endif
 
       !goto 113         ! for testing: neither remeshes nor writes any data then.
@@ -699,70 +699,53 @@ yinyang_loop: &
 ! SC: the spreading into different processors is now done after the remeshing
 !     in all dimensions.
 !
-! Spreading results to different processors.
+! Spreading results to different processors. The blocks of the new processors
+! are smoothed and written one after the other, so only one of them is held in ff.
 !
       deallocate(acoll)
-      allocate(ff(mmx,mmy,mmz,mvar,mprocs),stat=stat)
+      allocate(ff(mmx,mmy,mmz,mvar),stat=stat)
       if (stat/=0) print*, 'allocation of ff fails, iproc=', iproc
 
-      if (any((/mulx,muly,mulz/)/=1)) then
-        do counx=1,mulx
-          do couny=1,muly
-            do counz=1,mulz
-!                cpu_local=(couny-1)+muly*(counz-1)+1
-              cpu_local=(counx-1)+mulx*(couny-1)+mulx*muly*(counz-1)+1
-              xstart=1+(counx-1)*nnx
-              xstop=counx*nnx+2*nghost
-              ystart=1+(couny-1)*nny
-              ystop=couny*nny+2*nghost
-              zstart=1+(counz-1)*nnz
-              zstop=counz*nnz+2*nghost
-!
-!NILS: This is not OK if mulx>1....should be fixed
-! SC: @NILS: is it OK now?
-! SC: changed 'ff' array from 'ff(i+addx,...)' to 'ff(:,...)'
-! SC: added to 'f' array 'xstart:xstop'
-              ff(:,:,:,:,cpu_local)=f(xstart:xstop,ystart:ystop,zstart:zstop,:)
-!--             if (itx == 2) then
-              rrx(:,cpu_local)=rx(xstart:xstop)
-              rry(:,cpu_local)=ry(ystart:ystop)
-              rrz(:,cpu_local)=rz(zstart:zstop)
-!--             endif
-            enddo
-          enddo
-        enddo
-      else
-        ff(:mmx_grid,:mmy_grid,:mmz_grid,:mvar,1)=f
-        rrx(:mmx_grid,1)=rx; rry(:mmy_grid,1)=ry; rrz(:mmz_grid,1)=rz
-      endif
+      inquire(IOLENGTH=io_len) t_sp
+      out_size=nnx*nny*nnz*io_len
+
+      do i=1,mprocs
 !
-! SC: former end of the itx loop
+!  i=cpu_local=(counx-1)+mulx*(couny-1)+mulx*muly*(counz-1)+1, as cpu_global above.
+!
+        counx=mod(i-1,mulx)+1
+        couny=mod((i-1)/mulx,muly)+1
+        counz=(i-1)/(mulx*muly)+1
+        xstart=1+(counx-1)*nnx
+        xstop=counx*nnx+2*nghost
+        ystart=1+(couny-1)*nny
+        ystop=couny*nny+2*nghost
+        zstart=1+(counz-1)*nnz
+        zstop=counz*nnz+2*nghost
+
+        ff=f(xstart:xstop,ystart:ystop,zstart:zstop,:)
+        rrx(:,i)=rx(xstart:xstop)
+        rry(:,i)=ry(ystart:ystop)
+        rrz(:,i)=rz(zstart:zstop)
 !
 !  Smoothing data if any of the remesh_par* is unequal to 1.
 !
-      if (any((/remesh_parx,remesh_pary,remesh_parz/)/=1.)) then
-        do j=1,mprocs
-          do i=1,mvar
-            call rmwig(ff(:,:,:,:,j),i,1.,.false.)
+        if (any((/remesh_parx,remesh_pary,remesh_parz/)/=1.)) then
+          do j=1,mvar
+            call rmwig(ff,j,1.,.false.)
           enddo
-        enddo
-      endif
+        endif
 !
 !  Write new var.dat 
 !
-      inquire(IOLENGTH=io_len) t_sp
-      out_size=nnx*nny*nnz*io_len
-      do i=1,mprocs
         if (lastaroth) then
           call find_proc_coords_general(cpu_global(i),layout_dst(1),layout_dst(2),layout_dst(3),idpx,idpy,idpz)
           call chn(idpx*nnx,chx); call chn(idpy*nny,chy); call chn(idpz*nnz,chz);
           call safe_character_assign(file_new,trim(destination)//'/'//trim(datadir)//'/allprocs/field-')
           call safe_character_assign(file2,'-segment-'//trim(chx)//'-'//trim(chy)//'-'//trim(chz)//'.mesh')
           do j=1,mvar
-            !call chn(j,ch)
-!print*, trim(file_new)//trim(fields(j))//trim(file2)
             open(91,file=trim(file_new)//trim(fields(j))//trim(file2),form='unformatted',access='direct',recl=out_size)
-            write(91,rec=1) ff(nghost+1:nghost+nnx,nghost+1:nghost+nny,nghost+1:nghost+nnz,j,i)
+            write(91,rec=1) ff(nghost+1:nghost+nnx,nghost+1:nghost+nny,nghost+1:nghost+nnz,j)
             close(91)
           enddo
         else
@@ -770,9 +753,8 @@ yinyang_loop: &
           call safe_character_assign(file_new,trim(datadir)//'/proc'//trim(ch)//'/var.dat')
           call safe_character_assign(file2,trim(destination)//'/'//trim(file_new))
           if (ip<8) print*,'Writing '//trim(file2)
-!print*, 'cpu, cpu_global, rrx=', cpu, cpu_global(i), rrx(:,i)
           open(91,file=file2,form='unformatted')
-          write(91) ff(:,:,:,:,i)
+          write(91) ff
           if (lshear) then
             write(91) t_sp,rrx(:,i),rry(:,i),rrz(:,i),dx,dy,dz,deltay
             print*,'wrote deltay=',deltay
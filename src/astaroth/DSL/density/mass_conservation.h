@@ -1,15 +1,20 @@
 #if LDENSITY
 global output real AC_current_total_mass
 
+//Also called from the epilogue of twopass_solve_final (steps_two.h) with the freshly integrated density.
+reduce_total_mass(real density)
+{
+	rho = (AC_ldensity_nolog__mod__cdata) ? density : exp(density);
+	integration_weight =  AC_dvol_x__mod__cdata[vertexIdx.x]
+		            * AC_dvol_y__mod__cdata[vertexIdx.y]
+		            * AC_dvol_z__mod__cdata[vertexIdx.z]
+	reduce_sum(rho*integration_weight,AC_current_total_mass)
+}
 Kernel get_current_total_mass(bool lrmv)
 {
 	if(lrmv && AC_lconserve_total_mass__mod__density && AC_total_mass__mod__density > 0.0)
 	{
-		rho = (AC_ldensity_nolog__mod__cdata) ? value(RHO) : exp(LNRHO);
-		integration_weight =  AC_dvol_x__mod__cdata[vertexIdx.x]
-			            * AC_dvol_y__mod__cdata[vertexIdx.y]
-			            * AC_dvol_z__mod__cdata[vertexIdx.z]
-		reduce_sum(rho*integration_weight,AC_current_total_mass)
+		reduce_total_mass(value(RHO))
 	}
 }
 Kernel fix_mass_drift(bool lrmv)
@@ -1,14 +1,12 @@
 // Kramers opacity-based heat conduction.
+// Included from heat_ss.h, which has already set lnrho, glnrho, lnTT, gss and del2ss.
     if (lheatc_kramers){
       //cv1 = 1./cv
-      rho1 = exp(-value(LNRHO))    // v
-      lnTT = lnTT0+cv1*value(SS)+(gamma-1.)*(value(LNRHO)-lnrho0)  // v
-      glnrho = gradient(LNRHO)     // v
+      glnTT  = cv1*gss + gamma_m1*glnrho   //  v
+      del2lnTT = cv1*del2ss + gamma_m1*laplace(LNRHO)  // v
     
-      glnTT  = cv1*gradient(SS) + (gamma-1.)*glnrho   //  v
-      del2lnTT = cv1*laplace(SS) + (gamma-1.)*laplace(LNRHO)  // v
-    
-      Krho1 = hcond0_kramers * pow(rho1,(2.*nkramers+1.)) * pow(exp(lnTT),(6.5*nkramers))   // = K/rho   v
+      // rho1^(2n+1) * TT^(6.5n) as a single exponential
+      Krho1 = hcond0_kramers * exp(6.5*nkramers*lnTT - (2.*nkramers+1.)*lnrho)   // = K/rho   v
 
       g2 = dot(-2.*nkramers*glnrho+(6.5*nkramers+1.)*glnTT,glnTT)   // v
       rhs += Krho1*(del2lnTT+g2)    // v
@@ -27,7 +27,7 @@ else{
 #endif
     if (ladvection_velocity) {
       if (lupw_uu){
-        rhs -= real3(ugrad_upw(UUX,UU), ugrad_upw(UUY,UU), ugrad_upw(UUZ,UU))
+        rhs -= ugrad_upw(UU,UU)
       }
       else{
         rhs -= gradient_tensor(UU) * UU
@@ -118,6 +118,8 @@ Kernel calc_kappar_and_dtau(){
   write(DTAU,KAPPAR*rho*AC_x__mod__cdata[vertexIdx.x]/AC_dy_1__mod__cdata[AC_m__mod__cdata-1])
 }
 
+//The optical depths are integrated by integrateTauGPU in gpu_astaroth.cc, which scans the columns locally and
+//combines only their totals across the processors in y. The ray kernels below are kept for custom compute steps.
 Raytrace (+0,+1,+0) newton_cooling_up_ray
 Raytrace (+0,-1,+0) newton_cooling_down_ray
 
@@ -143,3 +145,8 @@ Kernel integrate_tau_up(){}
 Kernel integrate_tau_down(){}
 Kernel calc_tau(){}
 #endif
+
+ComputeSteps AC_calc_kappar_and_dtau(boundconds)
+{
+	calc_kappar_and_dtau()
+}
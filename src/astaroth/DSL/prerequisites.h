@@ -58,6 +58,7 @@ enum PC_SUB_STEP_NUMBER
 #define AC_mzgrid mzgrid
 
 #include "fieldecs.h"
+#include "../spectra.h"
 #include "../stdlib/optimized_integrators.h"
 //#include "../stdlib/units.h"
 #include "../stdlib/utils/kernels.h"
@@ -94,5 +95,9 @@ global output  real AC_Arms
   #include "../forcing/pcstyleforcing.h"
 #endif
 
-#include "../steps_two.h"
+#if SINGLEPASS
+  #include "../steps_single.h"
+#else
+  #include "../steps_two.h"
+#endif
 #include "equations.h"
@@ -59,13 +59,23 @@ Kernel calc_final_potential(real t)
 		)
 	}
 }
+// Over-relaxed with AC_omega_sor__mod__selfgravity (see omega_sor_selfgrav), which for the optimal factor cuts
+// the number of sweeps from O(N^2) to O(N) on an N^3 grid.
 Kernel selfgravity_sor_step(int color)
 {
-	poisson_sor_red_black(color,RHS_POISSON,SELFGRAVITY_POTENTIAL,1.0)		
+	poisson_sor_red_black(color,RHS_POISSON,SELFGRAVITY_POTENTIAL,AC_omega_sor__mod__selfgravity)
+}
+global output real AC_sor_residual
+global output real AC_sor_rhs_max
+Kernel selfgravity_sor_residual()
+{
+	reduce_max(abs(laplace(SELFGRAVITY_POTENTIAL) - value(RHS_POISSON)),AC_sor_residual)
+	reduce_max(abs(value(RHS_POISSON)),AC_sor_rhs_max)
 }
 #else
 Kernel selfgravity_calc_rhs(){}
 Kernel calc_final_potential(real t){suppress_unused_warning(t)}
 Kernel selfgravity_sor_step(int color){suppress_unused_warning(color)}
+Kernel selfgravity_sor_residual(){}
 #endif
 
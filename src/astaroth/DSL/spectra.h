@@ -0,0 +1,6 @@
+// Scratch fields for the spectra computed on the GPU (powerSpectraGPU): the planar forward transforms
+// of the three components of the vector whose shell spectrum is taken.
+#if LPOWER_SPECTRUM
+Field SPECTRUM_RE[3]
+Field SPECTRUM_IM[3]
+#endif
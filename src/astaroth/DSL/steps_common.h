@@ -0,0 +1,98 @@
+//Declarations and compute steps shared by the integration schemes in steps_two.h and steps_single.h.
+#include "../shock/kernels.ac"
+#include "../density/mass_conservation.h"
+#include "../selfgravity.h"
+#include "../magnetic/before_boundary.h"
+#include "../alphadisk/after_timestep.h"
+
+input real AC_dt
+input PC_SUB_STEP_NUMBER AC_step_num
+input bool AC_lrmv
+input real AC_t
+
+ComputeSteps AC_calc_selfgravity_rhs(boundconds)
+{
+	selfgravity_calc_rhs()
+}
+ComputeSteps AC_calc_final_potential(boundconds)
+{
+	calc_final_potential(AC_t)
+}
+
+ComputeSteps AC_sor_step(boundconds)
+{
+	selfgravity_sor_step(0)
+	selfgravity_sor_step(1)
+}
+ComputeSteps AC_sor_residual(boundconds)
+{
+	selfgravity_sor_residual()
+}
+
+//The two reductions read disjoint fields (RHO, AA) and neither reads what fix_mass_drift writes (RHO, UU),
+//so they come first and adjacent: a task graph may run them on separate streams, fix_mass_drift waits for the mass.
+ComputeSteps AC_before_boundary_steps(boundconds)
+{
+	get_current_total_mass(AC_lrmv)
+	magnetic_before_boundary_reductions()
+	fix_mass_drift(AC_lrmv)
+}
+ComputeSteps AC_after_timestep(boundconds)
+{
+	after_timestep_alphadisk()
+}
+BoundConds boundconds{
+  #include "boundconds.h"
+}
+//TP: periodic in XY sym in Z
+//BoundConds boundconds{
+//  periodic(BOUNDARY_XY)
+//  bc_sym_z(BOUNDARY_Z_TOP, 1.0,AC_top,UUX,false)
+//  bc_sym_z(BOUNDARY_Z_TOP, 1.0,AC_top,UUY,false)
+//  bc_sym_z(BOUNDARY_Z_TOP, 1.0,AC_top,UUZ,false)
+//
+//  bc_sym_z(BOUNDARY_Z_TOP, 1.0,AC_top,AAX,false)
+//  bc_sym_z(BOUNDARY_Z_TOP, 1.0,AC_top,AAY,false)
+//  bc_sym_z(BOUNDARY_Z_TOP, 1.0,AC_top,AAZ,false)
+//
+//  bc_sym_z(BOUNDARY_Z_TOP, 1.0,AC_top,SS,false)
+//  bc_sym_z(BOUNDARY_Z_TOP, 1.0,AC_top,RHO,false)
+//
+//  bc_sym_z(BOUNDARY_Z_BOT, 1.0,AC_bot,UUX,false)
+//  bc_sym_z(BOUNDARY_Z_BOT, 1.0,AC_bot,UUY,false)
+//  bc_sym_z(BOUNDARY_Z_BOT, 1.0,AC_bot,UUZ,false)
+//
+//  bc_sym_z(BOUNDARY_Z_BOT, 1.0,AC_bot,AAX,false)
+//  bc_sym_z(BOUNDARY_Z_BOT, 1.0,AC_bot,AAY,false)
+//  bc_sym_z(BOUNDARY_Z_BOT, 1.0,AC_bot,AAZ,false)
+//
+//  bc_sym_z(BOUNDARY_Z_BOT, 1.0,AC_bot,SS,false)
+//  bc_sym_z(BOUNDARY_Z_BOT, 1.0,AC_bot,RHO,false)
+//}
+////TP example 2
+//BoundConds boundconds{
+//  periodic(BOUNDARY_XY)
+//  bc_sym_z(BOUNDARY_Z_TOP, 1.0,AC_top,UUY,false)
+//  bc_sym_z(BOUNDARY_Z_TOP, 1.0,AC_top,UUZ,false)
+//  bc_sym_z(BOUNDARY_Z_BOT, 1.0,AC_bot,UUY,false)
+//  bc_sym_z(BOUNDARY_Z_BOT, 1.0,AC_bot,UUZ,false)
+//
+//  bc_sym_z(BOUNDARY_Z_TOP, 1.0,AC_top,AAX,false)
+//  bc_sym_z(BOUNDARY_Z_TOP, 1.0,AC_top,AAY,false)
+//  bc_sym_z(BOUNDARY_Z_TOP, 1.0,AC_top,AAZ,false)
+//
+//  bc_ss_flux(BOUNDARY_Z_TOP, AC_top)
+//
+//  bc_sym_z(BOUNDARY_Z_BOT, 1.0,AC_bot,AAX,false)
+//  bc_sym_z(BOUNDARY_Z_BOT, 1.0,AC_bot,AAY,false)
+//  bc_sym_z(BOUNDARY_Z_BOT, 1.0,AC_bot,AAZ,false)
+//
+//  bc_sym_z(BOUNDARY_Z_BOT, 1.0,AC_bot,SS,false)
+//
+//  bc_steady_z(BOUNDARY_Z_TOP, AC_top,UUX)
+//  bc_steady_z(BOUNDARY_Z_BOT, AC_bot,UUX)
+//
+//  bc_ism(BOUNDARY_Z_BOT, AC_bot,RHO)
+//  bc_ism(BOUNDARY_Z_TOP, AC_top,RHO)
+//}
+
@@ -1,8 +1,26 @@
-input real AC_dt
-input int AC_step_num
-ComputeSteps AC_rhs(boundconds) {
-  singlepass_solve(AC_step_num,AC_dt)
+#include "../steps_common.h"
+
+//Single-pass integration: singlepass_solve applies the pointwise final RK3 stage together with the next rhs evaluation,
+//reconstructing the previous rhs from the two stored states. This saves the read and write of the rhs buffer which the
+//two-pass scheme (steps_two.h) needs per substep. Selected with CMAKE_SINGLEPASS=ON in src/astaroth/Makefile.
+//singlepass_solve never holds the final state of a substep, hence no reduction epilogue: nothing to skip before the boundaries.
+ComputeSteps AC_before_boundary_fused(boundconds)
+{
+	get_current_total_mass(AC_lrmv)
+	magnetic_before_boundary_reductions()
+	fix_mass_drift(AC_lrmv)
 }
-BoundConds boundconds{
-  #include "boundconds.h"
+ComputeSteps AC_rhs(boundconds)
+{
+	shock_1_divu()
+	shock_2_max()
+	shock_3_smooth()
+	singlepass_solve(AC_step_num,AC_dt)
+}
+ComputeSteps AC_calculate_timestep(boundconds)
+{
+	shock_1_divu()
+	shock_2_max()
+	shock_3_smooth()
+	singlepass_solve(PC_FIRST_SUB_STEP,AC_dt)
 }
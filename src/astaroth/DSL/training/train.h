@@ -1,7 +1,9 @@
 //#if LTRAINING
+//UUMEAN and TAU go with their halos into the model and TAU is smoothed, so both need halo exchanges.
+//TAU_INFERRED is written whole by the model and otherwise only read at the point itself.
 communicated Field3 UUMEAN
 communicated FieldSymmetricTensor TAU
-communicated FieldSymmetricTensor TAU_INFERRED
+FieldSymmetricTensor TAU_INFERRED
 
 Stencil avgr1
 {
@@ -249,6 +251,28 @@ ComputeSteps scale(boundconds){
 	scale_kernel()
 }
 
+//smooth_tau, final_tau and scale_kernel in one sweep, for all samples after the first, once minTAU etc. are known
+Kernel smooth_final_scale_tau(){
+	UX = UUMEAN.x
+	UY = UUMEAN.y
+	UZ = UUMEAN.z
+	real tau_min_max = maxTAU-minTAU
+
+	write(TAU.xx, (gaussian_smooth(TAU.xx) - UX*UX - minTAU)/tau_min_max)
+	write(TAU.yy, (gaussian_smooth(TAU.yy) - UY*UY - minTAU)/tau_min_max)
+	write(TAU.zz, (gaussian_smooth(TAU.zz) - UZ*UZ - minTAU)/tau_min_max)
+	write(TAU.xy, (gaussian_smooth(TAU.xy) - UX*UY - minTAU)/tau_min_max)
+	write(TAU.yz, (gaussian_smooth(TAU.yz) - UY*UZ - minTAU)/tau_min_max)
+	write(TAU.xz, (gaussian_smooth(TAU.xz) - UX*UZ - minTAU)/tau_min_max)
+
+	write(UUMEAN, train_scale(UUMEAN, minUUMEAN, maxUUMEAN))
+}
+
+ComputeSteps prepare_scaled_uumean_tau(boundconds){
+	tau_uumean()
+	smooth_final_scale_tau()
+}
+
 ComputeSteps descale(boundconds){
 	descale_kernel()
 }
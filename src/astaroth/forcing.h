@@ -1,5 +1,6 @@
 #pragma once
 
+#include <future>
 #include "../forcing_c.h"
 
 typedef struct ForcingParams{
@@ -8,12 +9,77 @@ typedef struct ForcingParams{
 
     real coef1[3], coef2[3], coef3[3], fda[3], kk[3];
     real phase, fact;
+    std::vector<AcReal> fx_re, fx_im, fy_re, fy_im, fz_re, fz_im;
+    std::future<void> drawn;
 
+    // Tabulates the separable factors of the forcing wave, including the amplitude profiles, for forcing() in
+    // DSL/forcing/pcstyleforcing.h.
+    void TabulateFactors(){
+
+      const AcReal k1_ff = mesh.info[AC_k1_ff__mod__forcing];
+      const int zsym = mesh.info[AC_iforcing_zsym__mod__forcing];
+      const AcReal* xx = mesh.info[AC_x__mod__cdata];
+      const AcReal* yy = mesh.info[AC_y__mod__cdata];
+      const AcReal* zz = mesh.info[AC_z__mod__cdata];
+      const AcReal* profx = mesh.info[AC_profx_ampl__mod__forcing];
+      const AcReal* profy = mesh.info[AC_profy_ampl__mod__forcing];
+      const AcReal* profz = mesh.info[AC_profz_ampl__mod__forcing];
+
+      fx_re.assign(mx,0.); fx_im.assign(mx,0.);
+      fy_re.resize(my); fy_im.resize(my);
+      fz_re.resize(mz); fz_im.resize(mz);
+
+      // profx_ampl has only the nx interior points, the others are never forced.
+      for (int i = NGHOST; i < NGHOST+nx; i++){
+        const AcReal arg = kk[0]*k1_ff*xx[i] + phase;
+        fx_re[i] = fact*profx[i-NGHOST]*cos(arg);
+        fx_im[i] = fact*profx[i-NGHOST]*sin(arg);
+      }
+      for (int j = 0; j < my; j++){
+        const AcReal arg = kk[1]*k1_ff*yy[j];
+        fy_re[j] = profy[j]*cos(arg);
+        fy_im[j] = profy[j]*sin(arg);
+      }
+      for (int k = 0; k < mz; k++){
+        const AcReal arg = kk[2]*k1_ff*zz[k];
+        fz_re[k] = profz[k]*(zsym == -1 ? sin(arg) : cos(arg));
+        fz_im[k] = zsym == 0 ? profz[k]*sin(arg) : 0.;
+      }
+
+    }
+
+    void LoadFactors(Device device){
+
+      acPushToConfig(mesh.info, AC_forcing_fx_re, fx_re.data());
+      acPushToConfig(mesh.info, AC_forcing_fx_im, fx_im.data());
+      acPushToConfig(mesh.info, AC_forcing_fy_re, fy_re.data());
+      acPushToConfig(mesh.info, AC_forcing_fy_im, fy_im.data());
+      acPushToConfig(mesh.info, AC_forcing_fz_re, fz_re.data());
+      acPushToConfig(mesh.info, AC_forcing_fz_im, fz_im.data());
+      for (auto param : {AC_forcing_fx_re, AC_forcing_fx_im, AC_forcing_fy_re, AC_forcing_fy_im, AC_forcing_fz_re, AC_forcing_fz_im})
+        acDeviceLoadRealArray(device, STREAM_DEFAULT, mesh.info, param);
+    }
+
+    // Draws the forcing parameters of the current timestep and tabulates the factors on a separate host thread,
+    // so that this overlaps with the first substeps on the GPU. Needs dt to be already set.
+    // The wave vector and phase are still drawn by forcing_pars_hel from the CPU random number channel, which keeps
+    // GPU and CPU runs and their restarts (the seeds are in the snapshots) reproducible.
+    void Draw(){
+
+      if (lforce_helical[0])
+        drawn = std::async(std::launch::async, [this]{
+                  forcing_pars_hel(coef1,coef2,coef3,fda,kk,&phase,&fact);
+                  TabulateFactors();
+                });
+    }
+
+    // Loads the parameters of the last Draw into the GPU.
     void Update(){
 
       if (lforce_helical[0])
       {
-      	forcing_pars_hel(coef1,coef2,coef3,fda,kk,&phase,&fact);
+        if (!drawn.valid()) Draw();
+        drawn.get();
 //printf("phase,fact,kk= %f %f %f %f %f\n", phase, fact, kk[0],kk[1],kk[2]);
 
       	Device device = acGridGetDevice();
@@ -24,6 +90,7 @@ typedef struct ForcingParams{
       	acDeviceLoadVectorUniform(device, STREAM_DEFAULT, AC_coef3, TOACREAL3(coef3));
       	acDeviceLoadVectorUniform(device, STREAM_DEFAULT, AC_fda, TOACREAL3(fda));
       	acDeviceLoadVectorUniform(device, STREAM_DEFAULT, AC_kk, TOACREAL3(kk));
+      	LoadFactors(device);
       }
     }
 } ForcingParams;
@@ -14,8 +14,25 @@
 #include <string.h>
 #include <unistd.h>
 #include <mpi.h>
+#if defined(OPEN_MPI) && __has_include(<mpi-ext.h>)
+  #include <mpi-ext.h>       // MPIX_Query_cuda_support, MPIX_Query_rocm_support
+#endif
 #include <sys/resource.h>
+#include <sys/syscall.h>
+#include <errno.h>
+#include <stdint.h>
+#include <sched.h>
+#include <linux/mempolicy.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <string>
 #include <fstream>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <vector>
+#include <unordered_map>
 
 //TP: defined here since mpi.h can have its own definition of DOUBLE_PRECISION
 //    and we don't want to conflict it with it. This is at least true on my laptop
@@ -34,6 +51,12 @@ bool calculated_coeff_scales = false;
 
 // Astaroth headers
 #include "astaroth.h"
+#include "gpu_runtime.h"
+#include "gpu_profiler.h"
+#include "gpu_kernels.h"
+#if PC_USE_CUFILE
+  #include <cufile.h>
+#endif
 
 #define real AcReal
 #include "math_utils.h"
@@ -66,6 +89,13 @@ bool calculated_coeff_scales = false;
   #define chi_hyper3 chi_hyper3__mod__energy
 
   #define lmorton_curve lmorton_curve__mod__cdata
+  #define lhilbert_curve lhilbert_curve__mod__cdata
+  #define ipx ipx__mod__cdata
+  #define ipy ipy__mod__cdata
+  #define ipz ipz__mod__cdata
+  #define nprocx_node nprocx_node__mod__cdata
+  #define nprocy_node nprocy_node__mod__cdata
+  #define nprocz_node nprocz_node__mod__cdata
   #define ltest_bcs     ltest_bcs__mod__cdata
   #define num_substeps  num_substeps__mod__cdata
   #define maux_vtxbuf_index maux_vtxbuf_index__mod__cdata
@@ -113,6 +143,7 @@ bool calculated_coeff_scales = false;
   #define lperi                  lperi__mod__cdata
   #define lxyz                   lxyz__mod__cdata
   #define lac_sparse_autotuning  lac_sparse_autotuning__mod__cdata
+  #define lgpu_lazy_autotuning   lgpu_lazy_autotuning__mod__cdata
   #define ldebug ldebug__mod__cdata
   
   #define deltay  deltay__mod__cdata
@@ -124,15 +155,30 @@ bool calculated_coeff_scales = false;
   #define itauyy itauyy__mod__training
   #define itauyz itauyz__mod__training
   #define itauzz itauzz__mod__training
+  #define ltrain_async  ltrain_async__mod__training
+  #define ntrain_replay ntrain_replay__mod__training
+  #define ltrain_interior ltrain_interior__mod__training
+  #define ltrain_single   ltrain_single__mod__training
 
   #define lread_all_vars_from_device lread_all_vars_from_device__mod__cdata
   #define lcuda_aware_mpi            lcuda_aware_mpi__mod__cdata
+  #define lcopy_farray_async         lcopy_farray_async__mod__cdata
+  #define lpin_farray                lpin_farray__mod__cdata
+  #define lgpu_timings               lgpu_timings__mod__cdata
+  #define ldt_limiter_report         ldt_limiter_report__mod__cdata
+  #define lreproducible_reductions   lreproducible_reductions__mod__cdata
+  #define lgpu_numa_placement        lgpu_numa_placement__mod__cdata
+  #define lgpu_direct_snapshots      lgpu_direct_snapshots__mod__cdata
   #define lsecond_force lsecond_force__mod__forcing
   #define lforce_helical lforce_helical__mod__forcing
 
   #define lrmv lrmv__mod__cdata
+  #define it_rmv it_rmv__mod__cdata
   #define lconserve_total_mass lconserve_total_mass__mod__density
   #define tstart_selfgrav tstart_selfgrav__mod__selfgravity
+  #define niter_sor_selfgrav niter_sor_selfgrav__mod__selfgravity
+  #define nsor_check_selfgrav nsor_check_selfgrav__mod__selfgravity
+  #define tol_sor_selfgrav tol_sor_selfgrav__mod__selfgravity
 #endif
 
 AcReal dt1_interface;
@@ -146,12 +192,22 @@ static AcTaskGraph *randomize_graph;
 static AcTaskGraph *rhs_test_graph;
 static AcTaskGraph *rhs_test_rhs_1;
 
-void torch_trainCAPI(int sub_dims[3], float* input, float* label, float* loss_val, bool dble=false);
+void torch_trainCAPI(int sub_dims[3], float* input, float* label, float* loss_val, bool dble=false, void* stream=NULL);
 void torch_inferCAPI(int sub_dims[3], float* input, float* label, bool dble=false);
 //void torch_createmodel(const char* name, const char* config_fname, MPI_Comm mpi_comm, int device);
 
 extern "C" void copyFarray(AcReal* f);    // ahead declaration
+void markDeviceDirty();                   // ahead declaration
+//Reductions of AC_before_boundary_steps already taken by the epilogue of the last AC_rhs (see DSL/steps_two.h);
+//void as soon as any other kernel has run or the fields have been loaded from the host
+static bool before_boundary_reductions_done = false;
 
+/***********************************************************************************************/
+void executeBoundconds(AcTaskGraph* bcs)
+{
+	GpuRegion region(GPU_REGION_BOUNDCONDS,lgpu_timings);
+	acGridExecuteTaskGraph(bcs,1);
+}
 /***********************************************************************************************/
 AcReal cpu_pow(AcReal const val, AcReal exponent)
 {
@@ -233,7 +289,7 @@ float MSE(){
 	
   	auto bcs = acGetOptimizedDSLTaskGraph(boundconds);	
 	acGridSynchronizeStream(STREAM_ALL);
-	acGridExecuteTaskGraph(bcs,1);
+	executeBoundconds(bcs);
 	acGridSynchronizeStream(STREAM_ALL);
 
 	auto calc_infered_loss = acGetOptimizedDSLTaskGraph(calc_validation_loss);
@@ -241,54 +297,152 @@ float MSE(){
 	acGridExecuteTaskGraph(calc_infered_loss, 1);
 	acGridSynchronizeStream(STREAM_ALL);
 
-  	bcs = acGetOptimizedDSLTaskGraph(boundconds);	
-	acGridSynchronizeStream(STREAM_ALL);
-	acGridExecuteTaskGraph(bcs,1);
-	acGridSynchronizeStream(STREAM_ALL);
-
+	//l2_sum only reduces, no boundary conditions needed afterwards
 	return (acDeviceGetOutput(acGridGetDevice(), AC_l2_sum))/(6*nxgrid*nygrid*nzgrid);
 #else
         return 0;
 #endif
 }
 /***********************************************************************************************/
-extern "C" void torch_infer_c_api(int itstub){	
+void scaling();     // forward declaration
+/***********************************************************************************************/
+void prepareTrainingSample()
+//
+//  Computes the filtered UUMEAN and TAU, scaled into [0,1], with their halos as input and label of the model.
+//  Once the scaling coefficients are known, this is a single graph of two sweeps (prepare_scaled_uumean_tau),
+//  in which only the smoothing of TAU needs a halo exchange, followed by one boundary update.
+//
+{
 #if TRAINING
 	#include "user_constants.h"
 
-	auto calc_uumean_tau = acGetOptimizedDSLTaskGraph(initialize_uumean_tau);
-	acGridSynchronizeStream(STREAM_ALL);
-	acGridExecuteTaskGraph(calc_uumean_tau, 1);
+	auto bcs = acGetOptimizedDSLTaskGraph(boundconds);
+	if (calculated_coeff_scales)
+	{
+		acGridExecuteTaskGraph(acGetOptimizedDSLTaskGraph(prepare_scaled_uumean_tau), 1);
+		executeBoundconds(bcs);
+		acGridSynchronizeStream(STREAM_ALL);
+		return;
+	}
+	//First sample: the scaling coefficients are taken from the unscaled fields
 	acGridSynchronizeStream(STREAM_ALL);
-
-  	auto bcs = acGetOptimizedDSLTaskGraph(boundconds);	
+	acGridExecuteTaskGraph(acGetOptimizedDSLTaskGraph(initialize_uumean_tau), 1);
 	acGridSynchronizeStream(STREAM_ALL);
-	acGridExecuteTaskGraph(bcs,1);
+	executeBoundconds(bcs);
 	acGridSynchronizeStream(STREAM_ALL);
 
-	if (!calculated_coeff_scales){
-		scaling();
-	}
-
-	auto scale_uumean_tau = acGetOptimizedDSLTaskGraph(scale);
-	acGridSynchronizeStream(STREAM_ALL);
-	acGridExecuteTaskGraph(scale_uumean_tau, 1);
-	acGridSynchronizeStream(STREAM_ALL);
+	scaling();
 
-  	bcs = acGetOptimizedDSLTaskGraph(boundconds);	
+	acGridExecuteTaskGraph(acGetOptimizedDSLTaskGraph(scale), 1);
 	acGridSynchronizeStream(STREAM_ALL);
-	acGridExecuteTaskGraph(bcs,1);
+	executeBoundconds(bcs);
 	acGridSynchronizeStream(STREAM_ALL);
+#endif
+}
+/***********************************************************************************************/
+#if TRAINING
+// Input (UUMEAN) and label (TAU or TAU_INFERRED) of the model. By default the vertex buffers themselves, ghost zones
+// included, with the components of a field assumed to be contiguous. With ltrain_interior, their computational domains
+// are packed into a tensor of their own, converted to single precision with ltrain_single, so that the model sees
+// no ghost zones; training and inference have then both to use it.
+typedef struct {
+  void* input;
+  void* label;
+  int dims[3];
+  bool dble;
+  size_t input_bytes, label_bytes;
+} TrainingTensors;
+
+static void* train_packed = NULL;
+/***********************************************************************************************/
+TrainingTensors trainingTensors(const VertexBufferHandle label_xx, const bool pack_label)
+{
+  #include "user_constants.h"
+  TrainingTensors tensors;
+  AcReal* in  = NULL;
+  AcReal* out = NULL;
+  if (!ltrain_interior)
+  {
+	  acDeviceGetVertexBufferPtrs(acGridGetDevice(), UUMEAN.x, &in, &out);
+	  tensors.input = in;
+	  acDeviceGetVertexBufferPtrs(acGridGetDevice(), label_xx, &in, &out);
+	  tensors.label = in;
+	  tensors.dims[0] = mx; tensors.dims[1] = my; tensors.dims[2] = mz;
+	  tensors.dble = AC_DOUBLE_PRECISION;
+	  tensors.input_bytes = 3*acVertexBufferSizeBytes(mesh.info);
+	  tensors.label_bytes = 6*acVertexBufferSizeBytes(mesh.info);
+	  return tensors;
+  }
+  const GpuGridDims dims = {mx,my,mz,NGHOST,NGHOST,NGHOST,nx,ny,nz};
+  const size_t npoints = (size_t)nx*ny*nz;
+  tensors.dble = AC_DOUBLE_PRECISION && !ltrain_single;
+  const size_t elem = tensors.dble ? sizeof(double) : sizeof(float);
+  if (train_packed == NULL)
+  {
+#if AC_CPU_BUILD
+	  train_packed = malloc(9*npoints*sizeof(AcReal));
+#else
+	  if (cudaMalloc(&train_packed, 9*npoints*sizeof(AcReal)) != cudaSuccess) train_packed = NULL;
+#endif
+	  if (train_packed == NULL)
+	  {
+		  fprintf(stderr,"trainingTensors: could not allocate the packed tensors\n");
+		  exit(EXIT_FAILURE);
+	  }
+  }
+  const GpuKernelReal* fields[9];
+  for (int i = 0; i < 3; ++i)
+  {
+	  acDeviceGetVertexBufferPtrs(acGridGetDevice(), VertexBufferHandle(UUMEAN.x+i), &in, &out);
+	  fields[i] = in;
+  }
+  for (int i = 0; i < 6; ++i)
+  {
+	  acDeviceGetVertexBufferPtrs(acGridGetDevice(), VertexBufferHandle(label_xx+i), &in, &out);
+	  fields[3+i] = in;
+  }
+  gpuPackDomain(fields, pack_label ? 9 : 3, dims, !tensors.dble, train_packed);
+#if !AC_CPU_BUILD
+  //The tensors are also read from the stream of the training thread
+  cudaStreamSynchronize(0);
+#endif
+  tensors.input = train_packed;
+  tensors.label = (char*)train_packed + 3*npoints*elem;
+  tensors.dims[0] = nx; tensors.dims[1] = ny; tensors.dims[2] = nz;
+  tensors.input_bytes = 3*npoints*elem;
+  tensors.label_bytes = 6*npoints*elem;
+  return tensors;
+}
+/***********************************************************************************************/
+void storeInferredTau(const TrainingTensors tensors)
+//
+//  Writes the packed inference result back into TAU_INFERRED; its ghost zones are never read.
+//
+{
+  #include "user_constants.h"
+  if (!ltrain_interior) return;
+  const GpuGridDims dims = {mx,my,mz,NGHOST,NGHOST,NGHOST,nx,ny,nz};
+  GpuKernelReal* fields[6];
+  AcReal* out = NULL;
+  for (int i = 0; i < 6; ++i) acDeviceGetVertexBufferPtrs(acGridGetDevice(), VertexBufferHandle(TAU_INFERRED.xx+i), &fields[i], &out);
+  gpuUnpackDomain(tensors.label, !tensors.dble, 6, dims, fields);
+#if !AC_CPU_BUILD
+  cudaStreamSynchronize(0);
+#endif
+}
+#endif
+/***********************************************************************************************/
+extern "C" void torch_infer_c_api(int itstub){	
+  markDeviceDirty();
+#if TRAINING
+	#include "user_constants.h"
 
-	AcReal* out = NULL;
-	AcReal* uumean_ptr = NULL;
-	AcReal* tau_infer_ptr = NULL;
-
-	acDeviceGetVertexBufferPtrs(acGridGetDevice(), TAU_INFERRED.xx, &tau_infer_ptr, &out);
-	acDeviceGetVertexBufferPtrs(acGridGetDevice(), UUMEAN.x, &uumean_ptr, &out);
-		
+	prepareTrainingSample();
 	acGridHaloExchange();
-	torch_inferCAPI((int[]){mx,my,mz}, uumean_ptr, tau_infer_ptr, AC_DOUBLE_PRECISION);
+
+	TrainingTensors tensors = trainingTensors(TAU_INFERRED.xx, false);
+	torch_inferCAPI(tensors.dims, (float*)tensors.input, (float*)tensors.label, tensors.dble);
+	storeInferredTau(tensors);
 
 	float vloss = MSE();
  	
@@ -331,6 +485,7 @@ bool has_nans(AcMesh mesh_in)
 /***********************************************************************************************/
 extern "C" void testRHS(AcReal *farray_in, AcReal *dfarray_truth)
 {
+  markDeviceDirty();
   const auto DEVICE_VTXBUF_IDX = [&](const int x, const int y, const int z)
   				{
 					return acVertexBufferIdx(x,y,z,mesh.info);
@@ -684,7 +839,7 @@ AcBool3 to_bool3(void* param, const char* name)
 // PC interface headers.
 #include "PC_moduleflags.h"
 //#include "../cdata_c.h"
-#include "../sub_c.h"           // provides set_dt
+#include "../sub_c.h"           // provides set_dt, set_dt_global
 #include "../boundcond_c.h"     // provides boundconds[xyz] etc.
 #include "PC_module_parfuncs.h" // provides stuff from physics modules
 
@@ -714,6 +869,20 @@ AcReal3 DCONST(const AcReal3Param param)
   return mesh.info[param];
 }
 /***********************************************************************************************/
+bool gpuAwareMPI()
+{
+// Whether the MPI library can take device pointers. Only Open MPI can be asked at run time; for other libraries
+// lcuda_aware_mpi is trusted.
+
+#if !AC_CPU_BUILD && AC_USE_HIP && defined(MPIX_ROCM_AWARE_SUPPORT)
+  return MPIX_Query_rocm_support();
+#elif !AC_CPU_BUILD && !AC_USE_HIP && defined(MPIX_CUDA_AWARE_SUPPORT)
+  return MPIX_Query_cuda_support();
+#else
+  return true;
+#endif
+}
+/***********************************************************************************************/
 #define PCLoad acPushToConfig
 /***********************************************************************************************/
 void setupConfig(AcMeshInfo& config)
@@ -721,6 +890,12 @@ void setupConfig(AcMeshInfo& config)
   config = acInitInfo();
   #include "PC_modulepars.h"
   
+  //Without GPU-aware MPI the halo exchange from device buffers would fail or silently go wrong, so use host staging
+  if (lcuda_aware_mpi && !gpuAwareMPI())
+  {
+    acLogFromRootProc(rank,"setupConfig: the MPI library is not GPU-aware, halos are exchanged through host memory\n");
+    lcuda_aware_mpi = false;
+  }
   PCLoad(config, AC_use_cuda_aware_mpi,lcuda_aware_mpi);
   PCLoad(config, AC_bidiagonal_derij,lbidiagonal_derij);
   //TP: loads for non-Cartesian derivatives
@@ -760,15 +935,32 @@ void setupConfig(AcMeshInfo& config)
   PCLoad(config, AC_ngrid, (int3){nxgrid,nygrid,nzgrid});
   PCLoad(config, AC_skip_single_gpu_optim, true);
 
+  //On clusters with mixed GPUs, the imbalance this costs can be read off lgpu_timings=T
+  //(pencil.read.gputimings(...).imbalance(region)).
   PCLoad(config,AC_decompose_strategy,AC_DECOMPOSE_STRATEGY_EXTERNAL);
-  if (lmorton_curve)
-    PCLoad(config,AC_proc_mapping_strategy,AC_PROC_MAPPING_STRATEGY_MORTON);
-  else
+  //Astaroth derives the position on the processor grid from the rank and knows only the Morton and linear mappings.
+  //For the others (Hilbert curve, node blocks) it gets a communicator in which the ranks are ordered x fastest by
+  //the position find_proc_coords has assigned, so that both sides agree on the neighbours.
+  static MPI_Comm comm_astaroth = MPI_COMM_NULL;
+  const bool node_blocks = nprocx_node > 0 && nprocy_node > 0 && nprocz_node > 0;
+  if (lhilbert_curve || node_blocks)
+  {
+    if (comm_astaroth == MPI_COMM_NULL) MPI_Comm_split(comm_pencil, 0, ipx + nprocx*(ipy + nprocy*ipz), &comm_astaroth);
     PCLoad(config,AC_proc_mapping_strategy,AC_PROC_MAPPING_STRATEGY_LINEAR);
+  }
+  else
+  {
+    comm_astaroth = comm_pencil;
+    if (lmorton_curve)
+      PCLoad(config,AC_proc_mapping_strategy,AC_PROC_MAPPING_STRATEGY_MORTON);
+    else
+      PCLoad(config,AC_proc_mapping_strategy,AC_PROC_MAPPING_STRATEGY_LINEAR);
+  }
 
+  //Only the model input (UUMEAN) and the smoothing of TAU read the 3D halo corners
   PCLoad(config, AC_include_3d_halo_corners, ltraining);
   PCLoad(config,AC_MPI_comm_strategy,AC_MPI_COMM_STRATEGY_DUP_USER);
-  config.comm->handle = comm_pencil;
+  config.comm->handle = comm_astaroth;
 
 // grid and geometry related parameters
 
@@ -863,6 +1055,22 @@ AcReal max_diffus(AcReal maxnu_dyn, AcReal maxchi_dyn)
   return max_diffusions[0]*dxyz_vals.x/cdtv + max_diffusions[1]*dxyz_vals.y/cdtv2 + max_diffusions[2]*dxyz_vals.z/cdtv3;
 }
 /***********************************************************************************************/
+// With ldt_limiter_report, calc_dt1_courant appends the terms of 1/dt to dt_limiter.dat (rank 0 only, as the
+// reduction outputs are already global maxima).
+static FILE* dt_limiter_file = NULL;
+
+extern "C" void openDtLimiterReport(const char* filename)
+{
+  if (rank != 0) return;
+  dt_limiter_file = fopen(filename,"a");
+  if (dt_limiter_file == NULL)
+  {
+	  fprintf(stderr,"openDtLimiterReport: could not open %s\n",filename);
+	  return;
+  }
+  fprintf(dt_limiter_file,"#%15s %16s %16s %16s %16s %16s\n","t","dt1","dt1_advec","dt1_diffus","maxnu_dyn","maxchi_dyn");
+}
+/***********************************************************************************************/
 AcReal calc_dt1_courant(const AcReal t)
 {
 #if TRANSPILATION
@@ -887,11 +1095,30 @@ AcReal calc_dt1_courant(const AcReal t)
       maxnu_dyn = acDeviceGetOutput(acGridGetDevice(), AC_maxnu);
 //if (rank==0) printf("maxnu_dyn= %e \n", maxnu_dyn);
 #endif
-      return (AcReal)sqrt(pow(maxadvec, 2) + pow(max_diffus(maxnu_dyn,maxchi_dyn), 2));
+      const AcReal maxdiffus = max_diffus(maxnu_dyn,maxchi_dyn);
+      const AcReal dt1 = (AcReal)sqrt(pow(maxadvec, 2) + pow(maxdiffus, 2));
+      if (dt_limiter_file != NULL)
+	      fprintf(dt_limiter_file,"%16.8e %16.8e %16.8e %16.8e %16.8e %16.8e\n",
+	              (double)t,(double)dt1,(double)maxadvec,(double)maxdiffus,(double)maxnu_dyn,(double)maxchi_dyn);
+      return dt1;
+}
+/***********************************************************************************************/
+// The Courant reductions are done only in the first substep (step_num == 0) and their outputs are not touched by the
+// later substeps, so reading them back is deferred until the value is really needed, i.e., when AC_dt is set at the
+// beginning of the next timestep. This keeps the host read-out off the critical path of substep 1.
+static bool courant_dt_pending = false;
+static AcReal courant_dt_t;
+
+void resolveCourantDt()
+{
+  if (!courant_dt_pending) return;
+  dt1_interface = calc_dt1_courant(courant_dt_t);
+  courant_dt_pending = false;
 }
 /***********************************************************************************************/
 AcReal GpuCalcDt(const AcReal t)
 {
+  markDeviceDirty();
 	acGridSynchronizeStream(STREAM_ALL);
   	acDeviceSetInput(acGridGetDevice(), AC_step_num, (PC_SUB_STEP_NUMBER) 0);
 	const auto graph = acGetOptimizedDSLTaskGraph(AC_calculate_timestep);
@@ -903,6 +1130,7 @@ AcReal GpuCalcDt(const AcReal t)
 /***********************************************************************************************/
 extern "C" void sourceFunctionAndOpacity(int inu)
 {
+  markDeviceDirty();
 #if LRADIATION
   	acDeviceSetInput(acGridGetDevice(), AC_frequency_bin,inu);
 	acGridHaloExchange();
@@ -916,6 +1144,7 @@ extern "C" void sourceFunctionAndOpacity(int inu)
 /*
 extern "C" void testBcKernel(AcReal *farray_in, AcReal *farray_truth)
 {
+  markDeviceDirty();
   AcMesh mesh_true;
   AcMesh mesh_test;
   AcReal epsilon = 0.00001;
@@ -1065,53 +1294,149 @@ extern "C" void registerGPU()
 #endif
 }
 /***********************************************************************************************/
+#if TRAINING && !AC_CPU_BUILD
+// Asynchronous training (ltrain_async in training_run_pars): every prepared sample, i.e., the scaled UUMEAN and TAU,
+// is copied into a device ring of the latest ntrain_replay samples, on which a host thread of its own then trains
+// TorchFort on a separate stream while the solver advances. The loss handed back is the one of the previous call.
+// A new sample waits for the training on the previous ones to finish, so the model lags by at most it_train steps
+// and all ranks enter the distributed model in the same order. Requires MPI_THREAD_MULTIPLE.
+static std::thread train_thread;
+static std::mutex train_mutex;
+static std::condition_variable train_cv;
+static bool train_busy = false;
+static bool train_quit = false;
+static bool train_async_failed = false;
+static int train_head = -1, train_filled = 0, train_nreplay = 1;
+static float train_loss = 0.;
+static int train_device = 0;
+static cudaStream_t train_stream = NULL;
+static char* train_replay = NULL;
+static size_t train_slot_bytes = 0;
+static TrainingTensors train_sample;     // shapes of the samples in the ring
+/***********************************************************************************************/
+void trainingWorker()
+{
+  cudaSetDevice(train_device);
+  std::unique_lock<std::mutex> lock(train_mutex);
+  while (true)
+  {
+	  train_cv.wait(lock, []{ return train_busy || train_quit; });
+	  if (train_quit) return;
+	  const int head = train_head, nsamples = train_filled;
+	  TrainingTensors shape = train_sample;
+	  lock.unlock();
+
+	  float loss = 0.;
+	  //Oldest sample first, so that the model sees the latest one last
+	  for (int i = nsamples-1; i >= 0; --i)
+	  {
+		  char* sample = &train_replay[((head-i+train_nreplay) % train_nreplay)*train_slot_bytes];
+		  torch_trainCAPI(shape.dims, (float*)sample, (float*)&sample[shape.input_bytes], &loss, shape.dble, train_stream);
+	  }
+	  cudaStreamSynchronize(train_stream);
+
+	  lock.lock();
+	  train_loss = loss;
+	  train_busy = false;
+	  train_cv.notify_all();
+  }
+}
+/***********************************************************************************************/
+bool initAsyncTraining()
+{
+  if (train_thread.joinable()) return true;
+  if (train_async_failed) return false;
+  train_async_failed = true;
+
+  int provided;
+  MPI_Query_thread(&provided);
+  if (provided < MPI_THREAD_MULTIPLE)
+  {
+	  acLogFromRootProc(rank,"initAsyncTraining: MPI is not initialized with MPI_THREAD_MULTIPLE, training synchronously\n");
+	  return false;
+  }
+  train_nreplay = std::max(ntrain_replay,1);
+  //Large enough for the unpacked samples, which are never smaller than the packed ones
+  train_slot_bytes = 9*acVertexBufferSizeBytes(mesh.info);
+  const size_t bytes = train_nreplay*train_slot_bytes;
+  bool ok = cudaGetDevice(&train_device) == cudaSuccess
+         && cudaStreamCreateWithFlags(&train_stream, cudaStreamNonBlocking) == cudaSuccess
+         && cudaMalloc((void**)&train_replay, bytes) == cudaSuccess;
+  if (!ok)
+  {
+	  acLogFromRootProc(rank,"initAsyncTraining: could not allocate the replay buffer (%s), training synchronously\n",
+			    cudaGetErrorString(cudaGetLastError()));
+	  return false;
+  }
+  train_async_failed = false;
+  train_thread = std::thread(trainingWorker);
+  return true;
+}
+/***********************************************************************************************/
+void trainAsync(const TrainingTensors tensors, AcReal* loss_val)
+//
+//  Queues the current sample for the training thread.
+//
+{
+  std::unique_lock<std::mutex> lock(train_mutex);
+  train_cv.wait(lock, []{ return !train_busy; });
+
+  train_head = (train_head+1) % train_nreplay;
+  train_filled = std::min(train_filled+1, train_nreplay);
+  train_sample = tensors;
+  char* sample = &train_replay[train_head*train_slot_bytes];
+  //Ordered before the training on the same stream; the tensors are only rewritten by the next preparation
+  cudaMemcpyAsync(sample, tensors.input, tensors.input_bytes, cudaMemcpyDeviceToDevice, train_stream);
+  cudaMemcpyAsync(&sample[tensors.input_bytes], tensors.label, tensors.label_bytes, cudaMemcpyDeviceToDevice, train_stream);
+
+  *loss_val = train_loss;
+  train_busy = true;
+  train_cv.notify_all();
+}
+/***********************************************************************************************/
+void finalAsyncTraining()
+{
+  if (train_thread.joinable())
+  {
+	  {
+		  std::unique_lock<std::mutex> lock(train_mutex);
+		  train_cv.wait(lock, []{ return !train_busy; });
+		  train_quit = true;
+	  }
+	  train_cv.notify_all();
+	  train_thread.join();
+  }
+  if (train_replay != NULL) cudaFree(train_replay);
+  if (train_stream != NULL) cudaStreamDestroy(train_stream);
+  train_replay = NULL;
+  train_stream = NULL;
+}
+#endif
+/***********************************************************************************************/
 extern "C" void torch_train_c_api(AcReal *loss_val) {
+  markDeviceDirty();
 #if TRAINING
   #include "user_constants.h"
 	
-  auto calc_uumean_tau = acGetOptimizedDSLTaskGraph(initialize_uumean_tau);
-  acGridSynchronizeStream(STREAM_ALL);
-  acGridExecuteTaskGraph(calc_uumean_tau, 1);
-  acGridSynchronizeStream(STREAM_ALL);
-
-  auto bcs = acGetOptimizedDSLTaskGraph(boundconds);	
-  acGridSynchronizeStream(STREAM_ALL);
-  acGridExecuteTaskGraph(bcs,1);
-  acGridSynchronizeStream(STREAM_ALL);
-  
-  if (!calculated_coeff_scales){
-  	scaling();
-  }
-
-  auto scale_uumean_tau = acGetOptimizedDSLTaskGraph(scale);
-  acGridSynchronizeStream(STREAM_ALL);
-  acGridExecuteTaskGraph(scale_uumean_tau, 1);
-  acGridSynchronizeStream(STREAM_ALL);
-
-
-  bcs = acGetOptimizedDSLTaskGraph(boundconds);	
-  acGridSynchronizeStream(STREAM_ALL);
-  acGridExecuteTaskGraph(bcs,1);
-  acGridSynchronizeStream(STREAM_ALL);
-  
-  AcReal* out = NULL;
-  
-  AcReal* uumean_ptr = NULL;
-  AcReal* TAU_ptr = NULL;
+  prepareTrainingSample();
   *loss_val = 0.1;
-  
-  acDeviceGetVertexBufferPtrs(acGridGetDevice(), TAU.xx, &TAU_ptr, &out);
-  acDeviceGetVertexBufferPtrs(acGridGetDevice(), UUMEAN.x, &uumean_ptr, &out);
-  
-  
   acGridHaloExchange();
-  
+
+  TrainingTensors tensors = trainingTensors(TAU.xx, true);
+#if !AC_CPU_BUILD
+  if (ltrain_async && initAsyncTraining())
+  {
+	  trainAsync(tensors, loss_val);
+	  train_counter++;
+	  return;
+  }
+#endif
   double start, end;
   
   start = MPI_Wtime();
   float avgloss = 0;
   
-  torch_trainCAPI((int[]){mx,my,mz}, uumean_ptr, TAU_ptr, loss_val, AC_DOUBLE_PRECISION);
+  torch_trainCAPI(tensors.dims, (float*)tensors.input, (float*)tensors.label, loss_val, tensors.dble);
   /*
   for (int batch = 0; batch<5; batch++){
   	torch_trainCAPI((int[]){mx,my,mz}, uumean_ptr, TAU_ptr, loss_val, AC_DOUBLE_PRECISION);
@@ -1134,7 +1459,7 @@ void scaling(){
 		
   	auto bcs = acGetOptimizedDSLTaskGraph(boundconds);	
 	acGridSynchronizeStream(STREAM_ALL);
-	acGridExecuteTaskGraph(bcs,1);
+	executeBoundconds(bcs);
 	acGridSynchronizeStream(STREAM_ALL);
 
 	calculated_coeff_scales = true;
@@ -1156,32 +1481,97 @@ load_f_ode()
 #endif
 }
 /***********************************************************************************************/
+#if LNEWTON_COOLING
+void integrateTauGPU()
+//
+//  Optical depths of Newton cooling along y (see special/newton_cooling.f90): every rank scans its own columns of
+//  DTAU on the GPU and only the nx*nz column totals are combined across the processors in y, with a prefix sum
+//  and an allreduce which take O(log nprocy) steps, instead of sweeping the rays through the ranks one after another.
+//
+{
+  static MPI_Comm comm_y = MPI_COMM_NULL;
+  if (comm_y == MPI_COMM_NULL) MPI_Comm_split(comm_pencil, ipx + nprocx*ipz, ipy, &comm_y);
+  const MPI_Datatype real_type = sizeof(AcReal) == sizeof(double) ? MPI_DOUBLE : MPI_FLOAT;
+
+  acGridSynchronizeStream(STREAM_ALL);
+  AcReal *dtau = NULL, *up = NULL, *down = NULL, *out = NULL;
+  acDeviceGetVertexBufferPtrs(acGridGetDevice(), F_TAU, &dtau, &out);
+  acDeviceGetVertexBufferPtrs(acGridGetDevice(), TAU_BELOW, &up, &out);
+  acDeviceGetVertexBufferPtrs(acGridGetDevice(), TAU_ABOVE, &down, &out);
+
+  const GpuGridDims dims = {mx, my, mz, NGHOST, NGHOST, NGHOST, nx, ny, nz};
+  const int ncols = nx*nz;
+  static std::vector<AcReal> totals, inclusive, offsets;
+  totals.resize(ncols); inclusive.resize(ncols); offsets.resize(2*ncols);
+
+  gpuColumnScanY(dtau,dims,up,down,totals.data());
+  //Offsets: sum of the columns of the ranks below (for the upward scan) and above (for the downward scan)
+  MPI_Scan(totals.data(), inclusive.data(), ncols, real_type, MPI_SUM, comm_y);
+  for (int i = 0; i < ncols; i++) offsets[i] = inclusive[i] - totals[i];
+  MPI_Allreduce(MPI_IN_PLACE, totals.data(), ncols, real_type, MPI_SUM, comm_y);
+  for (int i = 0; i < ncols; i++) offsets[ncols+i] = totals[i] - inclusive[i];
+  gpuColumnOffsetMinY(up,down,dims,offsets.data(),dtau);
+}
+#endif
+/***********************************************************************************************/
+// Whether the AC_rhs graphs of all substeps have been tuned for AC_lrmv=false/true.
+static bool substeps_tuned[2] = {false,false};
+void autotuneSubsteps(const bool lrmv_);
+
 extern "C" void beforeBoundaryGPU(bool lrmv, int isubstep, double t)
 {
+  const bool reductions_done = before_boundary_reductions_done;
+  if (isubstep == 1 && !substeps_tuned[lrmv])
+  {
+	//Lazy autotuning: at the start of a timestep, the output buffers carry no meaning yet, as after afterTimeStepGPU
+	//at initialization, so the variant can be tuned here on the actual fields.
+	const double start = MPI_Wtime();
+	autotuneSubsteps(lrmv);
+	acDeviceSetInput(acGridGetDevice(), AC_step_num,(PC_SUB_STEP_NUMBER)0);
+	acLogFromRootProc(rank,"beforeBoundaryGPU: tuning for lrmv=%d took %f s\n",int(lrmv),MPI_Wtime()-start);
+  }
+  markDeviceDirty();
 	//TP: has to be done here since before boundary can use the ode array
 	load_f_ode();
  	acDeviceSetInput(acGridGetDevice(), AC_lrmv,lrmv);
  	acDeviceSetInput(acGridGetDevice(), AC_t,AcReal(t));
-	acGridExecuteTaskGraph(acGetOptimizedDSLTaskGraph(AC_before_boundary_steps),1);
+	{
+		GpuRegion region(GPU_REGION_BEFORE_BOUNDARY,lgpu_timings);
+		//Only fix_mass_drift remains if the last substep left the fields untouched since its reductions
+		acGridExecuteTaskGraph(acGetOptimizedDSLTaskGraph(reductions_done ? AC_before_boundary_fused
+		                                                                    : AC_before_boundary_steps),1);
+	}
 #if LSELFGRAVITY
 	if(t>=tstart_selfgrav)
 	{
+		GpuRegion region(GPU_REGION_SELFGRAVITY,lgpu_timings);
 		acGridExecuteTaskGraph(acGetOptimizedDSLTaskGraph(AC_calc_selfgravity_rhs),1);
-		//TP: A placeholder, in the future choose the number of solving steps based on the norm of the residual
-		for(int i = 0; i < 100; ++i)
+		//Sweep until the relative residual drops below tol_sor_selfgrav, at most niter_sor_selfgrav times
+		const int ncheck = std::max(nsor_check_selfgrav,1);
+		for(int i = 0; i < niter_sor_selfgrav; ++i)
 		{
 			acGridExecuteTaskGraph(acGetOptimizedDSLTaskGraph(AC_sor_step),1);
+			if(tol_sor_selfgrav > 0. && (i+1) % ncheck == 0)
+			{
+				acGridExecuteTaskGraph(acGetOptimizedDSLTaskGraph(AC_sor_residual),1);
+				const AcReal residual = acDeviceGetOutput(acGridGetDevice(), AC_sor_residual);
+				const AcReal rhs_max  = acDeviceGetOutput(acGridGetDevice(), AC_sor_rhs_max);
+				if(residual <= tol_sor_selfgrav*rhs_max) break;
+			}
 		}
 		acGridExecuteTaskGraph(acGetOptimizedDSLTaskGraph(AC_calc_final_potential),1);
 	}
 #endif
 #if LNEWTON_COOLING
-	acGridExecuteTaskGraph(acGetOptimizedDSLTaskGraph(AC_integrate_tau),1);
+	acGridExecuteTaskGraph(acGetOptimizedDSLTaskGraph(AC_calc_kappar_and_dtau),1);
+	integrateTauGPU();
 #endif
 }
 /***********************************************************************************************/
 extern "C" void afterTimeStepGPU()
 {
+  markDeviceDirty();
+  GpuRegion region(GPU_REGION_AFTER_TIMESTEP,lgpu_timings);
   	if(acDeviceGetInput(acGridGetDevice(), AC_step_num) == PC_FIRST_SUB_STEP)
 	{
 #if LGRAVITATIONAL_WAVES_HTXK
@@ -1202,19 +1592,17 @@ extern "C" void substepGPU(int isubstep, double t)
 //  Do the 'isubstep'th integration step on all GPUs on the node and handle boundaries.
 //
 {
-   //TP: logs performance metrics of Astaroth
-   const bool log = false;
+  markDeviceDirty();
 #if LFORCING
-  //Update forcing params
    if (lsecond_force) 
    {
 	   fprintf(stderr,"Second forcing force not yet implemented on GPU!\n");
 	   exit(EXIT_FAILURE);
    }
-   if (isubstep == itorder) forcing_params.Update();  // calculate on CPU and load into GPU
 #endif
   acDeviceSetInput(acGridGetDevice(), AC_step_num,(PC_SUB_STEP_NUMBER) (isubstep-1));
-  if (lshear && isubstep == 1) acDeviceSetInput(acGridGetDevice(), AC_shear_delta_y, deltay);
+  //deltay is advanced after every substep (advance_shear)
+  if (lshear) acDeviceSetInput(acGridGetDevice(), AC_shear_delta_y, deltay);
   Device dev = acGridGetDevice();
   //TP: done in this more complex manner to ensure the actually integrated time and the time reported by Pencil agree
   //if we call set_dt after the first timestep there would be slight shift in dt what Pencil sees and what is actually used for time integration
@@ -1222,17 +1610,36 @@ extern "C" void substepGPU(int isubstep, double t)
   if (isubstep == 1) 
   {
 	  //TP: done to have the same timestep as PC when testing
+	  resolveCourantDt();
 	  if (ldt && lcourant_dt && lcpu_timestep_on_gpu) dt1_interface = GpuCalcDt(AcReal(t));
-	  if (ldt) set_dt(dt1_interface);
+	  //The outputs of the reductions are already maxima over the whole grid, no need for another allreduce on the host.
+	  if (ldt) set_dt_global(dt1_interface);
 	  acDeviceSetInput(acGridGetDevice(), AC_dt,dt);
   }
+#if LFORCING
+  //Update forcing params
+  if (isubstep == 1) forcing_params.Draw();       // calculate on CPU while the first substeps run
+  if (isubstep == itorder) forcing_params.Update();  // load into GPU
+#endif
   acDeviceSetInput(acGridGetDevice(), AC_t,(AcReal)t);
   //fprintf(stderr,"before acGridExecuteTaskGraph");
+  //The graph is looked up every substep since acGetOptimizedDSLTaskGraph specializes it for the current inputs (AC_step_num, AC_lrmv).
+  //Capturing the whole timestep into a single CUDA/HIP graph is not possible as long as the task graphs do their halo exchanges
+  //with MPI and synchronize the host in between.
   AcTaskGraph *rhs =  acGetOptimizedDSLTaskGraph(AC_rhs);
-  auto start = MPI_Wtime();
-  acGridExecuteTaskGraph(rhs, 1);
-  auto end = MPI_Wtime();
-  if (log && !rank) fprintf(stderr,"RHS TOOK: %14e\n",end-start);
+  if (lgpu_timings)
+  {
+    //Probe: the halo exchange and boundary conditions of AC_rhs on their own, see writeGPUTimings.
+    //Harmless, as the boundconds graph only rewrites the ghost zones from the unchanged interior.
+    GpuRegion region(GPU_REGION_HALO_PROBE,true);
+    acGridExecuteTaskGraph(acGetOptimizedDSLTaskGraph(boundconds),1);
+  }
+  {
+    GpuRegion region(GPU_REGION_RHS,lgpu_timings);
+    GpuRegion region_substep(GpuRegionId(GPU_REGION_RHS_SUBSTEP+std::min(isubstep,GPU_MAX_SUBSTEPS)-1),lgpu_timings);
+    acGridExecuteTaskGraph(rhs, 1);
+  }
+  before_boundary_reductions_done = true;
   if (ldt && (   (isubstep == 5 && !lcourant_dt) 
               || (isubstep == 1 &&  lcourant_dt)
              )
@@ -1263,33 +1670,116 @@ extern "C" void substepGPU(int isubstep, double t)
     }
     else 
     {
-      dt1_ = calc_dt1_courant(AcReal(t));
+      //read out only in resolveCourantDt
+      courant_dt_t = AcReal(t);
+      courant_dt_pending = true;
+      return;
     }
     dt1_interface = dt1_;
   }
   return;
 }
 /***********************************************************************************************/
-void copyFarray(AcReal* f)
+// Per-vertex-buffer dirty tracking for the host<->device transfers.
+// host_dirty:   changed on the host (marked from Fortran via markFarrayDirty), to be uploaded by loadFarray.
+//               If no bit is set, loadFarray uploads everything as before.
+// device_dirty: possibly changed on the device since the last loadFarray/copyFarray, to be downloaded by copyFarray.
+//               Only the fields updated by the GPU graphs, i.e., mvar and the auxiliaries living on the GPU, ever get set;
+//               the trailing mfarray-mvar-maux slots are never written on the device.
+static bool vtxbuf_host_dirty[NUM_VTXBUF_HANDLES]{};
+static bool vtxbuf_device_dirty[NUM_VTXBUF_HANDLES]{};
+static bool any_host_dirty = false;
+//Host copy of the scalar outputs read by getGPUReducedVars; stale once graphs have run again
+static bool gpu_reduced_vars_valid = false;
+
+int numAuxOnGPU()
+{
+  int n_aux_on_gpu = 0;
+  for (int i = 0; i < mfarray; ++i)
+    if (maux_vtxbuf_index[i] != -1) ++n_aux_on_gpu;
+  return n_aux_on_gpu;
+}
+/***********************************************************************************************/
+int farrayToVtxbuf(const int ivar)
+//
+//  Maps a 0-based f-array slot onto the vertex buffer handle holding it, -1 if it is not on the GPU.
+//
+{
+  if (ivar < mvar) return ivar;
+  if (maux_vtxbuf_index[ivar] != -1) return maux_vtxbuf_index[ivar];
+  if (ivar >= mvar+maux) return mvar + numAuxOnGPU() + (ivar-mvar-maux);
+  return -1;
+}
+/***********************************************************************************************/
+void markDeviceDirty()
+//
+//  Called whenever task graphs or kernels have run: anything but the CPU-only trailing slots may have changed.
+//
+{
+  const int start_cpu_only = mvar + numAuxOnGPU();
+  const int end_cpu_only   = start_cpu_only + mfarray-mvar-maux;
+  for (int i = 0; i < NUM_VTXBUF_HANDLES; ++i)
+    if (i < start_cpu_only || i >= end_cpu_only) vtxbuf_device_dirty[i] = true;
+  gpu_reduced_vars_valid = false;
+  before_boundary_reductions_done = false;
+}
+/***********************************************************************************************/
+extern "C" void markFarrayDirty(int ivar1, int ivar2)
+//
+//  Flags the f-array slots ivar1..ivar2 (Fortran indexing) as changed on the host.
+//
+{
+  for (int ivar = ivar1-1; ivar < ivar2; ++ivar)
+  {
+    const int handle = farrayToVtxbuf(ivar);
+    if (handle == -1) continue;
+    vtxbuf_host_dirty[handle] = true;
+    any_host_dirty = true;
+  }
+}
+/***********************************************************************************************/
+int numCopiedVtxbufs()
 {
-  #include "user_constants.h"
-
-  acGridSynchronizeStream(STREAM_ALL);
   //TP: for now only copy the advanced fields back
   //TODO: should auxiliaries needed on the GPU like e.g. Shock be copied? They can always be recomputed on the host if needed
   //If doing training we read all since we might want TAU components to calculate e.g. validation error
-  const int end = ltraining ? NUM_VTXBUF_HANDLES : 
-	  	  lread_all_vars_from_device ? mfarray : mvar;
+  return ltraining ? NUM_VTXBUF_HANDLES : 
+	 lread_all_vars_from_device ? mfarray : mvar;
+}
+/***********************************************************************************************/
+// Astaroth does not allocate ghost zones for inactive dimensions for 1d simulations, so their vertex buffers are staged
+// through a separate host mesh; it is allocated on first use and kept until finalizeGPU instead of per transfer.
+static AcMesh staging_mesh_1d;
+static bool staging_mesh_1d_allocated = false;
 
-  AcMesh* dst = &mesh;
-  AcMesh tmp;
-  if(dimensionality == 1)
+AcMesh* stagingMesh1D()
+{
+  if (!staging_mesh_1d_allocated)
   {
-  	acHostMeshCopy(mesh, &tmp);
-	dst = &tmp;
+	  acHostMeshCopy(mesh, &staging_mesh_1d);
+	  staging_mesh_1d_allocated = true;
   }
+  return &staging_mesh_1d;
+}
+/***********************************************************************************************/
+void destroyStagingMesh1D()
+{
+  if (staging_mesh_1d_allocated) acHostMeshDestroy(&staging_mesh_1d);
+  staging_mesh_1d_allocated = false;
+}
+/***********************************************************************************************/
+void copyFarray(AcReal* f)
+{
+  #include "user_constants.h"
+
+  GpuRegion region(GPU_REGION_COPY_FARRAY,lgpu_timings);
+  acGridSynchronizeStream(STREAM_ALL);
+  const int end = numCopiedVtxbufs();
+
+  AcMesh* dst = (dimensionality == 1) ? stagingMesh1D() : &mesh;
   for (int i = 0; i < end; ++i)
   {
+	  if (!vtxbuf_device_dirty[i]) continue;
 	  acDeviceStoreVertexBuffer(acGridGetDevice(),STREAM_DEFAULT,VertexBufferHandle(i),dst);
   }
   acGridSynchronizeStream(STREAM_ALL);
@@ -1300,6 +1790,7 @@ void copyFarray(AcReal* f)
   	for (int i = 0; i < end; ++i)
   	{
 		if(i >= mvar && maux_vtxbuf_index[i] == -1) continue;
+		if(!vtxbuf_device_dirty[i]) continue;
  		if(nxgrid != 1)
 		{
 			for(int x = 0; x < nx; ++x)
@@ -1325,50 +1816,793 @@ void copyFarray(AcReal* f)
 			}
 		}
 	}
-  	acHostMeshDestroy(&tmp);
   }
+  for (int i = 0; i < end; ++i) vtxbuf_device_dirty[i] = false;
 }
 /***********************************************************************************************/
-void checkConfig(AcMeshInfo &config)
+extern "C" void copySlices(AcReal* f, const int* planes)
+//
+//  Downloads only the slabs of half-width NGHOST around the active video slice planes, enough for the slice
+//  quantities which are derived with finite differences. planes holds the (1-based) positions
+//  ix_loc; iy_loc, iy2_loc; iz_loc, iz2_loc, iz3_loc, iz4_loc with 0 for a plane not written by this rank.
+//  The device-dirty flags are left set, so that a later copyFarray still downloads everything.
+//
 {
- acLogFromRootProc(rank,"Check that config is correct\n");
- acLogFromRootProc(rank,"d[xyz]: %.14f %.14f %.14f \n", dx, dy, dz);
-// acLogFromRootProc(rank,"rank= %d: l1, l2, n1, n2, m1, m2= %d %d %d %d %d %d \n", rank, l1, l2, n1, n2, m1, m2);
-// acLogFromRootProc(rank,"zlen= %.14f %.14f \n", config[AC_len].z, lxyz[2]);
- /*
-#if LHYDRO
- acLogFromRootProc(rank,"lpressuregradientgas= %d %d \n", lpressuregradient_gas, config[AC_lpressuregradient_gas]);
-#endif
-#if LENTROPY
- acLogFromRootProc(rank,"chi= %f %f \n", chi, config[AC_chi]);
- acLogFromRootProc(rank,"nkramers= %f %f \n", nkramers, config[AC_nkramers]);
- acLogFromRootProc(rank,"hcond0_kramers= %f %f \n", hcond0_kramers, config[AC_hcond0_kramers]);
- acLogFromRootProc(rank,"hcond_Kconst= %f %f \n", hcond_Kconst, config[AC_hcond_Kconst]);
- //acLogFromRootProc(rank,"Fbot= %f %f \n", Fbot, config[AC_Fbot]);
- acLogFromRootProc(rank,"chi_t= %f %f \n", chi_t, config[AC_chi_t]);
-#endif
-#if LVISCOSITY
- acLogFromRootProc(rank,"nu= %f %f \n", nu, config[AC_nu]);
- acLogFromRootProc(rank,"zeta= %f %f \n", zeta, config[AC_zeta]);
-#endif
-#if LMAGNETIC
-  acLogFromRootProc(rank,"eta= %f %f \n", eta, config[AC_eta]);
-#endif
-#if LEOS
-  acLogFromRootProc(rank,"cs20= %f %f \n", cs20, config[AC_cs20]);
-  //  acLogFromRootProc(rank,"gamma= %f %f \n", gamma, get_real_param(config,comp_infoAC_gamma));
-  acLogFromRootProc(rank,"gamma_m1= %f %f \n", gamma_m1, config[AC_gamma_m1]);
-  acLogFromRootProc(rank,"gamma1= %f %f \n", gamma1, config[AC_gamma1]);
-  acLogFromRootProc(rank,"cv= %f %f \n", cv, config[AC_cv]);
-  acLogFromRootProc(rank,"cp= %f %f \n", cp, config[AC_cp]);
-  acLogFromRootProc(rank,"lnT0= %f %f \n", lnTT0, config[AC_lnTT0]);
-  acLogFromRootProc(rank,"lnrho0= %f %f \n", lnrho0, config[AC_lnrho0]);
-#endif
-#if LFORCING
-  acLogFromRootProc(rank,"iforcing_zsym= %f %f \n", iforcing_zsym, config[AC_iforcing_zsym]);
-  acLogFromRootProc(rank,"k1_ff= %f %f \n", k1_ff, config[AC_k1_ff]);
-  acLogFromRootProc(rank,"tforce_stop= %f %f \n", tforce_stop, config[AC_tforce_stop]);
-  acLogFromRootProc(rank,"k1_ff,profx_ampl, val= %f %d %lf %lf\n", k1_ff, profx_ampl, profx_ampl[0], profx_ampl[nx-1]);
+#if !AC_CPU_BUILD
+  if (dimensionality == 3)
+  {
+	  GpuRegion region(GPU_REGION_COPY_FARRAY,lgpu_timings);
+	  acGridSynchronizeStream(STREAM_ALL);
+	  const size_t bytes = sizeof(AcReal);
+	  //Index range [first,first+width) of the slab around a Fortran plane index within 0..extent-1
+	  const auto slab = [](const int plane, const int extent, int& first, int& width)
+	  {
+		  first = std::max(plane-1-NGHOST,0);
+		  width = std::min(plane+NGHOST,extent) - first;
+	  };
+	  int first, width;
+	  for (int i = 0; i < numCopiedVtxbufs(); ++i)
+	  {
+		  if (mesh.vertex_buffer[i] == NULL || !vtxbuf_device_dirty[i]) continue;
+		  AcReal* in  = NULL;
+		  AcReal* out = NULL;
+		  acDeviceGetVertexBufferPtrs(acGridGetDevice(),VertexBufferHandle(i),&in,&out);
+		  AcReal* host = mesh.vertex_buffer[i];
+		  if (planes[0] > 0)
+		  {
+			  slab(planes[0],mx,first,width);
+			  cudaMemcpy2D(&host[first], mx*bytes, &in[first], mx*bytes, width*bytes, (size_t)my*mz, cudaMemcpyDeviceToHost);
+		  }
+		  for (int j = 1; j <= 2; ++j)
+		  {
+			  if (planes[j] <= 0) continue;
+			  slab(planes[j],my,first,width);
+			  cudaMemcpy2D(&host[first*mx], mx*my*bytes, &in[first*mx], mx*my*bytes, width*mx*bytes, mz, cudaMemcpyDeviceToHost);
+		  }
+		  for (int j = 3; j <= 6; ++j)
+		  {
+			  if (planes[j] <= 0) continue;
+			  slab(planes[j],mz,first,width);
+			  cudaMemcpy(&host[(size_t)first*mx*my], &in[(size_t)first*mx*my], width*mx*my*bytes, cudaMemcpyDeviceToHost);
+		  }
+	  }
+	  return;
+  }
+#endif
+  //Astaroth does not allocate the ghost zones of inactive dimensions, so the plain copy is used
+  copyFarray(f);
+}
+/***********************************************************************************************/
+extern "C" void copyVars(const int ivar1, const int ivar2)
+//
+//  Downloads only the f-array slots ivar1..ivar2 (Fortran indexing) held on the GPU, also auxiliaries which copyFarray
+//  leaves on the device. The pinned f-array serves as their host mirror: slots unchanged on the device since their
+//  last download are skipped, and the downloaded ones are not fetched again by copyFarray.
+//
+{
+  //The 1d staging mesh holds all vertex buffers at once
+  if (dimensionality == 1)
+  {
+	  copyFarray(NULL);
+	  return;
+  }
+  GpuRegion region(GPU_REGION_COPY_FARRAY,lgpu_timings);
+  acGridSynchronizeStream(STREAM_ALL);
+  for (int ivar = ivar1-1; ivar < ivar2; ++ivar)
+  {
+	  const int handle = farrayToVtxbuf(ivar);
+	  if (handle == -1 || mesh.vertex_buffer[handle] == NULL || !vtxbuf_device_dirty[handle]) continue;
+	  acDeviceStoreVertexBuffer(acGridGetDevice(),STREAM_DEFAULT,VertexBufferHandle(handle),&mesh);
+	  vtxbuf_device_dirty[handle] = false;
+  }
+  acGridSynchronizeStream(STREAM_ALL);
+}
+/***********************************************************************************************/
+extern "C" void planeSumsGPU(const int ivar, const int keep_axis, const int power, AcReal* sums)
+//
+//  Sums of f(:,:,:,ivar)**power (power 1 or 2, ivar in Fortran indexing) over the local computational
+//  domain, reduced on the device onto the direction keep_axis: 1,2,3 give profiles in x,y,z of length
+//  nx,ny,nz, while 0 gives the z sums, an nx*ny array. The reduction across processors is left to the caller.
+//
+{
+  const int handle = farrayToVtxbuf(ivar-1);
+  if (handle == -1 || dimensionality != 3)
+  {
+	  fprintf(stderr,"planeSumsGPU: f-array slot %d is not on the GPU or the run is not 3D\n",ivar);
+	  exit(EXIT_FAILURE);
+  }
+  acGridSynchronizeStream(STREAM_ALL);
+  AcReal* in  = NULL;
+  AcReal* out = NULL;
+  acDeviceGetVertexBufferPtrs(acGridGetDevice(),VertexBufferHandle(handle),&in,&out);
+
+  const GpuGridDims dims = {mx, my, mz, NGHOST, NGHOST, NGHOST, nx, ny, nz};
+  if (keep_axis == 0)
+	  gpuZSums(in,dims,power,sums);
+  else
+	  gpuPlaneSums(in,dims,keep_axis-1,power,sums);
+}
+/***********************************************************************************************/
+extern "C" void shearShiftGPU(AcReal dt_shear, bool llast)
+//
+//  Shear advection as a shift (lshearadvection_as_shift): shifts the variables by uy0*dt_shear in y and, unless in
+//  the last substep, also the output buffers which hold their accumulated time derivatives, as advance_shear
+//  does for f and df on the CPU. The interpolation is local, so every processor has to hold the whole y extent.
+//
+{
+  if (!mesh.info[AC_lshearadvection_as_shift__mod__shear]) return;
+  if (nprocy != 1 || !lequidist.y)
+  {
+	  fprintf(stderr,"shearShiftGPU: the shift on the GPU needs nprocy=1 and an equidistant y grid\n");
+	  exit(EXIT_FAILURE);
+  }
+  markDeviceDirty();
+  acGridSynchronizeStream(STREAM_ALL);
+
+  const AcReal* uy0 = mesh.info[AC_uy0__mod__shear];
+  static std::vector<AcReal> shift;
+  shift.resize(nx);
+  for (int i = 0; i < nx; i++)
+  {
+	  const AcReal dist = fmod(uy0[i]*dt_shear,mesh.info[AC_len].y);
+	  shift[i] = dist/dy;
+  }
+  const GpuGridDims dims = {mx, my, mz, NGHOST, NGHOST, NGHOST, nx, ny, nz};
+  for (int ivar = 0; ivar < mvar; ivar++)
+  {
+	  AcReal* in  = NULL;
+	  AcReal* out = NULL;
+	  acDeviceGetVertexBufferPtrs(acGridGetDevice(),VertexBufferHandle(farrayToVtxbuf(ivar)),&in,&out);
+	  gpuShiftY(in,dims,shift.data());
+	  if (!llast) gpuShiftY(out,dims,shift.data());
+  }
+}
+/***********************************************************************************************/
+extern "C" int findNonFiniteGPU(int* pos)
+//
+//  Scans the f-array slots held on the GPU for NaN or Inf in a single kernel launch.
+//  Returns the (1-based) f-array slot of the first offending one, 0 if all values are finite;
+//  pos then gets its 0-based position relative to (l1,m1,n1).
+//
+{
+  std::vector<const AcReal*> fields;
+  std::vector<int> slots;
+  for (int ivar = 0; ivar < mfarray; ++ivar)
+  {
+	  const int handle = farrayToVtxbuf(ivar);
+	  if (handle == -1) continue;
+	  AcReal* in  = NULL;
+	  AcReal* out = NULL;
+	  acDeviceGetVertexBufferPtrs(acGridGetDevice(),VertexBufferHandle(handle),&in,&out);
+	  fields.push_back(in);
+	  slots.push_back(ivar+1);
+  }
+  const AcMeshDims dims = acGetMeshDims(acGridGetLocalMeshInfo());
+  const GpuGridDims grid = {dims.m1.x, dims.m1.y, dims.m1.z, dims.n0.x, dims.n0.y, dims.n0.z,
+                            dims.n1.x-dims.n0.x, dims.n1.y-dims.n0.y, dims.n1.z-dims.n0.z};
+  acGridSynchronizeStream(STREAM_ALL);
+  const int ifield = gpuFindNonFinite(fields.data(),fields.size(),grid,pos);
+  return ifield == -1 ? 0 : slots[ifield];
+}
+/***********************************************************************************************/
+extern "C" void powerSpectraGPU(const int ivar, const bool curl, const AcReal* kx, const AcReal* ky, const AcReal* kz,
+                                const AcReal kscale, const AcReal norm, const int nbins, AcReal* spectrum, AcReal* helicity)
+//
+//  Shell spectra of the vector f(:,:,:,ivar:ivar+2) (Fortran indexing) from its forward transform on the device,
+//  see gpuShellSpectra: the energy spectrum of the vector itself or of its curl, and the helicity spectrum.
+//  kx, ky, kz are the wavenumbers of the local modes. Only the local shells are returned, without reduction over
+//  the processors. The transforms go into the DSL scratch fields SPECTRUM_RE/IM (DSL/spectra.h).
+//
+{
+#if LPOWER_SPECTRUM
+  if (dimensionality != 3)
+  {
+	  fprintf(stderr,"powerSpectraGPU: only available for 3D runs\n");
+	  exit(EXIT_FAILURE);
+  }
+  acGridSynchronizeStream(STREAM_ALL);
+  const Field re[3] = {acGetSPECTRUM_RE_0(), acGetSPECTRUM_RE_1(), acGetSPECTRUM_RE_2()};
+  const Field im[3] = {acGetSPECTRUM_IM_0(), acGetSPECTRUM_IM_1(), acGetSPECTRUM_IM_2()};
+  GpuSpectralVector vec;
+  for (int i = 0; i < 3; ++i)
+  {
+	  const int handle = farrayToVtxbuf(ivar-1+i);
+	  if (handle == -1)
+	  {
+		  fprintf(stderr,"powerSpectraGPU: f-array slot %d is not on the GPU\n",ivar+i);
+		  exit(EXIT_FAILURE);
+	  }
+	  acDeviceFFTR2Planar(acGridGetDevice(), VertexBufferHandle(handle), re[i], im[i]);
+	  AcReal* out = NULL;
+	  acDeviceGetVertexBufferPtrs(acGridGetDevice(), re[i], (AcReal**)&vec.re[i], &out);
+	  acDeviceGetVertexBufferPtrs(acGridGetDevice(), im[i], (AcReal**)&vec.im[i], &out);
+  }
+  acGridSynchronizeStream(STREAM_ALL);
+  const GpuGridDims dims = {mx, my, mz, NGHOST, NGHOST, NGHOST, nx, ny, nz};
+  gpuShellSpectra(vec,dims,kx,ky,kz,kscale,curl,norm,nbins,spectrum,helicity);
+#else
+  fprintf(stderr,"powerSpectraGPU: Astaroth has been built without POWER=power_spectrum\n");
+  exit(EXIT_FAILURE);
+#endif
+}
+/***********************************************************************************************/
+extern "C" void histogramGPU(const int ivar, const int transform, const AcReal shift, const AcReal scale,
+                             const AcReal a, const AcReal b, const int nbins, int* counts)
+//
+//  Histogram of f(:,:,:,ivar) (Fortran indexing) over the local computational domain, binned on the device,
+//  see gpuHistogram for transform, shift, scale, a and b. The reduction across processors is left to the caller.
+//
+{
+  const int handle = farrayToVtxbuf(ivar-1);
+  if (handle == -1 || dimensionality != 3)
+  {
+	  fprintf(stderr,"histogramGPU: f-array slot %d is not on the GPU or the run is not 3D\n",ivar);
+	  exit(EXIT_FAILURE);
+  }
+  acGridSynchronizeStream(STREAM_ALL);
+  AcReal* in  = NULL;
+  AcReal* out = NULL;
+  acDeviceGetVertexBufferPtrs(acGridGetDevice(),VertexBufferHandle(handle),&in,&out);
+
+  const GpuGridDims dims = {mx, my, mz, NGHOST, NGHOST, NGHOST, nx, ny, nz};
+  gpuHistogram(in,dims,transform,shift,scale,a,b,nbins,counts);
+}
+/***********************************************************************************************/
+extern "C" void structureFunctionsGPU(const int ivar, const int* separations, const int nsep, AcReal* sf)
+//
+//  Sums for the structure functions of f(:,:,:,ivar) (Fortran indexing) along x over the local computational
+//  domain, see gpuStructureFunctionsX. sf is dimensioned (nsep,GPU_SF_QMAX); no reduction across processors.
+//
+{
+  const int handle = farrayToVtxbuf(ivar-1);
+  if (handle == -1 || dimensionality != 3)
+  {
+	  fprintf(stderr,"structureFunctionsGPU: f-array slot %d is not on the GPU or the run is not 3D\n",ivar);
+	  exit(EXIT_FAILURE);
+  }
+  acGridSynchronizeStream(STREAM_ALL);
+  AcReal* in  = NULL;
+  AcReal* out = NULL;
+  acDeviceGetVertexBufferPtrs(acGridGetDevice(),VertexBufferHandle(handle),&in,&out);
+
+  const GpuGridDims dims = {mx, my, mz, NGHOST, NGHOST, NGHOST, nx, ny, nz};
+  gpuStructureFunctionsX(in,dims,separations,nsep,sf);
+}
+/***********************************************************************************************/
+extern "C" void downsampleGPU(const int ivar, const int* first, const int* step, const int* n, AcReal* out)
+//
+//  Every step(i)-th point of f(:,:,:,ivar) (Fortran indexing) along axis i, starting at the 1-based index first(i),
+//  for the downsampled snapshots VARd*; out is dimensioned n(1:3).
+//
+{
+  const int handle = farrayToVtxbuf(ivar-1);
+  if (handle == -1 || dimensionality != 3)
+  {
+	  fprintf(stderr,"downsampleGPU: f-array slot %d is not on the GPU or the run is not 3D\n",ivar);
+	  exit(EXIT_FAILURE);
+  }
+  acGridSynchronizeStream(STREAM_ALL);
+  AcReal* in  = NULL;
+  AcReal* out_buf = NULL;
+  acDeviceGetVertexBufferPtrs(acGridGetDevice(),VertexBufferHandle(handle),&in,&out_buf);
+
+  const GpuGridDims dims = {mx, my, mz, NGHOST, NGHOST, NGHOST, nx, ny, nz};
+  const int first0[3] = {first[0]-1, first[1]-1, first[2]-1};
+  gpuDecimate(in,dims,first0,step,n,out);
+}
+/***********************************************************************************************/
+// Time averages of the Timeavg module (TIMEAVG=timeavg) kept on the device, so that updating them after every
+// time step does not need the state on the host. Only downloaded when a TAVG snapshot or timeavg.dat is written.
+static AcReal* tavg_dev = NULL;
+static std::vector<int> tavg_handles;
+
+extern "C" void initTimeAveragesGPU(const int ntavg, const int* idx, const AcReal* f_tavg)
+//
+//  Sets up the averages of f(:,:,:,idx(1:ntavg)) (Fortran indexing), starting from the host values f_tavg.
+//
+{
+  if (dimensionality != 3)
+  {
+	  fprintf(stderr,"initTimeAveragesGPU: time averages on the GPU need a 3D run\n");
+	  exit(EXIT_FAILURE);
+  }
+  tavg_handles.resize(ntavg);
+  for (int i = 0; i < ntavg; ++i)
+  {
+	  tavg_handles[i] = farrayToVtxbuf(idx[i]-1);
+	  if (tavg_handles[i] == -1)
+	  {
+		  fprintf(stderr,"initTimeAveragesGPU: f-array slot %d is not on the GPU\n",idx[i]);
+		  exit(EXIT_FAILURE);
+	  }
+  }
+  const size_t bytes = sizeof(AcReal)*mw*ntavg;
+#if AC_CPU_BUILD
+  tavg_dev = (AcReal*)malloc(bytes);
+  memcpy(tavg_dev, f_tavg, bytes);
+#else
+  if (cudaMalloc((void**)&tavg_dev, bytes) != cudaSuccess)
+  {
+	  fprintf(stderr,"initTimeAveragesGPU: could not allocate %zu bytes on the device\n",bytes);
+	  exit(EXIT_FAILURE);
+  }
+  cudaMemcpy(tavg_dev, f_tavg, bytes, cudaMemcpyHostToDevice);
+#endif
+}
+/***********************************************************************************************/
+extern "C" void updateTimeAveragesGPU(const AcReal weight)
+{
+  acGridSynchronizeStream(STREAM_ALL);
+  for (size_t i = 0; i < tavg_handles.size(); ++i)
+  {
+	  AcReal* in  = NULL;
+	  AcReal* out = NULL;
+	  acDeviceGetVertexBufferPtrs(acGridGetDevice(),VertexBufferHandle(tavg_handles[i]),&in,&out);
+	  gpuRelax(tavg_dev+i*mw,in,mw,weight);
+  }
+}
+/***********************************************************************************************/
+extern "C" void copyTimeAveragesGPU(AcReal* f_tavg)
+{
+  const size_t bytes = sizeof(AcReal)*mw*tavg_handles.size();
+#if AC_CPU_BUILD
+  memcpy(f_tavg, tavg_dev, bytes);
+#else
+  cudaMemcpy(f_tavg, tavg_dev, bytes, cudaMemcpyDeviceToHost);
+#endif
+}
+/***********************************************************************************************/
+void finalTimeAverages()
+{
+  if (tavg_dev == NULL) return;
+#if AC_CPU_BUILD
+  free(tavg_dev);
+#else
+  cudaFree(tavg_dev);
+#endif
+  tavg_dev = NULL;
+  tavg_handles.clear();
+}
+/***********************************************************************************************/
+// Non-blocking variant of copyFarray for the diagnostics helper thread (lcopy_farray_async).
+// The vertex buffers are first duplicated on the device (cheap), then streamed into a pinned host buffer
+// on a separate stream while the main thread continues with the next substep.
+// The pinned buffer is unpacked into the f-array only once the diagnostics need it, see waitFarrayAsync.
+// 1D runs still go through copyFarray since their vertex buffers do not map one-to-one onto the f-array.
+static bool async_copy_enabled = false;
+static bool snapshot_pending = false;
+static std::mutex snapshot_mutex;
+#if !AC_CPU_BUILD
+static cudaStream_t copy_stream = NULL;
+static cudaEvent_t  snapshot_taken, snapshot_stored;
+static AcReal* snapshot_dev  = NULL;
+static AcReal* snapshot_host = NULL;
+#endif
+/***********************************************************************************************/
+void initAsyncCopy()
+{
+#if !AC_CPU_BUILD
+  if (!lcopy_farray_async || dimensionality == 1) return;
+
+  const size_t bytes = numCopiedVtxbufs()*acVertexBufferSizeBytes(mesh.info);
+  bool ok = cudaStreamCreateWithFlags(&copy_stream, cudaStreamNonBlocking) == cudaSuccess
+         && cudaEventCreateWithFlags(&snapshot_taken, cudaEventDisableTiming) == cudaSuccess
+         && cudaEventCreateWithFlags(&snapshot_stored, cudaEventDisableTiming) == cudaSuccess
+         && cudaMalloc((void**)&snapshot_dev, bytes) == cudaSuccess
+         && cudaMallocHost((void**)&snapshot_host, bytes) == cudaSuccess;
+  if (!ok)
+  {
+	  acLogFromRootProc(rank,"initAsyncCopy: could not allocate snapshot buffers (%s), falling back to blocking copyFarray\n",
+			    cudaGetErrorString(cudaGetLastError()));
+	  return;
+  }
+  async_copy_enabled = true;
+#endif
+}
+/***********************************************************************************************/
+void finalAsyncCopy()
+{
+#if !AC_CPU_BUILD
+  if (copy_stream != NULL) cudaStreamSynchronize(copy_stream);
+  if (snapshot_host != NULL) cudaFreeHost(snapshot_host);
+  if (snapshot_dev != NULL) cudaFree(snapshot_dev);
+  if (async_copy_enabled)
+  {
+	  cudaEventDestroy(snapshot_taken);
+	  cudaEventDestroy(snapshot_stored);
+  }
+  if (copy_stream != NULL) cudaStreamDestroy(copy_stream);
+  snapshot_host = NULL;
+  snapshot_dev  = NULL;
+  copy_stream   = NULL;
+#endif
+  async_copy_enabled = false;
+  snapshot_pending = false;
+}
+/***********************************************************************************************/
+// Page-locking of the f-array (lpin_farray), so that the vertex buffer loads and stores run at full DMA bandwidth
+// instead of being staged through pageable memory by the driver.
+static AcReal* pinned_farray = NULL;
+
+void pinFarray(AcReal* farr)
+{
+#if !AC_CPU_BUILD
+  if (!lpin_farray) return;
+  const size_t bytes = sizeof(AcReal)*mw*mfarray;
+  if (cudaHostRegister(farr, bytes, cudaHostRegisterDefault) != cudaSuccess)
+  {
+	  //Typically the locked-memory limit (ulimit -l) is too small; pageable transfers still work
+	  acLogFromRootProc(rank,"pinFarray: could not page-lock the f-array (%s), using pageable transfers\n",
+			    cudaGetErrorString(cudaGetLastError()));
+	  return;
+  }
+  pinned_farray = farr;
+#endif
+}
+/***********************************************************************************************/
+void unpinFarray()
+{
+#if !AC_CPU_BUILD
+  if (pinned_farray != NULL) cudaHostUnregister(pinned_farray);
+#endif
+  pinned_farray = NULL;
+}
+/***********************************************************************************************/
+// Placement of the host side of a rank next to its GPU (lgpu_numa_placement): the threads are bound to the cores
+// which /sys reports as local to the PCI device, and the f-array and the pinned staging buffers live on its NUMA node.
+// Crossing the socket interconnect otherwise costs a sizeable fraction of the host-device bandwidth.
+static cpu_set_t gpu_local_cpus;
+static bool gpu_local_cpus_found = false;
+static int  gpu_numa_node = -1;
+#define NODEMASK_WORDS (16)
+#define NODEMASK_BITS  (NODEMASK_WORDS*8*sizeof(unsigned long))
+
+static bool gpuNodeMask(unsigned long nodemask[NODEMASK_WORDS])
+{
+  if (gpu_numa_node < 0 || gpu_numa_node >= (int)NODEMASK_BITS) return false;
+  for (int i = 0; i < NODEMASK_WORDS; ++i) nodemask[i] = 0;
+  nodemask[gpu_numa_node/(8*sizeof(unsigned long))] = 1UL << (gpu_numa_node%(8*sizeof(unsigned long)));
+  return true;
+}
+
+static bool parseCpuList(const char* list, cpu_set_t* set)
+{
+  // Linux cpulist format, e.g. "0-15,32-47".
+  CPU_ZERO(set);
+  const char* p = list;
+  while (*p != '\0' && *p != '\n')
+  {
+	  char* end;
+	  const long first = strtol(p, &end, 10);
+	  if (end == p) return false;
+	  long last = first;
+	  if (*end == '-') 
+	  {
+		  p = end+1;
+		  last = strtol(p, &end, 10);
+		  if (end == p) return false;
+	  }
+	  for (long cpu = first; cpu <= last && cpu < CPU_SETSIZE; ++cpu) CPU_SET(cpu, set);
+	  p = (*end == ',') ? end+1 : end;
+  }
+  return CPU_COUNT(set) > 0;
+}
+/***********************************************************************************************/
+void findGPUTopology()
+{
+#if !AC_CPU_BUILD
+  int device;
+  char busid[64];
+  if (cudaGetDevice(&device) != cudaSuccess || cudaDeviceGetPCIBusId(busid, sizeof(busid), device) != cudaSuccess) return;
+
+  //The runtime reports e.g. "0000:3B:00.0", sysfs has lower-case hex without a wider domain field
+  unsigned int domain, bus, dev, func;
+  if (sscanf(busid, "%x:%x:%x.%x", &domain, &bus, &dev, &func) != 4) return;
+  char path[128];
+  snprintf(path, sizeof(path), "/sys/bus/pci/devices/%04x:%02x:%02x.%x/", domain, bus, dev, func);
+
+  char line[4096];
+  FILE* fp = fopen((std::string(path)+"local_cpulist").c_str(), "r");
+  if (fp != NULL)
+  {
+	  if (fgets(line, sizeof(line), fp) != NULL) gpu_local_cpus_found = parseCpuList(line, &gpu_local_cpus);
+	  fclose(fp);
+  }
+  fp = fopen((std::string(path)+"numa_node").c_str(), "r");
+  if (fp != NULL)
+  {
+	  if (fscanf(fp, "%d", &gpu_numa_node) != 1) gpu_numa_node = -1;   // -1 also on non-NUMA machines
+	  fclose(fp);
+  }
+  if (gpu_local_cpus_found)
+  {
+	  //Only cores that the launcher granted are usable; if none of them is close to the GPU, leave the binding alone
+	  cpu_set_t granted;
+	  if (sched_getaffinity(0, sizeof(cpu_set_t), &granted) == 0) CPU_AND(&gpu_local_cpus, &gpu_local_cpus, &granted);
+	  gpu_local_cpus_found = CPU_COUNT(&gpu_local_cpus) > 0;
+	  if (!gpu_local_cpus_found)
+		  fprintf(stderr,"rank %d: none of the granted cores is local to GPU %s, check the binding of the launcher\n",
+			  rank, busid);
+  }
+  if (ldebug) printf("rank %d: GPU %d (%s) on NUMA node %d, %d local cores\n", rank, device, busid, gpu_numa_node,
+		     gpu_local_cpus_found ? CPU_COUNT(&gpu_local_cpus) : 0);
+#endif
+}
+/***********************************************************************************************/
+void checkDeviceOccupancy()
+{
+// The Astaroth grid drives exactly one device per rank, so a node with fewer ranks than visible devices leaves the
+// rest idle and one with more ranks shares them. Either is legal but rarely intended, hence the notice.
+// Sharing is the way to fill a GPU with small independent runs (ensembles of 1d/2d or 32^3 setups): one process
+// per member, started under MPS so that their kernels run concurrently; a mesh holding several members is not
+// supported by Astaroth.
+#if !AC_CPU_BUILD
+  int ndevices = 0;
+  if (cudaGetDeviceCount(&ndevices) != cudaSuccess || ndevices <= 0) return;
+  MPI_Comm comm_node;
+  MPI_Comm_split_type(comm_pencil, MPI_COMM_TYPE_SHARED, rank, MPI_INFO_NULL, &comm_node);
+  int nranks_node;
+  MPI_Comm_size(comm_node, &nranks_node);
+  MPI_Comm_free(&comm_node);
+  int local[2] = {std::max(ndevices-nranks_node,0), std::max(nranks_node-ndevices,0)}, global[2];
+  MPI_Allreduce(local, global, 2, MPI_INT, MPI_MAX, comm_pencil);
+  if (rank == 0 && global[0] > 0)
+    fprintf(stderr,"Notice: up to %d GPUs per node are idle, as each rank drives one GPU; "
+                   "launch one rank per GPU to use all of them\n", global[0]);
+  if (rank == 0 && global[1] > 0)
+    fprintf(stderr,"Notice: up to %d ranks per node share a GPU with another rank\n", global[1]);
+#endif
+}
+/***********************************************************************************************/
+extern "C" void bindThreadNearGPU()
+{
+// Binds the calling thread to the cores local to the GPU of this rank and makes its future allocations
+// prefer the GPU's NUMA node. Threads created afterwards by the calling thread inherit both.
+
+  if (!lgpu_numa_placement) return;
+  if (gpu_local_cpus_found) sched_setaffinity(0, sizeof(cpu_set_t), &gpu_local_cpus);
+  unsigned long nodemask[NODEMASK_WORDS];
+  if (gpuNodeMask(nodemask)) syscall(SYS_set_mempolicy, MPOL_PREFERRED, nodemask, NODEMASK_BITS);
+}
+/***********************************************************************************************/
+void placeFarrayNearGPU(AcReal* farr)
+{
+// Migrates the pages of the (already touched) f-array to the NUMA node of the GPU. Must precede pinFarray,
+// as page-locked memory cannot be moved.
+
+  unsigned long nodemask[NODEMASK_WORDS];
+  if (!lgpu_numa_placement || !gpuNodeMask(nodemask)) return;
+
+  const uintptr_t page  = sysconf(_SC_PAGESIZE);
+  const uintptr_t start = (uintptr_t)farr & ~(page-1);
+  const uintptr_t end   = ((uintptr_t)(farr + mw*mfarray) + page-1) & ~(page-1);
+  if (syscall(SYS_mbind, (void*)start, end-start, MPOL_PREFERRED, nodemask, NODEMASK_BITS, MPOL_MF_MOVE) != 0)
+	  acLogFromRootProc(rank,"placeFarrayNearGPU: could not move the f-array to NUMA node %d (%s)\n", gpu_numa_node,
+			    strerror(errno));
+}
+/***********************************************************************************************/
+void unpackSnapshot()
+{
+#if !AC_CPU_BUILD
+  //Called with snapshot_mutex held.
+  if (!snapshot_pending) return;
+  cudaEventSynchronize(snapshot_stored);
+  const size_t size = acVertexBufferSize(mesh.info);
+  for (int i = 0; i < numCopiedVtxbufs(); ++i)
+  {
+	  if (mesh.vertex_buffer[i] == NULL) continue;
+	  memcpy(mesh.vertex_buffer[i], &snapshot_host[i*size], size*sizeof(AcReal));
+  }
+#endif
+  snapshot_pending = false;
+}
+/***********************************************************************************************/
+extern "C" void copyFarrayAsync()
+{
+  if (!async_copy_enabled)
+  {
+	  copyFarray(NULL);
+	  return;
+  }
+#if !AC_CPU_BUILD
+  std::lock_guard<std::mutex> lock(snapshot_mutex);
+  //Previous snapshot has to be consumed before its buffer is reused
+  unpackSnapshot();
+
+  acGridSynchronizeStream(STREAM_ALL);
+  const size_t size  = acVertexBufferSize(mesh.info);
+  const size_t bytes = acVertexBufferSizeBytes(mesh.info);
+  const int end = numCopiedVtxbufs();
+  for (int i = 0; i < end; ++i)
+  {
+	  AcReal* in  = NULL;
+	  AcReal* out = NULL;
+	  acDeviceGetVertexBufferPtrs(acGridGetDevice(),VertexBufferHandle(i),&in,&out);
+	  cudaMemcpyAsync(&snapshot_dev[i*size], in, bytes, cudaMemcpyDeviceToDevice, copy_stream);
+  }
+  cudaEventRecord(snapshot_taken, copy_stream);
+  cudaMemcpyAsync(snapshot_host, snapshot_dev, end*bytes, cudaMemcpyDeviceToHost, copy_stream);
+  cudaEventRecord(snapshot_stored, copy_stream);
+  snapshot_pending = true;
+
+  //The next substep overwrites the vertex buffers, so only the device-side duplicate has to be complete here.
+  cudaEventSynchronize(snapshot_taken);
+#endif
+}
+/***********************************************************************************************/
+extern "C" void waitFarrayAsync()
+{
+  std::lock_guard<std::mutex> lock(snapshot_mutex);
+  unpackSnapshot();
+}
+/***********************************************************************************************/
+// Snapshots written straight from device memory (lgpu_direct_snapshots). The data record of var.dat/VAR* in the
+// io_dist layout, f(:,:,:,1:nv) as one unformatted sequential record between 4-byte length markers, is streamed from
+// the vertex buffers, which have exactly the layout of the f-array slots, without going through the f-array.
+// With PC_USE_CUFILE it goes via GPUDirect Storage, otherwise, or if the cuFile driver is not available, through a
+// small pinned bounce buffer. Longer records would need the subrecords of the individual Fortran compilers.
+static constexpr size_t DIRECT_SNAPSHOT_CHUNK = size_t(64) << 20;
+static constexpr size_t MAX_RECORD_BYTES = 2147483639;
+static AcReal* snapshot_bounce = NULL;
+
+extern "C" bool directSnapshotPossible(const int nv)
+{
+  if (!lgpu_direct_snapshots || dimensionality != 3 || nv < 1 || nv > mvar) return false;
+  return nv*acVertexBufferSizeBytes(mesh.info) <= MAX_RECORD_BYTES;
+}
+/***********************************************************************************************/
+static bool pwriteAll(const int fd, const void* buffer, const size_t bytes, const off_t offset)
+{
+  size_t done = 0;
+  while (done < bytes)
+  {
+	  const ssize_t written = pwrite(fd, (const char*)buffer + done, bytes - done, offset + done);
+	  if (written < 0 && errno == EINTR) continue;
+	  if (written <= 0) return false;
+	  done += written;
+  }
+  return true;
+}
+/***********************************************************************************************/
+#if PC_USE_CUFILE
+static bool writeVtxbufsCuFile(const char* filename, const int nv, const size_t bytes)
+{
+  static bool driver_tried = false, driver_open = false;
+  if (!driver_tried)
+  {
+	  driver_tried = true;
+	  driver_open = cuFileDriverOpen().err == CU_FILE_SUCCESS;
+	  if (!driver_open) acLogFromRootProc(rank,"cuFile driver not available, snapshots from the GPU go through the host\n");
+  }
+  if (!driver_open) return false;
+
+  const int fd = open(filename, O_WRONLY|O_DIRECT);
+  if (fd == -1) return false;
+  CUfileDescr_t descr{};
+  descr.handle.fd = fd;
+  descr.type = CU_FILE_HANDLE_TYPE_OPAQUE_FD;
+  CUfileHandle_t handle;
+  const bool registered = cuFileHandleRegister(&handle, &descr).err == CU_FILE_SUCCESS;
+  bool ok = registered;
+  for (int i = 0; ok && i < nv; ++i)
+  {
+	  AcReal* in  = NULL;
+	  AcReal* out = NULL;
+	  acDeviceGetVertexBufferPtrs(acGridGetDevice(),VertexBufferHandle(i),&in,&out);
+	  ok = cuFileWrite(handle, in, bytes, sizeof(int32_t) + (off_t)i*bytes, 0) == (ssize_t)bytes;
+  }
+  if (registered) cuFileHandleDeregister(handle);
+  close(fd);
+  return ok;
+}
+#endif
+/***********************************************************************************************/
+static bool writeVtxbufsBounce(const int fd, const int nv, const size_t bytes)
+{
+  for (int i = 0; i < nv; ++i)
+  {
+	  AcReal* in  = NULL;
+	  AcReal* out = NULL;
+	  acDeviceGetVertexBufferPtrs(acGridGetDevice(),VertexBufferHandle(i),&in,&out);
+	  const off_t offset = sizeof(int32_t) + (off_t)i*bytes;
+#if AC_CPU_BUILD
+	  if (!pwriteAll(fd, in, bytes, offset)) return false;
+#else
+	  for (size_t done = 0; done < bytes; done += DIRECT_SNAPSHOT_CHUNK)
+	  {
+		  const size_t chunk = std::min(DIRECT_SNAPSHOT_CHUNK, bytes - done);
+		  if (cudaMemcpy(snapshot_bounce, (char*)in + done, chunk, cudaMemcpyDeviceToHost) != cudaSuccess) return false;
+		  if (!pwriteAll(fd, snapshot_bounce, chunk, offset + done)) return false;
+	  }
+#endif
+  }
+  return true;
+}
+/***********************************************************************************************/
+extern "C" int writeSnapshotGPU(const char* filename, const int nv)
+//
+//  Creates filename with f(:,:,:,1:nv) from the device as its first record; returns 0 on success, -1 otherwise.
+//  The ghost zones are filled on the device first. Must be called only if directSnapshotPossible(nv).
+//
+{
+  GpuRegion region(GPU_REGION_COPY_FARRAY,lgpu_timings);
+  markDeviceDirty();
+  acGridSynchronizeStream(STREAM_ALL);
+  acGridExecuteTaskGraph(acGetOptimizedDSLTaskGraph(boundconds),1);
+  acGridSynchronizeStream(STREAM_ALL);
+
+  const size_t bytes = acVertexBufferSizeBytes(mesh.info);
+  const int32_t marker = nv*bytes;
+  const int fd = open(filename, O_WRONLY|O_CREAT|O_TRUNC, S_IRUSR|S_IWUSR|S_IRGRP|S_IROTH);
+  if (fd == -1) return -1;
+  bool ok = pwriteAll(fd, &marker, sizeof(marker), 0) &&
+            pwriteAll(fd, &marker, sizeof(marker), sizeof(marker) + (off_t)nv*bytes);
+#if PC_USE_CUFILE
+  if (ok && fsync(fd) == 0 && writeVtxbufsCuFile(filename, nv, bytes))
+  {
+	  return close(fd) == 0 ? 0 : -1;
+  }
+#endif
+#if !AC_CPU_BUILD
+  if (ok && snapshot_bounce == NULL && cudaMallocHost((void**)&snapshot_bounce, DIRECT_SNAPSHOT_CHUNK) != cudaSuccess)
+  {
+	  snapshot_bounce = NULL;
+	  ok = false;
+  }
+#endif
+  ok = ok && writeVtxbufsBounce(fd, nv, bytes);
+  if (close(fd) != 0) ok = false;
+  return ok ? 0 : -1;
+}
+/***********************************************************************************************/
+void finalDirectSnapshots()
+{
+#if !AC_CPU_BUILD
+  if (snapshot_bounce != NULL) cudaFreeHost(snapshot_bounce);
+#endif
+  snapshot_bounce = NULL;
+}
+/***********************************************************************************************/
+void checkConfig(AcMeshInfo &config)
+{
+ acLogFromRootProc(rank,"Check that config is correct\n");
+ acLogFromRootProc(rank,"d[xyz]: %.14f %.14f %.14f \n", dx, dy, dz);
+// acLogFromRootProc(rank,"rank= %d: l1, l2, n1, n2, m1, m2= %d %d %d %d %d %d \n", rank, l1, l2, n1, n2, m1, m2);
+// acLogFromRootProc(rank,"zlen= %.14f %.14f \n", config[AC_len].z, lxyz[2]);
+ /*
+#if LHYDRO
+ acLogFromRootProc(rank,"lpressuregradientgas= %d %d \n", lpressuregradient_gas, config[AC_lpressuregradient_gas]);
+#endif
+#if LENTROPY
+ acLogFromRootProc(rank,"chi= %f %f \n", chi, config[AC_chi]);
+ acLogFromRootProc(rank,"nkramers= %f %f \n", nkramers, config[AC_nkramers]);
+ acLogFromRootProc(rank,"hcond0_kramers= %f %f \n", hcond0_kramers, config[AC_hcond0_kramers]);
+ acLogFromRootProc(rank,"hcond_Kconst= %f %f \n", hcond_Kconst, config[AC_hcond_Kconst]);
+ //acLogFromRootProc(rank,"Fbot= %f %f \n", Fbot, config[AC_Fbot]);
+ acLogFromRootProc(rank,"chi_t= %f %f \n", chi_t, config[AC_chi_t]);
+#endif
+#if LVISCOSITY
+ acLogFromRootProc(rank,"nu= %f %f \n", nu, config[AC_nu]);
+ acLogFromRootProc(rank,"zeta= %f %f \n", zeta, config[AC_zeta]);
+#endif
+#if LMAGNETIC
+  acLogFromRootProc(rank,"eta= %f %f \n", eta, config[AC_eta]);
+#endif
+#if LEOS
+  acLogFromRootProc(rank,"cs20= %f %f \n", cs20, config[AC_cs20]);
+  //  acLogFromRootProc(rank,"gamma= %f %f \n", gamma, get_real_param(config,comp_infoAC_gamma));
+  acLogFromRootProc(rank,"gamma_m1= %f %f \n", gamma_m1, config[AC_gamma_m1]);
+  acLogFromRootProc(rank,"gamma1= %f %f \n", gamma1, config[AC_gamma1]);
+  acLogFromRootProc(rank,"cv= %f %f \n", cv, config[AC_cv]);
+  acLogFromRootProc(rank,"cp= %f %f \n", cp, config[AC_cp]);
+  acLogFromRootProc(rank,"lnT0= %f %f \n", lnTT0, config[AC_lnTT0]);
+  acLogFromRootProc(rank,"lnrho0= %f %f \n", lnrho0, config[AC_lnrho0]);
+#endif
+#if LFORCING
+  acLogFromRootProc(rank,"iforcing_zsym= %f %f \n", iforcing_zsym, config[AC_iforcing_zsym]);
+  acLogFromRootProc(rank,"k1_ff= %f %f \n", k1_ff, config[AC_k1_ff]);
+  acLogFromRootProc(rank,"tforce_stop= %f %f \n", tforce_stop, config[AC_tforce_stop]);
+  acLogFromRootProc(rank,"k1_ff,profx_ampl, val= %f %d %lf %lf\n", k1_ff, profx_ampl, profx_ampl[0], profx_ampl[nx-1]);
 #endif
   acLogFromRootProc(rank,"mu0= %f %f \n", (double)mu0, (double)config[AC_mu0]);
 */
@@ -1406,28 +2640,39 @@ extern "C" void copyVBApointers(AcReal **in, AcReal **out)
   acDeviceGetVertexBufferPtrs(acGridGetDevice(),VertexBufferHandle(0),in,out);
 }
 /***********************************************************************************************/
-void autotune_all_integration_substeps()
+void autotuneSubsteps(const bool lrmv_)
 {
+  acDeviceSetInput(acGridGetDevice(), AC_lrmv,lrmv_);
   for (int i = 0; i < num_substeps; ++i)
   {
   	acDeviceSetInput(acGridGetDevice(), AC_step_num,(PC_SUB_STEP_NUMBER)i);
         if (rank==0 && ldebug) printf("memusage before GetOptimizedDSLTaskGraph= %f MBytes\n", acMemUsage()/1024.);
-  	acDeviceSetInput(acGridGetDevice(), AC_lrmv,false);
-	acGetOptimizedDSLTaskGraph(AC_rhs);
-  	acDeviceSetInput(acGridGetDevice(), AC_lrmv,true);
 	acGetOptimizedDSLTaskGraph(AC_rhs);
         if (rank==0 && ldebug) printf("memusage after GetOptimizedDSLTaskGraph= %f MBytes\n", acMemUsage()/1024.);
   }
+  substeps_tuned[lrmv_] = true;
+}
+/***********************************************************************************************/
+void autotune_all_integration_substeps()
+{
+  //The library may be new (reloadConfig), so nothing counts as tuned.
+  substeps_tuned[false] = substeps_tuned[true] = false;
+  //With lgpu_lazy_autotuning, beforeBoundaryGPU tunes each AC_lrmv variant at the start of the first timestep using it.
+  if (lgpu_lazy_autotuning) return;
+  const double start = MPI_Wtime();
+  //With it_rmv<=1, lrmv is true in every timestep, so the graphs for AC_lrmv=false would never be used
+  if (it_rmv > 1) autotuneSubsteps(false);
+  autotuneSubsteps(true);
+  acLogFromRootProc(rank,"autotune_all_integration_substeps: took %f s\n",MPI_Wtime()-start);
 }
 /***********************************************************************************************/
 extern "C" void loadFarray()
 {
+  GpuRegion region(GPU_REGION_LOAD_FARRAY,lgpu_timings);
   AcMesh src = mesh;
-  AcMesh tmp;
   if(dimensionality == 1)
   {
-  	acHostMeshCopy(mesh, &tmp);
-	src = tmp;
+	src = *stagingMesh1D();
     	for (int i = 0; i < mfarray; ++i)
   	{
 		const int index = (i < mvar) ? i : maux_vtxbuf_index[i];
@@ -1460,7 +2705,10 @@ extern "C" void loadFarray()
   }
   acGridSynchronizeStream(STREAM_ALL);
   {
+    //If nothing has been marked, upload everything as the host could have changed any field
+    const bool all = !any_host_dirty;
     for (int i = 0; i < mvar; ++i)
+      if (all || vtxbuf_host_dirty[i])
   	acDeviceLoadVertexBuffer(acGridGetDevice(), STREAM_DEFAULT, src, VertexBufferHandle(i));
 
     int n_aux_on_gpu = 0;
@@ -1468,15 +2716,180 @@ extern "C" void loadFarray()
       if (maux_vtxbuf_index[i] != -1)
       {
 	      n_aux_on_gpu++;
+	      if (all || vtxbuf_host_dirty[maux_vtxbuf_index[i]])
   		acDeviceLoadVertexBuffer(acGridGetDevice(), STREAM_DEFAULT, src, VertexBufferHandle(maux_vtxbuf_index[i]));
       }
     for(int i = 0; i < mfarray-mvar-maux; ++i)
     {
+      if (all || vtxbuf_host_dirty[mvar+n_aux_on_gpu+i])
   	acDeviceLoadVertexBuffer(acGridGetDevice(), STREAM_DEFAULT, src, VertexBufferHandle(mvar+n_aux_on_gpu+i));
     }
   }
   acGridSynchronizeStream(STREAM_ALL);
-  if(dimensionality == 1) acHostMeshDestroy(&tmp);
+  //Host and device agree now
+  for (int i = 0; i < NUM_VTXBUF_HANDLES; ++i)
+  {
+    vtxbuf_host_dirty[i] = false;
+    vtxbuf_device_dirty[i] = false;
+  }
+  any_host_dirty = false;
+  before_boundary_reductions_done = false;
+}
+/***********************************************************************************************/
+#if AC_RUNTIME_COMPILATION
+// Shared cache of runtime-compiled DSL libraries, enabled by pointing the environment variable PC_AC_COMPILE_CACHE to a
+// directory common to all runs (e.g. of a parameter sweep). The build directory is named by a hash of the DSL source
+// contents, the remaining cmake options, the loaded configuration and the compiler, so runs with identical inputs find
+// a finished build there and skip acCompile. Concurrent jobs are serialized by an flock on <key>.lock.
+static uint64_t fnv1a(const void* data, const size_t n, uint64_t hash)
+{
+  const unsigned char* bytes = (const unsigned char*)data;
+  for (size_t i = 0; i < n; ++i)
+  {
+	  hash ^= bytes[i];
+	  hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+/***********************************************************************************************/
+static uint64_t hashFile(const char* path, uint64_t hash)
+{
+  std::ifstream file(path, std::ios::binary);
+  if (!file) return fnv1a(path,strlen(path),hash);
+  char buffer[1<<16];
+  while (file.read(buffer,sizeof(buffer)) || file.gcount() > 0) hash = fnv1a(buffer,file.gcount(),hash);
+  return hash;
+}
+/***********************************************************************************************/
+static uint64_t hashConfig(const AcMeshInfo& info, uint64_t hash)
+{
+  char config_file[64];
+  sprintf(config_file,"ac_compile_cache_%d.conf",(int)getpid());
+  acStoreConfig(info,config_file);
+  hash = hashFile(config_file,hash);
+  remove(config_file);
+  return hash;
+}
+/***********************************************************************************************/
+static uint64_t compileCacheKey(const char* options, const AcMeshInfo& info)
+{
+  uint64_t hash = 14695981039346656037ULL;
+  // The DSL sources enter by content, not by path, since the paths point into the individual run directories.
+  std::string opts(options);
+  const std::string tag = "-DDSL_EXT_SOURCES=\"";
+  const size_t begin = opts.find(tag);
+  if (begin != std::string::npos)
+  {
+	  size_t end = opts.find('"',begin+tag.size());
+	  if (end == std::string::npos) end = opts.size()-1;
+	  const std::string sources = opts.substr(begin+tag.size(),end-begin-tag.size());
+	  size_t pos = 0;
+	  while (pos < sources.size())
+	  {
+		  size_t next = sources.find_first_of("; ",pos);
+		  if (next == std::string::npos) next = sources.size();
+		  const std::string source = sources.substr(pos,next-pos);
+		  if (!source.empty()) hash = hashFile(source.c_str(),hash);
+		  pos = next+1;
+	  }
+	  opts.erase(begin,end+1-begin);
+  }
+  hash = fnv1a(opts.data(),opts.size(),hash);
+  hash = hashConfig(info,hash);
+
+  const char* compiler_vars[] = {"CC","CXX","CUDACXX","HIPCXX"};
+  for (const char* var : compiler_vars)
+  {
+	  const char* value = getenv(var);
+	  if (value) hash = fnv1a(value,strlen(value),hash);
+  }
+  return hash;
+}
+/***********************************************************************************************/
+// Whether the loaded library was compiled with ELIMINATE_CONDITIONALS, i.e., with the parameter values as constants,
+// and the hash of the configuration it was compiled with (rank 0 only); see recompilationNeeded.
+static bool compiled_eliminating_conditionals = false;
+static uint64_t compiled_config_hash = 0;
+
+void runtimeCompile(const char* options, AcMeshInfo& info)
+{
+  //The last occurrence of an option is the one in effect
+  const char* elim = NULL;
+  for (const char* p = strstr(options,"-DELIMINATE_CONDITIONALS="); p != NULL; p = strstr(p+1,"-DELIMINATE_CONDITIONALS="))
+	  elim = p + strlen("-DELIMINATE_CONDITIONALS=");
+  compiled_eliminating_conditionals = elim != NULL && (strncasecmp(elim,"on",2) == 0 || strncasecmp(elim,"true",4) == 0
+		                                       || elim[0] == '1');
+  if (rank == 0) compiled_config_hash = hashConfig(info,14695981039346656037ULL);
+
+  const char* cache_dir = getenv("PC_AC_COMPILE_CACHE");
+  if (cache_dir == NULL || cache_dir[0] == '\0')
+  {
+	  acCompile(options,info);
+	  acLoadLibrary(rank == 0 ? stderr : NULL,info);
+	  return;
+  }
+  char build_path[4096];
+  int cached = 0;
+  int lock_fd = -1;
+  if (rank == 0)
+  {
+	  sprintf(build_path,"%s/%016llx",cache_dir,(unsigned long long)compileCacheKey(options,info));
+	  mkdir(cache_dir,0775);
+	  char lock_file[4200];
+	  sprintf(lock_file,"%s.lock",build_path);
+	  lock_fd = open(lock_file,O_CREAT|O_RDWR,0664);
+	  if (lock_fd >= 0) flock(lock_fd,LOCK_EX);
+	  char marker[4200];
+	  sprintf(marker,"%s/.complete",build_path);
+	  cached = access(marker,F_OK) == 0;
+	  acLogFromRootProc(rank,"runtimeCompile: %s build in %s\n",cached ? "reusing" : "creating",build_path);
+  }
+  MPI_Bcast(build_path,sizeof(build_path),MPI_CHAR,0,comm_pencil);
+  MPI_Bcast(&cached,1,MPI_INT,0,comm_pencil);
+  info.runtime_compilation_build_path = strdup(build_path);
+
+  if (!cached) acCompile(options,info);
+  if (rank == 0)
+  {
+	  if (!cached)
+	  {
+		  char marker[4200];
+		  sprintf(marker,"%s/.complete",build_path);
+		  FILE* fp = fopen(marker,"w");
+		  if (fp) fclose(fp);
+	  }
+	  if (lock_fd >= 0)
+	  {
+		  flock(lock_fd,LOCK_UN);
+		  close(lock_fd);
+	  }
+  }
+  acLoadLibrary(rank == 0 ? stderr : NULL,info);
+}
+#endif
+/***********************************************************************************************/
+void reportDeviceMemory()
+//
+//  Startup report of the device memory of the fullest GPU: the vertex buffers (in and out per field), the rest
+//  (profiles, arrays, halo and communication buffers, task graphs and autotuning, runtime context, interface buffers)
+//  as the remainder, and the largest local grid which would fit if only the vertex buffers grew with the grid.
+//
+{
+#if !AC_CPU_BUILD
+  size_t free_bytes, total_bytes;
+  if (cudaMemGetInfo(&free_bytes,&total_bytes) != cudaSuccess) return;
+  const double per_point = 2.*NUM_VTXBUF_HANDLES*sizeof(AcReal);
+  double local[2] = {per_point*acVertexBufferSize(mesh.info), (double)(total_bytes-free_bytes)}, global[2];
+  MPI_Allreduce(local,global,2,MPI_DOUBLE,MPI_MAX,comm_pencil);
+  const double vtxbufs = global[0], used = global[1], rest = std::max(used-vtxbufs,0.);
+  const double MB = 1024.*1024.;
+  acLogFromRootProc(rank,"Device memory: %.1f of %.1f MB used: %d fields x 2 vertex buffers %.1f MB, rest %.1f MB\n",
+		    used/MB, total_bytes/MB, (int)NUM_VTXBUF_HANDLES, vtxbufs/MB, rest/MB);
+  //The halo buffers grow only with the surface, so this is a slight overestimate for much larger grids
+  const double max_points = std::max((double)total_bytes-rest,0.)/per_point;
+  acLogFromRootProc(rank,"Device memory: the current module set fits about %.3g grid points per GPU, "
+		    "e.g. a local %d^3 domain with ghost zones\n", max_points, (int)cbrt(max_points));
+#endif
 }
 /***********************************************************************************************/
 void testBCs();     // forward declaration
@@ -1562,18 +2975,27 @@ extern "C" void initializeGPU(AcReal *farr, int comm_fint, double t)
   if (rank==0 && ldebug) printf("memusage after pointer assign= %f MBytes\n", acMemUsage()/1024.);
 #if AC_RUNTIME_COMPILATION
 #include "cmake_options.h"
-  acCompile(cmake_options,mesh.info);
-  acLoadLibrary(rank == 0 ? stderr : NULL,mesh.info);
+  runtimeCompile(cmake_options,mesh.info);
   acCheckDeviceAvailability();
   acLogFromRootProc(rank, "Done setupConfig && acCompile\n");
 #else
   acLogFromRootProc(rank, "Done setupConfig\n");
 #endif
+  //The max reductions (dt, maxadvec etc.) are order-independent anyway, but the sums of the task graph outputs
+  //are accumulated inside Astaroth, where the compensated accumulation of the cuda/src_new reductions is not available
+  if (lreproducible_reductions)
+    acLogFromRootProc(rank, "lreproducible_reductions: sums reduced by Astaroth are not compensated and may depend on the decomposition\n");
   fflush(stdout);
   checkConfig(mesh.info);
   if (rank==0 && ldebug) printf("memusage grid_init= %f MBytes\n", acMemUsage()/1024.);
   acGridInit(mesh);
   if (rank==0 && ldebug) printf("memusage after grid_init= %f MBytes\n", acMemUsage()/1024.);
+  //The device of this rank is known only now
+  checkDeviceOccupancy();
+  if (lgpu_numa_placement) findGPUTopology();
+  bindThreadNearGPU();
+  placeFarrayNearGPU(farr);
+  pinFarray(farr);
 
   mesh.info = acGridDecomposeMeshInfo(mesh.info);
   //TP: important to do before autotuning
@@ -1583,6 +3005,7 @@ extern "C" void initializeGPU(AcReal *farr, int comm_fint, double t)
   acDeviceSetInput(acGridGetDevice(), AC_shear_delta_y,deltay);
 		
   if (ltest_bcs) testBCs();
+  initAsyncCopy();
   //TP: for autotuning
   afterTimeStepGPU();
   autotune_all_integration_substeps();
@@ -1591,6 +3014,7 @@ extern "C" void initializeGPU(AcReal *farr, int comm_fint, double t)
   if (rank==0 && ldebug) printf("memusage after store config= %f MBytes\n", acMemUsage()/1024.);
   acGridSynchronizeStream(STREAM_ALL);
   if (rank==0 && ldebug) printf("memusage after store synchronize stream= %f MBytes\n", acMemUsage()/1024.);
+  reportDeviceMemory();
   acLogFromRootProc(rank, "DONE initializeGPU\n");
   fflush(stdout);
 
@@ -1598,16 +3022,40 @@ extern "C" void initializeGPU(AcReal *farr, int comm_fint, double t)
   dt1_interface = unit/dt;
 }
 /***********************************************************************************************/
+#if AC_RUNTIME_COMPILATION
+bool recompilationNeeded(const AcMeshInfo& info)
+//
+//  Without eliminated conditionals, the library does not depend on the parameter values, which acDeviceUpdate loads
+//  as uniforms. Otherwise it has to be rebuilt only if the configuration differs from the one it was compiled with,
+//  e.g., not if RELOAD changed only parameters which do not enter the GPU configuration.
+//
+{
+  if (!compiled_eliminating_conditionals) return false;
+  int changed = 0;
+  if (rank == 0) changed = hashConfig(info,14695981039346656037ULL) != compiled_config_hash;
+  MPI_Bcast(&changed,1,MPI_INT,0,comm_pencil);
+  return changed;
+}
+#endif
+/***********************************************************************************************/
 extern "C" void reloadConfig()
 {
+  resolveCourantDt();
   setupConfig(mesh.info);
   acGridSynchronizeStream(STREAM_ALL);
   acDeviceUpdate(acGridGetDevice(), mesh.info);
   acGridSynchronizeStream(STREAM_ALL);
 #if AC_RUNTIME_COMPILATION
+  if (!recompilationNeeded(mesh.info))
+  {
+	  acLogFromRootProc(rank, "DONE reloading on GPU, parameters updated in place\n");
+	  fflush(stdout);
+	  return;
+  }
   //save the current values of the vtxbufs since the device arrays are freed by acGridQuit
   copyFarray(mesh.vertex_buffer[0]);
   acGridQuit();
+  destroyStagingMesh1D();
   const AcResult closed_res = acCloseLibrary();
   if(closed_res != AC_SUCCESS)
   {
@@ -1615,10 +3063,8 @@ extern "C" void reloadConfig()
 	  exit(EXIT_FAILURE);
   }
 #include "cmake_options.h"
-  char src_cmake_options[10000];
-  sprintf(src_cmake_options,"%s -DELIMINATE_CONDITIONALS=%s",cmake_options,TRANSPILATION ? "on" : "off");
-  acCompile(src_cmake_options,mesh.info);
-  acLoadLibrary(rank == 0 ? stderr : NULL,mesh.info);
+  //cmake_options carries ELIMINATE_CONDITIONALS as configured in the Makefile, as for the first compilation
+  runtimeCompile(cmake_options,mesh.info);
   acGridInit(mesh);
   acLogFromRootProc(rank, "Done setupConfig && acCompile\n");
   fflush(stdout);
@@ -1626,6 +3072,8 @@ extern "C" void reloadConfig()
   //TP: this is important that we don't overwrite the output buffer in middle of a timestep when the output buffer holds some meaning!
   autotune_all_integration_substeps();
   //TP: restore the vtxbuf values before quitting grid
+  //The device arrays are new, so all of them have to be restored irrespective of what has been marked dirty
+  any_host_dirty = false;
   loadFarray();
 #endif
   acLogFromRootProc(rank, "DONE reloading on GPU\n");
@@ -1644,34 +3092,238 @@ extern "C" void updateInConfigScal(int index, AcReal value)
      acDeviceLoadScalarUniform(acGridGetDevice(),STREAM_DEFAULT,static_cast<AcRealParam>(index),value);
 }
 /***********************************************************************************************/
+// Name -> index tables of the real arrays and scalars, built on first use; for equal names the last index wins,
+// as with the former linear search.
+static int configIndex(const char* name, const bool array)
+{
+    static std::unordered_map<std::string,int> array_index, scalar_index;
+    if (array && array_index.empty())
+       for (int i=0; i<NUM_REAL_ARRAYS; i++) array_index[get_array_info(static_cast<AcRealArrayParam>(i)).name] = i;
+    if (!array && scalar_index.empty())
+       for (int i=0; i<NUM_REAL_PARAMS; i++) scalar_index[realparam_names[i]] = i;
+    const auto& table = array ? array_index : scalar_index;
+    const auto it = table.find(name);
+    return it == table.end() ? -1 : it->second;
+}
+/***********************************************************************************************/
 extern "C" int updateInConfigArrName(char *name)
 {
-    int index = -1;
-    for (int i=0; i<NUM_REAL_ARRAYS; i++){
-       if (strcmp(get_array_info(static_cast<AcRealArrayParam>(i)).name,name)==0) index=i;
-    }
+    const int index = configIndex(name,true);
     if (index>-1) updateInConfigArr(index);
     return index;
 }
 /***********************************************************************************************/
 extern "C" int updateInConfigScalName(char *name, AcReal value)
 {
-    int index = -1;
-    for (int i=0; i<NUM_REAL_PARAMS; i++){
-       if (strcmp(realparam_names[i],name)==0) index=i;
-    }
+    const int index = configIndex(name,false);
     if (index>-1) updateInConfigScal(index, value);
     return index;
 }
 /**********************************************************************************************/
+static void writeGPUTrace(const char* filename)
+//
+//  Gathers the timelines of the profiled regions and writes them from the root as Chrome trace (chrome://tracing,
+//  ui.perfetto.dev), one process per rank. The n-th call of a region is collective, so of its n-th events the longest
+//  one is that of the rank the others wait for; it is marked critical. The times of each rank count from its
+//  first event, since the clocks of different nodes need not agree.
+//
+{
+  int nranks;
+  MPI_Comm_size(comm_pencil,&nranks);
+  const int nlocal = gpu_trace_events.size();
+  std::vector<int> counts(rank == 0 ? nranks : 0), displs(rank == 0 ? nranks : 0);
+  MPI_Gather(&nlocal,1,MPI_INT,counts.data(),1,MPI_INT,0,comm_pencil);
+  int ntotal = 0;
+  for (int r = 0; r < (int)counts.size(); ++r)
+  {
+	  displs[r] = ntotal;
+	  ntotal += counts[r];
+  }
+  std::vector<double> all(ntotal);
+  MPI_Gatherv(gpu_trace_events.data(),nlocal,MPI_DOUBLE,all.data(),counts.data(),displs.data(),MPI_DOUBLE,0,comm_pencil);
+  if (rank != 0) return;
+
+  //critical[r][e]: event e of rank r is the longest of its call
+  std::vector<std::vector<bool>> critical(nranks);
+  std::vector<std::vector<std::vector<int>>> calls(NUM_GPU_REGIONS,std::vector<std::vector<int>>(nranks));
+  for (int r = 0; r < nranks; ++r)
+  {
+	  critical[r].assign(counts[r]/3,false);
+	  for (int e = 0; e < counts[r]/3; ++e) calls[(int)all[displs[r]+3*e]][r].push_back(e);
+  }
+  for (int i = 0; i < NUM_GPU_REGIONS; ++i)
+    for (size_t n = 0;; ++n)
+    {
+	  int slowest = -1;
+	  double longest = -1.;
+	  for (int r = 0; r < nranks; ++r)
+	  {
+		  if (n >= calls[i][r].size()) continue;
+		  const double* event = &all[displs[r]+3*calls[i][r][n]];
+		  if (event[2]-event[1] > longest)
+		  {
+			  longest = event[2]-event[1];
+			  slowest = r;
+		  }
+	  }
+	  if (slowest < 0) break;
+	  critical[slowest][calls[i][slowest][n]] = true;
+    }
+
+  FILE* fp = fopen(filename,"w");
+  if (fp == NULL)
+  {
+	  fprintf(stderr,"writeGPUTrace: could not open %s\n",filename);
+	  return;
+  }
+  fprintf(fp,"{\"displayTimeUnit\": \"ms\", \"traceEvents\": [");
+  bool first = true;
+  for (int r = 0; r < nranks; ++r)
+  {
+	  fprintf(fp,"%s\n{\"name\": \"process_name\", \"ph\": \"M\", \"pid\": %d, \"args\": {\"name\": \"rank %d\"}}",
+		  first ? "" : ",",r,r);
+	  first = false;
+	  for (int e = 0; e < counts[r]/3; ++e)
+	  {
+		  const double* event = &all[displs[r]+3*e];
+		  const double origin = all[displs[r]+1];
+		  fprintf(fp,",\n{\"name\": \"%s\", \"ph\": \"X\", \"pid\": %d, \"tid\": 0, \"ts\": %.3f, \"dur\": %.3f%s}",
+			  gpu_region_names[(int)event[0]],r,1e6*(event[1]-origin),1e6*(event[2]-event[1]),
+			  critical[r][e] ? ", \"cname\": \"terrible\", \"args\": {\"critical\": true}" : "");
+	  }
+  }
+  fprintf(fp,"\n]}\n");
+  fclose(fp);
+}
+/**********************************************************************************************/
+extern "C" void writeGPUTimings(const char* filename)
+//
+//  Gathers the per-rank timings of the profiled regions (lgpu_timings) and writes them from the root,
+//  with ENERGY_METERING also the energy drawn by the devices in the regions. Their timeline goes to
+//  gpu_trace.json in the same directory.
+//
+{
+  const std::string dir(filename);
+  writeGPUTrace((dir.substr(0,dir.find_last_of('/')+1)+"gpu_trace.json").c_str());
+
+  constexpr int nstats = 5;
+  double local[NUM_GPU_REGIONS*nstats];
+  for (int i = 0; i < NUM_GPU_REGIONS; ++i)
+  {
+	  const GpuRegionStats& stats = gpu_region_stats[i];
+	  local[nstats*i  ] = stats.calls;
+	  local[nstats*i+1] = stats.calls ? stats.min : 0.;
+	  local[nstats*i+2] = stats.calls ? stats.sum/stats.calls : 0.;
+	  local[nstats*i+3] = stats.max;
+	  local[nstats*i+4] = stats.energy;
+  }
+  int nranks;
+  MPI_Comm_size(comm_pencil,&nranks);
+  std::vector<double> all(rank == 0 ? nranks*NUM_GPU_REGIONS*nstats : 0);
+  MPI_Gather(local,NUM_GPU_REGIONS*nstats,MPI_DOUBLE,all.data(),NUM_GPU_REGIONS*nstats,MPI_DOUBLE,0,comm_pencil);
+  if (rank != 0) return;
+
+  FILE* fp = fopen(filename,"w");
+  if (fp == NULL)
+  {
+	  fprintf(stderr,"writeGPUTimings: could not open %s\n",filename);
+	  return;
+  }
+  fprintf(fp,"#%-24s %6s %10s %14s %14s %14s%s\n","region","rank","calls","min[s]","mean[s]","max[s]",
+	  AC_ENERGY_METERING ? "      energy[J]" : "");
+  for (int i = 0; i < NUM_GPU_REGIONS; ++i)
+    for (int r = 0; r < nranks; ++r)
+    {
+	  const double* stats = &all[nstats*(r*NUM_GPU_REGIONS+i)];
+	  if (stats[0] == 0) continue;
+	  fprintf(fp,"%-25s %6d %10ld %14.6e %14.6e %14.6e",gpu_region_names[i],r,(long)stats[0],stats[1],stats[2],stats[3]);
+	  if (AC_ENERGY_METERING) fprintf(fp," %14.6e",stats[4]);
+	  fprintf(fp,"\n");
+    }
+  //Energy to solution of the time stepping: AC_rhs runs once per substep on every rank
+  if (AC_ENERGY_METERING)
+  {
+    double energy = 0.;
+    long calls = 0;
+    for (int r = 0; r < nranks; ++r)
+    {
+	  energy += all[nstats*(r*NUM_GPU_REGIONS+GPU_REGION_RHS)+4];
+	  calls   = std::max(calls,(long)all[nstats*(r*NUM_GPU_REGIONS+GPU_REGION_RHS)]);
+    }
+    const double steps = (double)calls/num_substeps;
+    if (steps > 0)
+	    fprintf(fp,"# AC_rhs, all ranks: %.6e J per time step, %.6e J per cell update\n",
+		    energy/steps, energy/(steps*nxgrid*nygrid*nzgrid));
+  }
+  //Overlap of the halo exchange (probe time E) with the compute C in AC_rhs (time R), per substep: the hidden fraction
+  //of the exchange is (C+E-R)/E. C is not measurable inside the task graph, but it is the same on all ranks of a uniform
+  //decomposition and bracketed by the fastest rank f: R_f-E_f <= C <= R_f.
+  fprintf(fp,"#%-24s %6s %14s %14s %10s %10s\n","overlap","rank","exchange[s]","rhs[s]","hidden_min","hidden_max");
+  for (int k = 0; k < GPU_MAX_SUBSTEPS; ++k)
+  {
+    const int i = GPU_REGION_RHS_SUBSTEP+k;
+    int fastest = -1;
+    for (int r = 0; r < nranks; ++r)
+    {
+      const double* rhs = &all[nstats*(r*NUM_GPU_REGIONS+i)];
+      if (rhs[0] > 0 && (fastest < 0 || rhs[2] < all[nstats*(fastest*NUM_GPU_REGIONS+i)+2])) fastest = r;
+    }
+    if (fastest < 0) continue;
+    const double rhs_fastest   = all[nstats*(fastest*NUM_GPU_REGIONS+i)+2];
+    const double probe_fastest = all[nstats*(fastest*NUM_GPU_REGIONS+GPU_REGION_HALO_PROBE)+2];
+    for (int r = 0; r < nranks; ++r)
+    {
+	  const double* probe = &all[nstats*(r*NUM_GPU_REGIONS+GPU_REGION_HALO_PROBE)];
+	  const double* rhs   = &all[nstats*(r*NUM_GPU_REGIONS+i)];
+	  if (rhs[0] == 0 || probe[0] == 0 || probe[2] <= 0.) continue;
+	  const auto hidden = [&](const double compute) {return std::max(0.,std::min(1.,(compute+probe[2]-rhs[2])/probe[2]));};
+	  fprintf(fp,"substep %-17d %6d %14.6e %14.6e %10.2f %10.2f\n",k+1,r,probe[2],rhs[2],
+		  hidden(rhs_fastest-probe_fastest),hidden(rhs_fastest));
+    }
+  }
+  fclose(fp);
+}
+/***********************************************************************************************/
 extern "C" void finalizeGPU()
 {
   // Deallocate everything on the GPUs and reset
+  finalAsyncCopy();
+  finalDirectSnapshots();
+  finalTimeAverages();
+#if TRAINING && !AC_CPU_BUILD
+  finalAsyncTraining();
+#endif
+#if TRAINING
+  if (train_packed != NULL)
+  {
+  #if AC_CPU_BUILD
+	  free(train_packed);
+  #else
+	  cudaFree(train_packed);
+  #endif
+	  train_packed = NULL;
+  }
+#endif
+  if (dt_limiter_file != NULL)
+  {
+	  fclose(dt_limiter_file);
+	  dt_limiter_file = NULL;
+  }
+  if (ldebug) acLogFromRootProc(rank,"finalizeGPU: high-water mark of the reduction scratch= %f MBytes\n",
+		                 gpuScratchBytes()/(1024.*1024.));
+  gpuFreeScratch();
   AcResult res = acGridQuit();
+  unpinFarray();
+  destroyStagingMesh1D();
 }
 /***********************************************************************************************/
+// Initial conditions are set by start.x on the host, which does not initialize
+// the GPU, and run.x uploads them once with the first copy to the device. Moving
+// initlnrho/inituu/initaa into DSL kernels (with a counter-based RNG, so results
+// do not depend on the decomposition) needs start.x to drive the device first.
 extern "C" void random_initial_condition()
 {
+  markDeviceDirty();
   return;
   //acGridSynchronizeStream(STREAM_ALL);
   //AcMeshDims dims = acGetMeshDims(acGridGetLocalMeshInfo());
@@ -1847,6 +3499,7 @@ void check_sym_x(const AcMesh mesh_in)
 /***********************************************************************************************/
 void testBCs()
 {
+  markDeviceDirty();
   // Set random seed for reproducibility
   srand(321654987);
   const auto DEVICE_VTXBUF_IDX = [&](const int x, const int y, const int z)
@@ -1880,7 +3533,7 @@ void testBCs()
   boundconds_z_c(mesh.vertex_buffer[0],&ivar1,&ivar2);
 
   acGridSynchronizeStream(STREAM_ALL);
-  acGridExecuteTaskGraph(bcs,1);
+  executeBoundconds(bcs);
   acGridSynchronizeStream(STREAM_ALL);
 
   acGridSynchronizeStream(STREAM_ALL);
@@ -2023,6 +3676,7 @@ void testBCs()
 /***********************************************************************************************/
 extern "C" void gpuSetDt(double t)
 {
+  markDeviceDirty();
 	acGridSynchronizeStream(STREAM_ALL);
  	acDeviceSetInput(acGridGetDevice(), AC_t,AcReal(t));
 	beforeBoundaryGPU(false,0,t);
@@ -2038,16 +3692,24 @@ extern "C" void gpuSetDt(double t)
 	acGridExecuteTaskGraph(graph,1);
 	acGridSynchronizeStream(STREAM_ALL);
 	AcReal dt1_ = calc_dt1_courant(AcReal(t));
-	set_dt(dt1_);
+	set_dt_global(dt1_);
 	dt1_interface = dt1_;
+	courant_dt_pending = false;
         acDeviceSwapBuffers(acGridGetDevice());
 	loadFarray();
 	//TP: not strictly needed but for extra safety
 }
 /***********************************************************************************************/
-extern "C" void getGPUReducedVars(AcReal* dst)
+#define NUM_GPU_REDUCED_VARS 10
+static AcReal gpu_reduced_vars[NUM_GPU_REDUCED_VARS]{};
+
+void collectGPUReducedVars()
+//
+//  Waits for the graphs issued so far and copies all reduced outputs needed by the ODE into the host buffer.
+//
 {
 	acGridSynchronizeStream(STREAM_ALL);
+	AcReal* dst = gpu_reduced_vars;
 #if LAXIONSU2BACK
 	dst[0] = acDeviceGetOutput(acGridGetDevice(), AC_grand_sum);
 	dst[1] = acDeviceGetOutput(acGridGetDevice(), AC_dgrant_sum);
@@ -2071,5 +3733,16 @@ extern "C" void getGPUReducedVars(AcReal* dst)
 	dst[7] = acDeviceGetOutput(acGridGetDevice(), AC_e2m_all__mod__backreact_infl);
 	dst[8] = acDeviceGetOutput(acGridGetDevice(), AC_b2m_all__mod__backreact_infl);
 #endif
+	gpu_reduced_vars_valid = true;
+}
+/***********************************************************************************************/
+extern "C" void getGPUReducedVars(AcReal* dst)
+//
+//  The device is synchronized only on the first call after graphs have run;
+//  further calls within the same substep (e.g. for the diagnostics) return the buffered values.
+//
+{
+	if (!gpu_reduced_vars_valid) collectGPUReducedVars();
+	for (int i = 0; i < NUM_GPU_REDUCED_VARS; ++i) dst[i] = gpu_reduced_vars[i];
 }
 /***********************************************************************************************/
@@ -0,0 +1,784 @@
+/*                             gpu_kernels.cu
+                               --------------------
+
+   Description:
+           Implementation of the interface kernels declared in gpu_kernels.h.
+           Block reductions go through shared memory only, so that they work unchanged for 32-wide warps (CUDA)
+           and 64-wide wavefronts (HIP).
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <cmath>
+#include <algorithm>
+#include <vector>
+
+#include "gpu_runtime.h"
+#include "gpu_kernels.h"
+
+#define KERNEL_THREADS 256
+// Largest number of shells accumulated in shared memory (two spectra) before falling back to global atomics.
+#define MAX_SHARED_BINS 2048
+// Same for the counts of gpuHistogram (16 kB of int).
+#define MAX_SHARED_COUNTS 4096
+// Upper limit of the blocks of structureFunctionsXKernel over all separations.
+#define MAX_SF_BLOCKS 1024
+
+/***********************************************************************************************/
+#if !AC_CPU_BUILD
+static void checkKernelError(const char* name)
+{
+  const cudaError_t err = cudaGetLastError();
+  if (err != cudaSuccess)
+  {
+	  fprintf(stderr,"%s failed: %s\n",name,cudaGetErrorString(err));
+	  exit(EXIT_FAILURE);
+  }
+}
+/***********************************************************************************************/
+// Device scratch buffer shared by all kernels below, grown on demand and kept for the whole run;
+// its size is thus the high-water mark of the scratch requested so far.
+static GpuKernelReal* d_scratch = NULL;
+static size_t scratch_count = 0;
+
+static GpuKernelReal* scratchBuffer(const size_t count)
+{
+  if (count > scratch_count)
+  {
+	  if (d_scratch != NULL) cudaFree(d_scratch);
+	  if (cudaMalloc((void**)&d_scratch, count*sizeof(GpuKernelReal)) != cudaSuccess) checkKernelError("scratchBuffer");
+	  scratch_count = count;
+  }
+  return d_scratch;
+}
+/***********************************************************************************************/
+__device__ GpuKernelReal powerOf(const GpuKernelReal val, const int power)
+{
+  return power == 2 ? val*val : val;
+}
+/***********************************************************************************************/
+// One block per point along keep_axis; the threads stride over the perpendicular plane.
+__global__ void planeSumsKernel(const GpuKernelReal* field, const GpuGridDims dims, const int keep_axis, const int power,
+                                GpuKernelReal* sums)
+{
+  __shared__ GpuKernelReal partial[KERNEL_THREADS];
+
+  const int na = keep_axis == 0 ? dims.ny : dims.nx;
+  const int nb = keep_axis == 2 ? dims.ny : dims.nz;
+  const int k  = blockIdx.x;
+
+  GpuKernelReal sum = 0;
+  for (int p = threadIdx.x; p < na*nb; p += blockDim.x)
+  {
+	  const int a = p % na, b = p / na;
+	  int x, y, z;
+	  if (keep_axis == 0)      { x = k; y = a; z = b; }
+	  else if (keep_axis == 1) { x = a; y = k; z = b; }
+	  else                     { x = a; y = b; z = k; }
+	  const size_t idx = (dims.l1+x) + (size_t)dims.mx*((dims.m1+y) + (size_t)dims.my*(dims.n1+z));
+	  sum += powerOf(field[idx],power);
+  }
+  partial[threadIdx.x] = sum;
+  __syncthreads();
+
+  for (int stride = blockDim.x/2; stride > 0; stride /= 2)
+  {
+	  if (threadIdx.x < stride) partial[threadIdx.x] += partial[threadIdx.x+stride];
+	  __syncthreads();
+  }
+  if (threadIdx.x == 0) sums[k] = partial[0];
+}
+/***********************************************************************************************/
+// One thread per (x,y), summing its column along z; consecutive threads read consecutive x.
+__global__ void zSumsKernel(const GpuKernelReal* field, const GpuGridDims dims, const int power, GpuKernelReal* sums)
+{
+  const int p = threadIdx.x + blockIdx.x*blockDim.x;
+  if (p >= dims.nx*dims.ny) return;
+
+  const int x = p % dims.nx, y = p / dims.nx;
+  GpuKernelReal sum = 0;
+  for (int z = 0; z < dims.nz; ++z)
+	  sum += powerOf(field[(dims.l1+x) + (size_t)dims.mx*((dims.m1+y) + (size_t)dims.my*(dims.n1+z))],power);
+  sums[p] = sum;
+}
+#endif
+/***********************************************************************************************/
+#if !AC_CPU_BUILD
+// blockIdx.y selects the field; every non-finite point lowers the field's entry in first to its own linear index
+// within the computational domain, so that the smallest index (the first in Fortran order) survives.
+__global__ void findNonFiniteKernel(const GpuKernelReal* const* fields, const GpuGridDims dims,
+                                    unsigned long long* first)
+{
+  const GpuKernelReal* field = fields[blockIdx.y];
+  const unsigned long long npoints = (unsigned long long)dims.nx*dims.ny*dims.nz;
+  for (unsigned long long p = threadIdx.x + (unsigned long long)blockIdx.x*blockDim.x; p < npoints;
+       p += (unsigned long long)blockDim.x*gridDim.x)
+  {
+	  const int x = p % dims.nx, y = (p / dims.nx) % dims.ny, z = p / ((unsigned long long)dims.nx*dims.ny);
+	  if (!isfinite(field[(dims.l1+x) + (size_t)dims.mx*((dims.m1+y) + (size_t)dims.my*(dims.n1+z))]))
+	  {
+		  atomicMin(&first[blockIdx.y],p);
+		  return;
+	  }
+  }
+}
+#endif
+/***********************************************************************************************/
+int gpuFindNonFinite(const GpuKernelReal* const* d_fields, const int nfields, const GpuGridDims dims, int pos[3])
+{
+  const unsigned long long npoints = (unsigned long long)dims.nx*dims.ny*dims.nz;
+  std::vector<unsigned long long> first(nfields,npoints);
+#if AC_CPU_BUILD
+  for (int i = 0; i < nfields; ++i)
+	  for (unsigned long long p = 0; p < npoints; ++p)
+	  {
+		  const int x = p % dims.nx, y = (p / dims.nx) % dims.ny, z = p / ((unsigned long long)dims.nx*dims.ny);
+		  if (!std::isfinite(d_fields[i][(dims.l1+x) + (size_t)dims.mx*((dims.m1+y) + (size_t)dims.my*(dims.n1+z))]))
+		  {
+			  first[i] = p;
+			  break;
+		  }
+	  }
+#else
+  //Field pointers and per-field results stay allocated; nfields does not change during a run
+  static const GpuKernelReal** d_ptrs = NULL;
+  static unsigned long long* d_first = NULL;
+  static int allocated = 0;
+  if (nfields > allocated)
+  {
+	  if (d_ptrs != NULL) { cudaFree(d_ptrs); cudaFree(d_first); }
+	  if (cudaMalloc((void**)&d_ptrs, nfields*sizeof(GpuKernelReal*)) != cudaSuccess ||
+	      cudaMalloc((void**)&d_first, nfields*sizeof(unsigned long long)) != cudaSuccess) checkKernelError("gpuFindNonFinite");
+	  allocated = nfields;
+  }
+  cudaMemcpy(d_ptrs, d_fields, nfields*sizeof(GpuKernelReal*), cudaMemcpyHostToDevice);
+  cudaMemcpy(d_first, first.data(), nfields*sizeof(unsigned long long), cudaMemcpyHostToDevice);
+  //A moderate number of blocks per field suffices since the scan is bandwidth bound
+  const unsigned long long nblocks = std::min((npoints+KERNEL_THREADS-1)/KERNEL_THREADS,1024ULL);
+  findNonFiniteKernel<<<dim3(nblocks,nfields),KERNEL_THREADS>>>(d_ptrs,dims,d_first);
+  checkKernelError("findNonFiniteKernel");
+  cudaMemcpy(first.data(), d_first, nfields*sizeof(unsigned long long), cudaMemcpyDeviceToHost);
+#endif
+  for (int i = 0; i < nfields; ++i)
+  {
+	  if (first[i] == npoints) continue;
+	  pos[0] = first[i] % dims.nx;
+	  pos[1] = (first[i] / dims.nx) % dims.ny;
+	  pos[2] = first[i] / ((unsigned long long)dims.nx*dims.ny);
+	  return i;
+  }
+  return -1;
+}
+/***********************************************************************************************/
+#if AC_CPU_BUILD
+#define HOST_DEVICE
+#else
+#define HOST_DEVICE __host__ __device__
+#endif
+// Energy and helicity contributions of the Fourier mode idx with wave vector k; returns its shell.
+HOST_DEVICE int modeContribution(const GpuSpectralVector vec, const size_t idx, const GpuKernelReal k[3],
+                                 const GpuKernelReal kscale, const bool curl, GpuKernelReal& energy,
+                                 GpuKernelReal& helicity)
+{
+  GpuKernelReal ar[3], ai[3], cr[3], ci[3];
+  for (int c = 0; c < 3; ++c)
+  {
+	  ar[c] = vec.re[c][idx];
+	  ai[c] = vec.im[c][idx];
+  }
+  for (int c = 0; c < 3; ++c)
+  {
+	  const int c1 = (c+1)%3, c2 = (c+2)%3;
+	  cr[c] = k[c1]*ar[c2] - k[c2]*ar[c1];
+	  ci[c] = k[c1]*ai[c2] - k[c2]*ai[c1];
+  }
+  energy = 0;
+  helicity = 0;
+  for (int c = 0; c < 3; ++c)
+  {
+	  energy   += curl ? cr[c]*cr[c] + ci[c]*ci[c] : ar[c]*ar[c] + ai[c]*ai[c];
+	  helicity += ai[c]*cr[c] - ar[c]*ci[c];
+  }
+  return (int)lrint(kscale*sqrt(k[0]*k[0] + k[1]*k[1] + k[2]*k[2]));
+}
+/***********************************************************************************************/
+#if !AC_CPU_BUILD
+// One thread per local Fourier mode. With few enough shells every block accumulates its own histogram in
+// shared memory, so that the global atomics are issued once per shell and block instead of once per mode.
+__global__ void shellSpectraKernel(const GpuSpectralVector vec, const GpuGridDims dims, const GpuKernelReal* kxyz,
+                                   const GpuKernelReal kscale, const bool curl, const int nbins, GpuKernelReal* bins)
+{
+  extern __shared__ GpuKernelReal shared_bins[];
+  const bool use_shared = nbins <= MAX_SHARED_BINS/2;
+  if (use_shared)
+  {
+	  for (int i = threadIdx.x; i < 2*nbins; i += blockDim.x) shared_bins[i] = 0;
+	  __syncthreads();
+  }
+  GpuKernelReal* acc = use_shared ? shared_bins : bins;
+
+  const int p = threadIdx.x + blockIdx.x*blockDim.x;
+  if (p < dims.nx*dims.ny*dims.nz)
+  {
+	  const int x = p % dims.nx, y = (p / dims.nx) % dims.ny, z = p / (dims.nx*dims.ny);
+	  const GpuKernelReal k[3] = {kxyz[x], kxyz[dims.nx+y], kxyz[dims.nx+dims.ny+z]};
+	  const size_t idx = (dims.l1+x) + (size_t)dims.mx*((dims.m1+y) + (size_t)dims.my*(dims.n1+z));
+	  GpuKernelReal energy, helicity;
+	  const int shell = modeContribution(vec,idx,k,kscale,curl,energy,helicity);
+	  if (shell >= 0 && shell < nbins)
+	  {
+		  atomicAdd(&acc[shell],energy);
+		  atomicAdd(&acc[nbins+shell],helicity);
+	  }
+  }
+  if (use_shared)
+  {
+	  __syncthreads();
+	  for (int i = threadIdx.x; i < 2*nbins; i += blockDim.x)
+		  if (shared_bins[i] != 0) atomicAdd(&bins[i],shared_bins[i]);
+  }
+}
+#endif
+/***********************************************************************************************/
+void gpuShellSpectra(const GpuSpectralVector vec, const GpuGridDims dims, const GpuKernelReal* h_kx,
+                     const GpuKernelReal* h_ky, const GpuKernelReal* h_kz, const GpuKernelReal kscale,
+                     const bool curl, const GpuKernelReal norm, const int nbins,
+                     GpuKernelReal* h_spectrum, GpuKernelReal* h_helicity)
+{
+  //Wavenumbers followed by the zeroed shells, uploaded with a single copy
+  const int nk = dims.nx+dims.ny+dims.nz;
+  std::vector<GpuKernelReal> work(nk+2*nbins,0);
+  std::copy(h_kx,h_kx+dims.nx,work.begin());
+  std::copy(h_ky,h_ky+dims.ny,work.begin()+dims.nx);
+  std::copy(h_kz,h_kz+dims.nz,work.begin()+dims.nx+dims.ny);
+#if AC_CPU_BUILD
+  GpuKernelReal* bins = work.data()+nk;
+  for (int z = 0; z < dims.nz; ++z)
+  for (int y = 0; y < dims.ny; ++y)
+  for (int x = 0; x < dims.nx; ++x)
+  {
+	  const GpuKernelReal k[3] = {h_kx[x], h_ky[y], h_kz[z]};
+	  const size_t idx = (dims.l1+x) + (size_t)dims.mx*((dims.m1+y) + (size_t)dims.my*(dims.n1+z));
+	  GpuKernelReal energy, helicity;
+	  const int shell = modeContribution(vec,idx,k,kscale,curl,energy,helicity);
+	  if (shell >= 0 && shell < nbins)
+	  {
+		  bins[shell] += energy;
+		  bins[nbins+shell] += helicity;
+	  }
+  }
+#else
+  GpuKernelReal* d_work = scratchBuffer(work.size());
+  cudaMemcpy(d_work, work.data(), work.size()*sizeof(GpuKernelReal), cudaMemcpyHostToDevice);
+  const int nmodes = dims.nx*dims.ny*dims.nz;
+  const size_t shared_bytes = nbins <= MAX_SHARED_BINS/2 ? 2*nbins*sizeof(GpuKernelReal) : 0;
+  shellSpectraKernel<<<(nmodes+KERNEL_THREADS-1)/KERNEL_THREADS,KERNEL_THREADS,shared_bytes>>>
+	  (vec,dims,d_work,kscale,curl,nbins,d_work+nk);
+  checkKernelError("shellSpectraKernel");
+  cudaMemcpy(work.data()+nk, d_work+nk, 2*nbins*sizeof(GpuKernelReal), cudaMemcpyDeviceToHost);
+  GpuKernelReal* bins = work.data()+nk;
+#endif
+  for (int i = 0; i < nbins; ++i)
+  {
+	  h_spectrum[i] = norm*bins[i];
+	  h_helicity[i] = norm*bins[nbins+i];
+  }
+}
+/***********************************************************************************************/
+// Bin of the value val, see gpuHistogram; int() truncates towards zero like the Fortran intrinsic.
+HOST_DEVICE int histogramBin(const GpuKernelReal val, const int transform, const GpuKernelReal shift,
+                             const GpuKernelReal scale, const GpuKernelReal a, const GpuKernelReal b, const int nbins)
+{
+  GpuKernelReal g;
+  if (transform == GPU_HIST_LOG10_ABS) g = log10(scale*fabs(val-shift));
+  else if (transform == GPU_HIST_LOG)  g = scale*log(val);
+  else                                 g = scale*(val-shift);
+  const GpuKernelReal x = a*g + b;
+  if (!(x > 0)) return 0;                    //also catches NaN
+  return x >= nbins ? nbins-1 : (int)x;
+}
+/***********************************************************************************************/
+#if !AC_CPU_BUILD
+// One thread per point; as in shellSpectraKernel the blocks count into shared memory if the bins fit.
+__global__ void histogramKernel(const GpuKernelReal* field, const GpuGridDims dims, const int transform,
+                                const GpuKernelReal shift, const GpuKernelReal scale, const GpuKernelReal a,
+                                const GpuKernelReal b, const int nbins, int* counts)
+{
+  extern __shared__ int shared_counts[];
+  const bool use_shared = nbins <= MAX_SHARED_COUNTS;
+  if (use_shared)
+  {
+	  for (int i = threadIdx.x; i < nbins; i += blockDim.x) shared_counts[i] = 0;
+	  __syncthreads();
+  }
+  int* acc = use_shared ? shared_counts : counts;
+
+  const int p = threadIdx.x + blockIdx.x*blockDim.x;
+  if (p < dims.nx*dims.ny*dims.nz)
+  {
+	  const int x = p % dims.nx, y = (p / dims.nx) % dims.ny, z = p / (dims.nx*dims.ny);
+	  const GpuKernelReal val = field[(dims.l1+x) + (size_t)dims.mx*((dims.m1+y) + (size_t)dims.my*(dims.n1+z))];
+	  atomicAdd(&acc[histogramBin(val,transform,shift,scale,a,b,nbins)],1);
+  }
+  if (use_shared)
+  {
+	  __syncthreads();
+	  for (int i = threadIdx.x; i < nbins; i += blockDim.x)
+		  if (shared_counts[i] != 0) atomicAdd(&counts[i],shared_counts[i]);
+  }
+}
+#endif
+/***********************************************************************************************/
+void gpuHistogram(const GpuKernelReal* d_field, const GpuGridDims dims, const int transform, const GpuKernelReal shift,
+                  const GpuKernelReal scale, const GpuKernelReal a, const GpuKernelReal b, const int nbins,
+                  int* h_counts)
+{
+#if AC_CPU_BUILD
+  for (int i = 0; i < nbins; ++i) h_counts[i] = 0;
+  for (int z = 0; z < dims.nz; ++z)
+  for (int y = 0; y < dims.ny; ++y)
+  for (int x = 0; x < dims.nx; ++x)
+  {
+	  const GpuKernelReal val = d_field[(dims.l1+x) + (size_t)dims.mx*((dims.m1+y) + (size_t)dims.my*(dims.n1+z))];
+	  h_counts[histogramBin(val,transform,shift,scale,a,b,nbins)]++;
+  }
+#else
+  int* d_counts = (int*)scratchBuffer((nbins*sizeof(int)+sizeof(GpuKernelReal)-1)/sizeof(GpuKernelReal));
+  cudaMemset(d_counts, 0, nbins*sizeof(int));
+  const int npoints = dims.nx*dims.ny*dims.nz;
+  const size_t shared_bytes = nbins <= MAX_SHARED_COUNTS ? nbins*sizeof(int) : 0;
+  histogramKernel<<<(npoints+KERNEL_THREADS-1)/KERNEL_THREADS,KERNEL_THREADS,shared_bytes>>>
+	  (d_field,dims,transform,shift,scale,a,b,nbins,d_counts);
+  checkKernelError("histogramKernel");
+  cudaMemcpy(h_counts, d_counts, nbins*sizeof(int), cudaMemcpyDeviceToHost);
+#endif
+}
+/***********************************************************************************************/
+// Adds |du|^q, q=1..GPU_SF_QMAX-1, and du^3 of the increment du to sums.
+HOST_DEVICE void addIncrementMoments(const GpuKernelReal du, GpuKernelReal sums[GPU_SF_QMAX])
+{
+  const GpuKernelReal adu = fabs(du);
+  GpuKernelReal pow_q = 1;
+  for (int q = 0; q < GPU_SF_QMAX-1; ++q)
+  {
+	  pow_q *= adu;
+	  sums[q] += pow_q;
+  }
+  sums[GPU_SF_QMAX-1] += du*du*du;
+}
+/***********************************************************************************************/
+#if !AC_CPU_BUILD
+// 2-D grid: blockIdx.y selects the separation and the blocks along x share the domain by grid striding. Each block
+// reduces its moments in shared memory and adds them to sf with one atomic per moment, as gpuHistogram does.
+__global__ void structureFunctionsXKernel(const GpuKernelReal* field, const GpuGridDims dims, const int* separations,
+                                          const int nsep, GpuKernelReal* sf)
+{
+  __shared__ GpuKernelReal partial[KERNEL_THREADS];
+
+  const int sep = separations[blockIdx.y] % dims.nx;
+  GpuKernelReal sums[GPU_SF_QMAX] = {0};
+  for (int p = threadIdx.x + blockIdx.x*blockDim.x; p < dims.nx*dims.ny*dims.nz; p += blockDim.x*gridDim.x)
+  {
+	  const int x = p % dims.nx, y = (p / dims.nx) % dims.ny, z = p / (dims.nx*dims.ny);
+	  const GpuKernelReal* row = field + dims.l1 + (size_t)dims.mx*((dims.m1+y) + (size_t)dims.my*(dims.n1+z));
+	  addIncrementMoments(row[x] - row[(x+sep) % dims.nx],sums);
+	  addIncrementMoments(row[x] - row[(x-sep+dims.nx) % dims.nx],sums);
+  }
+  for (int q = 0; q < GPU_SF_QMAX; ++q)
+  {
+	  partial[threadIdx.x] = sums[q];
+	  __syncthreads();
+	  for (int stride = blockDim.x/2; stride > 0; stride /= 2)
+	  {
+		  if (threadIdx.x < stride) partial[threadIdx.x] += partial[threadIdx.x+stride];
+		  __syncthreads();
+	  }
+	  if (threadIdx.x == 0) atomicAdd(&sf[q*nsep + blockIdx.y],partial[0]);
+	  __syncthreads();
+  }
+}
+#endif
+/***********************************************************************************************/
+void gpuStructureFunctionsX(const GpuKernelReal* d_field, const GpuGridDims dims, const int* h_separations,
+                            const int nsep, GpuKernelReal* h_sf)
+{
+#if AC_CPU_BUILD
+  for (int i = 0; i < nsep; ++i)
+  {
+	  const int sep = h_separations[i] % dims.nx;
+	  GpuKernelReal sums[GPU_SF_QMAX] = {0};
+	  for (int z = 0; z < dims.nz; ++z)
+	  for (int y = 0; y < dims.ny; ++y)
+	  for (int x = 0; x < dims.nx; ++x)
+	  {
+		  const GpuKernelReal* row = d_field + dims.l1 + (size_t)dims.mx*((dims.m1+y) + (size_t)dims.my*(dims.n1+z));
+		  addIncrementMoments(row[x] - row[(x+sep) % dims.nx],sums);
+		  addIncrementMoments(row[x] - row[(x-sep+dims.nx) % dims.nx],sums);
+	  }
+	  for (int q = 0; q < GPU_SF_QMAX; ++q) h_sf[q*nsep + i] = sums[q];
+  }
+#else
+  //Separations (as reals, rounded up) followed by the sums
+  const size_t nsep_reals = (nsep*sizeof(int)+sizeof(GpuKernelReal)-1)/sizeof(GpuKernelReal);
+  GpuKernelReal* d_work = scratchBuffer(nsep_reals + GPU_SF_QMAX*nsep);
+  cudaMemcpy(d_work, h_separations, nsep*sizeof(int), cudaMemcpyHostToDevice);
+  cudaMemset(d_work+nsep_reals, 0, GPU_SF_QMAX*nsep*sizeof(GpuKernelReal));
+  //Enough chunks per separation to fill the device, but no more blocks than points to cover
+  const int npoints = dims.nx*dims.ny*dims.nz;
+  const int nchunks = std::max(1,std::min((npoints+KERNEL_THREADS-1)/KERNEL_THREADS,MAX_SF_BLOCKS/nsep));
+  structureFunctionsXKernel<<<dim3(nchunks,nsep),KERNEL_THREADS>>>(d_field,dims,(const int*)d_work,nsep,d_work+nsep_reals);
+  checkKernelError("structureFunctionsXKernel");
+  cudaMemcpy(h_sf, d_work+nsep_reals, GPU_SF_QMAX*nsep*sizeof(GpuKernelReal), cudaMemcpyDeviceToHost);
+#endif
+}
+/***********************************************************************************************/
+void gpuPlaneSums(const GpuKernelReal* d_field, const GpuGridDims dims, const int keep_axis, const int power,
+                  GpuKernelReal* h_sums)
+{
+  const int nkeep = keep_axis == 0 ? dims.nx : keep_axis == 1 ? dims.ny : dims.nz;
+#if AC_CPU_BUILD
+  for (int k = 0; k < nkeep; ++k) h_sums[k] = 0;
+  for (int z = 0; z < dims.nz; ++z)
+  for (int y = 0; y < dims.ny; ++y)
+  for (int x = 0; x < dims.nx; ++x)
+  {
+	  const GpuKernelReal val = d_field[(dims.l1+x) + (size_t)dims.mx*((dims.m1+y) + (size_t)dims.my*(dims.n1+z))];
+	  h_sums[keep_axis == 0 ? x : keep_axis == 1 ? y : z] += power == 2 ? val*val : val;
+  }
+#else
+  GpuKernelReal* d_sums = scratchBuffer(nkeep);
+  planeSumsKernel<<<nkeep,KERNEL_THREADS>>>(d_field,dims,keep_axis,power,d_sums);
+  checkKernelError("planeSumsKernel");
+  cudaMemcpy(h_sums, d_sums, nkeep*sizeof(GpuKernelReal), cudaMemcpyDeviceToHost);
+#endif
+}
+/***********************************************************************************************/
+void gpuZSums(const GpuKernelReal* d_field, const GpuGridDims dims, const int power, GpuKernelReal* h_sums)
+{
+  const int nxy = dims.nx*dims.ny;
+#if AC_CPU_BUILD
+  for (int p = 0; p < nxy; ++p)
+  {
+	  const int x = p % dims.nx, y = p / dims.nx;
+	  h_sums[p] = 0;
+	  for (int z = 0; z < dims.nz; ++z)
+	  {
+		  const GpuKernelReal val = d_field[(dims.l1+x) + (size_t)dims.mx*((dims.m1+y) + (size_t)dims.my*(dims.n1+z))];
+		  h_sums[p] += power == 2 ? val*val : val;
+	  }
+  }
+#else
+  GpuKernelReal* d_sums = scratchBuffer(nxy);
+  zSumsKernel<<<(nxy+KERNEL_THREADS-1)/KERNEL_THREADS,KERNEL_THREADS>>>(d_field,dims,power,d_sums);
+  checkKernelError("zSumsKernel");
+  cudaMemcpy(h_sums, d_sums, nxy*sizeof(GpuKernelReal), cudaMemcpyDeviceToHost);
+#endif
+}
+/***********************************************************************************************/
+#if !AC_CPU_BUILD
+// One thread per (x,z) column, consecutive threads read consecutive x. The columns are independent, so the
+// sequential sweeps along y of all nx*nz columns proceed in parallel.
+__global__ void columnScanYKernel(const GpuKernelReal* dtau, const GpuGridDims dims, GpuKernelReal* up,
+                                  GpuKernelReal* down, GpuKernelReal* totals)
+{
+  const int p = threadIdx.x + blockIdx.x*blockDim.x;
+  if (p >= dims.nx*dims.nz) return;
+
+  const int x = p % dims.nx, z = p / dims.nx;
+  const size_t base = (dims.l1+x) + (size_t)dims.mx*(dims.m1 + (size_t)dims.my*(dims.n1+z));
+  GpuKernelReal sum = 0;
+  for (int y = 0; y < dims.ny; ++y)
+  {
+	  sum += dtau[base + (size_t)dims.mx*y];
+	  up[base + (size_t)dims.mx*y] = sum;
+  }
+  totals[p] = sum;
+  sum = 0;
+  for (int y = dims.ny-1; y >= 0; --y)
+  {
+	  sum += dtau[base + (size_t)dims.mx*y];
+	  down[base + (size_t)dims.mx*y] = sum;
+  }
+}
+/***********************************************************************************************/
+__global__ void columnOffsetMinYKernel(GpuKernelReal* up, GpuKernelReal* down, const GpuGridDims dims,
+                                       const GpuKernelReal* offsets, GpuKernelReal* tau)
+{
+  const int p = threadIdx.x + blockIdx.x*blockDim.x;
+  if (p >= dims.nx*dims.ny*dims.nz) return;
+
+  const int x = p % dims.nx, y = (p / dims.nx) % dims.ny, z = p / (dims.nx*dims.ny);
+  const size_t idx = (dims.l1+x) + (size_t)dims.mx*((dims.m1+y) + (size_t)dims.my*(dims.n1+z));
+  const int column = x + dims.nx*z;
+  const GpuKernelReal val_up   = up[idx]   + offsets[column];
+  const GpuKernelReal val_down = down[idx] + offsets[dims.nx*dims.nz+column];
+  up[idx]   = val_up;
+  down[idx] = val_down;
+  tau[idx]  = val_up < val_down ? val_up : val_down;
+}
+#endif
+/***********************************************************************************************/
+void gpuColumnScanY(const GpuKernelReal* d_dtau, const GpuGridDims dims, GpuKernelReal* d_up, GpuKernelReal* d_down,
+                    GpuKernelReal* h_totals)
+{
+  const int ncols = dims.nx*dims.nz;
+#if AC_CPU_BUILD
+  for (int p = 0; p < ncols; ++p)
+  {
+	  const int x = p % dims.nx, z = p / dims.nx;
+	  const size_t base = (dims.l1+x) + (size_t)dims.mx*(dims.m1 + (size_t)dims.my*(dims.n1+z));
+	  GpuKernelReal sum = 0;
+	  for (int y = 0; y < dims.ny; ++y)
+	  {
+		  sum += d_dtau[base + (size_t)dims.mx*y];
+		  d_up[base + (size_t)dims.mx*y] = sum;
+	  }
+	  h_totals[p] = sum;
+	  sum = 0;
+	  for (int y = dims.ny-1; y >= 0; --y)
+	  {
+		  sum += d_dtau[base + (size_t)dims.mx*y];
+		  d_down[base + (size_t)dims.mx*y] = sum;
+	  }
+  }
+#else
+  GpuKernelReal* d_totals = scratchBuffer(ncols);
+  columnScanYKernel<<<(ncols+KERNEL_THREADS-1)/KERNEL_THREADS,KERNEL_THREADS>>>(d_dtau,dims,d_up,d_down,d_totals);
+  checkKernelError("columnScanYKernel");
+  cudaMemcpy(h_totals, d_totals, ncols*sizeof(GpuKernelReal), cudaMemcpyDeviceToHost);
+#endif
+}
+/***********************************************************************************************/
+void gpuColumnOffsetMinY(GpuKernelReal* d_up, GpuKernelReal* d_down, const GpuGridDims dims,
+                         const GpuKernelReal* h_offsets, GpuKernelReal* d_tau)
+{
+  const int ncols = dims.nx*dims.nz;
+#if AC_CPU_BUILD
+  for (int z = 0; z < dims.nz; ++z)
+  for (int y = 0; y < dims.ny; ++y)
+  for (int x = 0; x < dims.nx; ++x)
+  {
+	  const size_t idx = (dims.l1+x) + (size_t)dims.mx*((dims.m1+y) + (size_t)dims.my*(dims.n1+z));
+	  d_up[idx]   += h_offsets[x + dims.nx*z];
+	  d_down[idx] += h_offsets[ncols + x + dims.nx*z];
+	  d_tau[idx]   = std::min(d_up[idx],d_down[idx]);
+  }
+#else
+  GpuKernelReal* d_offsets = scratchBuffer(2*ncols);
+  cudaMemcpy(d_offsets, h_offsets, 2*ncols*sizeof(GpuKernelReal), cudaMemcpyHostToDevice);
+  const int npoints = dims.nx*dims.ny*dims.nz;
+  columnOffsetMinYKernel<<<(npoints+KERNEL_THREADS-1)/KERNEL_THREADS,KERNEL_THREADS>>>(d_up,d_down,dims,d_offsets,d_tau);
+  checkKernelError("columnOffsetMinYKernel");
+#endif
+}
+/***********************************************************************************************/
+#define SHIFT_POINTS 6
+// Value of the column through idx0 (stride mx) at y-shift, from the SHIFT_POINTS nearest points, periodic in ny.
+HOST_DEVICE GpuKernelReal shiftedValue(const GpuKernelReal* field, const size_t idx0, const GpuGridDims dims,
+                                       const int y, const GpuKernelReal shift)
+{
+  const GpuKernelReal pos = y - shift;
+  const GpuKernelReal base = floor(pos);
+  const GpuKernelReal frac = pos - base;
+  const int first = (int)base - SHIFT_POINTS/2 + 1;
+
+  GpuKernelReal val = 0;
+  for (int i = 0; i < SHIFT_POINTS; ++i)
+  {
+	  GpuKernelReal weight = 1;
+	  const int offset = i - SHIFT_POINTS/2 + 1;
+	  for (int j = 0; j < SHIFT_POINTS; ++j)
+		  if (j != i) weight *= (frac - (j - SHIFT_POINTS/2 + 1))/(GpuKernelReal)(offset - (j - SHIFT_POINTS/2 + 1));
+	  const int yy = ((first + i) % dims.ny + dims.ny) % dims.ny;
+	  val += weight*field[idx0 + (size_t)dims.mx*yy];
+  }
+  return val;
+}
+/***********************************************************************************************/
+#if !AC_CPU_BUILD
+// Writes the shifted values to shifted (nx*ny*nz, x fastest), so that no thread reads what another one has written.
+__global__ void shiftYKernel(const GpuKernelReal* field, const GpuGridDims dims, const GpuKernelReal* shift,
+                             GpuKernelReal* shifted)
+{
+  const int p = threadIdx.x + blockIdx.x*blockDim.x;
+  if (p >= dims.nx*dims.ny*dims.nz) return;
+
+  const int x = p % dims.nx, y = (p / dims.nx) % dims.ny, z = p / (dims.nx*dims.ny);
+  const size_t idx0 = (dims.l1+x) + (size_t)dims.mx*(dims.m1 + (size_t)dims.my*(dims.n1+z));
+  shifted[p] = shiftedValue(field,idx0,dims,y,shift[x]);
+}
+/***********************************************************************************************/
+__global__ void copyToDomainKernel(const GpuKernelReal* src, const GpuGridDims dims, GpuKernelReal* field)
+{
+  const int p = threadIdx.x + blockIdx.x*blockDim.x;
+  if (p >= dims.nx*dims.ny*dims.nz) return;
+
+  const int x = p % dims.nx, y = (p / dims.nx) % dims.ny, z = p / (dims.nx*dims.ny);
+  field[(dims.l1+x) + (size_t)dims.mx*((dims.m1+y) + (size_t)dims.my*(dims.n1+z))] = src[p];
+}
+#endif
+/***********************************************************************************************/
+void gpuShiftY(GpuKernelReal* d_field, const GpuGridDims dims, const GpuKernelReal* h_shift)
+{
+  const int npoints = dims.nx*dims.ny*dims.nz;
+#if AC_CPU_BUILD
+  std::vector<GpuKernelReal> shifted(npoints);
+  for (int p = 0; p < npoints; ++p)
+  {
+	  const int x = p % dims.nx, y = (p / dims.nx) % dims.ny, z = p / (dims.nx*dims.ny);
+	  const size_t idx0 = (dims.l1+x) + (size_t)dims.mx*(dims.m1 + (size_t)dims.my*(dims.n1+z));
+	  shifted[p] = shiftedValue(d_field,idx0,dims,y,h_shift[x]);
+  }
+  for (int p = 0; p < npoints; ++p)
+  {
+	  const int x = p % dims.nx, y = (p / dims.nx) % dims.ny, z = p / (dims.nx*dims.ny);
+	  d_field[(dims.l1+x) + (size_t)dims.mx*((dims.m1+y) + (size_t)dims.my*(dims.n1+z))] = shifted[p];
+  }
+#else
+  //Shifts first, then the shifted field, in one scratch allocation
+  GpuKernelReal* d_work = scratchBuffer(dims.nx + npoints);
+  cudaMemcpy(d_work, h_shift, dims.nx*sizeof(GpuKernelReal), cudaMemcpyHostToDevice);
+  const int nblocks = (npoints+KERNEL_THREADS-1)/KERNEL_THREADS;
+  shiftYKernel<<<nblocks,KERNEL_THREADS>>>(d_field,dims,d_work,d_work+dims.nx);
+  checkKernelError("shiftYKernel");
+  copyToDomainKernel<<<nblocks,KERNEL_THREADS>>>(d_work+dims.nx,dims,d_field);
+  checkKernelError("copyToDomainKernel");
+#endif
+}
+/***********************************************************************************************/
+#if !AC_CPU_BUILD
+template <typename T>
+__global__ void packDomainKernel(const GpuKernelReal* field, const GpuGridDims dims, T* packed)
+{
+  const int p = threadIdx.x + blockIdx.x*blockDim.x;
+  if (p >= dims.nx*dims.ny*dims.nz) return;
+
+  const int x = p % dims.nx, y = (p / dims.nx) % dims.ny, z = p / (dims.nx*dims.ny);
+  packed[p] = (T)field[(dims.l1+x) + (size_t)dims.mx*((dims.m1+y) + (size_t)dims.my*(dims.n1+z))];
+}
+/***********************************************************************************************/
+template <typename T>
+__global__ void unpackDomainKernel(const T* packed, const GpuGridDims dims, GpuKernelReal* field)
+{
+  const int p = threadIdx.x + blockIdx.x*blockDim.x;
+  if (p >= dims.nx*dims.ny*dims.nz) return;
+
+  const int x = p % dims.nx, y = (p / dims.nx) % dims.ny, z = p / (dims.nx*dims.ny);
+  field[(dims.l1+x) + (size_t)dims.mx*((dims.m1+y) + (size_t)dims.my*(dims.n1+z))] = (GpuKernelReal)packed[p];
+}
+#endif
+/***********************************************************************************************/
+void gpuPackDomain(const GpuKernelReal* const* d_fields, const int nfields, const GpuGridDims dims, const bool to_float,
+                   void* d_packed)
+{
+  const size_t npoints = (size_t)dims.nx*dims.ny*dims.nz;
+  for (int i = 0; i < nfields; ++i)
+  {
+#if AC_CPU_BUILD
+	  for (size_t p = 0; p < npoints; ++p)
+	  {
+		  const int x = p % dims.nx, y = (p / dims.nx) % dims.ny, z = p / ((size_t)dims.nx*dims.ny);
+		  const GpuKernelReal val = d_fields[i][(dims.l1+x) + (size_t)dims.mx*((dims.m1+y) + (size_t)dims.my*(dims.n1+z))];
+		  if (to_float) ((float*)d_packed)[i*npoints+p] = (float)val;
+		  else  ((GpuKernelReal*)d_packed)[i*npoints+p] = val;
+	  }
+#else
+	  const int nblocks = (npoints+KERNEL_THREADS-1)/KERNEL_THREADS;
+	  if (to_float)
+		  packDomainKernel<<<nblocks,KERNEL_THREADS>>>(d_fields[i],dims,(float*)d_packed+i*npoints);
+	  else
+		  packDomainKernel<<<nblocks,KERNEL_THREADS>>>(d_fields[i],dims,(GpuKernelReal*)d_packed+i*npoints);
+	  checkKernelError("packDomainKernel");
+#endif
+  }
+}
+/***********************************************************************************************/
+void gpuUnpackDomain(const void* d_packed, const bool from_float, const int nfields, const GpuGridDims dims,
+                     GpuKernelReal* const* d_fields)
+{
+  const size_t npoints = (size_t)dims.nx*dims.ny*dims.nz;
+  for (int i = 0; i < nfields; ++i)
+  {
+#if AC_CPU_BUILD
+	  for (size_t p = 0; p < npoints; ++p)
+	  {
+		  const int x = p % dims.nx, y = (p / dims.nx) % dims.ny, z = p / ((size_t)dims.nx*dims.ny);
+		  d_fields[i][(dims.l1+x) + (size_t)dims.mx*((dims.m1+y) + (size_t)dims.my*(dims.n1+z))]
+			  = from_float ? (GpuKernelReal)((const float*)d_packed)[i*npoints+p] : ((const GpuKernelReal*)d_packed)[i*npoints+p];
+	  }
+#else
+	  const int nblocks = (npoints+KERNEL_THREADS-1)/KERNEL_THREADS;
+	  if (from_float)
+		  unpackDomainKernel<<<nblocks,KERNEL_THREADS>>>((const float*)d_packed+i*npoints,dims,d_fields[i]);
+	  else
+		  unpackDomainKernel<<<nblocks,KERNEL_THREADS>>>((const GpuKernelReal*)d_packed+i*npoints,dims,d_fields[i]);
+	  checkKernelError("unpackDomainKernel");
+#endif
+  }
+}
+/***********************************************************************************************/
+#if !AC_CPU_BUILD
+__global__ void decimateKernel(const GpuKernelReal* field, const GpuGridDims dims, const int3 first, const int3 step,
+                               const int3 n, GpuKernelReal* out)
+{
+  const int p = blockIdx.x*blockDim.x + threadIdx.x;
+  if (p >= n.x*n.y*n.z) return;
+  const int x = p % n.x, y = (p / n.x) % n.y, z = p / (n.x*n.y);
+  out[p] = field[(first.x+x*step.x) + (size_t)dims.mx*((first.y+y*step.y) + (size_t)dims.my*(first.z+z*step.z))];
+}
+#endif
+/***********************************************************************************************/
+void gpuDecimate(const GpuKernelReal* d_field, const GpuGridDims dims, const int first[3], const int step[3],
+                 const int n[3], GpuKernelReal* h_out)
+{
+  const int npoints = n[0]*n[1]*n[2];
+#if AC_CPU_BUILD
+  for (int p = 0; p < npoints; ++p)
+  {
+	  const int x = p % n[0], y = (p / n[0]) % n[1], z = p / (n[0]*n[1]);
+	  h_out[p] = d_field[(first[0]+x*step[0]) + (size_t)dims.mx*((first[1]+y*step[1]) + (size_t)dims.my*(first[2]+z*step[2]))];
+  }
+#else
+  GpuKernelReal* d_work = scratchBuffer(npoints);
+  decimateKernel<<<(npoints+KERNEL_THREADS-1)/KERNEL_THREADS,KERNEL_THREADS>>>
+	  (d_field,dims,make_int3(first[0],first[1],first[2]),make_int3(step[0],step[1],step[2]),make_int3(n[0],n[1],n[2]),d_work);
+  checkKernelError("decimateKernel");
+  cudaMemcpy(h_out, d_work, npoints*sizeof(GpuKernelReal), cudaMemcpyDeviceToHost);
+#endif
+}
+/***********************************************************************************************/
+#if !AC_CPU_BUILD
+__global__ void relaxKernel(GpuKernelReal* avg, const GpuKernelReal* field, const size_t count, const GpuKernelReal weight)
+{
+  const size_t i = (size_t)blockIdx.x*blockDim.x + threadIdx.x;
+  if (i < count) avg[i] += weight*(field[i]-avg[i]);
+}
+#endif
+/***********************************************************************************************/
+void gpuRelax(GpuKernelReal* d_avg, const GpuKernelReal* d_field, const size_t count, const GpuKernelReal weight)
+{
+#if AC_CPU_BUILD
+  for (size_t i = 0; i < count; ++i) d_avg[i] += weight*(d_field[i]-d_avg[i]);
+#else
+  relaxKernel<<<(count+KERNEL_THREADS-1)/KERNEL_THREADS,KERNEL_THREADS>>>(d_avg,d_field,count,weight);
+  checkKernelError("relaxKernel");
+#endif
+}
+/***********************************************************************************************/
+size_t gpuScratchBytes()
+{
+#if AC_CPU_BUILD
+  return 0;
+#else
+  return scratch_count*sizeof(GpuKernelReal);
+#endif
+}
+/***********************************************************************************************/
+void gpuFreeScratch()
+{
+#if !AC_CPU_BUILD
+  if (d_scratch != NULL) cudaFree(d_scratch);
+  d_scratch = NULL;
+  scratch_count = 0;
+#endif
+}
+/***********************************************************************************************/
@@ -0,0 +1,101 @@
+/*                             gpu_kernels.h
+                               --------------------
+
+   Description:
+           Small device kernels of the PC-Astaroth interface which work directly on the raw vertex buffers
+           (acDeviceGetVertexBufferPtrs), for reductions that are not expressed as DSL task graphs.
+           Compiled as CUDA or HIP (as plain C++ for CPU_BUILD) in gpu_kernels.cu.
+*/
+#pragma once
+
+#if AC_DOUBLE_PRECISION
+  typedef double GpuKernelReal;
+#else
+  typedef float  GpuKernelReal;
+#endif
+
+// Extents of a vertex buffer (m*) and of its computational domain (n*, starting at the 0-based index *1).
+typedef struct {
+  int mx, my, mz;
+  int l1, m1, n1;
+  int nx, ny, nz;
+} GpuGridDims;
+
+// Sums of field^power over the two directions perpendicular to keep_axis (0=x, 1=y, 2=z), for each point of the
+// computational domain along keep_axis. h_sums receives nx, ny or nz values on the host.
+void gpuPlaneSums(const GpuKernelReal* d_field, const GpuGridDims dims, const int keep_axis, const int power,
+                  GpuKernelReal* h_sums);
+
+// Sums of field^power over z for each (x,y) of the computational domain; h_sums receives nx*ny values, x fastest.
+void gpuZSums(const GpuKernelReal* d_field, const GpuGridDims dims, const int power, GpuKernelReal* h_sums);
+
+// Scans the computational domain of the nfields device buffers d_fields (a host array of device pointers) for
+// NaN or Inf. Returns the index of the first offending field, -1 if all are finite; pos then receives the 0-based
+// position of its first non-finite point relative to the start of the computational domain (l1,m1,n1).
+int gpuFindNonFinite(const GpuKernelReal* const* d_fields, const int nfields, const GpuGridDims dims, int pos[3]);
+
+// Planar Fourier coefficients of the three components of a vector, laid out like the vertex buffers.
+typedef struct {
+  const GpuKernelReal* re[3];
+  const GpuKernelReal* im[3];
+} GpuSpectralVector;
+
+// Shell-integrated spectra of the local Fourier modes of vec: h_spectrum gets |a|^2 (|k x a|^2 if curl),
+// h_helicity Re(a^* . (i k x a)), both times norm. h_kx,h_ky,h_kz are the local wavenumbers (nx,ny,nz values),
+// the shell of a mode is nint(kscale*|k|) and only shells 0..nbins-1 are kept.
+void gpuShellSpectra(const GpuSpectralVector vec, const GpuGridDims dims, const GpuKernelReal* h_kx,
+                     const GpuKernelReal* h_ky, const GpuKernelReal* h_kz, const GpuKernelReal kscale,
+                     const bool curl, const GpuKernelReal norm, const int nbins,
+                     GpuKernelReal* h_spectrum, GpuKernelReal* h_helicity);
+
+// Transformations of the values before binning in gpuHistogram.
+enum { GPU_HIST_LINEAR, GPU_HIST_LOG10_ABS, GPU_HIST_LOG };
+
+// Histogram of the computational domain of d_field in nbins bins. A value f falls into bin int(a*g+b), clamped to
+// 0..nbins-1, with g = scale*(f-shift) (GPU_HIST_LINEAR), log10(scale*|f-shift|) (GPU_HIST_LOG10_ABS) or
+// scale*log(f) (GPU_HIST_LOG). h_counts receives the nbins counts of the local subdomain.
+void gpuHistogram(const GpuKernelReal* d_field, const GpuGridDims dims, const int transform, const GpuKernelReal shift,
+                  const GpuKernelReal scale, const GpuKernelReal a, const GpuKernelReal b, const int nbins,
+                  int* h_counts);
+
+// Sums for the structure functions of struct_func.f90 along x: for each of the nsep separations s in h_separations,
+// h_sf[(q-1)*nsep+i] receives the sum of |du|^q for q=1..GPU_SF_QMAX-1 and, in the last slot, that of du^3, over both
+// increments du = u(x)-u(x+-s) of every point, with x+-s wrapped periodically within the local nx.
+#define GPU_SF_QMAX 9
+void gpuStructureFunctionsX(const GpuKernelReal* d_field, const GpuGridDims dims, const int* h_separations,
+                            const int nsep, GpuKernelReal* h_sf);
+
+// Inclusive sums of the computational domain of d_dtau along y for every (x,z): d_up gets them in the direction of
+// increasing y, d_down in that of decreasing y. h_totals receives the nx*nz column totals, x fastest.
+void gpuColumnScanY(const GpuKernelReal* d_dtau, const GpuGridDims dims, GpuKernelReal* d_up, GpuKernelReal* d_down,
+                    GpuKernelReal* h_totals);
+
+// Adds the per-column offsets h_offsets (nx*nz values for d_up, followed by nx*nz for d_down) and writes
+// min(d_up,d_down) to d_tau, all on the computational domain.
+void gpuColumnOffsetMinY(GpuKernelReal* d_up, GpuKernelReal* d_down, const GpuGridDims dims,
+                         const GpuKernelReal* h_offsets, GpuKernelReal* d_tau);
+
+// Shifts the computational domain of d_field periodically along y by h_shift[x] (nx values, in grid spacings) for
+// every x, f(y) -> f(y-shift), with 6-point Lagrangian interpolation. The subdomain must span the whole y extent.
+void gpuShiftY(GpuKernelReal* d_field, const GpuGridDims dims, const GpuKernelReal* h_shift);
+
+// Copies the computational domains of the nfields device buffers d_fields (a host array of device pointers) one after
+// another into d_packed, x fastest, converted to float if to_float; the layout of a contiguous (nfields,nz,ny,nx) tensor.
+void gpuPackDomain(const GpuKernelReal* const* d_fields, const int nfields, const GpuGridDims dims, const bool to_float,
+                   void* d_packed);
+
+// Inverse of gpuPackDomain: writes the packed (float if from_float) values back into the computational domains.
+void gpuUnpackDomain(const void* d_packed, const bool from_float, const int nfields, const GpuGridDims dims,
+                     GpuKernelReal* const* d_fields);
+
+// Copies every step[i]-th point of d_field along axis i, starting at first[i] (0-based, ghost zones included), to h_out,
+// which receives n[0]*n[1]*n[2] values, x fastest.
+void gpuDecimate(const GpuKernelReal* d_field, const GpuGridDims dims, const int first[3], const int step[3],
+                 const int n[3], GpuKernelReal* h_out);
+
+// Relaxes the count values of d_avg towards d_field, avg += weight*(field-avg); weight=1 copies d_field.
+void gpuRelax(GpuKernelReal* d_avg, const GpuKernelReal* d_field, const size_t count, const GpuKernelReal weight);
+
+// Bytes held by the device scratch buffer of the reductions above (its high-water mark), and its release at the end.
+size_t gpuScratchBytes();
+void gpuFreeScratch();
@@ -0,0 +1,203 @@
+/*                             gpu_profiler.h
+                               --------------------
+
+   Description:
+           Runtime-switchable (lgpu_timings) wall-clock timing of the task graphs and host-device copies
+           issued by the PC-Astaroth interface, with per-rank min/mean/max written to gpu_timings.dat.
+           If built with GPU_TRACING=on, every region is also pushed as an NVTX (CUDA) or roctx (HIP) range,
+           so that Nsight Systems/rocprof timelines can be matched with the Pencil substeps.
+           The ranges also select the kernels for per-kernel counters, e.g. a roofline of those of AC_rhs with
+           ncu --nvtx --nvtx-include "AC_rhs/" --set roofline, or rocprof-compute profile with the roctx range filter.
+           If built with ENERGY_METERING=on, the timed regions also accumulate the energy drawn by the device,
+           read from its NVML (CUDA) or ROCm SMI (HIP) energy counter.
+           The timed regions are also kept as a timeline (the first GPU_TRACE_MAX_EVENTS per rank), written
+           as Chrome trace gpu_trace.json with the rank setting the pace of each call marked as critical.
+*/
+#pragma once
+
+#include <cfloat>
+#include <vector>
+
+#if AC_GPU_TRACING && !AC_CPU_BUILD
+#if AC_USE_HIP
+  #include <roctracer/roctx.h>
+  #define gpuTracePush(name) roctxRangePushA(name)
+  #define gpuTracePop()      roctxRangePop()
+#else
+  #include <nvtx3/nvToolsExt.h>
+  #define gpuTracePush(name) nvtxRangePushA(name)
+  #define gpuTracePop()      nvtxRangePop()
+#endif
+#else
+  #define gpuTracePush(name)
+  #define gpuTracePop()
+#endif
+
+#if AC_ENERGY_METERING && !AC_CPU_BUILD
+#if AC_USE_HIP
+  #include <rocm_smi/rocm_smi.h>
+#else
+  #include <nvml.h>
+#endif
+#endif
+
+typedef enum {
+  GPU_REGION_RHS,
+  GPU_REGION_BEFORE_BOUNDARY,
+  GPU_REGION_AFTER_TIMESTEP,
+  GPU_REGION_BOUNDCONDS,
+  GPU_REGION_SELFGRAVITY,
+  GPU_REGION_LOAD_FARRAY,
+  GPU_REGION_COPY_FARRAY,
+  GPU_REGION_HALO_PROBE,
+  GPU_REGION_RHS_SUBSTEP,        // one per substep, up to GPU_MAX_SUBSTEPS
+  NUM_GPU_REGIONS = GPU_REGION_RHS_SUBSTEP + 5
+} GpuRegionId;
+#define GPU_MAX_SUBSTEPS (NUM_GPU_REGIONS-GPU_REGION_RHS_SUBSTEP)
+
+static const char* gpu_region_names[NUM_GPU_REGIONS] = {
+  "AC_rhs",
+  "AC_before_boundary_steps",
+  "AC_after_timestep",
+  "boundconds",
+  "selfgravity",
+  "loadFarray",
+  "copyFarray",
+  "halo exchange+bcs alone",
+  "AC_rhs substep 1",
+  "AC_rhs substep 2",
+  "AC_rhs substep 3",
+  "AC_rhs substep 4",
+  "AC_rhs substep 5",
+};
+
+typedef struct {
+  double min, max, sum;
+  double energy;                 // J, only with ENERGY_METERING
+  long   calls;
+} GpuRegionStats;
+
+static GpuRegionStats gpu_region_stats[NUM_GPU_REGIONS] = {};
+
+// Timeline of the timed regions: region id, start and end time [s] per event.
+constexpr size_t GPU_TRACE_MAX_EVENTS = 100000;
+static std::vector<double> gpu_trace_events;
+
+/***********************************************************************************************/
+// Energy consumed by the device of this rank since an arbitrary origin in J, negative if not available.
+// The counter is looked up on first use by the PCI bus id of the current device.
+static double gpuDeviceEnergy()
+{
+#if AC_ENERGY_METERING && !AC_CPU_BUILD
+  static int state = 0;          // 0: not yet initialized, 1: available, -1: not available
+#if AC_USE_HIP
+  static uint32_t handle = 0;
+#else
+  static nvmlDevice_t handle;
+#endif
+  if (state == 0)
+  {
+	  state = -1;
+	  int device = -1;
+	  char busid[64];
+	  if (cudaGetDevice(&device) == cudaSuccess && cudaDeviceGetPCIBusId(busid, sizeof(busid), device) == cudaSuccess)
+	  {
+#if AC_USE_HIP
+		  unsigned domain, bus, dev, func;
+		  uint32_t ndevices = 0;
+		  if (sscanf(busid, "%x:%x:%x.%x", &domain, &bus, &dev, &func) == 4 && rsmi_init(0) == RSMI_STATUS_SUCCESS
+		      && rsmi_num_monitor_devices(&ndevices) == RSMI_STATUS_SUCCESS)
+		  {
+			  const uint64_t bdfid = ((uint64_t)domain << 32) | (bus << 8) | (dev << 3) | func;
+			  for (uint32_t i = 0; i < ndevices; ++i)
+			  {
+				  uint64_t id;
+				  if (rsmi_dev_pci_id_get(i, &id) == RSMI_STATUS_SUCCESS && id == bdfid)
+				  {
+					  handle = i;
+					  state = 1;
+				  }
+			  }
+		  }
+#else
+		  if (nvmlInit_v2() == NVML_SUCCESS && nvmlDeviceGetHandleByPciBusId_v2(busid, &handle) == NVML_SUCCESS)
+		  {
+			  unsigned long long energy;
+			  //The counter exists from Volta on
+			  if (nvmlDeviceGetTotalEnergyConsumption(handle, &energy) == NVML_SUCCESS) state = 1;
+		  }
+#endif
+	  }
+	  if (state < 0) fprintf(stderr,"gpuDeviceEnergy: no energy counter available for device %d\n", device);
+  }
+  if (state < 0) return -1.;
+#if AC_USE_HIP
+  uint64_t power, timestamp;
+  float resolution;
+  if (rsmi_dev_energy_count_get(handle, &power, &resolution, &timestamp) != RSMI_STATUS_SUCCESS) return -1.;
+  return 1e-6*power*resolution;
+#else
+  unsigned long long energy;
+  if (nvmlDeviceGetTotalEnergyConsumption(handle, &energy) != NVML_SUCCESS) return -1.;
+  return 1e-3*energy;
+#endif
+#else
+  return -1.;
+#endif
+}
+
+/***********************************************************************************************/
+static void gpuRegionRecord(const GpuRegionId id, const double start, const double end, const double energy)
+{
+  const double elapsed = end-start;
+  if (gpu_trace_events.size() < 3*GPU_TRACE_MAX_EVENTS)
+  {
+	  gpu_trace_events.push_back(id);
+	  gpu_trace_events.push_back(start);
+	  gpu_trace_events.push_back(end);
+  }
+  GpuRegionStats& stats = gpu_region_stats[id];
+  if (stats.calls == 0)
+  {
+	  stats.min = DBL_MAX;
+	  stats.max = 0.;
+  }
+  stats.min  = std::min(stats.min,elapsed);
+  stats.max  = std::max(stats.max,elapsed);
+  stats.sum += elapsed;
+  stats.energy += energy;
+  stats.calls++;
+}
+/***********************************************************************************************/
+// Scoped region: the device is synchronized at both ends only when timing is switched on,
+// so that the measured wall-clock time covers the asynchronous work issued inside.
+class GpuRegion
+{
+  public:
+    GpuRegion(const GpuRegionId id_, const bool timed_) : id(id_), timed(timed_)
+    {
+      gpuTracePush(gpu_region_names[id]);
+      if (timed)
+      {
+	      acGridSynchronizeStream(STREAM_ALL);
+	      start = MPI_Wtime();
+	      start_energy = gpuDeviceEnergy();
+      }
+    }
+    ~GpuRegion()
+    {
+      if (timed)
+      {
+	      acGridSynchronizeStream(STREAM_ALL);
+	      const double end = MPI_Wtime(), end_energy = gpuDeviceEnergy();
+	      gpuRegionRecord(id,start,end,start_energy >= 0. && end_energy >= 0. ? end_energy-start_energy : 0.);
+      }
+      gpuTracePop();
+    }
+  private:
+    const GpuRegionId id;
+    const bool timed;
+    double start = 0.;
+    double start_energy = -1.;
+};
+/***********************************************************************************************/
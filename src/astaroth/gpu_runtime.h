@@ -0,0 +1,55 @@
+/*                             gpu_runtime.h
+                               --------------------
+
+   Description:
+           Thin mapping of the few CUDA runtime calls which the PC-Astaroth interface issues directly
+           (streams, events, pinned and page-locked host memory) onto HIP when Astaroth is built with USE_HIP.
+           Everything else goes through the Astaroth API.
+*/
+#pragma once
+
+#if !AC_CPU_BUILD
+#if AC_USE_HIP
+  #include <hip/hip_runtime.h>
+
+  #define cudaError_t                hipError_t
+  #define cudaSuccess                hipSuccess
+  #define cudaGetErrorString         hipGetErrorString
+  #define cudaGetLastError           hipGetLastError
+
+  #define cudaStream_t               hipStream_t
+  #define cudaStreamCreateWithFlags  hipStreamCreateWithFlags
+  #define cudaStreamNonBlocking      hipStreamNonBlocking
+  #define cudaStreamDestroy          hipStreamDestroy
+  #define cudaStreamSynchronize      hipStreamSynchronize
+
+  #define cudaEvent_t                hipEvent_t
+  #define cudaEventCreateWithFlags   hipEventCreateWithFlags
+  #define cudaEventDisableTiming     hipEventDisableTiming
+  #define cudaEventRecord            hipEventRecord
+  #define cudaEventSynchronize       hipEventSynchronize
+  #define cudaEventDestroy           hipEventDestroy
+
+  #define cudaMalloc                 hipMalloc
+  #define cudaFree                   hipFree
+  #define cudaMallocHost             hipHostMalloc
+  #define cudaFreeHost               hipHostFree
+  #define cudaHostRegister           hipHostRegister
+  #define cudaHostRegisterDefault    hipHostRegisterDefault
+  #define cudaHostUnregister         hipHostUnregister
+  #define cudaMemcpy                 hipMemcpy
+  #define cudaMemcpy2D               hipMemcpy2D
+  #define cudaMemcpyAsync            hipMemcpyAsync
+  #define cudaMemcpyDeviceToDevice   hipMemcpyDeviceToDevice
+  #define cudaMemcpyDeviceToHost     hipMemcpyDeviceToHost
+  #define cudaMemcpyHostToDevice     hipMemcpyHostToDevice
+
+  #define cudaGetDevice              hipGetDevice
+  #define cudaSetDevice              hipSetDevice
+  #define cudaGetDeviceCount         hipGetDeviceCount
+  #define cudaDeviceGetPCIBusId      hipDeviceGetPCIBusId
+  #define cudaMemGetInfo             hipMemGetInfo
+#else
+  #include <cuda_runtime.h>
+#endif
+#endif
@@ -26,6 +26,9 @@ static AcReal *halo_xz_buffer[2], *halo_yz_buffer[2];
 extern Node node;
 
 const int BOT=0, TOP=1, TOT=2;
+// nghost is set per build by the DERIV module (e.g. 2 for deriv_4th, 1 for deriv_2nd), and
+// so is NGHOST in the DSL (DSL/local/PC_nghost.h, see scripts/cparam.sed); lower-order builds
+// therefore already have narrower halos. Per-field widths would need Astaroth's halo exchange.
 int halo_widths_x[3]={nghost,nghost,2*nghost};    // bottom and top halo width and sum of them
 int halo_widths_y[3]={nghost,nghost,2*nghost};
 int halo_widths_z[3]={nghost,nghost,2*nghost};
@@ -128,12 +131,16 @@ void loadOuterRight(AcMesh& mesh, Stream stream)
 
 void loadOuterHalos(AcMesh& mesh)
 {
-    loadOuterFront(mesh,STREAM_DEFAULT);
-    loadOuterBack(mesh,STREAM_DEFAULT);
-    loadOuterTop(mesh,STREAM_DEFAULT);
-    loadOuterBot(mesh,STREAM_DEFAULT);
-    loadOuterLeft(mesh,STREAM_DEFAULT);
-    loadOuterRight(mesh,STREAM_DEFAULT);
+// One stream per plate (the same as in storeInnerHalos), so that the plates are transferred
+// concurrently; the caller synchronizes before integrating.
+// The CPU boundconds cannot be applied face by face as the plates arrive, as boundconds_y/z
+// work on the full arrays.
+    loadOuterFront(mesh,STREAM_6);
+    loadOuterBack(mesh,STREAM_1);
+    loadOuterTop(mesh,STREAM_3);
+    loadOuterBot(mesh,STREAM_2);
+    loadOuterLeft(mesh,STREAM_4);
+    loadOuterRight(mesh,STREAM_5);
 }
 
 void storeInnerFront(AcMesh& mesh, Stream stream)
@@ -5,7 +5,7 @@
 #include <stdio.h>
 #include <mpi.h>
 
-void torch_trainCAPI(int sub_dims[3], float* input, float* label, float* loss_val, bool dble=false){
+void torch_trainCAPI(int sub_dims[3], float* input, float* label, float* loss_val, bool dble=false, void* stream=NULL){
 
         torchfort_datatype_t precision = dble ? TORCHFORT_DOUBLE : TORCHFORT_FLOAT;
 	torchfort_result_t result = torchfort_set_manual_seed(943442);
@@ -18,7 +18,7 @@ void torch_trainCAPI(int sub_dims[3], float* input, float* label, float* loss_va
 	//printf("Calling c API");
 	int64_t input_shape[5] = {1, 3, sub_dims[2], sub_dims[1], sub_dims[0]};
 	int64_t label_shape[5] = {1, 6, sub_dims[2], sub_dims[1], sub_dims[0]};
-  	torchfort_result_t res = torchfort_train("stationary", input, 5, input_shape, label, 5, label_shape, loss_val, precision, 0);
+  	torchfort_result_t res = torchfort_train("stationary", input, 5, input_shape, label, 5, label_shape, loss_val, precision, (cudaStream_t) stream);
 
  	if (res != TORCHFORT_RESULT_SUCCESS)
  	{
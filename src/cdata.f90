@@ -211,12 +211,18 @@ module Cdata
   integer :: iz_loc=1,iz2_loc=1, iz3_loc=1, iz4_loc=1
   integer :: iproc=0,ipx=0,ipy=0,ipz=0,iproc_world=0,ipatch=0
   logical :: lprocz_slowest=.true.,lzorder=.false.,lmorton_curve=.false.,ltest_bcs=.true.,lcpu_timestep_on_gpu=.false., &
-             lsuppress_parallel_reductions=.false.,lread_all_vars_from_device = .false., lcuda_aware_mpi=.true.
-  logical :: lac_sparse_autotuning=.false.
+             lhilbert_curve=.false., &
+             lsuppress_parallel_reductions=.false.,lread_all_vars_from_device = .false., lcuda_aware_mpi=.true., &
+             lcopy_farray_async=.false., lpin_farray=.false., lgpu_timings=.false., ldt_limiter_report=.false., &
+             lreproducible_reductions=.false., lpin_helper_threads=.false., lgpu_numa_placement=.false., &
+             lgpu_direct_snapshots=.false., lshared_mem_halos=.false., lthreaded_mn_loop=.false., &
+             lhalo_traffic=.false.
+  logical :: lac_sparse_autotuning=.false., lgpu_lazy_autotuning=.false.
   integer :: xlneigh,ylneigh,zlneigh ! `lower' processor neighbours
   integer :: xuneigh,yuneigh,zuneigh ! `upper' processor neighbours
   integer :: poleneigh               ! `pole' processor neighbours
   integer :: nprocx_node=0, nprocy_node=0, nprocz_node=0
+  logical :: lnode_local_mapping=.false.
 !
 !  Data for registering of already updated variable ghost zones for only partly
 !  updating by the *_after_timestep routines.
@@ -269,6 +275,8 @@ module Cdata
   real :: km0EM=0., km1EM=0.
   integer :: farray_smooth_width=6
   integer :: isave=100, ialive=0, isaveglobal=0, nv1_capitalvar=1
+  integer :: isave_base=0
+  real :: delta_threshold=0.
   logical :: lwrite_ts_hdf5=.true., lsave=.false.
   logical :: lread_aux=.false., lwrite_aux=.false., lwrite_dvar=.false.
   logical :: lenforce_maux_check=.true., lwrite_avg1d_binary = .false.
@@ -303,6 +311,7 @@ module Cdata
   logical :: lread_from_other_prec=.false.       ! works so far only with io_dist!
   integer, dimension(3) :: downsampl=1, firstind=1, ndown=0, ngrid_down
   logical :: ldownsampl=.false., ldownsampling=.false., lrepair_snap=.false., linterpol_on_repair=.false.
+  logical :: lsnap_checksum=.false., lsnap_async=.false.
   logical :: lastaroth_output=.false.
   character(LEN=fnlen) :: astaroth_dest=''
   integer, dimension(2) :: ivar_omit=(/0,0/)
@@ -343,6 +352,9 @@ module Cdata
   logical :: lgravx_dust=.true.,lgravy_dust=.true.,lgravz_dust=.true.
   logical :: lgravr=.false.
   logical :: lwrite_ic=.true.,lnowrite=.false.,lserial_io=.false.
+  integer :: io_aggregators=0
+  character (len=labellen) :: snap_compression='none'
+  integer :: snap_compression_level=4, snap_compression_digits=6
   logical :: lmodify=.false.
   logical :: lroot=.true.,lcaproot=.false.,ldebug=.false.,lfft=.true.
   logical :: lproc_pt=.false., lproc_p2=.false.
@@ -482,7 +494,10 @@ module Cdata
   logical, dimension (ny*nz) :: necessary=.false.
   integer :: necessary_imn=0
   integer, dimension (my,mz) :: imn_array
-  character(LEN=labellen) :: shared_mem_name=''
+  character(LEN=labellen) :: mn_order='yz'
+  integer, dimension(2) :: mn_tile=0
+  character(LEN=labellen) :: shared_mem_name='', shared_mem_publish_name=''
+  integer :: it_shared_mem_publish=1
 !
 !  Parameters related to the pencils
 !
@@ -542,6 +557,7 @@ module Cdata
   logical :: lwrite_sound=.false.
   logical :: lwrite_slice_xy2=.false.,lwrite_slice_xy=.false.,lwrite_slice_xz=.false.,lwrite_slice_yz=.false.
   logical :: lwrite_slice_xy3=.false.,lwrite_slice_xy4=.false.,lwrite_slice_xz2=.false., lwrite_slice_r=.false.
+  integer :: nvid_buffer=1
 
   logical :: lout=.false.,headt=.false.,headtt=.true.,lrmv=.false.
   logical :: ldiagnos=.false.,lvideo=.false.,lwrite_prof=.true.,lout_sound=.false.
@@ -880,7 +896,8 @@ module Cdata
 !
 !$omp threadprivate(inds_max_diags, inds_sum_diags)
 !$omp threadprivate(dxyz_2,dxyz_4,dxyz_6,dvol,dxmax_pencil,dxmin_pencil,dline_1,lcoarse_mn, seed, m, n)
-!$omp threadprivate(lfirstpoint,thread_id)
+!$omp threadprivate(lfirstpoint,thread_id,imn)
+!$omp threadprivate(advec_cs2,maxadvec,advec2,advec2_hypermesh,maxdiffus,maxdiffus2,maxdiffus3,maxsrc,dt1_max)
 !$omp threadprivate(fname,fnamex,fnamey,fnamez,fnamer,fnamexy,fnamexz,fnamerz,fname_keep,fname_sound,ncountsz)
 !$omp threadprivate(l1dphiavg, l1davgfirst, l2davgfirst, ldiagnos,lout, l1davg, l2davg, lout_sound, lvideo)
 !$omp threadprivate(t,tspec,tdiagnos,t1ddiagnos,t2davgfirst,tslice,tsound,itdiagnos,dtdiagnos,eps_rkf_diagnos)
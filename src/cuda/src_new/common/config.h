@@ -85,6 +85,9 @@ class RunConfig : public Config {
     //Forcing
     real relhel;        //Helicity of forcing
 
+    //Diagnostics
+    bool reproducible_reductions=false;  //Compensated sums: more accurate, still order-dependent
+
     //Implementation for virtual functions
     virtual void parse(const char* keyword, const char* value); //overrides (c++11-only feature)
     void Setup(real cdt_, real cdtv_, real cs2_=0., real nu_=0., real eta_=0.);
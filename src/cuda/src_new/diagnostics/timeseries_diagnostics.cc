@@ -31,28 +31,35 @@ void timeseries_diagnostics(const Grid & h_grid)
   // Contains automatically generated calls to reduce_cuda_PC according to required diagnostics of the different modules.
   #include "diagnostics/PC_modulediags.h"
 
-  if (idiag_mass){
-    diag=reduce_cuda_PC(ldensity_nolog ? SUM_SCAL : SUM_EXP, h_grid.LNRHO)*box_volume/nw;
-    save_name(diag,idiag_mass);
+/* not yet automatically generated density diagnostics calls:
+   all of them are derived from one fused max/min/sum/sum-of-squares pass over LNRHO */
+  if (idiag_mass || idiag_rhomax>0 || idiag_rhomin>0 || idiag_rhom || idiag_rhorms){
+
+    real rho_red[NUM_FUSED_REDUCTIONS];
+    reduce_fused_cuda_PC(h_grid.LNRHO, !ldensity_nolog, rho_red);
+
+    if (idiag_mass){
+      diag=rho_red[FUSED_SUM]*box_volume/nw;
+      save_name(diag,idiag_mass);
+    }
+    if (idiag_rhomax>0) {
+      diag=rho_red[FUSED_MAX];
+      if (!ldensity_nolog) diag = exp(diag);       //Change away from the logarithmic form
+      save_name(diag,idiag_rhomax);
+    }
+    if (idiag_rhomin>0) {
+      diag=rho_red[FUSED_MIN];
+      if (!ldensity_nolog) diag = exp(diag);       //Change away from the logarithmic form
+      diag=-diag;
+      save_name(diag,idiag_rhomin);
+    }
+    if (idiag_rhom){
+      diag=rho_red[FUSED_SUM];
+      save_name(diag,idiag_rhom);
+    }
+    if (idiag_rhorms){
+      diag=rho_red[FUSED_SQRSUM];
+      save_name(diag,idiag_rhorms);
+    }
   }
-/* not yet automatically generated density diagnostics calls */
-                if (idiag_rhomax>0) {
-                        diag=reduce_cuda_PC(MAX_SCAL, h_grid.LNRHO);
-                        if (!ldensity_nolog) diag = exp(diag);       //Change away from the logarithmic form
-                        save_name(diag,idiag_rhomax);
-                }
-                if (idiag_rhomin>0) {
-                        diag=reduce_cuda_PC(MIN_SCAL, h_grid.LNRHO);
-                        if (!ldensity_nolog) diag = exp(diag);       //Change away from the logarithmic form
-                        diag=-diag;
-                        save_name(diag,idiag_rhomin);
-                }
-                if (idiag_rhom){
-                        diag=reduce_cuda_PC(ldensity_nolog ? SUM_SCAL : SUM_EXP, h_grid.LNRHO);
-                        save_name(diag,idiag_rhom);
-                }
- 		if (idiag_rhorms){
-                        diag=reduce_cuda_PC(ldensity_nolog ? RMS_SCAL : RMS_EXP, h_grid.LNRHO);
-    	        	save_name(diag,idiag_rhorms);
-		}
 }
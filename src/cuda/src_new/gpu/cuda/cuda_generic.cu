@@ -176,7 +176,7 @@ void initialize_cuda_generic(CParamConfig* cparamconf, RunConfig* runconf, const
         ctx->d_grid=h_grid; ctx->d_grid_dst=h_grid;    //MR: ???
         init_grid_cuda_core(&ctx->d_grid, &ctx->d_grid_dst, &ctx->d_cparams);
         init_slice_cuda_generic(&ctx->d_slice, &ctx->d_cparams, &h_run_params);
-        init_reduction_array_cuda_generic(&ctx->d_reduct_arr, &ctx->d_cparams);
+        init_reduction_array_cuda_generic(&ctx->d_reduct_arr, &ctx->d_cparams, h_run_params.reproducible_reductions);
         init_halo_cuda_core(*ctx,device_id==0,device_id==num_devices-1); //Note: Called even without multi-node */
 
         ctx->d_cparams.dsx = h_cparams.dsx;
@@ -460,6 +460,27 @@ real reduce_cuda_PC(ReductType t, GridType grid_type)
 
     return retval;
 }
+
+//Max, min, sum and sum of squares of one scalar in a single pass per device (see get_fused_reductions_cuda_generic)
+void reduce_fused_cuda_PC(GridType grid_type, bool exp_values, real res[NUM_FUSED_REDUCTIONS])
+{
+    for (int device_id=0; device_id < num_devices; ++device_id) {
+        cudaSetDevice(device_id);
+        GPUContext* ctx = &gpu_contexts[device_id];
+
+        real dev_res[NUM_FUSED_REDUCTIONS];
+        get_fused_reductions_cuda_generic(&ctx->d_reduct_arr, &ctx->d_cparams, ctx->d_grid.arr[grid_type], exp_values, dev_res);
+
+        if (device_id == 0) {
+            for (int i=0; i < NUM_FUSED_REDUCTIONS; ++i) res[i] = dev_res[i];
+        } else {
+            res[FUSED_MAX]    = max(res[FUSED_MAX], dev_res[FUSED_MAX]);
+            res[FUSED_MIN]    = min(res[FUSED_MIN], dev_res[FUSED_MIN]);
+            res[FUSED_SUM]    = res[FUSED_SUM]    + dev_res[FUSED_SUM];
+            res[FUSED_SQRSUM] = res[FUSED_SQRSUM] + dev_res[FUSED_SQRSUM];
+        }
+    }
+}
 #else
 real reduce_cuda_generic(ReductType t, GridType grid_type)
 {
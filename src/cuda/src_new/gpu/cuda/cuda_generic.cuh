@@ -57,6 +57,7 @@ void boundcond_step_cuda_generic();
 void exchange_halos_cuda_generic(bool circular);
 #ifdef GPU_ASTAROTH
 real reduce_cuda_PC(ReductType t, GridType a);
+void reduce_fused_cuda_PC(GridType a, bool exp_values, real res[NUM_FUSED_REDUCTIONS]);
 #else
 real reduce_cuda_generic(ReductType t, GridType a);
 #endif
@@ -1,263 +1,330 @@
 /*
 *   Reduction operations
-*   This all seems intimidating, but it's pretty directly adapted from
-*   http://developer.download.nvidia.com/compute/cuda/1.1-Beta/x86_website/projects/reduction/doc/reduction.pdf
+*   A single-pass, grid-stride reduction: every thread accumulates its share of the computational domain,
+*   warps combine their values with shuffles (cooperative groups), the warp results of a block are combined
+*   by the first warp, and the last block to finish reduces the per-block partial results.
+*   All kernels are templated on the value type, so they work for both float and double.
+*   In the reproducible mode the sums are accumulated with compensation (double-word arithmetic). This only
+*   makes them more accurate: compensated summation still depends on the order of the additions, so results
+*   from different GPU counts or launch configurations are not bitwise identical. For a fixed configuration
+*   the order is fixed anyway, as the partial results are combined by index and not with atomics.
 */
+#include <cooperative_groups.h>
+
 #include "collectiveops_cuda_generic.cuh"
 #include "gpu/cuda/core/dconsts_core.cuh"
 #include "gpu/cuda/core/errorhandler_cuda.cuh"
 #include "utils/utils.h"         //For templated max/min/sum
 
-#define COL_THREADS_X (32)       //TODO read from config
-#define COL_THREADS_Y (4)
-#define COL_ELEMS_PER_THREAD (1) //TODO ifndef, define here, else get from the compile flag
+namespace cg = cooperative_groups;
 
+#define COL_THREADS (256)        //TODO read from config
+//Width of the shuffle tiles: a whole wavefront on AMD GPUs (64 on CDNA), so that no lanes idle in reduce_warp
+//(untested: src_new can no longer be selected in Makefile.src, and this file has not been built for HIP)
+#if defined(__HIP_PLATFORM_AMD__) && defined(__AMDGCN_WAVEFRONT_SIZE)
+    #define COL_WARP_SIZE (__AMDGCN_WAVEFRONT_SIZE)
+#elif defined(__HIP_PLATFORM_AMD__)
+    #define COL_WARP_SIZE (64)
+#else
+    #define COL_WARP_SIZE (32)
+#endif
+#define COL_MAX_BLOCKS (1024)   //Upper limit for the grid-stride kernels
 
-//Comparison funcs (template magic :D)
-template<class T>
-__device__ T dmax(const T a, const T b) { return a > b ? a : b; }
 
-template<class T>
-__device__ T dmin(const T a, const T b) { return a < b ? a : b; }
-
-template<class T>
-__device__ T dsum(const T a, const T b) { return a + b; }
+//Comparison funcs
+struct MaxOp { template<class T> __device__ T operator()(const T a, const T b) const { return a > b ? a : b; } };
+struct MinOp { template<class T> __device__ T operator()(const T a, const T b) const { return a < b ? a : b; } };
+struct SumOp { template<class T> __device__ T operator()(const T a, const T b) const { return a + b; } };
 
 
 //The initial values when starting the reduction
-template<class T>
-__device__ T ddist(const T a, const T b, const T c) { return sqrt(a*a + b*b + c*c); }
+struct DistInit       { template<class T> __device__ T operator()(const T a, const T b, const T c) const { return sqrt(a*a + b*b + c*c); } };
+struct SqrSumInit     { template<class T> __device__ T operator()(const T a, const T b, const T c) const { return a*a + b*b + c*c; } };
+struct ExpSqrScalInit { template<class T> __device__ T operator()(const T a, const T b, const T c) const { return exp(a)*exp(a); } };
+struct ExpScalInit    { template<class T> __device__ T operator()(const T a, const T b, const T c) const { return exp(a); } };
+struct SqrScalInit    { template<class T> __device__ T operator()(const T a, const T b, const T c) const { return a*a; } };
+struct ScalInit       { template<class T> __device__ T operator()(const T a, const T b, const T c) const { return a; } };
+
+
+//Number of blocks of the grid-stride kernels: enough to fill the device, but never more than there are
+//threads' worth of points, so that every block has at least one point to reduce
+static int reduction_blocks(const CParamConfig* cparams)
+{
+    const long points = (long) cparams->nx * cparams->ny * cparams->nz;
+    const long blocks = points / COL_THREADS;
+    return (int) max(1L, min(blocks, (long) COL_MAX_BLOCKS));
+}
+
+
+void init_reduction_array_cuda_generic(ReductionArray* reduct_arr, CParamConfig* cparams, bool reproducible)
+{
+    reduct_arr->reproducible = reproducible;
+
+    // The device variables where the final results are written to
+    // (NUM_FUSED_REDUCTIONS of them for get_fused_reductions_cuda_generic)
+    CUDA_ERRCHK( cudaMalloc((real**) &reduct_arr->d_vec_res, sizeof(real)*NUM_FUSED_REDUCTIONS) );
+
+    //An intermediate array holding the per-block results (twice the size for the compensated sums)
+    reduct_arr->num_blocks = reduction_blocks(cparams);
+    CUDA_ERRCHK( cudaMalloc((real**) &reduct_arr->d_partial_result, 2*sizeof(real)*reduct_arr->num_blocks*NUM_FUSED_REDUCTIONS) );
+
+    //Counts the blocks which have finished; reset to zero by the last one
+    CUDA_ERRCHK( cudaMalloc((unsigned int**) &reduct_arr->d_block_counter, sizeof(unsigned int)) );
+    CUDA_ERRCHK( cudaMemset(reduct_arr->d_block_counter, 0, sizeof(unsigned int)) );
+}
+
+
+void destroy_reduction_array_cuda_generic(ReductionArray* reduct_arr)
+{
+    CUDA_ERRCHK( cudaFree(reduct_arr->d_vec_res) ); reduct_arr->d_vec_res = NULL;
+    CUDA_ERRCHK( cudaFree(reduct_arr->d_partial_result) ); reduct_arr->d_partial_result = NULL;
+    CUDA_ERRCHK( cudaFree(reduct_arr->d_block_counter) ); reduct_arr->d_block_counter = NULL;
+}
 
+
+//Compensated (double-word) accumulator for the reproducible mode: hi+lo carries the sum to about twice the
+//working precision, which reduces but does not remove the dependence on the order of the additions
 template<class T>
-__device__ T dsqrsum(const T a, const T b, const T c) { return a*a + b*b + c*c; }
+struct Compensated { T hi, lo; };
 
 template<class T>
-__device__ T dexpsqrscal(const T a, const T b, const T c) { return exp(a)*exp(a); }
+__device__ Compensated<T> two_sum(const T a, const T b)
+{
+    const T s  = a + b;
+    const T bb = s - a;
+    const Compensated<T> res = {s, (a - (s - bb)) + (b - bb)};
+    return res;
+}
 
+//Sum of two compensated values, renormalized so that |lo| stays below half an ulp of hi
+struct CompensatedSumOp {
+    template<class T> __device__ Compensated<T> operator()(const Compensated<T> a, const Compensated<T> b) const
+    {
+        const Compensated<T> s = two_sum(a.hi, b.hi);
+        const T lo = s.lo + a.lo + b.lo;
+        const T hi = s.hi + lo;
+        const Compensated<T> res = {hi, lo - (hi - s.hi)};
+        return res;
+    }
+};
+
+//Conversions between the element type and the accumulator type
+template<class V, class T> __device__ V    to_acc(const T a) { return a; }
+template<class T>          __device__ T    from_acc(const T a) { return a; }
+template<class T>          __device__ T    from_acc(const Compensated<T> a) { return a.hi + a.lo; }
+
+template<>
+__device__ Compensated<float>  to_acc<Compensated<float>,  float>(const float a)  { const Compensated<float>  res = {a, 0.f}; return res; }
+template<>
+__device__ Compensated<double> to_acc<Compensated<double>, double>(const double a) { const Compensated<double> res = {a, 0.};  return res; }
+
+//Warp shuffles and loads of the partial results of other blocks, component-wise for compensated values
 template<class T>
-__device__ T dexpscal(const T a, const T b, const T c) { return exp(a); }
+__device__ T shfl_down(const cg::thread_block_tile<COL_WARP_SIZE>& warp, const T val, const int offset)
+{ return warp.shfl_down(val, offset); }
 
 template<class T>
-__device__ T dsqrscal(const T a, const T b, const T c) { return a*a; }
+__device__ Compensated<T> shfl_down(const cg::thread_block_tile<COL_WARP_SIZE>& warp, const Compensated<T> val, const int offset)
+{
+    const Compensated<T> res = {warp.shfl_down(val.hi, offset), warp.shfl_down(val.lo, offset)};
+    return res;
+}
 
 template<class T>
-__device__ T dscal(const T a, const T b, const T c) { return a; }
+__device__ T load_volatile(const T* p) { return *(const volatile T*) p; }
 
-//Function pointer definitions
-typedef real (*ReduceFunc)(real, real);
-typedef real (*ReduceInitFunc)(real, real, real);
+template<class T>
+__device__ Compensated<T> load_volatile(const Compensated<T>* p)
+{
+    const volatile T* q = (const volatile T*) p;
+    const Compensated<T> res = {q[0], q[1]};
+    return res;
+}
 
 
-template<ReduceFunc reduce_op>
-__device__ void reduce_warp(volatile real* shared, int tid)
+//Reduces the values of the valid lanes of a warp; the result is valid in lane 0 if any lane was valid.
+//No identity element is needed, so that max and min work as well as sums.
+template<class V, class Op>
+__device__ V reduce_warp(const cg::thread_block_tile<COL_WARP_SIZE>& warp, V val, bool& valid, const Op op)
 {
-    shared[tid] = reduce_op(shared[tid], shared[tid+32]);__syncthreads();
-    shared[tid] = reduce_op(shared[tid], shared[tid+16]);__syncthreads();
-    shared[tid] = reduce_op(shared[tid], shared[tid+8]);__syncthreads();
-    shared[tid] = reduce_op(shared[tid], shared[tid+4]);__syncthreads();
-    shared[tid] = reduce_op(shared[tid], shared[tid+2]);__syncthreads();
-    shared[tid] = reduce_op(shared[tid], shared[tid+1]);__syncthreads();
+    for (int offset = COL_WARP_SIZE/2; offset > 0; offset /= 2) {
+        const V   other       = shfl_down(warp, val, offset);
+        const int other_valid = warp.shfl_down((int) valid, offset);
+        if (other_valid && warp.thread_rank() + offset < COL_WARP_SIZE) {
+            val   = valid ? op(val, other) : other;
+            valid = true;
+        }
+    }
+    return val;
 }
 
 
-void init_reduction_array_cuda_generic(ReductionArray* reduct_arr, CParamConfig* cparams)
+//Reduces the values of the valid threads of a block; the result is valid in thread 0
+template<class V, class Op>
+__device__ V reduce_block(V val, bool valid, const Op op)
 {
-    // The device variable where the maximum found value found is written to
-    CUDA_ERRCHK( cudaMalloc((real**) &reduct_arr->d_vec_res, sizeof(real)) );
- 
-    //An intermediate array used in computing the reduction
-	dim3 bpg;
-	bpg.x = ceil(cparams->nx / (double)COL_THREADS_X);
-	bpg.y = ceil(cparams->ny / (double)COL_THREADS_Y);
-	bpg.z = ceil(cparams->nz / (double)COL_ELEMS_PER_THREAD);
-	const int blocks_total = bpg.x * bpg.y * bpg.z;
-	CUDA_ERRCHK( cudaMalloc((real**) &reduct_arr->d_partial_result, sizeof(real)*blocks_total) );
+    __shared__ V   s_warp_res[COL_THREADS/COL_WARP_SIZE];
+    __shared__ int s_warp_valid[COL_THREADS/COL_WARP_SIZE];
+
+    cg::thread_block block = cg::this_thread_block();
+    cg::thread_block_tile<COL_WARP_SIZE> warp = cg::tiled_partition<COL_WARP_SIZE>(block);
+
+    block.sync(); //The shared arrays may still be read by a preceding reduce_block
+
+    val = reduce_warp(warp, val, valid, op);
+    const int warp_id = block.thread_rank() / COL_WARP_SIZE;
+    if (warp.thread_rank() == 0) {
+        s_warp_res[warp_id]   = val;
+        s_warp_valid[warp_id] = valid;
+    }
+    block.sync();
+
+    if (warp_id == 0) {
+        const int num_warps = block.size() / COL_WARP_SIZE;
+        const int lane = warp.thread_rank();
+        valid = lane < num_warps && s_warp_valid[lane];
+        val   = valid ? s_warp_res[lane] : val;
+        val   = reduce_warp(warp, val, valid, op);
+    }
+    return val;
 }
 
 
-void destroy_reduction_array_cuda_generic(ReductionArray* reduct_arr)
+//True in every thread of the block which finished last; the counter is reset for the next reduction
+__device__ bool is_last_block(unsigned int* d_block_counter)
 {
-    CUDA_ERRCHK( cudaFree(reduct_arr->d_vec_res) ); reduct_arr->d_vec_res = NULL;
-    CUDA_ERRCHK( cudaFree(reduct_arr->d_partial_result) ); reduct_arr->d_partial_result = NULL;
+    __shared__ bool s_is_last;
+
+    __threadfence(); //Make this block's partial results visible to the other blocks
+    if (threadIdx.x == 0)
+        s_is_last = (atomicInc(d_block_counter, gridDim.x-1) == gridDim.x-1);
+    __syncthreads();
+
+    return s_is_last;
 }
 
 
-template <unsigned int block_size, ReduceFunc reduce_op>
-__global__ void reduce(real* dest, real* src, int problem_size)
+//Reduces the per-block results of one quantity within the last block and writes it to dest
+template<class T, class V, class Op>
+__device__ void reduce_partial_results(T* dest, const V* d_partial_result, const Op op)
 {
-	int tid = threadIdx.x;
-	int i = tid + blockDim.x;//tid + offset
-	extern __shared__ real shared[];
-	shared[tid] = src[tid];
-	
-	//Add sequentially all blocks above block size
-	while (i < problem_size) {
-		shared[tid] = reduce_op(shared[tid], src[i]);
-		i += blockDim.x;
-	}
-	__syncthreads();
-
-	if (block_size >= 1024) {
-		if (tid < 512) { 			
-			shared[tid] = reduce_op(shared[tid], shared[tid+512]); 
-			__syncthreads(); 
-		}
-	}
-	if (block_size >= 512) {
-		if (tid < 256) { 			
-			shared[tid] = reduce_op(shared[tid], shared[tid+256]); 
-			__syncthreads(); 
-		}
-	}
-	if (block_size >= 256) {
-		if (tid < 128) { 			
-			shared[tid] = reduce_op(shared[tid], shared[tid+128]); 
-			__syncthreads(); 
-		}
-	}
-	if (block_size >= 128) {
-		if (tid < 64) { 			
-			shared[tid] = reduce_op(shared[tid], shared[tid+64]); 
-			__syncthreads(); 
-		}
-	}
-	if (tid < 32)
-		reduce_warp<reduce_op>(shared, tid);
-
-	if (tid == 0) *dest = shared[0];
+    V val = V();
+    bool valid = false;
+    for (int i = threadIdx.x; i < gridDim.x; i += blockDim.x) {
+        const V part = load_volatile(&d_partial_result[i]);
+        val   = valid ? op(val, part) : part;
+        valid = true;
+    }
+    val = reduce_block(val, valid, op);
+    if (threadIdx.x == 0) *dest = from_acc(val);
 }
 
 
-//Calculates the maximum vector magnitude found in the system
-template <unsigned int block_size, ReduceFunc reduce_op, ReduceInitFunc reduce_init_op>//inline const T& min(const T& a, const T& b)
-__global__ void reduce_initial(real* d_partial_result, real* d_vec_x, real* d_vec_y = NULL, real* d_vec_z = NULL)
+//Linear index of the p:th point of the computational domain in the full grid
+__device__ int interior_index(const int p)
 {
-	extern __shared__ real vec_shared[];
+    const int x = p % d_nx                + d_nx_min;
+    const int y = (p / d_nx) % d_ny       + d_ny_min;
+    const int z = p / (d_nx*d_ny)         + d_nz_min;
+    return x + y*d_mx + z*d_mxy;
+}
 
-	const int tid = threadIdx.x + threadIdx.y*blockDim.x;//index inside the shared mem array
 
-    const int tx = threadIdx.x + blockIdx.x*blockDim.x + d_nx_min;
-    const int ty = threadIdx.y + blockIdx.y*blockDim.y + d_ny_min;
-    const int tz = blockIdx.z*COL_ELEMS_PER_THREAD     + d_nz_min;
+//Reduction of a scalar (d_vec_y == NULL) or a vector, mapped pointwise to a scalar with reduce_init_op;
+//the values are accumulated in type V (T, or Compensated<T> for reproducible sums)
+template <class T, class V, class ReduceOp, class ReduceInitOp>
+__global__ void reduce_single_pass(T* dest, V* d_partial_result, unsigned int* d_block_counter,
+                                   const T* d_vec_x, const T* d_vec_y, const T* d_vec_z)
+{
+    const ReduceOp reduce_op = ReduceOp();
+    const ReduceInitOp reduce_init_op = ReduceInitOp();
+    const bool REDUCE_VEC = (d_vec_y != NULL);
+    const int num_points = d_nx*d_ny*d_nz;
+
+    V val = V();
+    bool valid = false;
+    for (int p = threadIdx.x + blockIdx.x*blockDim.x; p < num_points; p += blockDim.x*gridDim.x) {
+        const int idx = interior_index(p);
+        const V vec = to_acc<V>(REDUCE_VEC ? reduce_init_op(d_vec_x[idx], d_vec_y[idx], d_vec_z[idx])
+                                           : reduce_init_op(d_vec_x[idx], T(0), T(0)));
+        val   = valid ? reduce_op(val, vec) : vec;
+        valid = true;
+    }
 
-	const int base_idx = tx + ty*d_mx + tz*d_mxy;
+    val = reduce_block(val, valid, reduce_op);
+    if (threadIdx.x == 0) d_partial_result[blockIdx.x] = val;
 
-    assert(tx >= d_nx_min);
-	assert(tx < d_nx_max);
-    assert(ty >= d_ny_min);
-    assert(ty < d_ny_max);
-    assert(tz >= d_nz_min);
-    assert(tz < d_nz_max);
-	
-	real vec;
+    if (is_last_block(d_block_counter))
+        reduce_partial_results(dest, d_partial_result, reduce_op);
+}
 
-    const bool REDUCE_VEC = (d_vec_y != NULL);
-    if (REDUCE_VEC)
-	    vec_shared[tid] = reduce_init_op(d_vec_x[base_idx], 
-                                         d_vec_y[base_idx], 
-                                         d_vec_z[base_idx]); //init first value
-    else
-        vec_shared[tid] = reduce_init_op(d_vec_x[base_idx], 0, 0);
-
-	for (int i=1; i < COL_ELEMS_PER_THREAD && tz+i < d_nz_max; i++)
-	{	
-		const int grid_idx = base_idx + i*d_mxy;
-        assert(tz+i < d_nz_max);
-        
-        if (REDUCE_VEC)
-	        vec = reduce_init_op(d_vec_x[grid_idx], 
-                                 d_vec_y[grid_idx], 
-                                 d_vec_z[grid_idx]); //init first value
-        else
-            vec = reduce_init_op(d_vec_x[grid_idx], 0, 0);
-	
-		vec_shared[tid] = reduce_op(vec_shared[tid], vec);
-	}
-	__syncthreads();
-
-	if (block_size >= 1024) {
-		if (tid < 512) { 			
-			vec_shared[tid] = reduce_op(vec_shared[tid], vec_shared[tid+512]); 
-			__syncthreads(); 
-		}
-	}
-
-	if (block_size >= 512) {
-		if (tid < 256) { 			
-			vec_shared[tid] = reduce_op(vec_shared[tid], vec_shared[tid+256]); 
-			__syncthreads(); 
-		}
-	}
-	
-	if (block_size >= 256) {
-		if (tid < 128) { 			
-			vec_shared[tid] = reduce_op(vec_shared[tid], vec_shared[tid+128]); 
-			__syncthreads(); 
-		}
-	}
-    if (block_size >= 128) {
-	    if (tid < 64) { 			
-		    vec_shared[tid] = reduce_op(vec_shared[tid], vec_shared[tid+64]); 
-		    __syncthreads(); 
-	    }
+
+//Max, min, sum and sum of squares of a scalar in one pass; V is the accumulator type of the sums.
+//d_partial_result holds the per-block maxima and minima followed by the per-block sums and sums of squares.
+template <class T, class V, class SumOp_>
+__global__ void reduce_fused_single_pass(T* dest, T* d_partial_result, unsigned int* d_block_counter,
+                                         const T* d_a, const bool exp_values)
+{
+    const SumOp_ sum_op = SumOp_();
+    const int num_points = d_nx*d_ny*d_nz;
+
+    T a_max = 0, a_min = 0;
+    V sum = V(), sqrsum = V();
+    bool valid = false;
+    for (int p = threadIdx.x + blockIdx.x*blockDim.x; p < num_points; p += blockDim.x*gridDim.x) {
+        const T a   = d_a[interior_index(p)];
+        const T val = exp_values ? exp(a) : a;
+        a_max  = valid ? MaxOp()(a_max, a) : a;
+        a_min  = valid ? MinOp()(a_min, a) : a;
+        sum    = sum_op(sum,    to_acc<V>(val));
+        sqrsum = sum_op(sqrsum, to_acc<V>(val*val));
+        valid = true;
     }
 
-	if (tid < 32)
-		reduce_warp<reduce_op>(vec_shared, tid);
+    T* partial_max    = &d_partial_result[0];
+    T* partial_min    = &d_partial_result[gridDim.x];
+    V* partial_sum    = (V*) &d_partial_result[2*gridDim.x];
+    V* partial_sqrsum = &partial_sum[gridDim.x];
+
+    a_max  = reduce_block(a_max,  valid, MaxOp());
+    a_min  = reduce_block(a_min,  valid, MinOp());
+    sum    = reduce_block(sum,    valid, sum_op);
+    sqrsum = reduce_block(sqrsum, valid, sum_op);
+    if (threadIdx.x == 0) {
+        partial_max[blockIdx.x]    = a_max;
+        partial_min[blockIdx.x]    = a_min;
+        partial_sum[blockIdx.x]    = sum;
+        partial_sqrsum[blockIdx.x] = sqrsum;
+    }
 
-	if (tid == 0) d_partial_result[blockIdx.x + blockIdx.y*gridDim.x + blockIdx.z*gridDim.x*gridDim.y] = vec_shared[0];
+    if (is_last_block(d_block_counter)) {
+        reduce_partial_results(&dest[FUSED_MAX],    partial_max,    MaxOp());
+        reduce_partial_results(&dest[FUSED_MIN],    partial_min,    MinOp());
+        reduce_partial_results(&dest[FUSED_SUM],    partial_sum,    sum_op);
+        reduce_partial_results(&dest[FUSED_SQRSUM], partial_sqrsum, sum_op);
+    }
 }
 
 
-/*
-* Calculates the max vec found in the grid
-* Puts the result in reduct_arr->d_vec_res (in device memory)
-*/
-template<ReduceFunc reduce_op, ReduceInitFunc reduce_init_op>
-void reduce_cuda_generic(ReductionArray* reduct_arr, CParamConfig* cparams, real* d_vec_x, real* d_vec_y = NULL, real* d_vec_z = NULL)
+template<class T, class ReduceOp, class ReduceInitOp>
+void reduce_cuda_generic(ReductionArray* reduct_arr, T* d_vec_x, T* d_vec_y = NULL, T* d_vec_z = NULL)
+{
+    reduce_single_pass<T, T, ReduceOp, ReduceInitOp><<<reduct_arr->num_blocks, COL_THREADS>>>
+        ((T*) reduct_arr->d_vec_res, (T*) reduct_arr->d_partial_result, reduct_arr->d_block_counter, d_vec_x, d_vec_y, d_vec_z);
+    CUDA_ERRCHK_KERNEL();
+}
+
+//Sums are accumulated with compensation in the reproducible mode
+template<class T, class ReduceInitOp>
+void reduce_sum_cuda_generic(ReductionArray* reduct_arr, T* d_vec_x, T* d_vec_y = NULL, T* d_vec_z = NULL)
 {
-    const dim3 tpb(COL_THREADS_X, COL_THREADS_Y, 1);
-    const dim3 bpg((unsigned int) ceil((real) cparams->nx / (real)COL_THREADS_X),
-                   (unsigned int) ceil((real) cparams->ny / (real)COL_THREADS_Y),
-                   (unsigned int) ceil((real) cparams->nz / (real)COL_ELEMS_PER_THREAD));
-
-    const size_t SMEM_PER_BLOCK = tpb.x * tpb.y *tpb.z * sizeof(real);
-    const int BLOCKS_TOTAL = bpg.x * bpg.y * bpg.z;
-
-
-    //Collectiveops works only when BLOCKS_TOTAL is divisible by the thread block size.
-    //This is not good and collectiveops should be rewritten to support arbitrary grid dims
-    if (BLOCKS_TOTAL % (tpb.x * tpb.y * tpb.z) != 0)
-        CRASH("Incorrect BLOCKS_TOTAL in reduce_cuda_generic()")
-	
-	switch (tpb.x*tpb.y*tpb.z)
-	{
-		case 512:
-			reduce_initial<512, reduce_op, reduce_init_op><<<bpg, tpb, SMEM_PER_BLOCK>>>(reduct_arr->d_partial_result, d_vec_x, d_vec_y, d_vec_z); CUDA_ERRCHK_KERNEL(); break;
-		case 256:
-			reduce_initial<256, reduce_op, reduce_init_op><<<bpg, tpb, SMEM_PER_BLOCK>>>(reduct_arr->d_partial_result, d_vec_x, d_vec_y, d_vec_z); CUDA_ERRCHK_KERNEL(); break;
-		case 128:
-			reduce_initial<128, reduce_op, reduce_init_op><<<bpg, tpb, SMEM_PER_BLOCK>>>(reduct_arr->d_partial_result, d_vec_x, d_vec_y, d_vec_z); CUDA_ERRCHK_KERNEL(); break;
-		default:
-			printf("INCORRECT THREAD SIZE!\n");
-			exit(EXIT_FAILURE);
-	}
-    if (BLOCKS_TOTAL >= 1024) {
-        reduce<1024, reduce_op><<<1, 1024, 1024*sizeof(real)>>>(reduct_arr->d_vec_res, reduct_arr->d_partial_result, BLOCKS_TOTAL); CUDA_ERRCHK_KERNEL();
-    } else if (BLOCKS_TOTAL >= 512) {
-        reduce<512, reduce_op><<<1, 512, 512*sizeof(real)>>>(reduct_arr->d_vec_res, reduct_arr->d_partial_result, BLOCKS_TOTAL); CUDA_ERRCHK_KERNEL();
-    } else if (BLOCKS_TOTAL >= 256) {
-        reduce<256, reduce_op><<<1, 256, 256*sizeof(real)>>>(reduct_arr->d_vec_res, reduct_arr->d_partial_result, BLOCKS_TOTAL); CUDA_ERRCHK_KERNEL();
-    } else if (BLOCKS_TOTAL >= 128) {
-        reduce<128, reduce_op><<<1, 128, 128*sizeof(real)>>>(reduct_arr->d_vec_res, reduct_arr->d_partial_result, BLOCKS_TOTAL); CUDA_ERRCHK_KERNEL();
-    } else if (BLOCKS_TOTAL >= 16) {
-        reduce<16, reduce_op><<<1, 16, 16*sizeof(real)>>>(reduct_arr->d_vec_res, reduct_arr->d_partial_result, BLOCKS_TOTAL); CUDA_ERRCHK_KERNEL();
+    if (reduct_arr->reproducible) {
+        reduce_single_pass<T, Compensated<T>, CompensatedSumOp, ReduceInitOp><<<reduct_arr->num_blocks, COL_THREADS>>>
+            ((T*) reduct_arr->d_vec_res, (Compensated<T>*) reduct_arr->d_partial_result, reduct_arr->d_block_counter, d_vec_x, d_vec_y, d_vec_z);
+        CUDA_ERRCHK_KERNEL();
     } else {
-        printf("INCORRECT BLOCKS_TOTAL (= %d) IN collectiveops.cu!\n", BLOCKS_TOTAL);
-				exit(EXIT_FAILURE);
+        reduce_cuda_generic<T, SumOp, ReduceInitOp>(reduct_arr, d_vec_x, d_vec_y, d_vec_z);
     }
-
-	return;
 }
 
 //template<ReductType t>
@@ -266,31 +333,31 @@ real get_reduction_cuda_generic(ReductionArray* reduct_arr, ReductType t, CParam
     real res;
     switch (t) {
         case MAX_VEC:
-            reduce_cuda_generic<dmax, ddist>(reduct_arr, cparams, d_a, d_b, d_c);
+            reduce_cuda_generic<real, MaxOp, DistInit>(reduct_arr, d_a, d_b, d_c);
             break;
         case MIN_VEC:
-            reduce_cuda_generic<dmin, ddist>(reduct_arr, cparams, d_a, d_b, d_c);
+            reduce_cuda_generic<real, MinOp, DistInit>(reduct_arr, d_a, d_b, d_c);
             break;
         case RMS_VEC:
-            reduce_cuda_generic<dsum, dsqrsum>(reduct_arr, cparams, d_a, d_b, d_c);
+            reduce_sum_cuda_generic<real, SqrSumInit>(reduct_arr, d_a, d_b, d_c);
             break;
         case MAX_SCAL:
-            reduce_cuda_generic<dmax, dscal>(reduct_arr, cparams, d_a);
+            reduce_cuda_generic<real, MaxOp, ScalInit>(reduct_arr, d_a);
             break;
         case MIN_SCAL:
-            reduce_cuda_generic<dmin, dscal>(reduct_arr, cparams, d_a);
+            reduce_cuda_generic<real, MinOp, ScalInit>(reduct_arr, d_a);
             break;
         case RMS_SCAL:
-            reduce_cuda_generic<dsum, dsqrscal>(reduct_arr, cparams, d_a);
+            reduce_sum_cuda_generic<real, SqrScalInit>(reduct_arr, d_a);
             break;
         case RMS_EXP:
-            reduce_cuda_generic<dsum, dexpsqrscal>(reduct_arr, cparams, d_a);
+            reduce_sum_cuda_generic<real, ExpSqrScalInit>(reduct_arr, d_a);
             break;
         case SUM_SCAL:
-            reduce_cuda_generic<dsum, dscal>(reduct_arr, cparams, d_a);
+            reduce_sum_cuda_generic<real, ScalInit>(reduct_arr, d_a);
             break;
         case SUM_EXP:
-            reduce_cuda_generic<dsum, dexpscal>(reduct_arr, cparams, d_a);
+            reduce_sum_cuda_generic<real, ExpScalInit>(reduct_arr, d_a);
             break;
         default:
             CRASH("Invalid type!");
@@ -299,3 +366,21 @@ real get_reduction_cuda_generic(ReductionArray* reduct_arr, ReductType t, CParam
 
     return res;
 }
+
+
+/*
+* Computes max, min, sum and sum of squares of a scalar field (of exp of it, if exp_values, apart from max and min)
+* with a single pass over the grid instead of one per quantity
+*/
+void get_fused_reductions_cuda_generic(ReductionArray* reduct_arr, CParamConfig* cparams, real* d_a, bool exp_values,
+                                       real res[NUM_FUSED_REDUCTIONS])
+{
+    if (reduct_arr->reproducible)
+        reduce_fused_single_pass<real, Compensated<real>, CompensatedSumOp><<<reduct_arr->num_blocks, COL_THREADS>>>
+            (reduct_arr->d_vec_res, reduct_arr->d_partial_result, reduct_arr->d_block_counter, d_a, exp_values);
+    else
+        reduce_fused_single_pass<real, real, SumOp><<<reduct_arr->num_blocks, COL_THREADS>>>
+            (reduct_arr->d_vec_res, reduct_arr->d_partial_result, reduct_arr->d_block_counter, d_a, exp_values);
+    CUDA_ERRCHK_KERNEL();
+    CUDA_ERRCHK( cudaMemcpy(res, reduct_arr->d_vec_res, sizeof(real)*NUM_FUSED_REDUCTIONS, cudaMemcpyDeviceToHost) );
+}
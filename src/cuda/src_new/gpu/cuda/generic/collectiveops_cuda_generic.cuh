@@ -4,10 +4,19 @@
 struct ReductionArray{
     real* d_vec_res;
     real* d_partial_result;
+    unsigned int* d_block_counter;
+    int num_blocks;
+    bool reproducible;  //Whether sums are accumulated with compensation
 };
 
-void init_reduction_array_cuda_generic(ReductionArray* reduct_arr, CParamConfig* cparams);
+//Results of the fused scalar reduction, all obtained in a single sweep over the grid
+typedef enum {FUSED_MAX=0, FUSED_MIN, FUSED_SUM, FUSED_SQRSUM, NUM_FUSED_REDUCTIONS} FusedReduction;
+
+void init_reduction_array_cuda_generic(ReductionArray* reduct_arr, CParamConfig* cparams, bool reproducible = false);
 void destroy_reduction_array_cuda_generic(ReductionArray* reduct_arr);
 
 real get_reduction_cuda_generic(ReductionArray* reduct_arr, ReductType t, CParamConfig* cparams, 
                                 real* d_a, real* d_b = NULL, real* d_c = NULL);
+
+void get_fused_reductions_cuda_generic(ReductionArray* reduct_arr, CParamConfig* cparams, real* d_a, bool exp_values,
+                                       real res[NUM_FUSED_REDUCTIONS]);
@@ -127,6 +127,7 @@ extern "C" void initializeGPU()
 printf("DOUBLE PRECISION!\n");
 #endif
     	cparams.Setup(dx, dy, dz);
+        run_params.reproducible_reductions = lreproducible_reductions;
 
         GPUInitialize(&cparams, &run_params, h_grid);         // loads device constants
 
@@ -244,25 +244,29 @@ int output_penciled_c (char *filename, REAL *pencil, FINT *ndim,
   New version (the old one used linked lists and relied on having the same
   access pattern all the time) mapping file name onto file id. This
   mapping is done via the list `file_list', which contains the entries
-  .name and .file) for each file.
+  .name, .file and .data for each file.
+
+  The pencils are collected in .data, a zero-initialised image of the whole
+  data record (ghost zones included), which the last pencil writes to the
+  file in one go, instead of seeking and writing for every pencil.
 */
 {
-  REAL zero=0.;
   char *fname;
   int npencil,ilast,bcount;
-  int j,len,fidx,k,l,m;
+  int j,len,fidx,m;
   long int mx,my,mz;
-  long int datasize,pos;
+  size_t datasize,pos;
   int first_pencil,last_pencil;
-/*    static int first_var=1,max_depth,toggle;	/ * Processing first variable * / */
 
   struct fentry{
     char name[FN_LENGTH+1];
     FILE *file;
+    REAL *data;
   };
   static struct fentry file_list[MAX_PENCIL_FILES];
   static int n_files=0;		/* Number of open files */
   FILE *cfile;			/* current file */
+  REAL *cdata;			/* its data record */
 
   mx = *nx + 2*(*nghost);
   my = *ny + 2*(*nghost);
@@ -273,6 +277,7 @@ int output_penciled_c (char *filename, REAL *pencil, FINT *ndim,
 
   first_pencil = (*i == 1);
   last_pencil = (*i == ilast);
+  datasize = mx*my*mz*(*ndim)*sizeof(REAL);
 
   /* Extract filename as C string */
   /* relevant filename length */
@@ -291,7 +296,7 @@ int output_penciled_c (char *filename, REAL *pencil, FINT *ndim,
 
   /* Called for the first time:
      - open file
-     - calculate and write byte count
+     - allocate the data record
   */
   if (first_pencil) {
     /* Consistency check */
@@ -299,94 +304,60 @@ int output_penciled_c (char *filename, REAL *pencil, FINT *ndim,
       fprintf(stderr,
 	      "debug_c.c inconsistency: File <%s> already in list\n", fname);
     }
+    if (n_files >= MAX_PENCIL_FILES) {
+      fprintf(stderr, "debug_c.c: Too many open files, can't open %s\n", fname);
+      abort();
+    }
     /* Open file and add to list */
     cfile=fopen(fname, "w");
     if (cfile == NULL) {
       fprintf(stderr, "debug_c.c: Can't open file %s\n", fname);
       abort();
     }
+    cdata=(REAL *)calloc(datasize/sizeof(REAL), sizeof(REAL));
+    if (cdata == NULL) {
+      fprintf(stderr, "debug_c.c: Can't allocate %zu bytes for %s\n", datasize, fname);
+      abort();
+    }
     fidx = n_files++;
     file_list[fidx].file = cfile;
+    file_list[fidx].data = cdata;
     strncpy(file_list[fidx].name, fname, len);
     file_list[fidx].name[len] = 0;
-
-    /* Write byte count */
-    datasize = mx*my*mz*(*ndim)*sizeof(REAL);
-    bcount = datasize;
-    fwrite(&bcount, sizeof(bcount), 1, cfile);
   }
 
   /* Any call:
-     - position appropriately
-     - write nghosts zeros, one pencil, nghost zeros
+     - copy the pencil into the data record, skipping the ghost zones
   */
   free(fname);		/* Not needed any more */
   cfile = file_list[fidx].file;	/* improves readability */
+  cdata = file_list[fidx].data;
   for (m=0;m<*ndim;m++) {
-    pos = sizeof(FINT) + mx*(*iy-1 + my*(*iz-1 + mz*m))*sizeof(REAL);
-    fseek(cfile, pos, SEEK_SET);
-    for (j=0;j<*nghost;j++) {
-      fwrite(&zero, sizeof(REAL), 1, cfile);
-    }
-    fwrite(pencil+m*(*nx), sizeof(REAL), *nx, cfile);
-    for (j=0;j<*nghost;j++) {
-      fwrite(&zero, sizeof(REAL), 1, cfile);
-    }
+    pos = *nghost + mx*(*iy-1 + my*(*iz-1 + mz*m));
+    memcpy(cdata+pos, pencil+m*(*nx), (*nx)*sizeof(REAL));
   }
 
   /* Last call:
-     - fill remaining ghost zones with zeros
-     - position after data block
-     - write byte count
+     - write the data record between its byte counts
      - write time as short record
      - close file
   */
   if (last_pencil) {
-    /* Zero out remaining ghost zones */
-    for (m=0;m<*ndim;m++) { 
-      for (k=0;k<*nghost;k++) {
-	for (l=0;l<mz;l++) {
-	  pos = sizeof(FINT) + mx*(k + my*(l + mz*m))*sizeof(REAL);
-	  fseek(cfile, pos, SEEK_SET);
-	  for (j=0;j<mx;j++) {
-	    fwrite(&zero, sizeof(REAL), 1, cfile);
-	  }
-	  pos = sizeof(FINT) + mx*((my-k-1) + my*(l + mz*m))*sizeof(REAL);
-	  fseek(cfile, pos, SEEK_SET);
-	  for (j=0;j<mx;j++) {
-	    fwrite(&zero, sizeof(REAL), 1, cfile);
-	  }
-	}
-      }
-      for (k=(*nghost);k<my-(*nghost);k++) {
-	for (l=0;l<*nghost;l++) {
-	  pos = sizeof(FINT) + mx*(k + my*(l + mz*m))*sizeof(REAL);
-	  fseek(cfile, pos, SEEK_SET);
-	  for (j=0;j<mx;j++) {
-	    fwrite(&zero, sizeof(REAL), 1, cfile);
-	  }
-	  pos = sizeof(FINT) + mx*(k + my*(mz-l-1 + mz*m))*sizeof(REAL);
-	  fseek(cfile, pos, SEEK_SET);
-	  for (j=0;j<mx;j++) {
-	    fwrite(&zero, sizeof(REAL), 1, cfile);
-	  }
-	}
-      }
-    }
-    /* Write byte count */
-    datasize = mx*my*mz*(*ndim)*sizeof(REAL);
-    pos = (long int)(datasize+sizeof(FINT));
-    fseek(cfile, pos, SEEK_SET);
     bcount = datasize;
     fwrite(&bcount, sizeof(bcount), 1, cfile);
+    if (fwrite(cdata, 1, datasize, cfile) != datasize) {
+      fprintf(stderr, "debug_c.c: Can't write file %s\n", file_list[fidx].name);
+    }
+    fwrite(&bcount, sizeof(bcount), 1, cfile);
     /* Write time record */
     bcount = sizeof(REAL);
     fwrite(&bcount, sizeof(bcount), 1, cfile);
     fwrite(t, sizeof(REAL), 1, cfile);
     fwrite(&bcount, sizeof(bcount), 1, cfile);
     fclose(cfile);
+    free(cdata);
     /* Remove this file from file_list */
-    for (j=fidx; j<n_files; j++) {
+    for (j=fidx; j<n_files-1; j++) {
       file_list[j] = file_list[j+1];
       }
     n_files--;
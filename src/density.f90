@@ -294,6 +294,7 @@ module Density
   logical :: lupdate_mass_source
   real, dimension(nx) :: diffus_diffrho
   real, dimension(nx) :: diffus_diffrho3
+  !$omp threadprivate(diffus_diffrho,diffus_diffrho3)
   real :: density_floor_log, density_ceiling_log, wdamp_rho
 !
   integer :: enum_ieos_profile = 0
@@ -766,8 +766,9 @@ module Diagnostics
       logical,optional,        intent(in)   :: lcomplex
 !
       real, dimension (nlname) :: fmax_tmp, fsum_tmp, fmax, fsum, fweight_tmp
+      real, dimension (2*nlname) :: fsum_comm, fsum_res
       real :: vol
-      integer :: iname, imax_count, isum_count, nmax_count, nsum_count, itype, maxreq
+      integer :: iname, imax_count, isum_count, nmax_count, nsum_count, nsum_comm, itype
       logical :: lweight_comm, lalways
       integer, parameter :: lun=1
       character (len=fnlen) :: datadir='data',path=''
@@ -820,12 +821,18 @@ module Diagnostics
         close(lun)
       endif
 !
-!  Communicate over all processors.
+!  Communicate over all processors; sums, weights and maxima go together
+!  in one reduction.
 !
-      call mpireduce_max(fmax_tmp,fmax,nmax_count)
-      call mpireduce_sum(fsum_tmp,fsum,nsum_count)  !,nonblock=maxreq)        ! wrong for Yin-Yang due to overlap
-      if (lweight_comm) call mpireduce_sum(fweight_tmp,fweight,nsum_count)!   ~
-      !call mpiwait(maxreq)
+      nsum_comm=nsum_count
+      fsum_comm(:nsum_count)=fsum_tmp(:nsum_count)
+      if (lweight_comm) then
+        fsum_comm(nsum_count+1:2*nsum_count)=fweight_tmp(:nsum_count)
+        nsum_comm=2*nsum_count
+      endif
+      call mpireduce_sum_max(fsum_comm,fsum_res,nsum_comm,fmax_tmp,fmax,nmax_count)     ! sum wrong for Yin-Yang due to overlap
+      fsum(:nsum_count)=fsum_res(:nsum_count)
+      if (lweight_comm) fweight(:nsum_count)=fsum_res(nsum_count+1:nsum_comm)
 !
 !  The result is present only on the root processor.
 !
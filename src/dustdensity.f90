@@ -51,6 +51,7 @@ module Dustdensity
   real, dimension(nx,ndustspec,ndustspec0) :: dndr_full, ppsf_full
 !  real, dimension(ndustspec0)  :: Ntot_i
   real, dimension(nx,ndustspec,ndustspec) :: dkern
+  integer, dimension(ndustspec,ndustspec) :: kcoag=ndustspec+1
   !$omp threadprivate(dkern)
   real, dimension(ndustspec,ndustspec0) :: init_distr_ki
   real, dimension(ndustspec0) :: BB=0.
@@ -583,6 +584,21 @@ module Dustdensity
         call fatal_error('initialize_dustdensity', &
                          'coagulation with lradius_binning=T is not working well') 
 !
+!  With fixed bin masses, the bin k receiving the mass md(i)+md(j) is the same at all
+!  points and all times, so it is looked up once here (ndustspec+1: none).
+!
+      if (ldustcoagulation.and..not.lmdvar) then
+        kcoag=ndustspec+1
+        do i=1,ndustspec; do j=i,ndustspec
+          do k=j,ndustspec
+            if (md(i) + md(j) >= mdminus(k) .and. md(i) + md(j) < mdplus(k)) then
+              kcoag(i,j)=k
+              exit
+            endif
+          enddo
+        enddo; enddo
+      endif
+!
 !24-Oct-16: Xiangyu added reading of mean kernel for Smoluchowski equation
 !
       if (ldustcoagulation.and.lkernel_mean) then
@@ -2938,7 +2954,7 @@ module Dustdensity
 !
       real :: dndfac, dndfaci, dndfacj, tmp
       real :: momcons_term_x,momcons_term_y,momcons_term_z
-      integer :: i,j,k,l,lgh
+      integer :: i,j,k,l,lgh,kmin,kmax
       logical :: lmdvar_noevolve=.false.
 !
 !  Carry out integration over all bins.
@@ -2986,7 +3002,12 @@ module Dustdensity
             !do k=j,ndustspec+1
 !AB: the above line is from revision r3271 (2004-04-12).
 !AB: but the index k=ndustspec+1 runs out of bounds, so I changed it.
-            do k=j,ndustspec
+            if (lmdvar) then
+              kmin=j; kmax=ndustspec
+            else
+              kmin=kcoag(i,j); kmax=min(kcoag(i,j),ndustspec)
+            endif
+            do k=kmin,kmax
               if (p%md(l,i) + p%md(l,j) >= mdminus(k) .and. p%md(l,i) + p%md(l,j) < mdplus(k)) then
                 if (lmdvar) then
                   df(lgh,m,n,ind(k)) = df(lgh,m,n,ind(k)) - dndfac
@@ -58,7 +58,7 @@ module Equ
 ! To check ghost cell consistency, please uncomment the following line:
 !     use Ghost_check, only: check_ghosts_consistency
       use GhostFold, only: fold_df, fold_df_3points
-      use Gpu, only: before_boundary_gpu, rhs_gpu, copy_farray_from_GPU, get_farray_ptr_gpu
+      use Gpu, only: before_boundary_gpu, rhs_gpu, copy_farray_from_GPU, copy_slices_from_GPU, get_farray_ptr_gpu
       use Gravity
       use Hydro
       use Magnetic
@@ -93,7 +93,7 @@ module Equ
                               ! density floor, or velocity ceiling
       intent(out)  :: df,p
 !
-      logical :: early_finalize
+      logical :: early_finalize, lvideo_only
       real, dimension(1)  :: mass_per_proc
       real :: start_time, end_time
 !
@@ -161,7 +161,7 @@ module Equ
 !                     lslope_limit_diff .or. lvisc_smag .or. &
                      lvisc_smag .or. ltraining .or. &
                      lyinyang .or. lgpu .or. &   !!!
-                     ncoarse>1
+                     ncoarse>1 .or. lthreaded_mn_loop
 !
 !  Write crash snapshots to the hard disc if the time-step is very low.
 !  The user must have set crash_file_dtmin_factor>0.0 in &run_pars for
@@ -302,9 +302,17 @@ module Equ
       call timing('pde','after "after_boundary" calls')
 !
       if (lgpu) then
-        if (lrhs_diagnostic_output) then
+!
+!  Steps writing only video slices need just the slabs around the slice planes.
+!
+        lvideo_only = lvideo .and. lwrite_slices .and. lfirst .and. .not.lrhs_diagnostic_output
+        if (lrhs_diagnostic_output .or. lvideo_only) then
           !wait in case the last diagnostic tasks are not finished
-          call copy_farray_from_GPU(f)
+          if (lvideo_only) then
+            call copy_slices_from_GPU(f)
+          else
+            call copy_farray_from_GPU(f,async_=.true.)
+          endif
           if(lode .and. lgpu) then
                   if (.not. allocated(f_ode_diagnostics)) then
                           allocate(f_ode_diagnostics(max_n_odevars))
@@ -316,7 +324,7 @@ module Equ
         start_time = mpiwtime()
         call rhs_gpu(f,itsub)
 !TP: should be done after rhs_gpu since if doing testing against cpu want to get the right value of dt
-        if (lrhs_diagnostic_output) then
+        if (lrhs_diagnostic_output .or. lvideo_only) then
 !$        call save_diagnostic_controls
         endif
         end_time = mpiwtime()
@@ -466,14 +474,17 @@ module Equ
     use Chemistry
     use Slices
     use Diagnostics
+    use Python, only: python_call
 
     real, dimension (mx,my,mz,mfarray) :: f
 !
 !  Print diagnostic averages to screen and file.
+!  In-situ Python analysis (python_run_pars) sees the same state.
 !
       if (lout) then
         call prints
         if (lchemistry) call write_net_reaction
+        if (lpython) call python_call(f)
       endif
 !
       if (l1davg) call write_1daverages
@@ -624,7 +635,11 @@ module Equ
       !TP: example code to explicitly set and get cores the thread are running on
       !TP: the flexible way to set this is with OMP_PROC_BIND=close,spread, but in case that fails one can be sure by using the code
       !below
-!!$    if (omp_get_thread_num() /= 0) call set_cpu(core_ids(omp_get_thread_num()+1))
+!
+!  With lpin_helper_threads, the workers are kept off the cores of the master (which drives MPI
+!  progress and the GPU) and of the helper master, see the remapping of core_ids in run.f90.
+!
+!$    if (lpin_helper_threads .and. omp_get_thread_num() /= 0) call set_cpu(core_ids(omp_get_thread_num()+1))
       !print*,"omp_id,cpu_id,mpi_id: ",omp_get_thread_num(), get_cpu(), iproc
 
       !$omp do
@@ -1058,6 +1073,7 @@ module Equ
       use Testflow
       use Testscalar
       use Training, only: calc_diagnostics_training
+!$    use OMP_lib
 
       real, dimension (mx,my,mz,mfarray),intent(INOUT) :: f
       real, dimension (mx,my,mz,mvar)   ,intent(OUT  ) :: df
@@ -1066,14 +1082,35 @@ module Equ
       logical                           ,intent(IN   ) :: early_finalize
 
       real, dimension (nx,3) :: df_iuu_pencil
-      logical :: lcommunicate
+      logical :: lcommunicate, lthreads
+!$    real, dimension(:), pointer :: p_dt1_max
+      integer :: jmn
 !
       lfirstpoint=.true.
       lcommunicate=.not.early_finalize
 
       call prep_rhs
+!
+!  With lthreaded_mn_loop, the pencils are shared among the threads of the
+!  rank (the halos are then complete before the loop, see early_finalize in pde).
+!  Pencil case, imn, m, n and the per-pencil timestep arrays are private to each
+!  thread, dt1_max is reduced at the end. Steps accumulating diagnostics, slices or
+!  other quantities outside of df stay serial, as do runs with modules whose
+!  per-pencil auxiliaries are not yet threadprivate.
+!
+      lthreads = lthreaded_mn_loop .and. early_finalize .and. .not. &
+                 (lrhs_diagnostic_output .or. (lvideo.and.lfirst) .or. headtt .or. lanelastic .or. &
+                  (ltime_integrals.and.llast) .or. lparticles .or. lpointmasses .or. lspecial .or. &
+                  lsolid_cells .or. lchemistry .or. ltraining)
+!$    p_dt1_max => dt1_max
+!
+!$omp parallel if(lthreads) num_threads(num_helper_threads) private(p,df_iuu_pencil) &
+!$omp copyin(t,lpencil,lfirstpoint,dt1_max,ldiagnos,l1davgfirst,l2davgfirst,l1dphiavg,lvideo,lout) &
+!$omp copyin(dline_1,dxyz_2,dxyz_4,dxyz_6,dvol,dxmax_pencil,dxmin_pencil,lcoarse_mn)
+!$omp do schedule(static)
+      mn_loop: do jmn=1,nyz
 
-      mn_loop: do imn=1,nyz
+        imn=jmn      ! imn is threadprivate, but cannot be the loop variable
 
         n=nn(imn)
         m=mm(imn)
@@ -1319,6 +1356,14 @@ module Equ
         lfirstpoint=.false.
 !
       enddo mn_loop
+!$omp end do
+!
+!$    if (lthreads .and. omp_get_thread_num()/=0) then
+!$omp critical (reduce_dt1_max)
+!$      if (lupdate_courant_dt) p_dt1_max=max(p_dt1_max,dt1_max)
+!$omp end critical (reduce_dt1_max)
+!$    endif
+!$omp end parallel
 !
       if (ltime_integrals.and.llast) then
         if (lhydro) call update_for_time_integrals_hydro
@@ -10,8 +10,10 @@
 
   public :: f, df
   public :: initialize, finalize
+  public :: begin_farray_update, end_farray_update, publish_farray
 
-  external :: allocate_shm
+  external :: allocate_shm, shm_write_begin, shm_write_end
+  external :: allocate_shm_publish, shm_publish
 
   contains
 !******************************************************************************
@@ -27,9 +29,10 @@
   type(C_PTR) :: fp
 
   interface
-    type(C_PTR) function allocate_shm(num,name)
+    type(C_PTR) function allocate_shm(num,dims,name)
       import :: c_ptr, ikind8
       integer(KIND=ikind8) :: num
+      integer, dimension(4) :: dims
       character(LEN=*) :: name
     endfunction
   end interface
@@ -43,7 +46,7 @@
     !mvar=nvar; maux=naux; maux_com=naux_com; mscratch=nscratch; mglobal=nglobal
 
     if (shared_mem_name/='') then
-      fp = allocate_shm(nelems,shared_mem_name//char(0))
+      fp = allocate_shm(nelems,(/mx,my,mz,mfarray/),shared_mem_name//char(0))
       call c_f_pointer(fp,f,(/mx,my,mz,mfarray/))
     else
       allocate(f_arr(mx,my,mz,mfarray),STAT=stat)
@@ -51,6 +54,11 @@
     endif
 
     if (stat>0) call fatal_error('farray_alloc','Could not allocate f')
+!
+!  Double-buffered copy for in-situ consumers, see publish_farray.
+!
+    if (shared_mem_publish_name/='') &
+      call allocate_shm_publish(nelems,(/mx,my,mz,mfarray/),shared_mem_publish_name//char(0))
     if (nt>0.and..not.lgpu) then
       allocate(df(mx,my,mz,mvar),STAT=stat)
       if (stat>0) call fatal_error('farray_alloc','Could not allocate df')
@@ -67,5 +75,49 @@
     if (allocated(df)) deallocate(df) 
 
   endsubroutine finalize
+!******************************************************************************
+  subroutine begin_farray_update(async_)
+!
+!  To be called before f is modified: readers of the shared-memory f-array
+!  discard what they see from now on until the matching end_farray_update,
+!  see shared_mem_layout.h. With async_=T, the update may be ended by another
+!  thread, and only one such update is open at a time.
+!
+    use Cdata, only: shared_mem_name
+    use General, only: loptest
+
+    logical, optional :: async_
+
+    if (shared_mem_name/='') call shm_write_begin(loptest(async_))
+
+  endsubroutine begin_farray_update
+!******************************************************************************
+  subroutine end_farray_update(async_)
+!
+!  f is consistent again and belongs to time t, time step it.
+!  With async_=T, ends the open asynchronous update, if any.
+!
+    use Cdata, only: shared_mem_name, t, it
+    use General, only: loptest
+
+    logical, optional :: async_
+
+    if (shared_mem_name/='') call shm_write_end(loptest(async_),t,it)
+
+  endsubroutine end_farray_update
+!******************************************************************************
+  subroutine publish_farray(a)
+!
+!  Copies the consistent f (a) into the older half of the publication segment
+!  and switches readers to it, so that they always find a complete time step,
+!  see shared_mem_layout.h. The cadence (it_shared_mem_publish) is up to the caller.
+!
+    use Cdata, only: shared_mem_publish_name, t, it, mx, my, mz, mfarray
+
+    real, dimension(mx,my,mz,mfarray) :: a
+
+    if (shared_mem_publish_name/='') call shm_publish(a,t,it)
+
+  endsubroutine publish_farray
 !******************************************************************************
   endmodule Farray_alloc
@@ -997,14 +997,7 @@ module Forcing
           do ilist=1,nlist_ck
             emm = cklist(ilist,1)
             Legendrel = cklist(ilist,2)
-            do n=1,mz
-              do m=1,my
-                call sp_harm_real(RYlm,Legendrel,emm,y(m),z(n))
-                call sp_harm_imag(IYlm,Legendrel,emm,y(m),z(n))
-                RYlm_list(m,n,ilist)=RYlm
-                IYlm_list(m,n,ilist)=IYlm
-              enddo
-            enddo
+            call sp_harm_grid(RYlm_list(:,:,ilist),IYlm_list(:,:,ilist),Legendrel,emm,y,my,z,mz)
 
             do aindex=1,3
               Balpha = cklist(ilist,2+aindex)
@@ -3076,7 +3069,8 @@ module Forcing
       real, dimension(nx,3,3) :: psi_ij,Tij
       integer :: emm,l,j,jf,Legendrel,lmindex,aindex
       real :: a_ell,anum,adenom,jlm_ff,ylm_ff,rphase1,fnorm,alphar,Balpha,&
-              psilm,RYlm,IYlm
+              psilm
+      real, dimension(my,mz) :: RYlm,IYlm
       real :: rz,rindex,ralpha,rphase2
       real, dimension(mx) :: Z_psi
 !
@@ -3127,11 +3121,10 @@ module Forcing
           Z_psi(l) = (a_ell*jlm_ff+ylm_ff)
         enddo
 !
+        call sp_harm_grid(RYlm,IYlm,Legendrel,emm,y,my,z,mz)
         do n=1,mz
           do m=1,my
-            call sp_harm_real(RYlm,Legendrel,emm,y(m),z(n))
-            call sp_harm_imag(IYlm,Legendrel,emm,y(m),z(n))
-            psilm = RYlm*cos(rphase1)-IYlm*sin(rphase1)
+            psilm = RYlm(m,n)*cos(rphase1)-IYlm(m,n)*sin(rphase1)
             psif(:,m,n) = Z_psi*psilm
             if (ck_equator_gap/=0) psif(:,m,n)=psif(:,m,n)*profy_ampl(m)
           enddo
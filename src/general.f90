@@ -70,7 +70,7 @@ module General
             qualify_position_biquin
   public :: binomial,merge_lists,reallocate
   public :: point_and_get_size, allocate_using_dims
-!$ public :: signal_wait, signal_send, signal_init, get_cpu, set_cpu, omp_single
+!$ public :: signal_wait, signal_send, signal_init, get_cpu, set_cpu, get_num_affinity_cpus, omp_single
   public :: string_to_enum
   interface string_to_enum
     module procedure string_to_enum_scalar
@@ -314,6 +314,21 @@ module General
     endfunction
   endinterface
 !
+!  Generalized Hilbert curve process mapping, also for non-power-of-two process grids (morton_helper.c).
+!
+  interface
+    pure type(int3) function gethilbertrank3d(rank, decomp_x, decomp_y, decomp_z) result(res)
+      import int3
+      integer, intent(in) :: rank, decomp_x, decomp_y, decomp_z
+    endfunction
+  endinterface
+!
+  interface
+    pure integer function gethilbertrank(x, y, z, decomp_x, decomp_y, decomp_z)
+      integer, intent(in) ::  x, y, z, decomp_x, decomp_y, decomp_z
+    endfunction
+  endinterface
+!
 ! For signaling across threads
 !
   interface
@@ -339,6 +354,11 @@ module General
 !$     integer :: core_id
 !$   endsubroutine set_cpu_c
 !$ endinterface
+!$
+!$ interface
+!$   integer function get_num_affinity_cpus_c()
+!$   endfunction get_num_affinity_cpus_c
+!$ endinterface
 !
   integer, parameter :: DIAG_COND = 1
 !
@@ -352,14 +372,16 @@ module General
 !
 !  16-sep-15/ccyang: coded.
 !
-      use Cdata, only: lprocz_slowest,lmorton_curve,nprocx_node,nprocy_node,nprocz_node
+      use Cdata, only: lprocz_slowest,lmorton_curve,lhilbert_curve,nprocx_node,nprocy_node,nprocz_node
 !
       integer, intent(in) :: ipx, ipy, ipz
 !
-      if (.false..and.all((/nprocx_node,nprocy_node,nprocz_node/)>0)) then
+      if (all((/nprocx_node,nprocy_node,nprocz_node/)>0)) then
         find_proc = find_proc_node_localty(ipx, ipy, ipz)
       else
-        if (lmorton_curve) then
+        if (lhilbert_curve) then
+          find_proc = gethilbertrank(ipx,ipy,ipz,nprocx,nprocy,nprocz)
+        else if (lmorton_curve) then
           find_proc = getmortonrank(ipx,ipy,ipz,nprocx,nprocy,nprocz)
         else if (lprocz_slowest) then
           find_proc = modulo(ipz,nprocz) * nprocxy + modulo(ipy,nprocy) * nprocx + modulo(ipx,nprocx)
@@ -376,7 +398,7 @@ module General
 !
 !  28-nov-23/ccyang: coded.
 !
-      use Cdata, only: lprocz_slowest, nprocx_node, nprocy_node, nprocz_node
+      use Cdata, only: nprocx_node, nprocy_node, nprocz_node
 !
       integer, intent(in) :: ipx_, ipy_, ipz_
 !
@@ -386,7 +408,7 @@ module General
       ipx=modulo(ipx_,nprocx); ipy=modulo(ipy_,nprocy); ipz=modulo(ipz_,nprocz)
       nprocs_node=nprocx_node*nprocy_node*nprocz_node
       rank = find_proc_general(mod(ipx,nprocx_node), mod(ipy,nprocy_node), mod(ipz,nprocz_node), &
-                               nprocx_node, nprocy_node, nprocz_node, lprocz_slowest) &
+                               nprocx_node, nprocy_node, nprocz_node) &
             + ipx/nprocx_node * nprocs_node &
             + ipy/nprocy_node * nprocx*nprocy_node*nprocz_node &
             + ipz/nprocz_node * nprocx*nprocy*nprocz_node
@@ -438,17 +460,21 @@ module General
 !***********************************************************************
     subroutine find_proc_coords(rank,ipx,ipy,ipz)
 
-      use Cdata, only: lprocz_slowest, lmorton_curve, nprocx_node, nprocy_node, nprocz_node
+      use Cdata, only: lprocz_slowest, lmorton_curve, lhilbert_curve, nprocx_node, nprocy_node, nprocz_node
 
       integer, intent(in) :: rank
       integer, intent(out) :: ipx, ipy, ipz
       type(int3) :: proc_coords
 
-      if (.false..and.all((/nprocx_node,nprocy_node,nprocz_node/)>0)) then
+      if (all((/nprocx_node,nprocy_node,nprocz_node/)>0)) then
         call find_proc_coords_node_localty(rank,ipx,ipy,ipz)
-print*, 'rank,ipx,ipy,ipz, find_proc=',rank, ipx,ipy,ipz, find_proc_node_localty(ipx,ipy,ipz)
       else
-        if (lmorton_curve) then
+        if (lhilbert_curve) then
+          proc_coords = gethilbertrank3d(rank,nprocx,nprocy,nprocz)
+          ipx = proc_coords%x
+          ipy = proc_coords%y
+          ipz = proc_coords%z
+        else if (lmorton_curve) then
           proc_coords = getmortonrank3d(rank,nprocx,nprocy,nprocz)
           ipx = proc_coords%x
           ipy = proc_coords%y
@@ -502,7 +528,7 @@ print*, 'rank,ipx,ipy,ipz, find_proc=',rank, ipx,ipy,ipz, find_proc_node_localty
 !
       use Cdata, only: mm,nn,imn_array,necessary,necessary_imn,lroot,ip, &
                        lyinyang,lcutoff_corners,nycut,nzcut, &
-                       lfirst_proc_y, lfirst_proc_z, llast_proc_y, llast_proc_z
+                       lfirst_proc_y, lfirst_proc_z, llast_proc_y, llast_proc_z, mn_order
 !
       integer :: imn,m,n
       integer :: min_m1i_m2,max_m2i_m1
@@ -596,6 +622,17 @@ print*, 'rank,ipx,ipy,ipz, find_proc=',rank, ipx,ipy,ipz, find_proc_node_localty
           enddo
         enddo
       endif
+!
+!  Optionally reorder the pencils within the stretches before and after the
+!  point where the communication must be completed, for a better cache reuse.
+!
+      if (mn_order/='yz') then
+        call reorder_mm_nn(1,necessary_imn-1)
+        call reorder_mm_nn(necessary_imn,ny*nz)
+        do imn=1,ny*nz
+          imn_array(mm(imn),nn(imn))=imn
+        enddo
+      endif
 
       if (lyinyang.and.lcutoff_corners) then
         if (lfirst_proc_y) then
@@ -621,6 +658,57 @@ print*, 'rank,ipx,ipy,ipz, find_proc=',rank, ipx,ipy,ipz, find_proc_node_localty
       !if (iproc==0) write(100,'(30(i3,1x))') imn_array
 !
     endsubroutine setup_mm_nn
+!***********************************************************************
+    subroutine reorder_mm_nn(imn1,imn2)
+!
+!  Reorders the pencils imn1..imn2 in mm, nn according to mn_order:
+!  'tiled':  y-z tiles of mn_tile(1) x mn_tile(2) pencils, y fastest within a tile.
+!            Without mn_tile, the tiles extend over the full z range and are as wide in y
+!            as lets the 2*nghost+1 pencil planes needed for the z derivatives fit into
+!            1 MB (a typical L2 cache).
+!  'morton': Morton (Z-order) curve in (m,n), as for the process mapping (morton_helper.c).
+!  The pencils are computed independently, so the result of the rhs does not depend on
+!  the order.
+!
+      use Cdata, only: mm,nn,mn_order,mn_tile,lroot,m1,n1
+!
+      integer, intent(in) :: imn1,imn2
+!
+      integer, dimension(imn2-imn1+1) :: keys, order
+      integer :: imn, ty, tz, ntiles_y, jy, jz
+!
+      if (imn2<=imn1) return
+!
+      select case (mn_order)
+      case ('tiled')
+        ty=mn_tile(1); tz=mn_tile(2)
+        if (ty<=0) ty=max(2**20/(mx*mfarray*storage_size(1.)/8)/(2*nghost+1)-2*nghost,1)
+        if (tz<=0) tz=nz
+        ty=min(ty,ny); tz=min(tz,nz)
+        ntiles_y=(ny-1)/ty+1
+        do imn=imn1,imn2
+          jy=mm(imn)-m1; jz=nn(imn)-n1
+          keys(imn-imn1+1)=((jz/tz*ntiles_y+jy/ty)*tz+mod(jz,tz))*ty+mod(jy,ty)
+        enddo
+      case ('morton')
+        if (max(ny,nz)>1024) then
+          if (lroot) print*, 'reorder_mm_nn: WARNING - Morton keys limited to ny,nz<=1024, keeping the yz order'
+          return
+        endif
+        do imn=imn1,imn2
+          keys(imn-imn1+1)=getmortonrank(mm(imn)-m1,nn(imn)-n1,0,ny,nz,1)
+        enddo
+      case default
+        if (lroot) print*, 'reorder_mm_nn: WARNING - no such mn_order: ', trim(mn_order), &
+                           ', keeping the yz order'
+        return
+      endselect
+!
+      call quick_sort(keys,order)
+      mm(imn1:imn2)=mm(imn1-1+order)
+      nn(imn1:imn2)=nn(imn1-1+order)
+!
+    endsubroutine reorder_mm_nn
 !***********************************************************************
     subroutine gaunoise_number(gn)
 !
@@ -8151,6 +8239,13 @@ iloop:do i=1,size(list2)
 !$    call set_cpu_c(cpu_id)
 !$  endsubroutine set_cpu
 !***********************************************************************
+!$  integer function get_num_affinity_cpus()
+!
+!  Number of CPUs the process may run on according to its affinity mask.
+!
+!$    get_num_affinity_cpus = get_num_affinity_cpus_c()
+!$  endfunction get_num_affinity_cpus
+!***********************************************************************
 !$  logical function omp_single()
 
 !$    use OMP_lib
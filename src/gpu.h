@@ -1,7 +1,11 @@
   public :: register_GPU, initialize_GPU, finalize_GPU, get_farray_ptr_gpu, rhs_GPU, &
-            copy_farray_from_GPU, &
+            copy_farray_from_GPU, finish_copy_farray_from_GPU, copy_slices_from_GPU, copy_vars_from_GPU, bind_thread_near_GPU, &
+            plane_sums_GPU, power_spectra_GPU, histogram_GPU, structure_functions_GPU, downsample_GPU, &
+            init_timeavgs_GPU, update_timeavgs_GPU, copy_timeavgs_from_GPU, nonfinite_on_GPU, shear_shift_GPU, &
+            save_rollback_state_GPU, rollback_GPU, &
+            direct_snapshot_possible_GPU, write_snapshot_from_GPU, lsnap_from_GPU, &
             read_gpu_run_pars, write_gpu_run_pars, &
-            load_farray_to_GPU, reload_GPU_config, update_on_gpu, get_ptr_GPU, get_ptr_GPU_training, &
+            load_farray_to_GPU, mark_farray_dirty_GPU, reload_GPU_config, update_on_gpu, get_ptr_GPU, get_ptr_GPU_training, &
             calcQ_gpu, before_boundary_gpu, &
             after_timestep_gpu, &
             gpu_set_dt, train_gpu, infer_gpu,source_function_and_opacity_gpu, &
@@ -26,15 +26,30 @@ module GPU
   external initialize_gpu_c
   external register_gpu_c
   external finalize_gpu_c
+  external write_gpu_timings_c
+  external open_dt_limiter_report_c
   external get_farray_ptr_gpu_c
   external rhs_gpu_c
   external before_boundary_gpu_c
   external after_timestep_gpu_c 
   external source_function_and_opacity_gpu_c
   external load_farray_c
+  external mark_farray_dirty_c
   external reload_gpu_config_c
   external test_rhs_c
   external copy_farray_c
+  external copy_farray_async_c
+  external copy_slices_c
+  external copy_vars_c
+  external plane_sums_gpu_c
+  external shear_shift_gpu_c
+  external power_spectra_gpu_c
+  external histogram_gpu_c
+  external structure_functions_gpu_c
+  external downsample_gpu_c
+  external init_timeavgs_gpu_c, update_timeavgs_gpu_c, copy_timeavgs_from_gpu_c
+  external wait_farray_async_c
+  external bind_thread_near_gpu_c
   external update_on_gpu_arr_by_ind_c
   external update_on_gpu_scal_by_ind_c
   external pos_real_ptr_c
@@ -46,12 +61,41 @@ module GPU
 
   integer, external :: update_on_gpu_arr_by_name_c
   integer, external :: update_on_gpu_scal_by_name_c
+  integer, external :: find_nonfinite_gpu_c
+  integer, external :: direct_snapshot_possible_gpu_c
+  integer, external :: write_snapshot_gpu_c
 
   !integer(KIND=ikind8) :: pFarr_GPU_in, pFarr_GPU_out
   type(C_PTR) :: pFarr_GPU_in, pFarr_GPU_out
+!
+!  Set when f holds only the slabs around the video slice planes (copy_slices_from_GPU).
+!
+  logical :: lslabs_copied=.false.
+!
+!  Check the f-array on the GPU for NaN/Inf every nonfinite_check_gpu time steps (0: never).
+!
+  integer :: nonfinite_check_gpu=0
+!
+!  Set while a snapshot is written whose data record is to come from the GPU (write_snapshot_from_GPU).
+!
+  logical :: lsnap_from_GPU=.false.
+!
+!  Ring of the last nrollback_gpu states in host memory, taken every it_rollback_gpu time steps
+!  at which the NaN/Inf check has passed. A run in which NaN/Inf are found continues from the
+!  newest of them, with cdt (dt if fixed) multiplied by rollback_dt_factor.
+!
+  integer :: nrollback_gpu=0, it_rollback_gpu=1000
+  real :: rollback_dt_factor=0.5
+  real, dimension(:,:,:,:,:), allocatable :: f_rollback
+  real(KIND=rkind8), dimension(:), allocatable :: t_rollback
+  real, dimension(:), allocatable :: deltay_rollback
+  integer :: nrollback_stored=0, irollback_newest=0
 
   namelist /gpu_run_pars/ &
-        ltest_bcs,lac_sparse_autotuning,lcpu_timestep_on_gpu,lread_all_vars_from_device,lcuda_aware_mpi
+        ltest_bcs,lac_sparse_autotuning,lcpu_timestep_on_gpu,lread_all_vars_from_device,lcuda_aware_mpi, &
+        lcopy_farray_async, lpin_farray, lgpu_timings, lreproducible_reductions, nonfinite_check_gpu, &
+        lgpu_numa_placement, lgpu_direct_snapshots, ldt_limiter_report, lgpu_lazy_autotuning, &
+        nrollback_gpu, it_rollback_gpu, rollback_dt_factor
 
 contains
 !***********************************************************************
@@ -93,6 +137,12 @@ contains
       if (lpoisson) str=trim(str)//', '//'poisson'
       if (lselfgravity) str=trim(str)//', '//'selfgravity'
       if (lsolid_cells) str=trim(str)//', '//'solid_cells'
+!
+!  The interpolation between the Yin and Yang patches is done in the CPU halo
+!  exchange only; the device has neither the stencils/weights nor the exchange.
+!
+      if (lyinyang) str=trim(str)//', '//'yinyang'
+!
       if (lparticles) str=trim(str)//', '//'particles'
 
       if (str/='') call fatal_error('initialize_GPU','no GPU implementation available for module(s) "'// &
@@ -100,6 +150,7 @@ contains
 !
       if (dt<=0.) dt = dtmin
       call initialize_gpu_c(f,MPI_COMM_PENCIL,t)
+      if (ldt_limiter_report) call open_dt_limiter_report_c(trim(datadir)//'/dt_limiter.dat'//char(0))
 !
 ! Load farray to gpu
 !
@@ -134,6 +185,8 @@ contains
 !**************************************************************************
     subroutine finalize_gpu
 !
+      if (lgpu_timings) call write_gpu_timings_c(trim(datadir)//'/gpu_timings.dat'//char(0))
+      if (allocated(f_rollback)) deallocate(f_rollback,t_rollback,deltay_rollback)
       call finalize_gpu_c
 !
     endsubroutine finalize_GPU
@@ -248,30 +301,370 @@ contains
 
     endfunction get_ptr_GPU_training
 !**************************************************************************
-    subroutine copy_farray_from_GPU(f,nowait_)
-
+    subroutine copy_farray_from_GPU(f,nowait_,async_)
+!
+!  If async_ is set (and lcopy_farray_async), the download is only started; f is valid after
+!  finish_copy_farray_from_GPU, which the helper thread calls before doing the diagnostics.
+!
 !$    use General, only: signal_wait
+      use Farray_alloc, only: begin_farray_update, end_farray_update
 
       real, dimension (mx,my,mz,mfarray), intent(OUT) :: f
-      logical, optional :: nowait_
+      logical, optional :: nowait_, async_
       logical :: nowait
       integer :: i
 
       nowait = loptest(nowait_)
       if (nowait) then
+        call begin_farray_update
         call copy_farray_c(f)
+        call end_farray_update
         return
       endif
 !
-!$    if (lfarray_copied) return
+!$    if (lfarray_copied .and. .not.lslabs_copied) then
+!$      if (lcopy_farray_async) call wait_farray_async_c
+!$      call end_farray_update(async_=.true.)
+!$      return
+!$    endif
 !
 ! Have to wait since if doing diagnostics don't want to overwrite f.
 !
 !$    call signal_wait(lhelper_perf, .false.)
+!
+! With lcopy_farray_async, only start the download here; the helper thread completes it
+! in finish_copy_farray_from_GPU while the GPU proceeds with the next substep.
+!
+!$    if (lcopy_farray_async .and. lmultithread .and. loptest(async_)) then
+!$      call begin_farray_update(async_=.true.)
+!$      call copy_farray_async_c
+!$      lslabs_copied = .false.
+!$      lfarray_copied = .true.
+!$      return
+!$    endif
+      call begin_farray_update
       call copy_farray_c(f)
+      call end_farray_update
+      lslabs_copied = .false.
 !$    lfarray_copied = .true.
 
     endsubroutine copy_farray_from_GPU
+!**************************************************************************
+    subroutine copy_slices_from_GPU(f)
+!
+!  For steps which only write video slices: downloads just the slabs around the
+!  slice planes of this rank, which suffice for the slice quantities derived by
+!  finite differences. The rest of f is left untouched (and outdated), so any
+!  later copy_farray_from_GPU in the same step does the full download.
+!  R-slices need the whole volume.
+!
+!$    use General, only: signal_wait
+      use Farray_alloc, only: begin_farray_update, end_farray_update
+
+      real, dimension (mx,my,mz,mfarray), intent(INOUT) :: f
+      integer, dimension(7) :: planes
+!
+!$    if (lfarray_copied) return
+!$    call signal_wait(lhelper_perf, .false.)
+!
+      call begin_farray_update
+      if (lwrite_slice_r) then
+        call copy_farray_c(f)
+      else
+        planes = (/ix_loc,iy_loc,iy2_loc,iz_loc,iz2_loc,iz3_loc,iz4_loc/)
+        where (.not.(/lwrite_slice_yz,lwrite_slice_xz,lwrite_slice_xz2,lwrite_slice_xy, &
+                      lwrite_slice_xy2,lwrite_slice_xy3,lwrite_slice_xy4/)) planes=0
+        call copy_slices_c(f,planes)
+        lslabs_copied = .true.
+      endif
+      call end_farray_update
+!$    lfarray_copied = .true.
+
+    endsubroutine copy_slices_from_GPU
+!**************************************************************************
+    subroutine copy_vars_from_GPU(f,ivar1,ivar2)
+!
+!  For CPU modules which need only a few variables, e.g., one field:
+!  downloads just f(:,:,:,ivar1:ivar2), skipping the slots which have
+!  not changed on the GPU since their last download, also by an earlier
+!  call in the same step. The rest of f is left untouched.
+!
+!$    use General, only: signal_wait
+      use Farray_alloc, only: begin_farray_update, end_farray_update
+
+      real, dimension (mx,my,mz,mfarray), intent(INOUT) :: f
+      integer, intent(IN) :: ivar1, ivar2
+!
+!$    if (lfarray_copied .and. .not.lslabs_copied) then
+!$      call copy_farray_from_GPU(f)
+!$      return
+!$    endif
+!$    call signal_wait(lhelper_perf, .false.)
+!
+      call begin_farray_update
+      call copy_vars_c(f,ivar1,ivar2)
+      call end_farray_update
+
+    endsubroutine copy_vars_from_GPU
+!**************************************************************************
+    subroutine plane_sums_GPU(ivar,idir,sums,power)
+!
+!  Sums of f(l1:l2,m1:m2,n1:n2,ivar)**power (power=1 by default, or 2) over the
+!  local domain, computed on the GPU without downloading f: idir=1,2,3 gives the
+!  profiles along x,y,z (sums over the other two directions, sums(1:nx|ny|nz)),
+!  idir=0 the z sums, sums(1:nx*ny) with x running fastest.
+!  The sums are not reduced over the processors.
+!
+      integer, intent(IN) :: ivar, idir
+      real, dimension(:), intent(OUT) :: sums
+      integer, optional, intent(IN) :: power
+
+      integer :: pow
+
+      pow=1
+      if (present(power)) pow=power
+      call plane_sums_gpu_c(ivar,idir,pow,sums)
+
+    endsubroutine plane_sums_GPU
+!**************************************************************************
+    subroutine shear_shift_GPU(dt_shear,llast_sub)
+!
+!  Shear advection as a shift (lshearadvection_as_shift): shifts the variables
+!  on the GPU, and unless in the last substep also their time derivatives,
+!  by uy0*dt_shear in y, like advance_shear does on the CPU.
+!
+      real, intent(IN) :: dt_shear
+      logical, intent(IN) :: llast_sub
+
+      call shear_shift_gpu_c(dt_shear,merge(1,0,llast_sub))
+
+    endsubroutine shear_shift_GPU
+!**************************************************************************
+    logical function nonfinite_on_GPU()
+!
+!  Every nonfinite_check_gpu time steps, scans the f-array slots held on the GPU
+!  for NaN or Inf with one kernel launch, reporting the first offending slot and
+!  point of each processor. True on all processors if any of them found one.
+!
+      use Mpicomm, only: mpiallreduce_or
+
+      integer :: ivar
+      integer, dimension(3) :: pos
+
+      nonfinite_on_GPU=.false.
+      if (nonfinite_check_gpu<=0) return
+      if (mod(it,nonfinite_check_gpu)/=0) return
+
+      ivar=find_nonfinite_gpu_c(pos)
+      if (ivar>0) print'(a,i6,a,i4,a,3i5,a,1p,3e13.5)', 'nonfinite_on_GPU: iproc=',iproc, &
+                        ' found NaN/Inf in f-array slot',ivar,' at (l,m,n)=',pos+(/l1,m1,n1/), &
+                        ', (x,y,z)=',x(l1+pos(1)),y(m1+pos(2)),z(n1+pos(3))
+      call mpiallreduce_or(ivar>0,nonfinite_on_GPU)
+
+    endfunction nonfinite_on_GPU
+!**************************************************************************
+    subroutine save_rollback_state_GPU(f)
+!
+!  Puts the state after the current time step into the ring of rollback states,
+!  if the step is one of the NaN/Inf check (which it has passed) and of it_rollback_gpu.
+!
+      real, dimension (mx,my,mz,mfarray), intent(INOUT) :: f
+
+      integer :: alloc_err
+
+      if (nrollback_gpu<=0 .or. nonfinite_check_gpu<=0) return
+      if (mod(it,nonfinite_check_gpu)/=0 .or. mod(it,it_rollback_gpu)/=0) return
+
+      if (.not.allocated(f_rollback)) then
+        allocate(f_rollback(mx,my,mz,mvar,nrollback_gpu),t_rollback(nrollback_gpu), &
+                 deltay_rollback(nrollback_gpu),stat=alloc_err)
+        if (alloc_err/=0) call fatal_error('save_rollback_state_GPU','could not allocate the rollback states')
+      endif
+
+      call copy_farray_from_GPU(f)
+      irollback_newest=mod(irollback_newest,nrollback_gpu)+1
+      f_rollback(:,:,:,:,irollback_newest)=f(:,:,:,1:mvar)
+      t_rollback(irollback_newest)=t
+      deltay_rollback(irollback_newest)=deltay
+      nrollback_stored=min(nrollback_stored+1,nrollback_gpu)
+
+    endsubroutine save_rollback_state_GPU
+!**************************************************************************
+    logical function rollback_GPU(f)
+!
+!  After NaN/Inf have been found, continues from the newest state of the ring with
+!  cdt (dt if fixed) reduced by rollback_dt_factor. The state is removed from the
+!  ring, so that a renewed blow-up goes back further. False if the ring is empty.
+!
+      real, dimension (mx,my,mz,mfarray), intent(INOUT) :: f
+
+      rollback_GPU=(nrollback_stored>0)
+      if (.not.rollback_GPU) return
+
+      f(:,:,:,1:mvar)=f_rollback(:,:,:,:,irollback_newest)
+      t=t_rollback(irollback_newest)
+      deltay=deltay_rollback(irollback_newest)
+      irollback_newest=mod(irollback_newest-2+nrollback_gpu,nrollback_gpu)+1
+      nrollback_stored=nrollback_stored-1
+
+      if (ldt) then
+        cdt=rollback_dt_factor*cdt
+      else
+        dt=rollback_dt_factor*dt
+      endif
+      if (lroot) print'(a,1p,e14.6,a,e11.3)', 'rollback_GPU: continuing from t=',t, &
+                       ' with '//merge('cdt=','dt= ',ldt),merge(cdt,dt,ldt)
+!
+!  The step size is part of the configuration on the device.
+!
+      call reload_GPU_config
+      call mark_farray_dirty_GPU(1,mvar)
+      call load_farray_to_GPU(f)
+
+    endfunction rollback_GPU
+!**************************************************************************
+    subroutine power_spectra_GPU(ivar,lcurl,kx,ky,kz,kscale,norm,spectrum,helicity)
+!
+!  Shell-integrated spectra of the vector f(l1:l2,m1:m2,n1:n2,ivar:ivar+2),
+!  Fourier transformed on the GPU: spectrum gets |a_k|^2 (|k x a_k|^2 if lcurl),
+!  helicity Re(a_k^* . (i k x a_k)), both multiplied by norm. kx, ky, kz are the
+!  wavenumbers of the local modes, the shell of a mode is nint(kscale*|k|).
+!  The spectra are not reduced over the processors.
+!
+      integer, intent(IN) :: ivar
+      logical, intent(IN) :: lcurl
+      real, dimension(nx), intent(IN) :: kx
+      real, dimension(ny), intent(IN) :: ky
+      real, dimension(nz), intent(IN) :: kz
+      real, intent(IN) :: kscale, norm
+      real, dimension(:), intent(OUT) :: spectrum, helicity
+
+      call power_spectra_gpu_c(ivar,merge(1,0,lcurl),kx,ky,kz,kscale,norm,size(spectrum),spectrum,helicity)
+
+    endsubroutine power_spectra_GPU
+!**************************************************************************
+    subroutine histogram_GPU(ivar,itransform,shift,scale,a,b,counts)
+!
+!  Histogram of f(l1:l2,m1:m2,n1:n2,ivar) binned on the GPU: a value falls into
+!  bin 1+int(a*g+b), clamped to 1..size(counts), where g is scale*(f-shift)
+!  (itransform=0), log10(scale*|f-shift|) (1) or scale*log(f) (2).
+!  The counts are not reduced over the processors.
+!
+      integer, intent(IN) :: ivar, itransform
+      real, intent(IN) :: shift, scale, a, b
+      integer, dimension(:), intent(OUT) :: counts
+
+      call histogram_gpu_c(ivar,itransform,shift,scale,a,b,size(counts),counts)
+
+    endsubroutine histogram_GPU
+!**************************************************************************
+    subroutine structure_functions_GPU(ivar,separations,sf)
+!
+!  Sums of |du|^q, q=1..8, and of du^3 (last column) over the increments
+!  du=u(x)-u(x+-s) along x of u=f(l1:l2,m1:m2,n1:n2,ivar), for each separation s
+!  in separations, formed on the GPU. As in structure, x+-s wraps within the
+!  local nx. The sums are not reduced over the processors.
+!
+      integer, dimension(:), intent(IN) :: separations
+      integer, intent(IN) :: ivar
+      real, dimension(:,:), intent(OUT) :: sf
+
+      call structure_functions_gpu_c(ivar,separations,size(separations),sf)
+
+    endsubroutine structure_functions_GPU
+!**************************************************************************
+    subroutine downsample_GPU(ivar,first,step,out)
+!
+!  out = f(first(1)::step(1),first(2)::step(2),first(3)::step(3),ivar),
+!  truncated to the shape of out, gathered on the GPU for wsnap_down.
+!
+      integer, intent(IN) :: ivar
+      integer, dimension(3), intent(IN) :: first, step
+      real, dimension(:,:,:), intent(OUT) :: out
+
+      call downsample_gpu_c(ivar,first,step,shape(out),out)
+
+    endsubroutine downsample_GPU
+!**************************************************************************
+    subroutine init_timeavgs_GPU(idx,f_tavg)
+!
+!  Keeps the time averages of f(:,:,:,idx) on the GPU from now on,
+!  starting from f_tavg; see update_timeavgs_GPU and copy_timeavgs_from_GPU.
+!
+      integer, dimension(:), intent(IN) :: idx
+      real, dimension(:,:,:,:), intent(IN) :: f_tavg
+
+      call init_timeavgs_gpu_c(size(idx),idx,f_tavg)
+
+    endsubroutine init_timeavgs_GPU
+!**************************************************************************
+    subroutine update_timeavgs_GPU(weight)
+!
+!  Relaxes the time averages on the GPU towards the current state by weight.
+!
+      real, intent(IN) :: weight
+
+      call update_timeavgs_gpu_c(weight)
+
+    endsubroutine update_timeavgs_GPU
+!**************************************************************************
+    subroutine copy_timeavgs_from_GPU(f_tavg)
+
+      real, dimension(:,:,:,:), intent(OUT) :: f_tavg
+
+      call copy_timeavgs_from_gpu_c(f_tavg)
+
+    endsubroutine copy_timeavgs_from_GPU
+!**************************************************************************
+    subroutine finish_copy_farray_from_GPU(f)
+!
+!  Waits for a download started by copy_farray_from_GPU in asynchronous mode
+!  and unpacks it into f. Returns immediately if nothing is pending.
+!
+      use Farray_alloc, only: end_farray_update
+
+      real, dimension (mx,my,mz,mfarray), intent(INOUT) :: f
+
+      if (lcopy_farray_async) call wait_farray_async_c
+      call end_farray_update(async_=.true.)
+      call keep_compiler_quiet(f)
+
+    endsubroutine finish_copy_farray_from_GPU
+!**************************************************************************
+    logical function direct_snapshot_possible_GPU(nv)
+!
+!  Whether f(:,:,:,1:nv) can be written to a snapshot straight from
+!  device memory, without copying it to the f-array (lgpu_direct_snapshots).
+!
+      integer, intent(IN) :: nv
+
+      direct_snapshot_possible_GPU=direct_snapshot_possible_gpu_c(nv)/=0
+
+    endfunction direct_snapshot_possible_GPU
+!**************************************************************************
+    subroutine write_snapshot_from_GPU(file,nv)
+!
+!  Creates file with f(:,:,:,1:nv), ghost zones included, from the GPU as its
+!  first unformatted record, as written by output_snap in io_dist.
+!
+
+      character(len=*), intent(IN) :: file
+      integer, intent(IN) :: nv
+
+      if (write_snapshot_gpu_c(trim(file)//char(0),nv)/=0) &
+        call fatal_error('write_snapshot_from_GPU','could not write '//trim(file))
+
+    endsubroutine write_snapshot_from_GPU
+!**************************************************************************
+    subroutine bind_thread_near_GPU
+!
+!  Binds the calling thread to the cores local to the GPU of this rank and
+!  lets it allocate on the GPU's NUMA node (lgpu_numa_placement).
+!  To be called by every OpenMP thread after initialize_GPU.
+!
+      call bind_thread_near_gpu_c
+
+    endsubroutine bind_thread_near_GPU
 !**************************************************************************
     subroutine load_farray_to_GPU(f)
 
@@ -280,6 +673,19 @@ contains
       call load_farray_c
 
     endsubroutine load_farray_to_GPU
+!**************************************************************************
+    subroutine mark_farray_dirty_GPU(ivar1,ivar2)
+!
+!  Flags the slots ivar1..ivar2 of f as changed on the CPU. If any slot has been
+!  flagged, the next load_farray_to_GPU uploads only the flagged ones.
+!
+      integer, intent(IN) :: ivar1
+      integer, optional, intent(IN) :: ivar2
+
+      if (ivar1<=0) return
+      call mark_farray_dirty_c(ivar1,ioptest(ivar2,ivar1))
+
+    endsubroutine mark_farray_dirty_GPU
 !**************************************************************************
     subroutine reload_GPU_config
 
@@ -26,13 +26,33 @@ void torch_infer_c_api(int);
 void registerGPU();
 void initializeGPU(REAL*, FINT, double);
 void finalizeGPU();
+void writeGPUTimings(const char*);
+void openDtLimiterReport(const char*);
 void getFArrayIn(REAL **);
 void substepGPU(int, double);
 void beforeBoundaryGPU(bool, int, double);
 void afterTimeStepGPU();
 void sourceFunctionAndOpacity(int);
 void copyFarray(REAL*);
+void copyFarrayAsync();
+void copySlices(REAL* f, const int* planes);
+void copyVars(int, int);
+void planeSumsGPU(int, int, int, REAL*);
+void shearShiftGPU(REAL, bool);
+int  findNonFiniteGPU(int*);
+void powerSpectraGPU(int, bool, const REAL*, const REAL*, const REAL*, REAL, REAL, int, REAL*, REAL*);
+void histogramGPU(int, int, REAL, REAL, REAL, REAL, int, int*);
+void structureFunctionsGPU(int, int*, int, REAL*);
+void downsampleGPU(int, int*, int*, int*, REAL*);
+void initTimeAveragesGPU(int, int*, REAL*);
+void updateTimeAveragesGPU(REAL);
+void copyTimeAveragesGPU(REAL*);
+void waitFarrayAsync();
+bool directSnapshotPossible(int);
+int  writeSnapshotGPU(const char*, int);
+void bindThreadNearGPU();
 void loadFarray();
+void markFarrayDirty(int, int);
 void reloadConfig();
 void updateInConfigArr(int);
 int  updateInConfigArrName(char *);
@@ -106,6 +126,20 @@ void FTNIZE(finalize_gpu_c)()
   finalizeGPU();
 }
 /* ---------------------------------------------------------------------- */
+void FTNIZE(write_gpu_timings_c)(char *filename)
+{
+// Writes per-rank min/mean/max timings of the GPU task graphs and copies (lgpu_timings).
+
+  writeGPUTimings(filename);
+}
+/* ---------------------------------------------------------------------- */
+void FTNIZE(open_dt_limiter_report_c)(char *filename)
+{
+// Opens the file to which the terms limiting the Courant timestep are appended (ldt_limiter_report).
+
+  openDtLimiterReport(filename);
+}
+/* ---------------------------------------------------------------------- */
 void FTNIZE(get_farray_ptr_gpu_c)(REAL** p_f_in)
 {
   getFArrayIn(p_f_in);
@@ -170,6 +204,128 @@ void FTNIZE(copy_farray_c)(REAL* f)
   copyFarray(f);
 }
 /* ---------------------------------------------------------------------- */
+void FTNIZE(copy_slices_c)(REAL* f, FINT* planes)
+{
+// Copies only the slabs around the video slice planes from GPU into f-array on CPU.
+
+  int iplanes[7];
+  for (int i = 0; i < 7; ++i) iplanes[i] = planes[i];
+  copySlices(f,iplanes);
+}
+/* ---------------------------------------------------------------------- */
+void FTNIZE(copy_vars_c)(REAL* f, FINT* ivar1, FINT* ivar2)
+{
+// Copies only the f-array slots ivar1..ivar2 from GPU into f-array on CPU.
+
+  copyVars(*ivar1,*ivar2);
+}
+/* ---------------------------------------------------------------------- */
+void FTNIZE(plane_sums_gpu_c)(FINT* ivar, FINT* idir, FINT* power, REAL* sums)
+{
+// Sums of f(:,:,:,ivar)**power reduced on the GPU onto direction idir (0 for the z sums).
+
+  planeSumsGPU(*ivar,*idir,*power,sums);
+}
+/* ---------------------------------------------------------------------- */
+void FTNIZE(shear_shift_gpu_c)(REAL* dt_shear, FINT* llast)
+{
+// Shear advection as a shift of the variables (and, if not *llast, of their time derivatives) on the GPU.
+
+  shearShiftGPU(*dt_shear,*llast!=0);
+}
+/* ---------------------------------------------------------------------- */
+FINT FTNIZE(find_nonfinite_gpu_c)(FINT* pos)
+{
+// Scans the f-array slots on the GPU for NaN/Inf; returns the first offending slot or 0.
+
+  int ipos[3];
+  const int ivar = findNonFiniteGPU(ipos);
+  for (int i = 0; i < 3; ++i) pos[i] = ipos[i];
+  return ivar;
+}
+/* ---------------------------------------------------------------------- */
+void FTNIZE(power_spectra_gpu_c)(FINT* ivar, FINT* icurl, REAL* kx, REAL* ky, REAL* kz, REAL* kscale, REAL* norm,
+                                 FINT* nbins, REAL* spectrum, REAL* helicity)
+{
+// Shell-integrated energy and helicity spectra of the vector f(:,:,:,ivar:ivar+2) from its transform on the GPU.
+
+  powerSpectraGPU(*ivar,*icurl!=0,kx,ky,kz,*kscale,*norm,*nbins,spectrum,helicity);
+}
+/* ---------------------------------------------------------------------- */
+void FTNIZE(histogram_gpu_c)(FINT* ivar, FINT* itransform, REAL* shift, REAL* scale, REAL* a, REAL* b,
+                             FINT* nbins, FINT* counts)
+{
+// Histogram of f(:,:,:,ivar) over the local domain, binned on the GPU.
+
+  histogramGPU(*ivar,*itransform,*shift,*scale,*a,*b,*nbins,counts);
+}
+/* ---------------------------------------------------------------------- */
+void FTNIZE(structure_functions_gpu_c)(FINT* ivar, FINT* separations, FINT* nsep, REAL* sf)
+{
+// Sums for the structure functions of f(:,:,:,ivar) along x over the local domain, formed on the GPU.
+
+  structureFunctionsGPU(*ivar,separations,*nsep,sf);
+}
+/* ---------------------------------------------------------------------- */
+void FTNIZE(downsample_gpu_c)(FINT* ivar, FINT* first, FINT* step, FINT* n, REAL* out)
+{
+// Every step-th point of f(:,:,:,ivar) from first on, gathered on the GPU.
+
+  downsampleGPU(*ivar,first,step,n,out);
+}
+/* ---------------------------------------------------------------------- */
+void FTNIZE(init_timeavgs_gpu_c)(FINT* ntavg, FINT* idx, REAL* f_tavg)
+{
+// Sets up the time averages on the GPU, starting from f_tavg.
+
+  initTimeAveragesGPU(*ntavg,idx,f_tavg);
+}
+/* ---------------------------------------------------------------------- */
+void FTNIZE(update_timeavgs_gpu_c)(REAL* weight)
+{
+  updateTimeAveragesGPU(*weight);
+}
+/* ---------------------------------------------------------------------- */
+void FTNIZE(copy_timeavgs_from_gpu_c)(REAL* f_tavg)
+{
+  copyTimeAveragesGPU(f_tavg);
+}
+/* ---------------------------------------------------------------------- */
+void FTNIZE(copy_farray_async_c)()
+{
+// Starts copying vertex buffers from GPU into a pinned staging buffer without waiting.
+
+  copyFarrayAsync();
+}
+/* ---------------------------------------------------------------------- */
+void FTNIZE(wait_farray_async_c)()
+{
+// Waits for the copy started by copy_farray_async_c and unpacks it into the f-array on CPU.
+
+  waitFarrayAsync();
+}
+/* ---------------------------------------------------------------------- */
+FINT FTNIZE(direct_snapshot_possible_gpu_c)(FINT* nv)
+{
+// Whether f(:,:,:,1:nv) can be written to a snapshot file straight from the GPU (lgpu_direct_snapshots).
+
+  return directSnapshotPossible(*nv);
+}
+/* ---------------------------------------------------------------------- */
+FINT FTNIZE(write_snapshot_gpu_c)(char *filename, FINT* nv)
+{
+// Creates filename with the record f(:,:,:,1:nv) taken from the GPU; returns 0 on success.
+
+  return writeSnapshotGPU(filename,*nv);
+}
+/* ---------------------------------------------------------------------- */
+void FTNIZE(bind_thread_near_gpu_c)()
+{
+// Binds the calling thread to the cores and NUMA node next to the GPU of this rank.
+
+  bindThreadNearGPU();
+}
+/* ---------------------------------------------------------------------- */
 void FTNIZE(load_farray_c)()
 {
 // Copies f-array on CPU to vertex buffers on GPU.
@@ -177,6 +333,13 @@ void FTNIZE(load_farray_c)()
   loadFarray();
 }
 /* ---------------------------------------------------------------------- */
+void FTNIZE(mark_farray_dirty_c)(FINT *ivar1, FINT *ivar2)
+{
+// Flags f-array slots ivar1..ivar2 as changed on CPU, so that only they go to GPU with the next load_farray_c.
+
+  markFarrayDirty(*ivar1,*ivar2);
+}
+/* ---------------------------------------------------------------------- */
 void FTNIZE(reload_gpu_config_c)()
 {
   reloadConfig();
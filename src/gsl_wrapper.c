@@ -3,6 +3,7 @@
 #include <gsl/gsl_sf_bessel.h>
 #include <gsl/gsl_sf_legendre.h>
 #include <math.h>
+#include <stdlib.h>
 
 #include "headers_c.h"
 
@@ -60,6 +61,31 @@ void FTNIZE(sp_harm_imag)
     *y = (REAL)pow(-1,emm)*Plm*sin(emm*fi);}
 }
 /* ---------------------------------------------------------------------- */
+void FTNIZE(sp_harm_grid)
+     (REAL *yr, REAL *yi, FINT *l, FINT *m, REAL *theta, FINT *ntheta, REAL *phi, FINT *nphi) {
+// Real and imaginary parts of Y_l^m, as from sp_harm_real and sp_harm_imag, on the
+// grid theta(1:ntheta) x phi(1:nphi) (theta fastest). P_l^m is evaluated once per
+// theta and the trigonometric factors once per phi, instead of once per point.
+  FINT ell = *l;
+  FINT emm = *m;
+  FINT nt = *ntheta, np = *nphi;
+  REAL sign = emm%2 == 0 ? 1. : -1.;
+  REAL *cosm = (REAL*) malloc(np*sizeof(REAL));
+  REAL *sinm = (REAL*) malloc(np*sizeof(REAL));
+  FINT i, j;
+  for (j=0; j<np; j++) {
+    cosm[j] = cos(emm*phi[j]);
+    sinm[j] = sin(emm*phi[j]);}
+#pragma omp parallel for private(j)
+  for (i=0; i<nt; i++) {
+    REAL Plm = sign*gsl_sf_legendre_sphPlm(ell,abs(emm),cos(theta[i]));
+    for (j=0; j<np; j++) {
+      yr[i+j*nt] = Plm*cosm[j];
+      yi[i+j*nt] = Plm*sinm[j];}}
+  free(cosm);
+  free(sinm);
+}
+/* ---------------------------------------------------------------------- */
 void FTNIZE(sp_harm_real_costh)
      (REAL *y, FINT *l, FINT *m, REAL *costh, REAL *phi) {
   REAL Plm;
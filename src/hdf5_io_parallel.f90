@@ -64,6 +64,7 @@ module HDF5_IO
   integer, parameter :: n_dims = 3
   integer(kind=8), dimension(n_dims+1) :: local_size, local_subsize, local_start
   integer(kind=8), dimension(n_dims+1) :: global_size, global_start
+  integer(kind=8), dimension(n_dims) :: chunk_size
   logical :: lcollective = .false., lwrite = .false.
   character (len=fnlen) :: current
   integer :: mvar_out, maux_out
@@ -104,6 +105,8 @@ module HDF5_IO
         local_subsize(1:3) = (/nx,ny,nz/)
       endif
       local_subsize(4:n_dims+1) = 1
+      ! compressed datasets are chunked in blocks of the size of a processor's portion
+      chunk_size = local_subsize(1:n_dims)
 !
       ! dimensions for local data portion with ghost layers
       local_size(1:3) = local_subsize(1:3)+2*nghost
@@ -222,7 +225,7 @@ module HDF5_IO
 !   7-May-2019/MR: added optional par comm for use in h5pset_fapl_mpio_f (default: MPI_COMM_WORLD)
 !
       use General, only: loptest, ioptest
-      use Mpicomm, only: MPI_COMM_WORLD, MPI_INFO_NULL
+      use Mpicomm, only: MPI_COMM_WORLD, mpi_io_info, mpi_free_info
 !
       character (len=*), intent(inout) :: file
       logical, optional, intent(in) :: truncate
@@ -232,7 +235,7 @@ module HDF5_IO
       integer, optional, intent(in) :: comm
 !
       logical :: ltrunc, lread_only
-      integer :: h5_read_mode, pos
+      integer :: h5_read_mode, pos, info
       integer :: i
 !
       if (lcollective .or. lwrite) call file_close_hdf5
@@ -255,8 +258,11 @@ module HDF5_IO
         ! setup file access property list
         call h5pcreate_f (H5P_FILE_ACCESS_F, h5_plist, h5_err)
         call check_error (h5_err, 'create global file access property list', caller='file_open_hdf5')
-        call h5pset_fapl_mpio_f (h5_plist, ioptest(comm,MPI_COMM_WORLD), MPI_INFO_NULL, h5_err)
+        ! collective buffering through io_aggregators writer ranks, if set
+        info = mpi_io_info (merge (0, io_aggregators, lread_only))
+        call h5pset_fapl_mpio_f (h5_plist, ioptest(comm,MPI_COMM_WORLD), info, h5_err)
         call check_error (h5_err, 'modify global file access property list')
+        call mpi_free_info (info)
 
         if (ltrunc) then
           ! create empty (or truncated) HDF5 file
@@ -1707,17 +1713,60 @@ module HDF5_IO
 !
     endsubroutine output_local_hdf5_3D
 !***********************************************************************
-    subroutine output_hdf5_3D(name, data)
+    function compression_plist(name, n, compress) result(plist)
+!
+!  Dataset creation property list for a distributed n-dimensional dataset:
+!  H5P_DEFAULT_F unless compress and snap_compression is set, otherwise chunked
+!  in processor-sized blocks and compressed by HDF5's built-in filters, which
+!  any HDF5 reader (h5py, IDL) decodes transparently:
+!    'deflate'     - lossless, byte shuffling and zlib at snap_compression_level;
+!    'scaleoffset' - lossy at a fixed absolute accuracy of 0.5*10^(-snap_compression_digits).
+!
+      character (len=*), intent(in) :: name
+      integer, intent(in) :: n
+      logical, intent(in) :: compress
+      integer(HID_T) :: plist
+!
+      integer(kind=8), dimension (n_dims+1) :: chunk
+!
+      plist = H5P_DEFAULT_F
+      if (.not. compress .or. snap_compression == 'none') return
+!
+      chunk(1:n_dims) = min (chunk_size, global_size(1:n_dims))
+      chunk(n_dims+1) = 1
+      call h5pcreate_f (H5P_DATASET_CREATE_F, plist, h5_err)
+      call check_error (h5_err, 'create dataset creation property list', name, caller='compression_plist')
+      call h5pset_chunk_f (plist, n, chunk(1:n), h5_err)
+      call check_error (h5_err, 'set chunk size', name)
+      select case (snap_compression)
+      case ('deflate')
+        call h5pset_shuffle_f (plist, h5_err)
+        call check_error (h5_err, 'set shuffle filter', name)
+        call h5pset_deflate_f (plist, snap_compression_level, h5_err)
+        call check_error (h5_err, 'set deflate filter', name)
+      case ('scaleoffset')
+        call h5pset_scaleoffset_f (plist, H5Z_SO_FLOAT_DSCALE_F, snap_compression_digits, h5_err)
+        call check_error (h5_err, 'set scale-offset filter', name)
+      case default
+        call fatal_error ('compression_plist', 'unknown snap_compression "'//trim (snap_compression)//'"')
+      endselect
+!
+    endfunction compression_plist
+!***********************************************************************
+    subroutine output_hdf5_3D(name, data, compress)
 !
 !  Write HDF5 dataset from a distributed 3D array.
+!  With compress, a new dataset is compressed as selected by snap_compression.
 !
 !  17-Oct-2018/PABourdin: coded
 !
       character (len=*), intent(in) :: name
       real, dimension (:,:,:), intent(in) :: data
+      logical, optional, intent(in) :: compress
 !
       integer(kind=8), dimension (n_dims) :: h5_stride, h5_count
       integer, parameter :: n = n_dims
+      integer(HID_T) :: h5_dcpl
 !
       if (.not. lcollective) &
         call check_error (1, '3D array output requires global file', name, caller='output_hdf5_3D')
@@ -1736,8 +1785,10 @@ module HDF5_IO
         call check_error (h5_err, 'open dataset', name)
       else
         ! create the dataset
-        call h5dcreate_f (h5_file, trim (name), h5_ntype, h5_fspace, h5_dset, h5_err)
+        h5_dcpl = compression_plist (name, n, loptest (compress))
+        call h5dcreate_f (h5_file, trim (name), h5_ntype, h5_fspace, h5_dset, h5_err, dcpl_id=h5_dcpl)
         call check_error (h5_err, 'create dataset', name)
+        if (h5_dcpl /= H5P_DEFAULT_F) call h5pclose_f (h5_dcpl, h5_err)
       endif
       call h5sclose_f (h5_fspace, h5_err)
       call check_error (h5_err, 'close global file space', name)
@@ -1789,7 +1840,7 @@ module HDF5_IO
       logical, optional, intent(in) :: compress
 !
       integer(kind=8), dimension (n_dims+1) :: h5_stride, h5_count
-      integer(kind=8), dimension(4), parameter :: chunk_dims=(/128,128,128,128/)
+      integer(HID_T) :: h5_dcpl
 !
       if (.not. lcollective) &
         call check_error (1, '4D array output requires global file', name, caller='output_hdf5_4D')
@@ -1806,11 +1857,6 @@ module HDF5_IO
       ! define 'memory-space' to indicate the local data portion in memory
       call h5screate_simple_f (n_dims+1, local_size, h5_mspace, h5_err)
       call check_error (h5_err, 'create local memory space', name)
-
-      if (loptest(compress)) then     ! not yet tested
-        call h5pset_chunk_f(h5_plist, 4, chunk_dims, h5_err)
-        call h5pset_deflate_f(h5_plist, 6, h5_err)
-      endif
 !
       if (exists_in_hdf5 (name)) then
         ! open dataset
@@ -1818,8 +1864,10 @@ module HDF5_IO
         call check_error (h5_err, 'open dataset', name)
       else
         ! create the dataset
-        call h5dcreate_f (h5_file, trim (name), h5_ntype, h5_fspace, h5_dset, h5_err)
+        h5_dcpl = compression_plist (name, n_dims+1, loptest (compress))
+        call h5dcreate_f (h5_file, trim (name), h5_ntype, h5_fspace, h5_dset, h5_err, dcpl_id=h5_dcpl)
         call check_error (h5_err, 'create dataset', name)
+        if (h5_dcpl /= H5P_DEFAULT_F) call h5pclose_f (h5_dcpl, h5_err)
       endif
       call h5sclose_f (h5_fspace, h5_err)
       call check_error (h5_err, 'close global file space', name)
@@ -2443,6 +2491,12 @@ module HDF5_IO
       call file_close_hdf5
 !
     endsubroutine input_slice_arr
+!***********************************************************************
+    subroutine hdf5_flush_slices
+!
+!  Nothing to do: the slices are written at once by the plane communicators.
+!
+    endsubroutine hdf5_flush_slices
 !***********************************************************************
     subroutine hdf5_output_slice(lwrite, time, label, suffix, pos, grid_pos, data)
 !
@@ -897,6 +897,7 @@ module Hydro
   real, dimension (my) :: prof_amp4
   real, dimension (nz,3) :: uumz_prof
   real, dimension (nx,3) :: fint,fext
+  !$omp threadprivate(Fmax,frict,fint,fext)
   real, dimension (nx,ny) :: omega_prof
 
   integer :: enum_friction_tdep = 0
@@ -2115,7 +2115,7 @@ module Interstellar
 !  relevant subroutines in entropy.f90
 !
       use General, only: touch_file
-      use Gpu, only: load_farray_to_GPU
+      use Gpu, only: load_farray_to_GPU, mark_farray_dirty_GPU
 !
       real, dimension(mx,my,mz,mfarray) :: f
 !
@@ -2168,7 +2168,12 @@ module Interstellar
             endif
           enddo
           call check_SNI(f,l_SNI)
-          if (lgpu.and.l_SNI) call load_farray_to_GPU(f)
+          if (lgpu.and.l_SNI) then
+            call mark_farray_dirty_GPU(1,mvar)
+            call mark_farray_dirty_GPU(iyH)
+            if (ilnTT/=0) call mark_farray_dirty_GPU(ilnTT)
+            call load_farray_to_GPU(f)
+          endif
           if (t>=tmax) then
             if (lroot) print*,'check_SN: sn_series.in list needs extending or set lSN_list=F to continue'
           endif
@@ -2187,7 +2192,16 @@ module Interstellar
             call check_SNII(f,l_SNI)
           endif
         endif
-        if (lgpu.and.l_SNI) call load_farray_to_GPU(f)
+!
+!  Explosions only change the evolved variables, the ionization fraction and
+!  the temperature (an auxiliary with entropy), so only these need to be uploaded.
+!
+        if (lgpu.and.l_SNI) then
+          call mark_farray_dirty_GPU(1,mvar)
+          call mark_farray_dirty_GPU(iyH)
+          if (ilnTT/=0) call mark_farray_dirty_GPU(ilnTT)
+          call load_farray_to_GPU(f)
+        endif
       endif
 !
     endsubroutine check_SN
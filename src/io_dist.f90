@@ -14,6 +14,10 @@
 !  10-Dec-2011/Bourdin.KIS: major cleanup
 !  01-Jun-2015/Bourdin.KIS: outlog removed to see clear-text error messages
 !
+!  With one file per process, startup on many thousands of ranks is limited
+!  by the file system metadata servers. For such runs use IO=io_mpi2 (one
+!  file, collective MPI_FILE_READ_ALL/WRITE_ALL) or IO=io_hdf5 instead.
+!
 module Io
 !
   use Cdata
@@ -61,6 +65,15 @@ module Io
   character (len=labellen) :: IO_strategy="dist"
 !
   integer :: persist_last_id=-max_int
+!
+!  With lsnap_async, the data record of a snapshot is copied to snap_async_buf
+!  and written by a separate thread, together with the remaining records, which
+!  are first written to snap_async_file//'.tail'; see output_snap_finalize.
+!
+  real, dimension (:,:,:,:), allocatable :: snap_async_buf
+  character (len=fnlen) :: snap_async_file=''
+  integer :: snap_async_handle=-1
+  logical :: lsnap_async_open=.false.
 !
   contains
 !***********************************************************************
@@ -81,6 +94,8 @@ module Io
     endsubroutine register_io
 !***********************************************************************
     subroutine finalize_io
+!
+      call wait_snap_async
 !
     endsubroutine finalize_io
 !***********************************************************************
@@ -119,6 +134,7 @@ module Io
       use Mpicomm, only: start_serialize, end_serialize
       use General, only: get_range_no, ioptest, safe_character_assign, itoa, upper_case
       use FArrayManager, only: farray_get_name
+      use GPU, only: lsnap_from_GPU, write_snapshot_from_GPU
 !
       real, dimension (:,:,:,:),  intent(IN) :: a
       integer,           optional,intent(IN) :: nv1,nv2
@@ -130,18 +146,45 @@ module Io
       character (len=fnlen) :: file1, file2
       character (len=30) :: vname, vnm
       logical, save :: lcalled_ast=.false.
+      logical :: lfrom_GPU, lasync
 !
       t_sp = real(t)
 !
       if (lserial_io) call start_serialize
-      if (present(file)) then
-        call delete_file(trim(directory_snap)//'/'//file)
-        open (lun_output, FILE=trim(directory_snap)//'/'//file, FORM='unformatted', status='new')
-      endif
-
       na=ioptest(nv1,1)
       ne=ioptest(nv2,mvar_io)
       if (lroot .and. (ip <= 8)) print *, 'output_snap: nv1,nv2 =', na,ne
+!
+!  With lsnap_from_GPU, the data record f(:,:,:,1:ne) is written from device memory,
+!  the remaining records are appended to it.
+!
+      lfrom_GPU=lsnap_from_GPU .and. present(file) .and. na==1 .and. .not.(lwrite_2d .or. lastaroth_output)
+!
+!  With lsnap_async, the previous snapshot has to be complete before the next one
+!  is started. Its data record (gfortran markers allow < 2 GiB) is written later,
+!  the file being replaced only then.
+!
+      lasync=lsnap_async .and. present(file) .and. .not.(lfrom_GPU .or. lwrite_2d .or. lastaroth_output .or. lserial_io)
+      if (lasync) lasync=storage_size(a)/8*(size(a,kind=ikind8)/size(a,4))*(ne-na+1) < 2_ikind8**31-1
+      if (lsnap_async) call wait_snap_async
+      if (lasync) then
+        call safe_character_assign(snap_async_file,trim(directory_snap)//'/'//file)
+        open (lun_output, FILE=trim(snap_async_file)//'.tail', FORM='unformatted', status='replace')
+        if (allocated(snap_async_buf)) then
+          if (any(shape(snap_async_buf)/=shape(a(:,:,:,na:ne)))) deallocate(snap_async_buf)
+        endif
+        if (.not.allocated(snap_async_buf)) allocate(snap_async_buf(size(a,1),size(a,2),size(a,3),ne-na+1))
+        snap_async_buf=a(:,:,:,na:ne)
+        lsnap_async_open=.true.
+      elseif (present(file)) then
+        call delete_file(trim(directory_snap)//'/'//file)
+        if (lfrom_GPU) then
+          call write_snapshot_from_GPU(trim(directory_snap)//'/'//file,ne)
+          open (lun_output, FILE=trim(directory_snap)//'/'//file, FORM='unformatted', status='old', position='append')
+        else
+          open (lun_output, FILE=trim(directory_snap)//'/'//file, FORM='unformatted', status='new')
+        endif
+      endif
 !
       if (lwrite_2d) then
         if (nx == 1) then
@@ -194,7 +237,16 @@ module Io
             j = j+ncomps
           enddo
         endif
-        write (lun_output) a(:,:,:,na:ne)
+        if (.not.(lfrom_GPU.or.lasync)) write (lun_output) a(:,:,:,na:ne)
+      endif
+!
+!  A sidecar left from an earlier write would not match the new data, also if
+!  this run does not use checksums, so it is always removed.
+!
+      if (present(file)) then
+        call delete_file(trim(directory_snap)//'/'//trim(file)//'.crc')
+        if (lsnap_checksum.and..not.(lwrite_2d.or.lfrom_GPU)) &
+          call write_snap_checksums(trim(directory_snap)//'/'//trim(file)//'.crc',a,na,ne)
       endif
 !
 !  Write shear at the end of x,y,z,dx,dy,dz.
@@ -212,6 +264,28 @@ module Io
       if (lode) call output_ode(file)
 !
     endsubroutine output_snap
+!***********************************************************************
+    subroutine write_snap_checksums(file,a,na,ne)
+!
+!  Writes the CRC-32C of each variable na..ne of the data record of a snapshot,
+!  which read_snap verifies with lsnap_checksum. Snapshots written from device
+!  memory get none, as the host copy of their data may be outdated.
+!
+      use Syscalls, only: crc32c
+!
+      character (len=*),          intent(IN) :: file
+      real, dimension (:,:,:,:),  intent(IN) :: a
+      integer,                    intent(IN) :: na, ne
+!
+      integer :: j
+!
+      open (lun_output+1, FILE=file, status='replace')
+      do j=na,ne
+        write (lun_output+1,'(i5,1x,z8.8)') j, crc32c(a(:,:,:,j))
+      enddo
+      close (lun_output+1)
+!
+    endsubroutine write_snap_checksums
 !***********************************************************************
     subroutine output_snap_finalize
 !
@@ -228,10 +302,43 @@ module Io
       endif
 !
       close (lun_output)
+!
+      if (lsnap_async_open) then
+        call start_snap_async
+        lsnap_async_open=.false.
+      endif
 !
       if (lserial_io) call end_serialize
 !
     endsubroutine output_snap_finalize
+!***********************************************************************
+    subroutine start_snap_async
+!
+!  Hands the data record in snap_async_buf and the remaining records of the
+!  snapshot to a writer thread, or writes them at once if none is available.
+!
+      use Syscalls, only: write_snapshot_file
+!
+      integer(KIND=ikind8) :: bytes, result
+!
+      bytes=storage_size(snap_async_buf)/8*size(snap_async_buf,kind=ikind8)
+      result=write_snapshot_file(snap_async_file,trim(snap_async_file)//'.tail',bytes,snap_async_buf,snap_async_handle)
+      if (result<0) call fatal_error('start_snap_async','could not write '//trim(snap_async_file))
+!
+    endsubroutine start_snap_async
+!***********************************************************************
+    subroutine wait_snap_async
+!
+!  Completes the snapshot being written by a writer thread, if any.
+!
+      use Syscalls, only: wait_binary_file
+!
+      if (snap_async_handle<0) return
+      if (wait_binary_file(snap_async_handle)<0) &
+        call fatal_error('wait_snap_async','could not write '//trim(snap_async_file))
+      snap_async_handle=-1
+!
+    endsubroutine wait_snap_async
 !***********************************************************************
     subroutine output_average_2D(label, nc, name, data, time, lwrite, header)
 !
@@ -723,7 +830,7 @@ module Io
       use Mpicomm, only: start_serialize, end_serialize, mpibcast, mpibcast_real, mpiallreduce_or, &
                          stop_it, mpiallreduce_min, mpiallreduce_max, MPI_COMM_PENCIL, &
                          mpisend_char, mpirecv_char, mpiallreduce_and
-      use Syscalls, only: islink, system_cmd, readlink, extract_str
+      use Syscalls, only: islink, system_cmd, readlink, extract_str, crc32c
       use General, only: itoa, find_proc, atoi
 !
       character (len=*), intent(in) :: file
@@ -760,7 +867,7 @@ module Io
       use Mpicomm, only: start_serialize, end_serialize, mpibcast, mpibcast_real, mpiallreduce_or, &
                          stop_it, mpiallreduce_min, mpiallreduce_max, MPI_COMM_PENCIL, &
                          mpisend_char, mpirecv_char,mpiallreduce_and
-      use Syscalls, only: islink, system_cmd, readlink, extract_str
+      use Syscalls, only: islink, system_cmd, readlink, extract_str, crc32c
       use General, only: itoa, find_proc, atoi
 !
       character (len=*), intent(in) :: file
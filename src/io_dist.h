@@ -5,7 +5,8 @@
       real :: t_test   ! t in single precision for backwards compatibility
       logical :: ltest,lok,lok_glob,l0,lmail,lmail_
       integer :: len1d,ios,iosr,ii,iia,jj,kk,iip,ind,ind1,kka,kke,jja,jje,iie
-      integer :: nprocz_src, nzgrid_src, mz_src, ipz_src
+      integer :: nprocz_src, nzgrid_src, mz_src, ipz_src, jvar
+      integer(KIND=ikind8) :: crc_file
       character(LEN=fnlen) :: readdir, srcdir
       character(LEN=linelen) :: message
       character(LEN=1024) :: mailstr
@@ -227,6 +228,33 @@ iloop:    do ii=iia,iie
                 l0=.false.
                 cycle iloop
               endif
+!
+!  Compare the variables with the checksums written by output_snap; a mismatch
+!  counts as an unreadable file, so with lrepair_snap a neighbouring snapshot is tried.
+!
+              if (lsnap_checksum .and. nghost_read_fewer==0 .and. ivar_omit(1)<=0 .and. &
+                  .not.(lwrite_2d .or. lzaver_on_input)) then
+                open (lun_input1, FILE=trim(readdir)//'/'//trim(file)//'.crc', status='old', iostat=ios)
+                if (ios==0) then
+                  iosr=0
+                  do
+                    read (lun_input1,'(i5,1x,z8)',iostat=ios) jvar, crc_file
+                    if (ios/=0) exit
+                    if (jvar<1 .or. jvar>nv) cycle
+                    if (crc32c(a(:,:,:,jvar))/=crc_file) then
+                      call warning('read_snap', 'checksum mismatch of variable '//trim(itoa(jvar))// &
+                                   ' in '//trim(readdir)//'/'//trim(file), iproc)
+                      iosr=1
+                    endif
+                  enddo
+                  close(lun_input1)
+                  if (iosr/=0) then
+                    close(lun_input)
+                    l0=.false.
+                    cycle iloop
+                  endif
+                endif
+              endif
               lok=.true.
               if (.not.l0) then
                 message=' reading '//trim(readdir)//'/'//trim(file)// &
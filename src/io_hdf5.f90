@@ -181,7 +181,7 @@ module Io
         do pos=na,ne
           group=index_get(pos)
           if (group == '') cycle
-          call output_hdf5 ('data/'//trim(group), a(:,:,:,pos))
+          call output_hdf5 ('data/'//trim(group), a(:,:,:,pos), compress=(dataset == 'f'))
         enddo
       elseif (dataset == 'globals') then
         if (.not. present (nv1)) &
@@ -1115,8 +1115,8 @@ module Magnetic
 !
   real, dimension(nx) :: eta_total=0.,eta_smag=0.,Fmax,dAmax,ssmax, &
                          diffus_eta=0.,diffus_eta2=0.,diffus_eta3=0.
-  !$omp threadprivate(eta_total)
   real, dimension(nx,3) :: fres,forcing_rhs
+  !$omp threadprivate(eta_total,eta_smag,Fmax,dAmax,ssmax,diffus_eta,diffus_eta2,diffus_eta3,fres,forcing_rhs)
   real, dimension(nzgrid) :: eta_zgrid=0.0
   real, dimension(mz) :: feta_ztdep=0.0
   real :: eta_shock_jump1=1.0, eta_tdep=0.0, Arms=0.0
@@ -119,6 +119,149 @@ FTNIZE(getmortonrank)(const int* x, const int* y, const int* z, const int* decom
 	return getPid((int3){*x,*y,*z}, (uint3_64){(uint64_t)*decomp_x,(uint64_t)*decomp_y,(uint64_t)*decomp_z});
 }
 
+/*
+ * Generalized Hilbert ("gilbert") curve through a process grid of arbitrary extents,
+ * after J. Cervený, https://github.com/jakubcerveny/gilbert. For power-of-two grids it is the
+ * classical Hilbert curve; otherwise consecutive ranks are still neighbours except for a few
+ * diagonal steps where an odd extent has to be split. Unlike the Morton order it has no
+ * large jumps at octant boundaries.
+ *
+ * The curve is tabulated once per process grid: coords[rank] and ranks[x+nx*(y+ny*z)].
+ */
+typedef struct {
+    int nx, ny, nz;
+    int3* coords;
+    int*  ranks;
+    int   count;
+} HilbertTable;
+
+static HilbertTable hilbert_table = {0, 0, 0, NULL, NULL, 0};
+
+static inline int
+sgn(const int v)
+{
+    return (v > 0) - (v < 0);
+}
+
+static inline int
+half(const int v)
+{
+    // floor(v/2), also for negative v
+    return v >= 0 ? v / 2 : -((1 - v) / 2);
+}
+
+static void
+hilbertVisit(HilbertTable* t, const int x, const int y, const int z)
+{
+    t->ranks[x + t->nx * (y + t->ny * z)] = t->count;
+    t->coords[t->count++] = (int3){x, y, z};
+}
+
+// Walks the cuboid spanned from (x,y,z) by the major axis a and the orthogonal axes b and c.
+static void
+hilbertGenerate(HilbertTable* t, int x, int y, int z, const int ax, const int ay, const int az,
+                const int bx, const int by, const int bz, const int cx, const int cy, const int cz)
+{
+    const int w = abs(ax + ay + az), h = abs(bx + by + bz), d = abs(cx + cy + cz);
+    const int dax = sgn(ax), day = sgn(ay), daz = sgn(az);
+    const int dbx = sgn(bx), dby = sgn(by), dbz = sgn(bz);
+    const int dcx = sgn(cx), dcy = sgn(cy), dcz = sgn(cz);
+
+    // Straight lines
+    if (h == 1 && d == 1) {
+        for (int i = 0; i < w; ++i, x += dax, y += day, z += daz) hilbertVisit(t, x, y, z);
+        return;
+    }
+    if (w == 1 && d == 1) {
+        for (int i = 0; i < h; ++i, x += dbx, y += dby, z += dbz) hilbertVisit(t, x, y, z);
+        return;
+    }
+    if (w == 1 && h == 1) {
+        for (int i = 0; i < d; ++i, x += dcx, y += dcy, z += dcz) hilbertVisit(t, x, y, z);
+        return;
+    }
+
+    int ax2 = half(ax), ay2 = half(ay), az2 = half(az);
+    int bx2 = half(bx), by2 = half(by), bz2 = half(bz);
+    int cx2 = half(cx), cy2 = half(cy), cz2 = half(cz);
+
+    // Prefer even halves, so that the sub-curves can be joined by unit steps
+    if ((abs(ax2 + ay2 + az2) % 2) && w > 2) { ax2 += dax; ay2 += day; az2 += daz; }
+    if ((abs(bx2 + by2 + bz2) % 2) && h > 2) { bx2 += dbx; by2 += dby; bz2 += dbz; }
+    if ((abs(cx2 + cy2 + cz2) % 2) && d > 2) { cx2 += dcx; cy2 += dcy; cz2 += dcz; }
+
+    if (2 * w > 3 * h && 2 * w > 3 * d) {
+        // Long in a: split only a
+        hilbertGenerate(t, x, y, z, ax2, ay2, az2, bx, by, bz, cx, cy, cz);
+        hilbertGenerate(t, x + ax2, y + ay2, z + az2, ax - ax2, ay - ay2, az - az2, bx, by, bz, cx, cy, cz);
+    }
+    else if (3 * h > 4 * d) {
+        // Do not split c
+        hilbertGenerate(t, x, y, z, bx2, by2, bz2, cx, cy, cz, ax2, ay2, az2);
+        hilbertGenerate(t, x + bx2, y + by2, z + bz2, ax, ay, az, bx - bx2, by - by2, bz - bz2, cx, cy, cz);
+        hilbertGenerate(t, x + (ax - dax) + (bx2 - dbx), y + (ay - day) + (by2 - dby), z + (az - daz) + (bz2 - dbz),
+                        -bx2, -by2, -bz2, cx, cy, cz, -(ax - ax2), -(ay - ay2), -(az - az2));
+    }
+    else if (3 * d > 4 * h) {
+        // Do not split b
+        hilbertGenerate(t, x, y, z, cx2, cy2, cz2, ax2, ay2, az2, bx, by, bz);
+        hilbertGenerate(t, x + cx2, y + cy2, z + cz2, ax, ay, az, bx, by, bz, cx - cx2, cy - cy2, cz - cz2);
+        hilbertGenerate(t, x + (ax - dax) + (cx2 - dcx), y + (ay - day) + (cy2 - dcy), z + (az - daz) + (cz2 - dcz),
+                        -cx2, -cy2, -cz2, -(ax - ax2), -(ay - ay2), -(az - az2), bx, by, bz);
+    }
+    else {
+        // Split all three axes
+        hilbertGenerate(t, x, y, z, bx2, by2, bz2, cx2, cy2, cz2, ax2, ay2, az2);
+        hilbertGenerate(t, x + bx2, y + by2, z + bz2, cx, cy, cz, ax2, ay2, az2, bx - bx2, by - by2, bz - bz2);
+        hilbertGenerate(t, x + (bx2 - dbx) + (cx - dcx), y + (by2 - dby) + (cy - dcy), z + (bz2 - dbz) + (cz - dcz),
+                        ax, ay, az, -bx2, -by2, -bz2, -(cx - cx2), -(cy - cy2), -(cz - cz2));
+        hilbertGenerate(t, x + (ax - dax) + bx2 + (cx - dcx), y + (ay - day) + by2 + (cy - dcy),
+                        z + (az - daz) + bz2 + (cz - dcz),
+                        -cx, -cy, -cz, -(ax - ax2), -(ay - ay2), -(az - az2), bx - bx2, by - by2, bz - bz2);
+        hilbertGenerate(t, x + (ax - dax) + (bx2 - dbx), y + (ay - day) + (by2 - dby), z + (az - daz) + (bz2 - dbz),
+                        -bx2, -by2, -bz2, cx2, cy2, cz2, -(ax - ax2), -(ay - ay2), -(az - az2));
+    }
+}
+
+static const HilbertTable*
+hilbertTable(const int nx, const int ny, const int nz)
+{
+    // The mapping is set up before any threads are started, so the table is not protected.
+    HilbertTable* t = &hilbert_table;
+    if (t->coords != NULL && t->nx == nx && t->ny == ny && t->nz == nz) return t;
+
+    free(t->coords);
+    free(t->ranks);
+    const size_t n = (size_t)nx * ny * nz;
+    *t = (HilbertTable){nx, ny, nz, malloc(n * sizeof(int3)), malloc(n * sizeof(int)), 0};
+    if (t->coords == NULL || t->ranks == NULL) {
+        fprintf(stderr, "hilbertTable: could not allocate the table for %d x %d x %d processes\n", nx, ny, nz);
+        exit(EXIT_FAILURE);
+    }
+    // Start along the longest axis
+    if (nx >= ny && nx >= nz)
+        hilbertGenerate(t, 0, 0, 0, nx, 0, 0, 0, ny, 0, 0, 0, nz);
+    else if (ny >= nx && ny >= nz)
+        hilbertGenerate(t, 0, 0, 0, 0, ny, 0, nx, 0, 0, 0, 0, nz);
+    else
+        hilbertGenerate(t, 0, 0, 0, 0, 0, nz, nx, 0, 0, 0, ny, 0);
+    return t;
+}
+
+int3
+FTNIZE(gethilbertrank3d)(const int* pid, const int* decomp_x, const int* decomp_y, const int* decomp_z)
+{
+    return hilbertTable(*decomp_x, *decomp_y, *decomp_z)->coords[*pid];
+}
+
+int
+FTNIZE(gethilbertrank)(const int* x, const int* y, const int* z, const int* decomp_x, const int* decomp_y, const int* decomp_z)
+{
+    const uint3_64 pid = wrap((int3){*x, *y, *z}, (uint3_64){(uint64_t)*decomp_x, (uint64_t)*decomp_y, (uint64_t)*decomp_z});
+    const HilbertTable* t = hilbertTable(*decomp_x, *decomp_y, *decomp_z);
+    return t->ranks[pid.x + t->nx * (pid.y + t->ny * pid.z)];
+}
+
 /**
 int main(int argc, char* argv[])
 {
@@ -52,6 +52,7 @@ module Mpicomm
   use Cdata
   use General, only: find_proc, ioptest,loptest
   use Yinyang
+  use iso_c_binding, only: c_ptr, c_null_ptr, c_f_pointer
 !
   implicit none
 !
@@ -77,10 +78,14 @@ module Mpicomm
 !  For f-array processor boundaries
 !
   real, dimension (:,:,:,:), allocatable :: lbufxi,ubufxi,lbufxo,ubufxo
-  real, dimension (:,:,:,:), allocatable :: lbufyi,ubufyi,lbufyo,ubufyo
-  real, dimension (:,:,:,:), allocatable :: lbufzi,ubufzi,lbufzo,ubufzo
+  real, dimension (:,:,:,:), allocatable :: lbufyi,ubufyi,lbufzi,ubufzi
   real, dimension (:,:,:,:), allocatable :: llbufi,lubufi,uubufi,ulbufi
-  real, dimension (:,:,:,:), allocatable :: llbufo,lubufo,uubufo,ulbufo
+!
+!  Pointers, as they are moved into a node-shared window with lshared_mem_halos;
+!  contiguous, as their elements are passed to MPI as start of the message.
+!
+  real, dimension (:,:,:,:), pointer, contiguous :: lbufyo=>null(),ubufyo=>null(),lbufzo=>null(),ubufzo=>null()
+  real, dimension (:,:,:,:), pointer, contiguous :: llbufo=>null(),lubufo=>null(),uubufo=>null(),ulbufo=>null()
   integer, dimension(4,2) :: bufsizes_yz
   integer, dimension(2,4,2) :: bufsizes_yz_corn
   integer, parameter :: INYU=1, INZU=2, INYL=3, INZL=4
@@ -121,6 +126,38 @@ module Mpicomm
   integer :: isend_rq_tolowz,isend_rq_touppz,irecv_rq_fromlowz,irecv_rq_fromuppz
   integer :: isend_rq_TOll,isend_rq_TOul,isend_rq_TOuu,isend_rq_TOlu  !(corners)
   integer :: irecv_rq_FRuu,irecv_rq_FRlu,irecv_rq_FRll,irecv_rq_FRul  !(corners)
+!
+!  Persistent requests of initiate_isendrcv_bdry: faces and corners for up to
+!  max_bdry_ranges different (ivar1,ivar2,size(f,1)), see post_bdry, and for
+!  either half of the shared window holding the send buffers.
+!
+  integer, parameter :: max_bdry_ranges=4, nbdry_rq=16
+  integer, dimension(3,max_bdry_ranges) :: bdry_ranges=0
+  integer, dimension(nbdry_rq,max_bdry_ranges,0:1) :: bdry_rq=MPI_REQUEST_NULL
+  integer :: nbdry_ranges=0, ibdry_range=0
+!
+!  Intra-node halo exchange through shared memory (lshared_mem_halos), see setup_shared_halos:
+!  per request slot the node rank of the partner (-1: not on this node) and
+!  its window segment, the offset, shape and size per variable of the send buffer
+!  in either half of the segment, the number of elements still to be copied, and
+!  the half in use.
+!
+  logical :: lshared_halos=.false., lshared_halos_done=.false.
+  integer :: comm_halo_node=MPI_COMM_NULL, win_halo=MPI_WIN_NULL, halo_elsize=0, halo_nelem_win=0
+  integer :: ihalo_half=0
+  integer, dimension(nbdry_rq) :: halo_node_rank=-1, halo_offset=0, halo_nelem_var=0, halo_pending=0
+  integer, dimension(4,nbdry_rq) :: halo_shape=0
+  real, dimension(:), pointer :: halo_win_seg=>null()
+  type(c_ptr), dimension(nbdry_rq) :: halo_peer_base=c_null_ptr
+  integer, dimension(nbdry_rq), parameter :: halo_counterpart=(/4,0,2,0,8,0,6,0,14,0,16,0,10,0,12,0/)
+!
+!  Halo traffic of the f-array boundary exchange (lhalo_traffic), see write_halo_traffic:
+!  bytes and messages sent to partners on this node (1) and on other nodes (2),
+!  time spent waiting for the receives, and per rank of MPI_COMM_GRID the lowest rank on its node.
+!
+  real(KIND=rkind8), dimension(2) :: halo_bytes=0., halo_msgs=0.
+  real(KIND=rkind8) :: halo_wait=0.
+  integer, dimension(:), allocatable :: halo_first_on_node
   integer :: isend_rq_tolastya,isend_rq_tonextya, &
              irecv_rq_fromlastya,irecv_rq_fromnextya ! For shear
   integer :: isend_rq_tolastyb,isend_rq_tonextyb, &
@@ -137,6 +174,7 @@ module Mpicomm
   integer, dimension (MPI_STATUS_SIZE) :: irecv_stat_Fuu,irecv_stat_Flu, &
                                           irecv_stat_Fll,irecv_stat_Ful
   integer :: REAL_ARR_MAXSIZE
+  integer :: REAL_PAIR, SUM_MAX_OP     ! for mpireduce_sum_max
 !
 !  Data for Yin-Yang communication.
 !
@@ -307,6 +345,9 @@ module Mpicomm
 !
       call MPI_TYPE_CONTIGUOUS(max_int, mpi_precision, REAL_ARR_MAXSIZE, mpierr)
       call MPI_TYPE_COMMIT(REAL_ARR_MAXSIZE, mpierr)
+      call MPI_TYPE_CONTIGUOUS(2, mpi_precision, REAL_PAIR, mpierr)
+      call MPI_TYPE_COMMIT(REAL_PAIR, mpierr)
+      call MPI_OP_CREATE(sum_max_pairs, .true., SUM_MAX_OP, mpierr)
 
     endsubroutine mpicomm_init
 !***********************************************************************
@@ -400,6 +441,16 @@ module Mpicomm
         ipatch=int(iproc/ncpus)
       endif
 !
+!  Blocks of the processor grid held by one node, see find_proc_node_localty.
+!
+      if (lnode_local_mapping .and. all((/nprocx_node,nprocy_node,nprocz_node/)==0)) call find_node_blocks
+      if (any((/nprocx_node,nprocy_node,nprocz_node/)/=0)) then
+        if (any((/nprocx_node,nprocy_node,nprocz_node/)<=0)) &
+          call stop_it('initialize_mpicomm: either all or none of nproc[xyz]_node must be set')
+        if (mod(nprocx,nprocx_node)/=0 .or. mod(nprocy,nprocy_node)/=0 .or. mod(nprocz,nprocz_node)/=0) &
+          call stop_it('initialize_mpicomm: nproc[xyz]_node must divide nproc[xyz]')
+      endif
+!
 !  Position on the processor grid (WITHIN Yin or Yang grid!).
 !  x is fastest direction, z slowest (this is the default)
 !
@@ -541,6 +592,67 @@ module Mpicomm
                           MPI_COMM_YZPLANE, mpierr)
 !
     endsubroutine initialize_mpicomm
+!***********************************************************************
+    subroutine find_node_blocks
+!
+!  Sets nproc[xyz]_node such that the ranks sharing a node (memory) form a block of the
+!  processor grid with the smallest surface towards the other nodes, so that most of the
+!  halo exchange stays within the node. Requires all nodes to hold the same number of
+!  ranks and the launcher to place consecutive ranks on the same node; otherwise the
+!  mapping is left unchanged.
+!
+      integer :: comm_node, nprocs_node, rank_node, first_on_node, nmin, nmax
+      integer :: px, py, pz
+      logical :: lcontiguous, lall_contiguous
+      real :: surface, surface_min
+!
+      call MPI_COMM_SPLIT_TYPE(MPI_COMM_GRID, MPI_COMM_TYPE_SHARED, iproc, MPI_INFO_NULL, comm_node, mpierr)
+      call MPI_COMM_SIZE(comm_node, nprocs_node, mpierr)
+      call MPI_COMM_RANK(comm_node, rank_node, mpierr)
+      call MPI_ALLREDUCE(iproc, first_on_node, 1, MPI_INTEGER, MPI_MIN, comm_node, mpierr)
+      call MPI_COMM_FREE(comm_node, mpierr)
+!
+      call MPI_ALLREDUCE(nprocs_node, nmin, 1, MPI_INTEGER, MPI_MIN, MPI_COMM_GRID, mpierr)
+      call MPI_ALLREDUCE(nprocs_node, nmax, 1, MPI_INTEGER, MPI_MAX, MPI_COMM_GRID, mpierr)
+      lcontiguous = iproc==first_on_node+rank_node .and. mod(first_on_node,nprocs_node)==0
+      call MPI_ALLREDUCE(lcontiguous, lall_contiguous, 1, MPI_LOGICAL, MPI_LAND, MPI_COMM_GRID, mpierr)
+!
+      if (nmin/=nmax .or. .not.lall_contiguous) then
+        if (lroot) print*, 'find_node_blocks: ranks not evenly and contiguously placed on nodes, '// &
+                           'keeping the processor mapping'
+        return
+      endif
+      if (nmax==1 .or. nmax==ncpus) return
+!
+!  Surface (in grid points) across which a block of px*py*pz processors exchanges halos with other nodes.
+!
+      surface_min=huge(1.)
+      do pz=1,nprocz
+        if (mod(nprocz,pz)/=0 .or. mod(nprocs_node,pz)/=0) cycle
+        do py=1,nprocy
+          if (mod(nprocy,py)/=0 .or. mod(nprocs_node,py*pz)/=0) cycle
+          px=nprocs_node/(py*pz)
+          if (px>nprocx .or. mod(nprocx,px)/=0) cycle
+          surface=0.
+          if (px<nprocx) surface=surface+real(py*ny)*real(pz*nz)
+          if (py<nprocy) surface=surface+real(px*nx)*real(pz*nz)
+          if (pz<nprocz) surface=surface+real(px*nx)*real(py*ny)
+          if (surface<surface_min) then
+            surface_min=surface
+            nprocx_node=px; nprocy_node=py; nprocz_node=pz
+          endif
+        enddo
+      enddo
+!
+      if (lroot) then
+        if (nprocx_node>0) then
+          print'(a,3i5)', 'find_node_blocks: processor block per node    =', nprocx_node, nprocy_node, nprocz_node
+        else
+          print*, 'find_node_blocks: no processor block fits ', nprocs_node, ' ranks per node, keeping the mapping'
+        endif
+      endif
+!
+    endsubroutine find_node_blocks
 !***********************************************************************
     subroutine create_communicators()
 
@@ -1500,9 +1612,28 @@ print*, 'noks_all,ngap_all,nstrip_total=', noks_all,ngap_all,nstrip_total
       if (present(ivar1_opt)) ivar1=ivar1_opt
       if (present(ivar2_opt)) ivar2=ivar2_opt
       if (ivar2==0) return
+!
+      if (lhalo_traffic.and..not.allocated(halo_first_on_node)) call setup_halo_traffic
 !
       mxl=size(f,1)
 !
+!  Without Yin-Yang grid, coarsening and communication across the poles, partners,
+!  tags, counts and buffers are the same in every call for a given range of
+!  variables, so that the requests are set up once and restarted.
+!
+      ibdry_range=0
+      if (.not.(lyinyang.or.lcoarse.or.lcommunicate_y)) ibdry_range=find_bdry_range(ivar1,ivar2,mxl)
+!
+!  With lshared_mem_halos, neighbours on the same node read the send buffers
+!  directly. They may still be reading the previous contents, so the buffers are
+!  filled in the other half of the window.
+!  All ranks have to enter here, as the setup is collective.
+!
+      if (lshared_mem_halos.and..not.(lyinyang.or.lcommunicate_y)) then
+        if (.not.lshared_halos_done) call setup_shared_halos
+        if (lshared_halos) call point_shared_halos(1-ihalo_half)
+      endif
+!
 !  Set communication across x-planes.
 !
       if (nprocx>1) call isendrcv_bdry_x(f,ivar1_opt,ivar2_opt)
@@ -1560,12 +1691,10 @@ if (notanumber(lbufyo)) print*, 'lbufyo: iproc=', iproc, iproc_world
 
         nbufy=bufact*bufsizes_yz(INYL,IRCV)
 !if (ldiagnos.and.lfirst.and.iproc_world==0) print*, iproc_world, ' receives', bufsizes_yz(INYL,IRCV), ' from', ylneigh
-        call MPI_IRECV(lbufyi(:,:,:,ivar1:ivar2),nbufy,mpi_precision, &
-                       ylneigh,touppyr,comm,irecv_rq_fromlowy,mpierr)
+        call post_bdry(lbufyi(1,1,1,ivar1),nbufy,ylneigh,touppyr,comm,.false.,1,irecv_rq_fromlowy)
 
         nbufy=bufact*bufsizes_yz(INYL,ISND)
-        call MPI_ISEND(lbufyo(:,:,:,ivar1:ivar2),nbufy,mpi_precision, &
-                       ylneigh,tolowys,comm,isend_rq_tolowy,mpierr)
+        call post_bdry(lbufyo(:,:,:,ivar1:ivar2),nbufy,ylneigh,tolowys,comm,.true.,2,isend_rq_tolowy)
 
         if (lyinyang.and.llast_proc_y) then
 !
@@ -1590,12 +1719,10 @@ if (notanumber(ubufyo)) print*, 'ubufyo: iproc=', iproc, iproc_world
         endif
 !
         nbufy=bufact*bufsizes_yz(INYU,IRCV)
-        call MPI_IRECV(ubufyi(:,:,:,ivar1:ivar2),nbufy,mpi_precision, &
-                       yuneigh,tolowyr,comm,irecv_rq_fromuppy,mpierr)
+        call post_bdry(ubufyi(1,1,1,ivar1),nbufy,yuneigh,tolowyr,comm,.false.,3,irecv_rq_fromuppy)
 
         nbufy=bufact*bufsizes_yz(INYU,ISND)
-        call MPI_ISEND(ubufyo(:,:,:,ivar1:ivar2),nbufy,mpi_precision, &
-                       yuneigh,touppys,comm,isend_rq_touppy,mpierr)
+        call post_bdry(ubufyo(:,:,:,ivar1:ivar2),nbufy,yuneigh,touppys,comm,.true.,4,isend_rq_touppy)
       endif
 !
 !  Set communication across z-planes.
@@ -1626,12 +1753,10 @@ if (notanumber(ubufyo)) print*, 'ubufyo: iproc=', iproc, iproc_world
 
         nbufz=bufact*bufsizes_yz(INZL,IRCV)
 !if (ldiagnos.and.lfirst.and.iproc_world==0) print*, iproc_world, ' receives', bufsizes_yz(INZL,IRCV), ' from', zlneigh
-        call MPI_IRECV(lbufzi(:,:,:,ivar1:ivar2),nbufz,mpi_precision, &
-                       zlneigh,touppzr,comm,irecv_rq_fromlowz,mpierr)
+        call post_bdry(lbufzi(1,1,1,ivar1),nbufz,zlneigh,touppzr,comm,.false.,5,irecv_rq_fromlowz)
 
         nbufz=bufact*bufsizes_yz(INZL,ISND)
-        call MPI_ISEND(lbufzo(:,:,:,ivar1:ivar2),nbufz,mpi_precision, &
-                       zlneigh,tolowzs,comm,isend_rq_tolowz,mpierr)
+        call post_bdry(lbufzo(:,:,:,ivar1:ivar2),nbufz,zlneigh,tolowzs,comm,.true.,6,isend_rq_tolowz)
 !
         if (lyinyang.and.llast_proc_z) then
 !
@@ -1656,12 +1781,10 @@ if (notanumber(ubufyo)) print*, 'ubufyo: iproc=', iproc, iproc_world
         endif
 
         nbufz=bufact*bufsizes_yz(INZU,IRCV)
-        call MPI_IRECV(ubufzi(:,:,:,ivar1:ivar2),nbufz,mpi_precision, &
-                       zuneigh,tolowzr,comm,irecv_rq_fromuppz,mpierr)
+        call post_bdry(ubufzi(1,1,1,ivar1),nbufz,zuneigh,tolowzr,comm,.false.,7,irecv_rq_fromuppz)
 
         nbufz=bufact*bufsizes_yz(INZU,ISND)
-        call MPI_ISEND(ubufzo(:,:,:,ivar1:ivar2),nbufz,mpi_precision, &
-                       zuneigh,touppzs,comm,isend_rq_touppz,mpierr)
+        call post_bdry(ubufzo(:,:,:,ivar1:ivar2),nbufz,zuneigh,touppzs,comm,.true.,8,isend_rq_touppz)
 !do j=ivar1,ivar2
 !if (notanumber(ubufzo(:,:,:,j))) print*, 'ubufzo: iproc,j=', iproc,j
 !if (notanumber(lbufzo(:,:,:,:))) print*, 'lbufzo: iproc,j=', iproc
@@ -1746,12 +1869,10 @@ if (notanumber(ubufyo)) print*, 'ubufyo: iproc=', iproc, iproc_world
         endif
 
         nbufyz=bufact*product(bufsizes_yz_corn(:,INLL,IRCV))
-        if (llcornr>=0) call MPI_IRECV(llbufi(:,:,:,ivar1:ivar2),nbufyz,mpi_precision, &
-                                       llcornr,TOuur,comm,irecv_rq_FRll,mpierr)
+        if (llcornr>=0) call post_bdry(llbufi(1,1,1,ivar1),nbufyz,llcornr,TOuur,comm,.false.,9,irecv_rq_FRll)
 
         nbufyz=bufact*product(bufsizes_yz_corn(:,INLL,ISND))
-        if (llcorns>=0) call MPI_ISEND(llbufo(:,:,:,ivar1:ivar2),nbufyz,mpi_precision, &
-                                       llcorns,TOlls,comm,isend_rq_TOll,mpierr)
+        if (llcorns>=0) call post_bdry(llbufo(:,:,:,ivar1:ivar2),nbufyz,llcorns,TOlls,comm,.true.,10,isend_rq_TOll)
 !
 !  Upper y, lower z.
 !
@@ -1779,12 +1900,10 @@ if (notanumber(ubufyo)) print*, 'ubufyo: iproc=', iproc, iproc_world
         nbufyz=bufact*product(bufsizes_yz_corn(:,INUL,IRCV))
 ! if (ldiagnos.and.lfirst.and.iproc_world==0) print*, iproc_world, ' receives', bufsizes_yz_corn(:,INUL,IRCV), &
 !' from', ulcornr
-        if (ulcornr>=0) call MPI_IRECV(ulbufi(:,:,:,ivar1:ivar2),nbufyz,mpi_precision, &
-                                       ulcornr,TOlur,comm,irecv_rq_FRul,mpierr)
+        if (ulcornr>=0) call post_bdry(ulbufi(1,1,1,ivar1),nbufyz,ulcornr,TOlur,comm,.false.,11,irecv_rq_FRul)
 
         nbufyz=bufact*product(bufsizes_yz_corn(:,INUL,ISND))
-        if (ulcorns>=0) call MPI_ISEND(ulbufo(:,:,:,ivar1:ivar2),nbufyz,mpi_precision, &
-                                       ulcorns,TOuls,comm,isend_rq_TOul,mpierr)
+        if (ulcorns>=0) call post_bdry(ulbufo(:,:,:,ivar1:ivar2),nbufyz,ulcorns,TOuls,comm,.true.,12,isend_rq_TOul)
 !
 !  Upper y, upper z.
 !
@@ -1808,12 +1927,10 @@ if (notanumber(ubufyo)) print*, 'ubufyo: iproc=', iproc, iproc_world
         endif
 
         nbufyz=bufact*product(bufsizes_yz_corn(:,INUU,IRCV))
-        if (uucornr>=0) call MPI_IRECV(uubufi(:,:,:,ivar1:ivar2),nbufyz,mpi_precision, &
-                                       uucornr,TOllr,comm,irecv_rq_FRuu,mpierr)
+        if (uucornr>=0) call post_bdry(uubufi(1,1,1,ivar1),nbufyz,uucornr,TOllr,comm,.false.,13,irecv_rq_FRuu)
 
         nbufyz=bufact*product(bufsizes_yz_corn(:,INUU,ISND))
-        if (uucorns>=0) call MPI_ISEND(uubufo(:,:,:,ivar1:ivar2),nbufyz,mpi_precision, &
-                                       uucorns,TOuus,comm,isend_rq_TOuu,mpierr)
+        if (uucorns>=0) call post_bdry(uubufo(:,:,:,ivar1:ivar2),nbufyz,uucorns,TOuus,comm,.true.,14,isend_rq_TOuu)
 !
 !  Lower y, upper z.
 !
@@ -1839,12 +1956,10 @@ if (notanumber(ubufyo)) print*, 'ubufyo: iproc=', iproc, iproc_world
         nbufyz=bufact*product(bufsizes_yz_corn(:,INLU,IRCV))
 !if (ldiagnos.and.lfirst.and.iproc_world==0) print*, iproc_world, ' receives', bufsizes_yz_corn(:,INLU,IRCV), &
 !' from', lucornr
-        if (lucornr>=0) call MPI_IRECV(lubufi(:,:,:,ivar1:ivar2),nbufyz,mpi_precision, &
-                                       lucornr,TOulr,comm,irecv_rq_FRlu,mpierr)
+        if (lucornr>=0) call post_bdry(lubufi(1,1,1,ivar1),nbufyz,lucornr,TOulr,comm,.false.,15,irecv_rq_FRlu)
 
         nbufyz=bufact*product(bufsizes_yz_corn(:,INLU,ISND))
-        if (lucorns>=0) call MPI_ISEND(lubufo(:,:,:,ivar1:ivar2),nbufyz,mpi_precision, &
-                                       lucorns,TOlus,comm,isend_rq_TOlu,mpierr)
+        if (lucorns>=0) call post_bdry(lubufo(:,:,:,ivar1:ivar2),nbufyz,lucorns,TOlus,comm,.true.,16,isend_rq_TOlu)
 !
       endif
 !if (itsub>=3.and.it>116) write(78,*) 'after corner comm it,itsub,iproc=', &
@@ -1857,6 +1972,333 @@ if (notanumber(ubufyo)) print*, 'ubufyo: iproc=', iproc, iproc_world
 !       print*,'initiate_isendrcv_bdry: MPICOMM send lu: ',iproc,lubufo(nx/2+4,:,1,2),' to ',lucorn
 !
     endsubroutine initiate_isendrcv_bdry
+!***********************************************************************
+    integer function find_bdry_range(ivar1,ivar2,mxl)
+!
+!  Slot of the persistent requests for variables ivar1:ivar2 of an f-array with
+!  x extent mxl, a new one if not yet used; 0 if all are taken.
+!
+      integer, intent(in) :: ivar1,ivar2,mxl
+!
+      integer :: i
+!
+      do i=1,nbdry_ranges
+        if (all(bdry_ranges(:,i)==(/ivar1,ivar2,mxl/))) then
+          find_bdry_range=i
+          return
+        endif
+      enddo
+!
+      if (nbdry_ranges<max_bdry_ranges) then
+        nbdry_ranges=nbdry_ranges+1
+        bdry_ranges(:,nbdry_ranges)=(/ivar1,ivar2,mxl/)
+        find_bdry_range=nbdry_ranges
+      else
+        find_bdry_range=0
+      endif
+!
+    endfunction find_bdry_range
+!***********************************************************************
+    subroutine post_bdry(buf,count,peer,tag,comm,lsend,islot,request)
+!
+!  Posts the receive (lsend=F) or send of count elements from buf for
+!  initiate_isendrcv_bdry. For a cached range of variables (ibdry_range>0) the
+!  persistent request islot is created on first use and restarted afterwards;
+!  finalize_isendrcv_bdry completes it by MPI_WAIT as it does a nonpersistent one.
+!  buf must never be a temporary copy, as a persistent request keeps its address:
+!  the receive buffers are passed as their first element, the send buffers, being
+!  pointers, as a section over the last dimension only, which is contiguous by their
+!  contiguous attribute (gfortran -Warray-temporaries reports no copy for them).
+!
+      real, dimension(*) :: buf
+      integer, intent(in) :: count,peer,tag,comm,islot
+      logical, intent(in) :: lsend
+      integer, intent(out) :: request
+!
+      if (lhalo_traffic.and.lsend) call count_halo_traffic(count,peer,comm)
+!
+!  A partner on the same node exchanges through the shared window: nothing to
+!  send, the receive is done by get_shared_halos.
+!
+      if (lshared_halos) then
+        if (halo_node_rank(islot)>=0) then
+          if (.not.lsend) halo_pending(islot)=count
+          request=MPI_REQUEST_NULL
+          return
+        endif
+      endif
+!
+      if (ibdry_range>0) then
+        if (bdry_rq(islot,ibdry_range,ihalo_half)==MPI_REQUEST_NULL) then
+          if (lsend) then
+            call MPI_SEND_INIT(buf,count,mpi_precision,peer,tag,comm,bdry_rq(islot,ibdry_range,ihalo_half),mpierr)
+          else
+            call MPI_RECV_INIT(buf,count,mpi_precision,peer,tag,comm,bdry_rq(islot,ibdry_range,ihalo_half),mpierr)
+          endif
+        endif
+        request=bdry_rq(islot,ibdry_range,ihalo_half)
+        call MPI_START(request,mpierr)
+      elseif (lsend) then
+        call MPI_ISEND(buf,count,mpi_precision,peer,tag,comm,request,mpierr)
+      else
+        call MPI_IRECV(buf,count,mpi_precision,peer,tag,comm,request,mpierr)
+      endif
+!
+    endsubroutine post_bdry
+!***********************************************************************
+    subroutine setup_shared_halos
+!
+!  Moves the send buffers of the y and z halo exchange into an MPI-3 shared-memory
+!  window of the ranks on this node. A neighbour on the same node then copies
+!  its halo directly from there in finalize_isendrcv_bdry instead of receiving
+!  a message; neighbours on other nodes are served by MPI as before.
+!  Collective on all ranks, called in the first initiate_isendrcv_bdry.
+!  Not used if any rank coarsens the grid (lcoarse is set per rank), as the
+!  buffers and partners of those ranks change from call to call.
+!
+      integer, dimension(nbdry_rq) :: partners
+      logical, dimension(nbdry_rq) :: lused
+      logical :: lcoarse_any
+      integer :: grid_group, node_group, disp_unit, nelem, nlocal, nnode, i
+      integer(KIND=MPI_ADDRESS_KIND) :: peer_size
+      type(c_ptr) :: base
+!
+      lshared_halos_done=.true.
+      call mpiallreduce_or(lcoarse, lcoarse_any)
+      if (lcoarse_any) then
+        if (lroot) print*, 'setup_shared_halos: lshared_mem_halos is ignored with grid coarsening'
+        lshared_halos=.false.
+        return
+      endif
+      call MPI_COMM_SPLIT_TYPE(MPI_COMM_GRID, MPI_COMM_TYPE_SHARED, iproc, MPI_INFO_NULL, comm_halo_node, mpierr)
+      call MPI_TYPE_SIZE(mpi_precision, halo_elsize, mpierr)
+!
+!  Offsets of the send buffers in the window, in the order of their request slots.
+!  All ranks have the same buffer shapes, hence the same layout of their segments.
+!
+      nelem=0; lused=.false.
+      call size_send_buffer(lbufyo,2); call size_send_buffer(ubufyo,4)
+      call size_send_buffer(lbufzo,6); call size_send_buffer(ubufzo,8)
+      call size_send_buffer(llbufo,10); call size_send_buffer(ulbufo,12)
+      call size_send_buffer(uubufo,14); call size_send_buffer(lubufo,16)
+!
+!  The window holds two copies of them, used in alternate exchanges.
+!
+      halo_nelem_win=nelem
+      call MPI_WIN_ALLOCATE_SHARED(2*int(nelem,MPI_ADDRESS_KIND)*halo_elsize, halo_elsize, MPI_INFO_NULL, &
+                                   comm_halo_node, base, win_halo, mpierr)
+      if (nelem>0) call c_f_pointer(base,halo_win_seg,(/2*nelem/))
+      call free_send_buffer(lbufyo); call free_send_buffer(ubufyo)
+      call free_send_buffer(lbufzo); call free_send_buffer(ubufzo)
+      call free_send_buffer(llbufo); call free_send_buffer(ulbufo)
+      call free_send_buffer(uubufo); call free_send_buffer(lubufo)
+      call point_shared_halos(0)
+      call MPI_WIN_LOCK_ALL(MPI_MODE_NOCHECK, win_halo, mpierr)
+!
+!  Node ranks of the partners and the start of their segments.
+!
+      partners=(/ylneigh,ylneigh,yuneigh,yuneigh,zlneigh,zlneigh,zuneigh,zuneigh, &
+                 llcornr,llcorns,ulcornr,ulcorns,uucornr,uucorns,lucornr,lucorns/)
+      call MPI_COMM_GROUP(MPI_COMM_GRID, grid_group, mpierr)
+      call MPI_COMM_GROUP(comm_halo_node, node_group, mpierr)
+      halo_node_rank=-1
+      do i=1,nbdry_rq
+        if (.not.lused(i) .or. partners(i)<0) cycle
+        call MPI_GROUP_TRANSLATE_RANKS(grid_group, 1, partners(i), node_group, halo_node_rank(i), mpierr)
+        if (halo_node_rank(i)==MPI_UNDEFINED) then
+          halo_node_rank(i)=-1
+        elseif (halo_counterpart(i)>0) then
+          call MPI_WIN_SHARED_QUERY(win_halo, halo_node_rank(i), peer_size, disp_unit, halo_peer_base(i), mpierr)
+        endif
+      enddo
+      call MPI_GROUP_FREE(grid_group, mpierr)
+      call MPI_GROUP_FREE(node_group, mpierr)
+!
+!  The synchronization is collective on the node, so all of its ranks take part
+!  if any of them has a neighbour on it.
+!
+      nlocal=count(halo_node_rank>=0)
+      call MPI_ALLREDUCE(nlocal, nnode, 1, MPI_INTEGER, MPI_MAX, comm_halo_node, mpierr)
+      lshared_halos = nnode>0
+      halo_pending=0
+!
+      contains
+!
+      subroutine size_send_buffer(buf,islot)
+!
+        real, dimension(:,:,:,:), pointer, contiguous :: buf
+        integer, intent(in) :: islot
+!
+        if (.not.associated(buf)) return
+        halo_offset(islot)=nelem
+        halo_shape(:,islot)=shape(buf)
+        halo_nelem_var(islot)=size(buf)/size(buf,4)
+        nelem=nelem+size(buf)
+        lused(islot-1:islot)=.true.
+!
+      endsubroutine size_send_buffer
+!
+      subroutine free_send_buffer(buf)
+!
+        real, dimension(:,:,:,:), pointer, contiguous :: buf
+!
+        if (associated(buf)) deallocate(buf)
+!
+      endsubroutine free_send_buffer
+!
+    endsubroutine setup_shared_halos
+!***********************************************************************
+    subroutine point_shared_halos(ihalf)
+!
+!  Points the send buffers of the y and z halo exchange to half ihalf of the
+!  shared window. A rank fills one half while its neighbours may still copy from
+!  the other, so that one synchronization per exchange, in get_shared_halos,
+!  suffices: a rank returns to a half only after all ranks of the node have
+!  passed that synchronization, i.e. finished reading it.
+!
+      integer, intent(in) :: ihalf
+!
+      ihalo_half=ihalf
+      call point_send_buffer(lbufyo,2); call point_send_buffer(ubufyo,4)
+      call point_send_buffer(lbufzo,6); call point_send_buffer(ubufzo,8)
+      call point_send_buffer(llbufo,10); call point_send_buffer(ulbufo,12)
+      call point_send_buffer(uubufo,14); call point_send_buffer(lubufo,16)
+!
+      contains
+!
+      subroutine point_send_buffer(buf,islot)
+!
+        real, dimension(:,:,:,:), pointer, contiguous :: buf
+        integer, intent(in) :: islot
+!
+        integer, dimension(4) :: shp
+        integer :: i0
+!
+        shp=halo_shape(:,islot)
+        if (product(shp)==0) return
+        i0=ihalo_half*halo_nelem_win+halo_offset(islot)
+        buf(1:shp(1),1:shp(2),1:shp(3),1:shp(4)) => halo_win_seg(i0+1:i0+product(shp))
+!
+      endsubroutine point_send_buffer
+!
+    endsubroutine point_shared_halos
+!***********************************************************************
+    subroutine sync_shared_halos
+!
+!  Makes the stores of all ranks of the node to the shared send buffers visible
+!  to the others.
+!
+      call MPI_WIN_SYNC(win_halo, mpierr)
+      call MPI_BARRIER(comm_halo_node, mpierr)
+      call MPI_WIN_SYNC(win_halo, mpierr)
+!
+    endsubroutine sync_shared_halos
+!***********************************************************************
+    subroutine get_shared_halos(ivar1)
+!
+!  Copies the halos posted by post_bdry for partners on the same node from
+!  their send buffers in the shared window into the receive buffers.
+!
+      integer, intent(in) :: ivar1
+!
+      real, dimension(:), pointer :: peer_seg, src
+      integer :: i, j, i0
+!
+      call sync_shared_halos
+      do i=1,nbdry_rq
+        if (halo_pending(i)==0) cycle
+        j=halo_counterpart(i)
+        call c_f_pointer(halo_peer_base(i),peer_seg,(/2*halo_nelem_win/))
+        i0=ihalo_half*halo_nelem_win+halo_offset(j)+(ivar1-1)*halo_nelem_var(j)
+        src => peer_seg(i0+1:i0+halo_pending(i))
+        select case (i)
+          case (1); call copy_shared_halo(lbufyi(1,1,1,ivar1),src,halo_pending(i))
+          case (3); call copy_shared_halo(ubufyi(1,1,1,ivar1),src,halo_pending(i))
+          case (5); call copy_shared_halo(lbufzi(1,1,1,ivar1),src,halo_pending(i))
+          case (7); call copy_shared_halo(ubufzi(1,1,1,ivar1),src,halo_pending(i))
+          case (9); call copy_shared_halo(llbufi(1,1,1,ivar1),src,halo_pending(i))
+          case (11); call copy_shared_halo(ulbufi(1,1,1,ivar1),src,halo_pending(i))
+          case (13); call copy_shared_halo(uubufi(1,1,1,ivar1),src,halo_pending(i))
+          case (15); call copy_shared_halo(lubufi(1,1,1,ivar1),src,halo_pending(i))
+        endselect
+        halo_pending(i)=0
+      enddo
+!
+    endsubroutine get_shared_halos
+!***********************************************************************
+    subroutine copy_shared_halo(buf,src,count)
+!
+      integer, intent(in) :: count
+      real, dimension(*) :: buf
+      real, dimension(count), intent(in) :: src
+!
+      buf(1:count)=src
+!
+    endsubroutine copy_shared_halo
+!***********************************************************************
+    subroutine setup_halo_traffic
+!
+!  Finds for every rank of MPI_COMM_GRID the lowest rank on its node, by which
+!  count_halo_traffic tells partners on this node from those on others.
+!  Collective, called in the first initiate_isendrcv_bdry.
+!
+      integer :: comm_node, first_on_node
+!
+      call MPI_COMM_SPLIT_TYPE(MPI_COMM_GRID, MPI_COMM_TYPE_SHARED, iproc, MPI_INFO_NULL, comm_node, mpierr)
+      call MPI_ALLREDUCE(iproc, first_on_node, 1, MPI_INTEGER, MPI_MIN, comm_node, mpierr)
+      call MPI_COMM_FREE(comm_node, mpierr)
+      allocate(halo_first_on_node(0:ncpus-1))
+      call MPI_ALLGATHER(first_on_node, 1, MPI_INTEGER, halo_first_on_node, 1, MPI_INTEGER, MPI_COMM_GRID, mpierr)
+      call MPI_TYPE_SIZE(mpi_precision, halo_elsize, mpierr)
+!
+    endsubroutine setup_halo_traffic
+!***********************************************************************
+    subroutine count_halo_traffic(count,peer,comm)
+!
+!  Adds a message of count elements to peer to the halo traffic. Partners in
+!  MPI_COMM_PENCIL (the other grid of a Yin-Yang run) count as on other nodes.
+!
+      integer, intent(in) :: count,peer,comm
+!
+      integer :: inode
+!
+      inode=2
+      if (comm==MPI_COMM_GRID) then
+        if (halo_first_on_node(peer)==halo_first_on_node(iproc)) inode=1
+      endif
+      halo_bytes(inode)=halo_bytes(inode)+real(count,rkind8)*halo_elsize
+      halo_msgs(inode)=halo_msgs(inode)+1.
+!
+    endsubroutine count_halo_traffic
+!***********************************************************************
+    subroutine write_halo_traffic(file)
+!
+!  Writes the halo traffic accumulated since the start of the run, one line per rank.
+!  Partners on the same node served through the shared window (lshared_mem_halos)
+!  count as messages on this node.
+!
+      character (len=*), intent(in) :: file
+!
+      integer, parameter :: lun_halo=92
+      real(KIND=rkind8), dimension(5) :: traffic
+      real(KIND=rkind8), dimension(5,0:ncpus-1) :: traffic_all
+      integer :: i
+!
+      if (.not.allocated(halo_first_on_node)) call setup_halo_traffic
+      traffic=(/halo_bytes(1),halo_msgs(1),halo_bytes(2),halo_msgs(2),halo_wait/)
+      call MPI_GATHER(traffic, 5, MPI_DOUBLE_PRECISION, traffic_all, 5, MPI_DOUBLE_PRECISION, root, MPI_COMM_GRID, mpierr)
+      if (.not.lroot) return
+!
+      open(lun_halo,file=file,status='replace')
+      write(lun_halo,'(a)') '# rank  node  bytes_on_node  msgs_on_node  bytes_off_node  msgs_off_node' // &
+                            '  mean_msg_bytes  recv_wait[s]'
+      do i=0,ncpus-1
+        write(lun_halo,'(2i6,1p,6e15.6)') i, halo_first_on_node(i), traffic_all(1:4,i), &
+            (traffic_all(1,i)+traffic_all(3,i))/max(traffic_all(2,i)+traffic_all(4,i),1._rkind8), traffic_all(5,i)
+      enddo
+      close(lun_halo)
+!
+    endsubroutine write_halo_traffic
 !***********************************************************************
     subroutine finalize_isendrcv_bdry(f,ivar1_opt,ivar2_opt)
 !
@@ -1876,11 +2318,16 @@ if (notanumber(ubufyo)) print*, 'ubufyo: iproc=', iproc, iproc_world
       integer, optional,                 intent(in)   :: ivar1_opt, ivar2_opt
 !
       integer :: ivar1, ivar2, j
+      real(KIND=rkind8) :: twait
 !
       ivar1=1; ivar2=min(mcom,size(f,4))
       if (present(ivar1_opt)) ivar1=ivar1_opt
       if (present(ivar2_opt)) ivar2=ivar2_opt
       if (ivar2==0) return
+!
+      if (lhalo_traffic) twait=mpiwtime()
+      if (lshared_halos) call get_shared_halos(ivar1)
+      if (lhalo_traffic) halo_wait=halo_wait+mpiwtime()-twait
 !
 !  1. wait until data received
 !  2. set ghost zones
@@ -1890,8 +2337,10 @@ if (notanumber(ubufyo)) print*, 'ubufyo: iproc=', iproc, iproc_world
 !
       if (nprocy>1.or.lyinyang) then
 
+        if (lhalo_traffic) twait=mpiwtime()
         call MPI_WAIT(irecv_rq_fromuppy,irecv_stat_fu,mpierr)
         call MPI_WAIT(irecv_rq_fromlowy,irecv_stat_fl,mpierr)
+        if (lhalo_traffic) halo_wait=halo_wait+mpiwtime()-twait
 
         do j=ivar1,ivar2
 
@@ -1976,8 +2425,10 @@ if (notanumber(ubufyi(:,:,mz+1:,j))) print*, 'ubufyi(mz+1:): iproc,j=', iproc, i
 !
       if (nprocz>1) then
 
+        if (lhalo_traffic) twait=mpiwtime()
         call MPI_WAIT(irecv_rq_fromuppz,irecv_stat_fu,mpierr)
         call MPI_WAIT(irecv_rq_fromlowz,irecv_stat_fl,mpierr)
+        if (lhalo_traffic) halo_wait=halo_wait+mpiwtime()-twait
 
         do j=ivar1,ivar2
 
@@ -2040,10 +2491,12 @@ if (notanumber(ubufyi(:,:,mz+1:,j))) print*, 'ubufyi(mz+1:): iproc,j=', iproc, i
 !
        if (nprocz>1.and.(nprocy>1.or.lyinyang)) then
 
+        if (lhalo_traffic) twait=mpiwtime()
         if (uucornr>=0) call MPI_WAIT(irecv_rq_FRuu,irecv_stat_Fuu,mpierr)
         if (lucornr>=0) call MPI_WAIT(irecv_rq_FRlu,irecv_stat_Flu,mpierr)
         if (llcornr>=0) call MPI_WAIT(irecv_rq_FRll,irecv_stat_Fll,mpierr)
         if (ulcornr>=0) call MPI_WAIT(irecv_rq_FRul,irecv_stat_Ful,mpierr)
+        if (lhalo_traffic) halo_wait=halo_wait+mpiwtime()-twait
 
         do j=ivar1,ivar2
 !
@@ -2215,6 +2668,7 @@ if (notanumber(ubufyi(:,:,mz+1:,j))) print*, 'ubufyi(mz+1:): iproc,j=', iproc, i
       integer, intent(in), optional :: ivar1_opt, ivar2_opt
 !
       integer :: ivar1, ivar2, nbufx, j
+      real(KIND=rkind8) :: twait
 !
       ivar1=1; ivar2=min(mcom,size(f,4))
       if (present(ivar1_opt)) ivar1=ivar1_opt
@@ -2234,8 +2688,14 @@ if (notanumber(ubufyi(:,:,mz+1:,j))) print*, 'ubufyi(mz+1:): iproc,j=', iproc, i
             xlneigh,tolowx,MPI_COMM_GRID,isend_rq_tolowx,mpierr)
         call MPI_ISEND(ubufxo(:,:,:,ivar1:ivar2),nbufx,mpi_precision, &
             xuneigh,touppx,MPI_COMM_GRID,isend_rq_touppx,mpierr)
+        if (lhalo_traffic) then
+          call count_halo_traffic(nbufx,xlneigh,MPI_COMM_GRID)
+          call count_halo_traffic(nbufx,xuneigh,MPI_COMM_GRID)
+          twait=mpiwtime()
+        endif
         call MPI_WAIT(irecv_rq_fromuppx,irecv_stat_fu,mpierr)
         call MPI_WAIT(irecv_rq_fromlowx,irecv_stat_fl,mpierr)
+        if (lhalo_traffic) halo_wait=halo_wait+mpiwtime()-twait
 !
 !  Inner communication or (shear-)periodic boundary conditions in x
 !  MR: Communication should only happen under these conditions.
@@ -4900,6 +5360,52 @@ if (notanumber(ubufyi(:,:,mz+1:,j))) print*, 'ubufyi(mz+1:): iproc,j=', iproc, i
                       ioptest(comm,MPI_COMM_GRID), mpierr)
 !
     endsubroutine mpireduce_max_arr
+!***********************************************************************
+    subroutine sum_max_pairs(vec1, vec2, n, type)
+!
+!  Helper function for mpireduce_sum_max: the pairs (value,kind) are
+!  summed for kind=0 and maximized for kind=1.
+!
+      integer,              intent(in)    :: n, type
+      real, dimension(2,n), intent(in)    :: vec1
+      real, dimension(2,n), intent(inout) :: vec2
+!
+      where (vec2(2,:)==0.)
+        vec2(1,:)=vec2(1,:)+vec1(1,:)
+      elsewhere
+        vec2(1,:)=max(vec2(1,:),vec1(1,:))
+      endwhere
+!
+      if (ALWAYS_FALSE) print *,type
+!
+    endsubroutine sum_max_pairs
+!***********************************************************************
+    subroutine mpireduce_sum_max(fsum_tmp,fsum,nsum,fmax_tmp,fmax,nmax,comm)
+!
+!  Calculate the total sum of fsum_tmp and the total maximum of fmax_tmp
+!  for each array element and return them to root. Both are done by a
+!  single reduction, so the latency is paid only once, e.g. for the
+!  diagnostics of every it1-th step.
+!
+      integer :: nsum, nmax
+      real, dimension(nsum) :: fsum_tmp,fsum
+      real, dimension(nmax) :: fmax_tmp,fmax
+      integer, optional :: comm
+!
+      real, dimension(2,nsum+nmax) :: buf, recvbuf
+!
+      if (nsum+nmax==0) return
+!
+      buf(1,:nsum)=fsum_tmp; buf(2,:nsum)=0.
+      buf(1,nsum+1:)=fmax_tmp; buf(2,nsum+1:)=1.
+!
+      call MPI_REDUCE(buf, recvbuf, nsum+nmax, REAL_PAIR, SUM_MAX_OP, root, &
+                      ioptest(comm,MPI_COMM_GRID), mpierr)
+!
+      fsum=recvbuf(1,:nsum)
+      fmax=recvbuf(1,nsum+1:)
+!
+    endsubroutine mpireduce_sum_max
 !***********************************************************************
     subroutine mpireduce_min_scl(fmin_tmp,fmin,comm)
 !
@@ -5317,8 +5823,38 @@ if (notanumber(ubufyi(:,:,mz+1:,j))) print*, 'ubufyi(mz+1:): iproc,j=', iproc, i
       call MPI_BARRIER(ioptest(comm,MPI_COMM_PENCIL), mpierr)
 !
     endsubroutine mpibarrier
+!***********************************************************************
+    integer function mpi_io_info(naggregators)
+!
+!  MPI-IO hints for collective writes through naggregators writer ranks
+!  (collective buffering); MPI_INFO_NULL, i.e. the defaults, if naggregators<=0.
+!  To be released by mpi_free_info.
+!
+      integer, intent(IN) :: naggregators
+!
+      character(len=16) :: str
+!
+      mpi_io_info=MPI_INFO_NULL
+      if (naggregators<=0) return
+
+      write(str,'(i0)') min(naggregators,nprocs)
+      call MPI_INFO_CREATE(mpi_io_info, mpierr)
+      call MPI_INFO_SET(mpi_io_info, 'romio_cb_write', 'enable', mpierr)
+      call MPI_INFO_SET(mpi_io_info, 'cb_nodes', trim(str), mpierr)
+!
+    endfunction mpi_io_info
+!***********************************************************************
+    subroutine mpi_free_info(info)
+!
+      integer, intent(INOUT) :: info
+!
+      if (info/=MPI_INFO_NULL) call MPI_INFO_FREE(info, mpierr)
+!
+    endsubroutine mpi_free_info
 !***********************************************************************
     subroutine mpifinalize
+!
+      integer :: i,j,k
 !
 !  Send stop signal to foreign code.
 !
@@ -5326,6 +5862,20 @@ if (notanumber(ubufyi(:,:,mz+1:,j))) print*, 'ubufyi(mz+1:): iproc,j=', iproc, i
         call MPI_SEND(.true.,1,MPI_LOGICAL,frgn_setup%root,tag_foreign,MPI_COMM_WORLD,mpierr)
 
       call MPI_TYPE_FREE(REAL_ARR_MAXSIZE, mpierr)
+      call MPI_TYPE_FREE(REAL_PAIR, mpierr)
+      call MPI_OP_FREE(SUM_MAX_OP, mpierr)
+      do k=0,1
+        do i=1,nbdry_ranges
+          do j=1,nbdry_rq
+            if (bdry_rq(j,i,k)/=MPI_REQUEST_NULL) call MPI_REQUEST_FREE(bdry_rq(j,i,k),mpierr)
+          enddo
+        enddo
+      enddo
+      if (win_halo/=MPI_WIN_NULL) then
+        call MPI_WIN_UNLOCK_ALL(win_halo, mpierr)
+        call MPI_WIN_FREE(win_halo, mpierr)
+        call MPI_COMM_FREE(comm_halo_node, mpierr)
+      endif
 
       call MPI_BARRIER(MPI_COMM_WORLD, mpierr)
       call MPI_FINALIZE(mpierr)
@@ -8427,6 +8977,43 @@ if (notanumber(ubufyi(:,:,mz+1:,j))) print*, 'ubufyi(mz+1:): iproc,j=', iproc, i
       !$omp end workshare
 !
     endsubroutine unmap_from_pencil_z_4D
+!***********************************************************************
+    subroutine exchange_boxes(send_buf, recv_buf, nbox, partners, tag, comm)
+!
+!  Sends box ibox of send_buf to partners(ibox) and receives box ibox of recv_buf
+!  from it, for all boxes at once: all receives and sends are posted before waiting,
+!  so the transfers of a transpose proceed concurrently instead of in consecutive
+!  pairwise rounds. The box of the own rank is copied.
+!  The price is memory: send_buf and recv_buf hold all boxes, so the callers
+!  allocate twice the size of the array transposed, where the pairwise rounds
+!  needed two single boxes.
+!
+      integer, dimension(0:), intent(in) :: partners
+      integer, intent(in) :: nbox, tag, comm
+      real, dimension(nbox,0:size(partners)-1), intent(in) :: send_buf
+      real, dimension(nbox,0:size(partners)-1), intent(out) :: recv_buf
+!
+      integer, dimension(2*size(partners)) :: requests
+      integer :: ibox, nreq
+!
+      nreq = 0
+      do ibox = 0, size(partners) - 1
+        if (partners(ibox) == iproc) then
+          recv_buf(:,ibox) = send_buf(:,ibox)
+        else
+          nreq = nreq + 1
+          call MPI_IRECV(recv_buf(1,ibox), nbox, mpi_precision, partners(ibox), tag, comm, requests(nreq), mpierr)
+        endif
+      enddo
+      do ibox = 0, size(partners) - 1
+        if (partners(ibox) /= iproc) then
+          nreq = nreq + 1
+          call MPI_ISEND(send_buf(1,ibox), nbox, mpi_precision, partners(ibox), tag, comm, requests(nreq), mpierr)
+        endif
+      enddo
+      call MPI_WAITALL(nreq, requests, MPI_STATUSES_IGNORE, mpierr)
+!
+    endsubroutine exchange_boxes
 !***********************************************************************
     subroutine remap_to_pencil_xy_2D(in, out,comm,lsync)
 !
@@ -8593,12 +9180,12 @@ if (notanumber(ubufyi(:,:,mz+1:,j))) print*, 'ubufyi(mz+1:): iproc,j=', iproc, i
       real, dimension(:,:,:), intent(out) :: out
 !
       integer, parameter :: bnx = nx, bny = ny / nprocx
-      integer, parameter :: ltag = 104, utag = 105
-      real, dimension(:,:,:), allocatable :: send_buf, recv_buf
-      integer, dimension(MPI_STATUS_SIZE) :: stat
+      integer, parameter :: tag = 104
+      real, dimension(:,:,:,:), allocatable :: send_buf, recv_buf
+      integer, dimension(0:nprocx-1) :: partners
       integer :: inx, iny, inz
       integer :: onx, ony, onz
-      integer :: ibox, partner, nbox, alloc_err
+      integer :: ibox, nbox, alloc_err
       integer :: ngc
       integer, optional :: comm
       logical, optional :: lsync
@@ -8646,29 +9233,23 @@ if (notanumber(ubufyi(:,:,mz+1:,j))) print*, 'ubufyi(mz+1:): iproc,j=', iproc, i
 !
 !  Allocate working arrays.
 !
-      allocate(send_buf(bnx+2*ngc,bny+2*ngc,inz), recv_buf(bnx+2*ngc,bny+2*ngc,inz), stat=alloc_err)
+      allocate(send_buf(bnx+2*ngc,bny+2*ngc,inz,0:nprocx-1), recv_buf(bnx+2*ngc,bny+2*ngc,inz,0:nprocx-1), &
+               stat=alloc_err)
       if (alloc_err > 0) call stop_fatal('remap_to_pencil_xy_3D: allocation failed. ', .true.)
 !
 !  Communicate.
+!
+      do ibox = 0, nprocx - 1
+        partners(ibox) = find_proc(ibox,ipy,ipz)
+        send_buf(:,:,:,ibox) = in(:,bny*ibox+1:bny*(ibox+1)+2*ngc,:)
+      enddo
+      call exchange_boxes(send_buf, recv_buf, nbox, partners, tag, ioptest(comm,MPI_COMM_GRID))
 !
       box: do ibox = 0, nprocx - 1
-        partner = find_proc(ibox,ipy,ipz)
-        local: if (iproc == partner) then  ! data is local
-          recv_buf = in(:,bny*ibox+1:bny*(ibox+1)+2*ngc,:)
-        else local                         ! communicate with partner
-          send_buf = in(:,bny*ibox+1:bny*(ibox+1)+2*ngc,:)
-          commun: if (iproc > partner) then  ! above diagonal: send first, receive then
-            call MPI_SEND(send_buf, nbox, mpi_precision, partner, utag, ioptest(comm,MPI_COMM_GRID), mpierr)
-            call MPI_RECV(recv_buf, nbox, mpi_precision, partner, ltag, ioptest(comm,MPI_COMM_GRID), stat, mpierr)
-          else commun                        ! below diagonal: receive first, send then
-            call MPI_RECV(recv_buf, nbox, mpi_precision, partner, utag, ioptest(comm,MPI_COMM_GRID), stat, mpierr)
-            call MPI_SEND(send_buf, nbox, mpi_precision, partner, ltag, ioptest(comm,MPI_COMM_GRID), mpierr)
-          endif commun
-        endif local
-        out(ngc+bnx*ibox+1:ngc+bnx*(ibox+1),:,:) = recv_buf(ngc+1:ngc+bnx,:,:)
+        out(ngc+bnx*ibox+1:ngc+bnx*(ibox+1),:,:) = recv_buf(ngc+1:ngc+bnx,:,:,ibox)
         ghost: if (ngc > 0) then
-          if (ibox == 0) out(1:ngc,:,:) = recv_buf(1:ngc,:,:)
-          if (ibox == nprocx - 1) out(onx-ngc+1:onx,:,:) = recv_buf(ngc+bnx+1:bnx+2*ngc,:,:)
+          if (ibox == 0) out(1:ngc,:,:) = recv_buf(1:ngc,:,:,ibox)
+          if (ibox == nprocx - 1) out(onx-ngc+1:onx,:,:) = recv_buf(ngc+bnx+1:bnx+2*ngc,:,:,ibox)
         endif ghost
       enddo box
 !
@@ -8934,12 +9515,12 @@ if (notanumber(ubufyi(:,:,mz+1:,j))) print*, 'ubufyi(mz+1:): iproc,j=', iproc, i
 !
       integer, parameter :: nypx = ny / nprocx
       integer, parameter :: bnx = nx, bny = nypx
-      integer, parameter :: ltag = 106, utag = 107
-      real, dimension(:,:,:), allocatable :: send_buf, recv_buf
-      integer, dimension(MPI_STATUS_SIZE) :: stat
+      integer, parameter :: tag = 106
+      real, dimension(:,:,:,:), allocatable :: send_buf, recv_buf
+      integer, dimension(0:nprocx-1) :: partners
       integer :: inx, iny, inz
       integer :: onx, ony, onz
-      integer :: ibox, partner, nbox, alloc_err
+      integer :: ibox, nbox, alloc_err
       integer :: ngc
       integer, optional :: comm
       logical, optional :: lsync
@@ -8987,29 +9568,23 @@ if (notanumber(ubufyi(:,:,mz+1:,j))) print*, 'ubufyi(mz+1:): iproc,j=', iproc, i
 !
 !  Allocate working arrays.
 !
-      allocate(send_buf(bnx+2*ngc,bny+2*ngc,inz), recv_buf(bnx+2*ngc,bny+2*ngc,inz), stat=alloc_err)
+      allocate(send_buf(bnx+2*ngc,bny+2*ngc,inz,0:nprocx-1), recv_buf(bnx+2*ngc,bny+2*ngc,inz,0:nprocx-1), &
+               stat=alloc_err)
       if (alloc_err > 0) call stop_fatal('unmap_from_pencil_xy_3D: allocation failed. ', .true.)
 !
 !  Communicate.
+!
+      do ibox = 0, nprocx - 1
+        partners(ibox) = find_proc(ibox,ipy,ipz)
+        send_buf(:,:,:,ibox) = in(bnx*ibox+1:bnx*(ibox+1)+2*ngc,:,:)
+      enddo
+      call exchange_boxes(send_buf, recv_buf, nbox, partners, tag, ioptest(comm,MPI_COMM_GRID))
 !
       box: do ibox = 0, nprocx - 1
-        partner = find_proc(ibox,ipy,ipz)
-        local: if (iproc == partner) then  ! data is local
-          recv_buf = in(bnx*ibox+1:bnx*(ibox+1)+2*ngc,:,:)
-        else local                         ! communicate with partner
-          send_buf = in(bnx*ibox+1:bnx*(ibox+1)+2*ngc,:,:)
-          commun: if (iproc > partner) then  ! above diagonal: send first, receive then
-            call MPI_SEND(send_buf, nbox, mpi_precision, partner, utag, ioptest(comm,MPI_COMM_GRID), mpierr)
-            call MPI_RECV(recv_buf, nbox, mpi_precision, partner, ltag, ioptest(comm,MPI_COMM_GRID), stat, mpierr)
-          else commun                        ! below diagonal: receive first, send then
-            call MPI_RECV(recv_buf, nbox, mpi_precision, partner, utag, ioptest(comm,MPI_COMM_GRID), stat, mpierr)
-            call MPI_SEND(send_buf, nbox, mpi_precision, partner, ltag, ioptest(comm,MPI_COMM_GRID), mpierr)
-          endif commun
-        endif local
-        out(:,ngc+bny*ibox+1:ngc+bny*(ibox+1),:) = recv_buf(:,ngc+1:ngc+bny,:)
+        out(:,ngc+bny*ibox+1:ngc+bny*(ibox+1),:) = recv_buf(:,ngc+1:ngc+bny,:,ibox)
         ghost: if (ngc > 0) then
-          if (ibox == 0) out(:,1:ngc,:) = recv_buf(:,1:ngc,:)
-          if (ibox == nprocx - 1) out(:,ony-ngc+1:ony,:) = recv_buf(:,ngc+bny+1:bny+2*ngc,:)
+          if (ibox == 0) out(:,1:ngc,:) = recv_buf(:,1:ngc,:,ibox)
+          if (ibox == nprocx - 1) out(:,ony-ngc+1:ony,:) = recv_buf(:,ngc+bny+1:bny+2*ngc,:,ibox)
         endif ghost
       enddo box
 !
@@ -9202,12 +9777,12 @@ if (notanumber(ubufyi(:,:,mz+1:,j))) print*, 'ubufyi(mz+1:): iproc,j=', iproc, i
       real, dimension(:,:,:), intent(out) :: out
       logical, intent(in), optional :: lghost
 !
-      integer, parameter :: ltag = 108, utag = 109
-      real, dimension(:,:,:), allocatable :: send_buf, recv_buf
-      integer, dimension(MPI_STATUS_SIZE) :: stat
+      integer, parameter :: tag = 108
+      real, dimension(:,:,:,:), allocatable :: send_buf, recv_buf
+      integer, dimension(0:nprocxy-1) :: partners
       integer :: inx, iny, inz, onx, ony, onz ! sizes of in and out arrays
       integer :: bnx, bny, nbox ! destination box sizes and number of elements
-      integer :: ibox, partner, alloc_err, iz, ngc
+      integer :: ibox, alloc_err, iz, ngc
       integer, optional :: comm
       logical, optional :: lsync
 !
@@ -9244,30 +9819,24 @@ if (notanumber(ubufyi(:,:,mz+1:,j))) print*, 'ubufyi(mz+1:): iproc,j=', iproc, i
 !
 !  Allocate working arrays.
 !
-      allocate (send_buf(bnx+2*ngc,bny+2*ngc,onz), recv_buf(bnx+2*ngc,bny+2*ngc,onz), stat=alloc_err)
+      allocate (send_buf(bnx+2*ngc,bny+2*ngc,onz,0:nprocxy-1), recv_buf(bnx+2*ngc,bny+2*ngc,onz,0:nprocxy-1), &
+                stat=alloc_err)
       if (alloc_err > 0) call stop_fatal('transp_pencil_xy_3D: allocation failed. ', .true.)
 !
 !  Communicate.
+!
+      do ibox = 0, nprocxy - 1
+        partners(ibox) = find_proc(modulo(ibox,nprocx),ibox/nprocx,ipz)
+        send_buf(:,:,:,ibox) = in(bnx*ibox+1:bnx*(ibox+1)+2*ngc,:,:)
+      enddo
+      call exchange_boxes(send_buf, recv_buf, nbox, partners, tag, ioptest(comm,MPI_COMM_GRID))
 !
       box: do ibox = 0, nprocxy - 1
-        partner = find_proc(modulo(ibox,nprocx),ibox/nprocx,ipz)
-        local: if (iproc == partner) then  ! data is local
-          recv_buf = in(bnx*ibox+1:bnx*(ibox+1)+2*ngc,:,:)
-        else local                        ! communicate with partner
-          send_buf = in(bnx*ibox+1:bnx*(ibox+1)+2*ngc,:,:)
-          if (iproc > partner) then  ! above diagonal: send first, receive then
-            call MPI_SEND(send_buf, nbox, mpi_precision, partner, utag, ioptest(comm,MPI_COMM_GRID), mpierr)
-            call MPI_RECV(recv_buf, nbox, mpi_precision, partner, ltag, ioptest(comm,MPI_COMM_GRID), stat, mpierr)
-          else
-            call MPI_RECV(recv_buf, nbox, mpi_precision, partner, utag, ioptest(comm,MPI_COMM_GRID), stat, mpierr)
-            call MPI_SEND(send_buf, nbox, mpi_precision, partner, ltag, ioptest(comm,MPI_COMM_GRID), mpierr)
-          endif
-        endif local
         do iz = 1, inz
-          out(ngc+bny*ibox+1:ngc+bny*(ibox+1),:,iz) = transpose(recv_buf(:,ngc+1:ngc+bny,iz))
+          out(ngc+bny*ibox+1:ngc+bny*(ibox+1),:,iz) = transpose(recv_buf(:,ngc+1:ngc+bny,iz,ibox))
           if (ngc > 0) then
-            if (ibox == 0) out(1:ngc,:,iz) = transpose(recv_buf(:,1:ngc,iz))
-            if (ibox == nprocxy - 1) out(onx-ngc+1:onx,:,iz) = transpose(recv_buf(:,ngc+bny+1:bny+2*ngc,iz))
+            if (ibox == 0) out(1:ngc,:,iz) = transpose(recv_buf(:,1:ngc,iz,ibox))
+            if (ibox == nprocxy - 1) out(onx-ngc+1:onx,:,iz) = transpose(recv_buf(:,ngc+bny+1:bny+2*ngc,iz,ibox))
           endif
         enddo
       enddo box
@@ -9392,11 +9961,11 @@ if (notanumber(ubufyi(:,:,mz+1:,j))) print*, 'ubufyi(mz+1:): iproc,j=', iproc, i
       integer, parameter :: ony=ny/nprocz, onz=nzgrid
       integer, parameter :: bny=ny/nprocz, bnz=nz ! transfer box sizes
       integer :: inx, onx ! sizes of in and out arrays
-      integer :: ibox, partner, nbox, alloc_err
+      integer :: ibox, nbox, alloc_err
       integer, parameter :: ytag=110
-      integer, dimension(MPI_STATUS_SIZE) :: stat
+      integer, dimension(0:nprocz-1) :: partners
 !
-      real, dimension(:,:,:), allocatable :: send_buf, recv_buf
+      real, dimension(:,:,:,:), allocatable :: send_buf, recv_buf
       integer, optional :: comm
       logical, optional :: lsync
 !
@@ -9425,29 +9994,18 @@ if (notanumber(ubufyi(:,:,mz+1:,j))) print*, 'ubufyi(mz+1:): iproc,j=', iproc, i
       if (inx /= onx) &
           call stop_fatal ('remap_to_pencil_yz_3D: inx/=onx - sizes differ in the x direction', lfirst_proc_yz)
 !
-      allocate (send_buf(onx,bny,bnz), stat=alloc_err)
+      allocate (send_buf(onx,bny,bnz,0:nprocz-1), stat=alloc_err)
       if (alloc_err > 0) call stop_fatal ('remap_to_pencil_yz_3D: not enough memory for send_buf!', .true.)
-      allocate (recv_buf(onx,bny,bnz), stat=alloc_err)
+      allocate (recv_buf(onx,bny,bnz,0:nprocz-1), stat=alloc_err)
       if (alloc_err > 0) call stop_fatal ('remap_to_pencil_yz_3D: not enough memory for recv_buf!', .true.)
 !
       do ibox = 0, nprocz-1
-        partner = find_proc(ipx,ipy,ibox)
-        if (iproc == partner) then
-          ! data is local
-          out(:,:,bnz*ibox+1:bnz*(ibox+1)) = in(:,bny*ibox+1:bny*(ibox+1),:)
-        else
-          ! communicate with partner
-          send_buf = in(:,bny*ibox+1:bny*(ibox+1),:)
-          if (iproc > partner) then ! above diagonal: send first, receive then
-            call MPI_SEND (send_buf, nbox, mpi_precision, partner, ytag, ioptest(comm,MPI_COMM_GRID), mpierr)
-            call MPI_RECV (recv_buf, nbox, mpi_precision, partner, ytag, ioptest(comm,MPI_COMM_GRID), stat, mpierr)
-          else                      ! below diagonal: receive first, send then
-            call MPI_RECV (recv_buf, nbox, mpi_precision, partner, ytag, ioptest(comm,MPI_COMM_GRID), stat, mpierr)
-            call MPI_SEND (send_buf, nbox, mpi_precision, partner, ytag, ioptest(comm,MPI_COMM_GRID), mpierr)
-          endif
-!
-          out(:,:,bnz*ibox+1:bnz*(ibox+1)) = recv_buf
-        endif
+        partners(ibox) = find_proc(ipx,ipy,ibox)
+        send_buf(:,:,:,ibox) = in(:,bny*ibox+1:bny*(ibox+1),:)
+      enddo
+      call exchange_boxes (send_buf, recv_buf, nbox, partners, ytag, ioptest(comm,MPI_COMM_GRID))
+      do ibox = 0, nprocz-1
+        out(:,:,bnz*ibox+1:bnz*(ibox+1)) = recv_buf(:,:,:,ibox)
       enddo
 !
       deallocate (send_buf, recv_buf)
@@ -9555,11 +10113,11 @@ if (notanumber(ubufyi(:,:,mz+1:,j))) print*, 'ubufyi(mz+1:): iproc,j=', iproc, i
       integer, parameter :: ony=ny, onz=nz
       integer :: inx, onx ! sizes of in and out arrays
       integer, parameter :: bny=ny/nprocz, bnz=nz ! transfer box sizes
-      integer :: ibox, partner, nbox, alloc_err
+      integer :: ibox, nbox, alloc_err
       integer, parameter :: ytag=111
-      integer, dimension(MPI_STATUS_SIZE) :: stat
+      integer, dimension(0:nprocz-1) :: partners
 !
-      real, dimension(:,:,:), allocatable :: send_buf, recv_buf
+      real, dimension(:,:,:,:), allocatable :: send_buf, recv_buf
       integer, optional :: comm
       logical, optional :: lsync
 !
@@ -9588,28 +10146,18 @@ if (notanumber(ubufyi(:,:,mz+1:,j))) print*, 'ubufyi(mz+1:): iproc,j=', iproc, i
       if (inx /= onx) &
           call stop_fatal ('unmap_from_pencil_yz_3D: inx/=onx - sizes differ in the x direction', lfirst_proc_yz)
 !
-      allocate (send_buf(onx,bny,bnz), stat=alloc_err)
+      allocate (send_buf(onx,bny,bnz,0:nprocz-1), stat=alloc_err)
       if (alloc_err > 0) call stop_fatal ('unmap_from_pencil_yz_3D: not enough memory for send_buf!', .true.)
-      allocate (recv_buf(onx,bny,bnz), stat=alloc_err)
+      allocate (recv_buf(onx,bny,bnz,0:nprocz-1), stat=alloc_err)
       if (alloc_err > 0) call stop_fatal ('unmap_from_pencil_yz_3D: not enough memory for recv_buf!', .true.)
 !
       do ibox = 0, nprocz-1
-        partner = find_proc(ipx,ipy,ibox)
-        if (iproc == partner) then
-          ! data is local
-          out(:,bny*ibox+1:bny*(ibox+1),:) = in(:,:,bnz*ibox+1:bnz*(ibox+1))
-        else
-          ! communicate with partner
-          send_buf = in(:,:,bnz*ibox+1:bnz*(ibox+1))
-          if (iproc > partner) then ! above diagonal: send first, receive then
-            call MPI_SEND (send_buf, nbox, mpi_precision, partner, ytag, ioptest(comm,MPI_COMM_GRID), mpierr)
-            call MPI_RECV (recv_buf, nbox, mpi_precision, partner, ytag, ioptest(comm,MPI_COMM_GRID), stat, mpierr)
-          else                      ! below diagonal: receive first, send then
-            call MPI_RECV (recv_buf, nbox, mpi_precision, partner, ytag, ioptest(comm,MPI_COMM_GRID), stat, mpierr)
-            call MPI_SEND (send_buf, nbox, mpi_precision, partner, ytag, ioptest(comm,MPI_COMM_GRID), mpierr)
-          endif
-          out(:,bny*ibox+1:bny*(ibox+1),:) = recv_buf
-        endif
+        partners(ibox) = find_proc(ipx,ipy,ibox)
+        send_buf(:,:,:,ibox) = in(:,:,bnz*ibox+1:bnz*(ibox+1))
+      enddo
+      call exchange_boxes (send_buf, recv_buf, nbox, partners, ytag, ioptest(comm,MPI_COMM_GRID))
+      do ibox = 0, nprocz-1
+        out(:,bny*ibox+1:bny*(ibox+1),:) = recv_buf(:,:,:,ibox)
       enddo
 !
       deallocate (send_buf, recv_buf)
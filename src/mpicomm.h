@@ -11,6 +11,7 @@
 
   public :: mpicomm_init, initialize_mpicomm, mpifinalize, yyinit
   public :: mpibarrier
+  public :: mpi_io_info, mpi_free_info
   public :: stop_it, stop_it_if_any
   public :: die_gracefully, die_immediately
   public :: check_emergency_brake
@@ -20,6 +21,8 @@
   public :: mpisendrecv_real, mpisendrecv_int
   public :: mpireduce_sum_int, mpireduce_sum             !, mpireduce_sum_double
   public :: mpireduce_max, mpireduce_max_int, mpireduce_min
+  public :: mpireduce_sum_max
+  public :: write_halo_traffic
   public :: mpiallreduce_max, mpiallreduce_min
   public :: mpiallreduce_sum, mpiallreduce_sum_int
   public :: mpiallreduce_sum_arr, mpiallreduce_sum_arr2
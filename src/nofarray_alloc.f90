@@ -9,16 +9,20 @@
 
   public :: f,df
   public :: initialize, finalize
+  public :: begin_farray_update, end_farray_update, publish_farray
 
   contains
 !***********************************************
   subroutine initialize
 
-    use Cdata, only: nt
+    use Cdata, only: nt, shared_mem_publish_name
     use Messages, only: fatal_error
 
     integer :: stat
 
+    if (shared_mem_publish_name/='') &
+      call fatal_error('farray_alloc','shared_mem_publish_name needs FARRAY_ALLOC=farray_alloc')
+
     if (nt>0.and..not.lgpu) then
       allocate(df(mx,my,mz,mvar),STAT=stat)
       if (stat>0) call fatal_error('farray_alloc','Could not allocate df')
@@ -33,5 +37,23 @@
     if (allocated(df)) deallocate(df)
 
   endsubroutine finalize
+!***********************************************
+  subroutine begin_farray_update(async_)
+
+    logical, optional :: async_
+
+  endsubroutine begin_farray_update
+!***********************************************
+  subroutine end_farray_update(async_)
+
+    logical, optional :: async_
+
+  endsubroutine end_farray_update
+!***********************************************
+  subroutine publish_farray(a)
+
+    real, dimension(mx,my,mz,mfarray) :: a
+
+  endsubroutine publish_farray
 !***********************************************
   endmodule
@@ -15,6 +15,8 @@ module GPU
 
   include 'gpu.h'
 
+  logical :: lsnap_from_GPU=.false.
+
 contains
 !***********************************************************************
     subroutine initialize_GPU(f)
@@ -107,14 +109,187 @@ contains
 
     endfunction get_ptr_GPU_training
 !**************************************************************************
-    subroutine copy_farray_from_GPU(f,nowait_)
+    subroutine copy_farray_from_GPU(f,nowait_,async_)
 
       real, dimension (:,:,:,:), intent(OUT) :: f
-      logical, optional :: nowait_
+      logical, optional :: nowait_, async_
 
       call keep_compiler_quiet(f)
 
     endsubroutine copy_farray_from_GPU
+!**************************************************************************
+    subroutine copy_slices_from_GPU(f)
+
+      real, dimension (:,:,:,:), intent(INOUT) :: f
+
+      call keep_compiler_quiet(f)
+
+    endsubroutine copy_slices_from_GPU
+!**************************************************************************
+    subroutine copy_vars_from_GPU(f,ivar1,ivar2)
+
+      real, dimension (:,:,:,:), intent(INOUT) :: f
+      integer, intent(IN) :: ivar1, ivar2
+
+      call keep_compiler_quiet(f)
+      call keep_compiler_quiet(ivar1,ivar2)
+
+    endsubroutine copy_vars_from_GPU
+!**************************************************************************
+    subroutine shear_shift_GPU(dt_shear,llast_sub)
+
+      real, intent(IN) :: dt_shear
+      logical, intent(IN) :: llast_sub
+
+      call keep_compiler_quiet(dt_shear)
+      call keep_compiler_quiet(llast_sub)
+
+    endsubroutine shear_shift_GPU
+!**************************************************************************
+    subroutine plane_sums_GPU(ivar,idir,sums,power)
+
+      integer, intent(IN) :: ivar, idir
+      real, dimension(:), intent(OUT) :: sums
+      integer, optional, intent(IN) :: power
+
+      call keep_compiler_quiet(ivar,idir)
+      call keep_compiler_quiet(sums)
+      if (present(power)) call keep_compiler_quiet(power)
+
+    endsubroutine plane_sums_GPU
+!**************************************************************************
+    logical function nonfinite_on_GPU()
+
+      nonfinite_on_GPU=.false.
+
+    endfunction nonfinite_on_GPU
+!**************************************************************************
+    subroutine save_rollback_state_GPU(f)
+
+      real, dimension (mx,my,mz,mfarray), intent(INOUT) :: f
+
+      call keep_compiler_quiet(f)
+
+    endsubroutine save_rollback_state_GPU
+!**************************************************************************
+    logical function rollback_GPU(f)
+
+      real, dimension (mx,my,mz,mfarray), intent(INOUT) :: f
+
+      call keep_compiler_quiet(f)
+      rollback_GPU=.false.
+
+    endfunction rollback_GPU
+!**************************************************************************
+    subroutine power_spectra_GPU(ivar,lcurl,kx,ky,kz,kscale,norm,spectrum,helicity)
+
+      integer, intent(IN) :: ivar
+      logical, intent(IN) :: lcurl
+      real, dimension(nx), intent(IN) :: kx
+      real, dimension(ny), intent(IN) :: ky
+      real, dimension(nz), intent(IN) :: kz
+      real, intent(IN) :: kscale, norm
+      real, dimension(:), intent(OUT) :: spectrum, helicity
+
+      call keep_compiler_quiet(ivar)
+      call keep_compiler_quiet(lcurl)
+      call keep_compiler_quiet(kx,ky,kz)
+      call keep_compiler_quiet(kscale,norm)
+      call keep_compiler_quiet(spectrum,helicity)
+
+    endsubroutine power_spectra_GPU
+!**************************************************************************
+    subroutine histogram_GPU(ivar,itransform,shift,scale,a,b,counts)
+
+      integer, intent(IN) :: ivar, itransform
+      real, intent(IN) :: shift, scale, a, b
+      integer, dimension(:), intent(OUT) :: counts
+
+      call keep_compiler_quiet(ivar,itransform)
+      call keep_compiler_quiet(shift,scale,a,b)
+      call keep_compiler_quiet(counts)
+
+    endsubroutine histogram_GPU
+!**************************************************************************
+    subroutine structure_functions_GPU(ivar,separations,sf)
+
+      integer, dimension(:), intent(IN) :: separations
+      integer, intent(IN) :: ivar
+      real, dimension(:,:), intent(OUT) :: sf
+
+      call keep_compiler_quiet(ivar)
+      call keep_compiler_quiet(separations)
+      call keep_compiler_quiet(sf)
+
+    endsubroutine structure_functions_GPU
+!**************************************************************************
+    subroutine downsample_GPU(ivar,first,step,out)
+
+      integer, intent(IN) :: ivar
+      integer, dimension(3), intent(IN) :: first, step
+      real, dimension(:,:,:), intent(OUT) :: out
+
+      call keep_compiler_quiet(ivar)
+      call keep_compiler_quiet(first,step)
+      call keep_compiler_quiet(out)
+
+    endsubroutine downsample_GPU
+!**************************************************************************
+    subroutine init_timeavgs_GPU(idx,f_tavg)
+
+      integer, dimension(:), intent(IN) :: idx
+      real, dimension(:,:,:,:), intent(IN) :: f_tavg
+
+      call keep_compiler_quiet(idx)
+      call keep_compiler_quiet(f_tavg)
+
+    endsubroutine init_timeavgs_GPU
+!**************************************************************************
+    subroutine update_timeavgs_GPU(weight)
+
+      real, intent(IN) :: weight
+
+      call keep_compiler_quiet(weight)
+
+    endsubroutine update_timeavgs_GPU
+!**************************************************************************
+    subroutine copy_timeavgs_from_GPU(f_tavg)
+
+      real, dimension(:,:,:,:), intent(OUT) :: f_tavg
+
+      call keep_compiler_quiet(f_tavg)
+
+    endsubroutine copy_timeavgs_from_GPU
+!**************************************************************************
+    subroutine finish_copy_farray_from_GPU(f)
+
+      real, dimension (:,:,:,:), intent(INOUT) :: f
+
+      call keep_compiler_quiet(f)
+
+    endsubroutine finish_copy_farray_from_GPU
+!**************************************************************************
+    logical function direct_snapshot_possible_GPU(nv)
+
+      integer, intent(IN) :: nv
+
+      call keep_compiler_quiet(nv)
+      direct_snapshot_possible_GPU=.false.
+
+    endfunction direct_snapshot_possible_GPU
+!**************************************************************************
+    subroutine write_snapshot_from_GPU(file,nv)
+
+      character(len=*), intent(IN) :: file
+      integer, intent(IN) :: nv
+
+      call keep_compiler_quiet(file)
+      call keep_compiler_quiet(nv)
+
+    endsubroutine write_snapshot_from_GPU
+!**************************************************************************
+    subroutine bind_thread_near_GPU
+    endsubroutine bind_thread_near_GPU
 !**************************************************************************
     subroutine load_farray_to_GPU(f)
 
@@ -123,6 +298,16 @@ contains
       call keep_compiler_quiet(f)
 
     endsubroutine  load_farray_to_GPU
+!**************************************************************************
+    subroutine mark_farray_dirty_GPU(ivar1,ivar2)
+
+      integer, intent(IN) :: ivar1
+      integer, optional, intent(IN) :: ivar2
+
+      call keep_compiler_quiet(ivar1)
+      if (present(ivar2)) call keep_compiler_quiet(ivar2)
+
+    endsubroutine mark_farray_dirty_GPU
 !**************************************************************************
     subroutine reload_GPU_config
 
@@ -18,6 +18,14 @@ void FTNIZE(finalize_gpu_c)()
 {
 }
 /* ------------------------------------------------------------------- */
+void FTNIZE(write_gpu_timings_c)(char *filename)
+{
+}
+/* ------------------------------------------------------------------- */
+void FTNIZE(open_dt_limiter_report_c)(char *filename)
+{
+}
+/* ------------------------------------------------------------------- */
 void FTNIZE(get_farray_ptr_gpu_c)(REAL** p_f_in)
 {
 }
@@ -42,10 +50,87 @@ void FTNIZE(copy_farray_c)(REAL* f)
 {
 }
 /* ------------------------------------------------------------------- */
+void FTNIZE(copy_slices_c)(REAL* f, FINT* planes)
+{
+}
+/* ------------------------------------------------------------------- */
+void FTNIZE(copy_vars_c)(REAL* f, FINT* ivar1, FINT* ivar2)
+{
+}
+/* ------------------------------------------------------------------- */
+void FTNIZE(plane_sums_gpu_c)(FINT* ivar, FINT* idir, FINT* power, REAL* sums)
+{
+}
+/* ------------------------------------------------------------------- */
+void FTNIZE(shear_shift_gpu_c)(REAL* dt_shear, FINT* llast)
+{
+}
+/* ------------------------------------------------------------------- */
+FINT FTNIZE(find_nonfinite_gpu_c)(FINT* pos)
+{
+  return 0;
+}
+/* ------------------------------------------------------------------- */
+void FTNIZE(power_spectra_gpu_c)(FINT* ivar, FINT* icurl, REAL* kx, REAL* ky, REAL* kz, REAL* kscale, REAL* norm,
+                                 FINT* nbins, REAL* spectrum, REAL* helicity)
+{
+}
+/* ------------------------------------------------------------------- */
+void FTNIZE(histogram_gpu_c)(FINT* ivar, FINT* itransform, REAL* shift, REAL* scale, REAL* a, REAL* b,
+                             FINT* nbins, FINT* counts)
+{
+}
+/* ------------------------------------------------------------------- */
+void FTNIZE(structure_functions_gpu_c)(FINT* ivar, FINT* separations, FINT* nsep, REAL* sf)
+{
+}
+/* ------------------------------------------------------------------- */
+void FTNIZE(downsample_gpu_c)(FINT* ivar, FINT* first, FINT* step, FINT* n, REAL* out)
+{
+}
+/* ------------------------------------------------------------------- */
+void FTNIZE(init_timeavgs_gpu_c)(FINT* ntavg, FINT* idx, REAL* f_tavg)
+{
+}
+/* ------------------------------------------------------------------- */
+void FTNIZE(update_timeavgs_gpu_c)(REAL* weight)
+{
+}
+/* ------------------------------------------------------------------- */
+void FTNIZE(copy_timeavgs_from_gpu_c)(REAL* f_tavg)
+{
+}
+/* ------------------------------------------------------------------- */
+void FTNIZE(copy_farray_async_c)()
+{
+}
+/* ------------------------------------------------------------------- */
+void FTNIZE(wait_farray_async_c)()
+{
+}
+/* ------------------------------------------------------------------- */
+FINT FTNIZE(direct_snapshot_possible_gpu_c)(FINT* nv)
+{
+  return 0;
+}
+/* ------------------------------------------------------------------- */
+FINT FTNIZE(write_snapshot_gpu_c)(char *filename, FINT* nv)
+{
+  return -1;
+}
+/* ------------------------------------------------------------------- */
+void FTNIZE(bind_thread_near_gpu_c)()
+{
+}
+/* ------------------------------------------------------------------- */
 void FTNIZE(load_farray_c)()
 {
 }
 /* ------------------------------------------------------------------- */
+void FTNIZE(mark_farray_dirty_c)(FINT *ivar1, FINT *ivar2)
+{
+}
+/* ------------------------------------------------------------------- */
 void FTNIZE(reload_gpu_config_c)()
 {
 }
@@ -15,6 +15,7 @@ DUMMY_ROUTINE(cyl_bessel_jnu)
 DUMMY_ROUTINE(cyl_bessel_ynu)
 DUMMY_ROUTINE(sp_harm_real)
 DUMMY_ROUTINE(sp_harm_imag)
+DUMMY_ROUTINE(sp_harm_grid)
 DUMMY_ROUTINE(sp_harm_real_costh)
 DUMMY_ROUTINE(sp_harm_imag_costh)
 DUMMY_ROUTINE(legendre_pl)
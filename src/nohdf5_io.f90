@@ -53,6 +53,17 @@ module HDF5_IO
   private
 !
   integer, parameter :: lun_input = 89, lun_output = 92
+!
+!  Slices of nvid_buffer video steps kept in memory, one buffer per slice file.
+!
+  type slice_buffer
+    character (len=fnlen) :: file
+    integer :: nbuf=0
+    real, dimension(:,:,:), allocatable :: data
+    real, dimension(:), allocatable :: time, pos
+  endtype slice_buffer
+!
+  type (slice_buffer), dimension(:), allocatable :: slice_buffers
 !
   contains
 !***********************************************************************
@@ -387,14 +398,16 @@ module HDF5_IO
 !
     endsubroutine output_local_hdf5_3D
 !***********************************************************************
-    subroutine output_hdf5_3D(name, data)
+    subroutine output_hdf5_3D(name, data, compress)
 !
       character (len=*), intent(in) :: name
       real, dimension (mx,my,mz), intent(in) :: data
+      logical, optional, intent(in) :: compress
 !
       call fatal_error ('output_hdf5_3D', 'You can not use HDF5 without setting an HDF5_IO module.')
       call keep_compiler_quiet(name)
       call keep_compiler_quiet(data)
+      if (present(compress)) call keep_compiler_quiet(compress)
 !
     endsubroutine output_hdf5_3D
 !***********************************************************************
@@ -689,6 +702,10 @@ module HDF5_IO
       real, intent(in) :: pos
       integer, intent(in) :: grid_pos
       real, dimension (:,:), pointer :: data
+!
+      type (slice_buffer), dimension(:), allocatable :: tmp
+      character (len=fnlen) :: file
+      integer :: ib
 !
       call keep_compiler_quiet(grid_pos)
 !
@@ -696,12 +713,73 @@ module HDF5_IO
 !
 !  files data/procN/slice*.* are distributed and will be synchronized a-posteriori on I/O error
 !
-      open (lun_output, file=trim(directory)//'/slice_'//trim(label)//'.'//trim(suffix), &
-            form='unformatted', position='append')
-      write (lun_output) data, time, pos
-      close (lun_output)
+      file=trim(directory)//'/slice_'//trim(label)//'.'//trim(suffix)
+      if (nvid_buffer<=1) then
+        open (lun_output, file=file, form='unformatted', position='append')
+        write (lun_output) data, time, pos
+        close (lun_output)
+        return
+      endif
+!
+!  Collect nvid_buffer video steps per file before appending them at once.
+!
+      if (.not.allocated(slice_buffers)) allocate(slice_buffers(0))
+      do ib=1,size(slice_buffers)
+        if (slice_buffers(ib)%file==file) exit
+      enddo
+      if (ib>size(slice_buffers)) then
+        allocate(tmp(size(slice_buffers)+1))
+        tmp(:size(slice_buffers))=slice_buffers
+        call move_alloc(tmp,slice_buffers)
+        ib=size(slice_buffers)
+        slice_buffers(ib)%file=file
+        allocate(slice_buffers(ib)%data(size(data,1),size(data,2),nvid_buffer), &
+                 slice_buffers(ib)%time(nvid_buffer),slice_buffers(ib)%pos(nvid_buffer))
+      endif
+!
+      associate (buf => slice_buffers(ib))
+        buf%nbuf=buf%nbuf+1
+        buf%data(:,:,buf%nbuf)=data
+        buf%time(buf%nbuf)=time
+        buf%pos(buf%nbuf)=pos
+        if (buf%nbuf==nvid_buffer) call flush_slice_buffer(buf)
+      endassociate
 !
     endsubroutine hdf5_output_slice
+!***********************************************************************
+    subroutine flush_slice_buffer(buf)
+!
+!  Append the buffered video steps of one slice file, with the same records
+!  as if they had been written one by one.
+!
+      type (slice_buffer), intent(inout) :: buf
+!
+      integer :: i
+!
+      if (buf%nbuf==0) return
+!
+      open (lun_output, file=buf%file, form='unformatted', position='append')
+      do i=1,buf%nbuf
+        write (lun_output) buf%data(:,:,i), buf%time(i), buf%pos(i)
+      enddo
+      close (lun_output)
+      buf%nbuf=0
+!
+    endsubroutine flush_slice_buffer
+!***********************************************************************
+    subroutine hdf5_flush_slices
+!
+!  Write out the slices still buffered, e.g. at the end of the run.
+!
+      integer :: ib
+!
+      if (.not.allocated(slice_buffers)) return
+!
+      do ib=1,size(slice_buffers)
+        call flush_slice_buffer(slice_buffers(ib))
+      enddo
+!
+    endsubroutine hdf5_flush_slices
 !***********************************************************************
     subroutine index_append(varname,ivar,vector,array)
 !
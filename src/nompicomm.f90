@@ -1339,6 +1339,29 @@ module Mpicomm
       if (ALWAYS_FALSE) print*, present(comm)
 !
     endsubroutine mpireduce_max_arr
+!***********************************************************************
+    subroutine mpireduce_sum_max(fsum_tmp,fsum,nsum,fmax_tmp,fmax,nmax,comm)
+!
+      integer :: nsum, nmax
+      real, dimension(nsum) :: fsum_tmp,fsum
+      real, dimension(nmax) :: fmax_tmp,fmax
+      integer, optional :: comm
+!
+      fsum=fsum_tmp
+      fmax=fmax_tmp
+      if (ALWAYS_FALSE) print*, present(comm)
+!
+    endsubroutine mpireduce_sum_max
+!***********************************************************************
+    subroutine write_halo_traffic(file)
+!
+!  No halos are exchanged in a serial run.
+!
+      character (len=*), intent(in) :: file
+!
+      if (ALWAYS_FALSE) print*, file
+!
+    endsubroutine write_halo_traffic
 !***********************************************************************
     subroutine mpireduce_min_scl(fmin_tmp,fmin,comm)
 !
@@ -1569,6 +1592,23 @@ module Mpicomm
       call keep_compiler_quiet(comm)
 !
     endsubroutine mpibarrier
+!***********************************************************************
+    integer function mpi_io_info(naggregators)
+
+      integer, intent(IN) :: naggregators
+
+      call keep_compiler_quiet(naggregators)
+      mpi_io_info=MPI_INFO_NULL
+
+    endfunction mpi_io_info
+!***********************************************************************
+    subroutine mpi_free_info(info)
+
+      integer, intent(INOUT) :: info
+
+      call keep_compiler_quiet(info)
+
+    endsubroutine mpi_free_info
 !***********************************************************************
     subroutine mpifinalize
 !
@@ -59,6 +59,36 @@ module power_spectrum
       call keep_compiler_quiet(ioptest(iapn_index))
 !
     endsubroutine power
+!***********************************************************************
+    logical function lpower_on_GPU(sp)
+!
+      character (len=*) :: sp
+!
+      call keep_compiler_quiet(sp)
+      lpower_on_GPU=.false.
+!
+    endfunction lpower_on_GPU
+!***********************************************************************
+    subroutine power_GPU_spectra
+!
+    endsubroutine power_GPU_spectra
+!***********************************************************************
+    logical function lpdf_on_GPU(variabl)
+!
+      character (len=*) :: variabl
+!
+      call keep_compiler_quiet(variabl)
+      lpdf_on_GPU=.false.
+!
+    endfunction lpdf_on_GPU
+!***********************************************************************
+    subroutine pdf_GPU_pdfs(cc_mean,cc_rms)
+!
+      real :: cc_mean, cc_rms
+!
+      call keep_compiler_quiet(cc_mean,cc_rms)
+!
+    endsubroutine pdf_GPU_pdfs
 !***********************************************************************
     subroutine power_2d(f,sp)
 !
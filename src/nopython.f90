@@ -31,7 +31,15 @@
 
     endsubroutine write_python_run_pars
 !***************************************************************
-    subroutine python_call
+    subroutine python_call(f)
+!
+      use Cparam, only: mx, my, mz, mfarray
+      use General, only: keep_compiler_quiet
+!
+      real, dimension (mx,my,mz,mfarray) :: f
+!
+      call keep_compiler_quiet(f)
+!
     endsubroutine python_call
 !***************************************************************
     subroutine python_finalize
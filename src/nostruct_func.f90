@@ -28,5 +28,19 @@ module struct_func
       call keep_compiler_quiet(variabl)
 !
     endsubroutine structure
+!***********************************************************************
+    logical function lstructure_on_GPU()
+!
+      lstructure_on_GPU=.false.
+!
+    endfunction lstructure_on_GPU
+!***********************************************************************
+    subroutine structure_GPU(ivec)
+!
+      integer :: ivec
+!
+      call keep_compiler_quiet(ivec)
+!
+    endsubroutine structure_GPU
 !***********************************************************************
 endmodule struct_func
@@ -2,9 +2,22 @@ if (lstart) then
   num_helper_threads = omp_get_max_threads()
 else
   call omp_set_max_active_levels(2)
-  num_helper_threads = omp_get_max_threads()-1
-  if (num_helper_threads==0) call fatal_error('run','zero helper threads in multithreaded version')
-  lmultithread=.true.
+!
+!  Don't start more threads than cores granted by the affinity mask, as the helper team
+!  would otherwise oversubscribe the cores of the master and helper threads.
+!
+  if (get_num_affinity_cpus() >= 2) call omp_set_num_threads(min(omp_get_max_threads(),get_num_affinity_cpus()))
+!
+!  With GPUs, helper threads do diagnostics and output concurrently with the master driving the
+!  GPU. On CPUs these are left to the master and all threads share the mn loop (lthreaded_mn_loop).
+!
+  if (lgpu) then
+    num_helper_threads = omp_get_max_threads()-1
+    if (num_helper_threads==0) call fatal_error('run','zero helper threads in multithreaded version')
+    lmultithread=.true.
+  else
+    num_helper_threads = omp_get_max_threads()
+  endif
   call signal_init
   loffload = omp_get_num_devices() /= 0
 endif
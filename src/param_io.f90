@@ -93,11 +93,12 @@ module Param_IO
       lread_oldsnap_notestfield, lread_oldsnap_notestscalar, lread_oldsnap_noshear, &
       lread_oldsnap_nohydro, lread_oldsnap_nohydro_nomu5, &
       lread_oldsnap_nohydro_efield, lread_oldsnap_nohydro_ekfield, &
-      lread_oldsnap_onlyA, lastaroth_output, astaroth_dest, &
+      lread_oldsnap_onlyA, lastaroth_output, astaroth_dest, lsnap_checksum, lsnap_async, &
       ireset_tstart, tstart, lghostfold_usebspline, &
       lread_aux, lwrite_aux, lkinflow_as_aux, lenforce_maux_check, &
       lreport_undefined_diagnostics, pretend_lnTT, lprocz_slowest, lmorton_curve, ltest_bcs, lsuppress_parallel_reductions, &
-      nprocx_node, nprocy_node, nprocz_node, &
+      lhilbert_curve, &
+      nprocx_node, nprocy_node, nprocz_node, lnode_local_mapping, &
       lcopysnapshots_exp, bcx, bcy, bcz, r_int, r_ext, r_ref, rsmooth, &
       r_int_border, r_ext_border, mu0, force_lower_bound, force_upper_bound, &
       lseparate_persist, ldistribute_persist, lpersist, lomit_add_data, &
@@ -139,7 +140,8 @@ module Param_IO
       lnoghost_strati, ichannel1, ichannel2, tag_foreign, &
       lpoint, mpoint, npoint, lpoint2, mpoint2, npoint2, &
       lfatal_num_vector_369, density_scale_factor, &
-      lsmooth_farray,farray_smooth_width, radius_diag, lread_oldsnap_nocoolprof
+      lsmooth_farray,farray_smooth_width, radius_diag, lread_oldsnap_nocoolprof, &
+      snap_compression, snap_compression_level, snap_compression_digits
 !
   namelist /run_pars/ &
       cvsid, ip, xyz0, xyz1, Lxyz, lperi, lpole, ncoarse, &
@@ -147,8 +149,8 @@ module Param_IO
       nt, it1, it1start, it1d, itspec, itsnap, it_rmv, dt, dt0, dt_epsi, dt_ratio, cdt, ddt, dt_incr, &
       lfractional_tstep_advance, lfractional_tstep_negative, leps_fixed, &
       cdtv, cdtv2, cdtv3, cdtsrc, cdts, cdtr, cdtf, &
-      cdtc, isave, itorder, dsnap, dsnap_down, mvar_down, maux_down, &
-      d1davg, d2davg, dvid, dsound, dtmin, dspec, tmax, toutoff, &
+      cdtc, isave, isave_base, delta_threshold, itorder, dsnap, dsnap_down, mvar_down, maux_down, &
+      d1davg, d2davg, dvid, nvid_buffer, dsound, dtmin, dspec, tmax, toutoff, &
       iwig, ldivu_perp, allproc_print, ssmask1, ssmask2, &
       dtracers, dfixed_points, unit_system, unit_length, &
       unit_velocity, unit_density, unit_temperature, unit_magnetic, &
@@ -179,6 +181,7 @@ module Param_IO
       test_nonblocking, lwrite_tracers, lwrite_fsum, lwrite_fixed_points, lwrite_ts_hdf5, &
       lread_oldsnap_lnrho2rho, lread_oldsnap_nomag, lread_oldsnap_notestflow, lread_oldsnap_nopscalar, &
       lread_oldsnap_notestfield, lread_oldsnap_notestscalar, lread_oldsnap_noshear, lrepair_snap, linterpol_on_repair, &
+      lsnap_checksum, lsnap_async, &
       lread_oldsnap_nohydro, lread_oldsnap_nohydro_efield, lread_oldsnap_nohydro_ekfield, &
       lread_oldsnap_noisothmhd, lread_oldsnap_onlyA, lastaroth_output, astaroth_dest, lbackup_snap, &
       lread_oldsnap_rho2lnrho, lread_oldsnap_nosink, lwrite_dim_again, lwrite_last_powersnap, &
@@ -231,8 +234,10 @@ module Param_IO
       uu_fft3d, oo_fft3d, bb_fft3d, jj_fft3d, uu_xkyz, oo_xkyz, bb_xkyz, jj_xkyz, &
       uu_kx0z, oo_kx0z, bb_kx0z, jj_kx0z, bb_k00z, ee_k00z, gwT_fft3d, &
       Em_specflux, Hm_specflux, Hc_specflux, density_scale_factor, radius_diag, &
-      lmorton_curve, lsuppress_parallel_reductions, &
-      shared_mem_name, lupdate_cvs, lread_oldsnap_nocoolprof
+      lmorton_curve, lhilbert_curve, lsuppress_parallel_reductions, lpin_helper_threads, &
+      lshared_mem_halos, lhalo_traffic, lthreaded_mn_loop, mn_order, mn_tile, &
+      shared_mem_name, shared_mem_publish_name, it_shared_mem_publish, lupdate_cvs, lread_oldsnap_nocoolprof, &
+      io_aggregators, snap_compression, snap_compression_level, snap_compression_digits
 !
   namelist /IO_pars/ &
       lcollective_IO, IO_strategy
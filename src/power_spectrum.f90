@@ -37,6 +37,7 @@ module Power_spectrum
 !
   include 'power_spectrum.h'
 !
+  integer, parameter :: n_pdf1d=3001
   real :: pdf_max=30., pdf_min=-30., pdf_max_logscale=3.0, pdf_min_logscale=-3.
   real :: pdfy_max=30., pdfy_min=-30., pdfy_max_logscale=3.0, pdfy_min_logscale=-3.
   real :: tout_min=0., tout_max=0.
@@ -46,7 +47,7 @@ module Power_spectrum
   logical :: lhalf_factor_in_GW=.false., lcylindrical_spectra=.false.
   logical :: lhorizontal_spectra=.false., lvertical_spectra=.false.
   logical :: lread_gauss_quadrature=.false., lshear_frame_correlation=.false.
-  logical :: lzero_spec_zerok=.false.
+  logical :: lzero_spec_zerok=.false., lpower_gpu=.false.
   integer :: legendre_lmax=1
   integer :: firstout = 0
   logical :: lglq_dot_dat_exists=.false.
@@ -84,6 +85,12 @@ module Power_spectrum
   real, dimension(nx,ny,nz,3) :: a_vec_re,a_vec_im, b_vec_re
   real, dimension(nx,ny,nz) :: a2
   real, dimension(:), allocatable :: kshell
+!
+!  Shell indices of the local Fourier points, computed on first use: 1-based,
+!  0 outside the spectrum; for power (ishell_xyz) and powerhel (ishell_hel,
+!  ishell_cyl for the cylindrical spectra).
+!
+  integer, dimension(:,:,:), allocatable :: ishell_xyz, ishell_hel, ishell_cyl
 !
   namelist /power_spectrum_run_pars/ &
       lintegrate_shell, lintegrate_z, lcomplex, ckxrange, ckyrange, czrange, &
@@ -94,7 +101,7 @@ module Power_spectrum
       power_format, kout_max, tout_min, tout_max, specflux_dp, specflux_dq, &
       lhorizontal_spectra, lvertical_spectra, ltrue_binning, max_k2, &
       specflux_pmin, specflux_pmax, lzero_spec_zerok, lcorrect_integer_kcalc, &
-      lpdf_2d_variable_range
+      lpdf_2d_variable_range, lpower_gpu
 !
 ! real, allocatable, dimension(:,:) :: spectrum_2d, spectrumhel_2d
 ! real, allocatable, dimension(:,:) :: spectrum_2d_sum, spectrumhel_2d_sum
@@ -280,8 +287,42 @@ outer:do ikz=1,nz
       enddo
       if (ipz==0) call mpimerge_1d(kshell,nk_xy,12) ! filling of the shell-wavenumber vector
     endif
+!
+!  Shell indices depend on the settings above; recompute them when needed.
+!
+    if (allocated(ishell_xyz)) deallocate(ishell_xyz,ishell_hel,ishell_cyl)
     !
   endsubroutine initialize_power_spectrum
+!***********************************************************************
+  subroutine init_shell_indices
+!
+!  Shell index of every local Fourier point, so that the binning in power
+!  and powerhel need not recompute k for every component and call.
+!
+    use General, only: pos_in_array
+!
+    integer :: ikx, iky, ikz, k
+!
+    allocate(ishell_xyz(nx,ny,nz),ishell_hel(nx,ny,nz),ishell_cyl(nx,ny,nz))
+!
+    do ikz=1,nz
+    do iky=1,ny
+    do ikx=1,nx
+      if (ltrue_binning) then
+        ishell_xyz(ikx,iky,ikz)=pos_in_array(int(get_k2(ikx+ipx*nx, iky+ipy*ny, ikz+ipz*nz)),k2s(:nk_truebin))
+      else
+        k=nint(get_k(ikx+ipx*nx, iky+ipy*ny, ikz+ipz*nz))
+        ishell_xyz(ikx,iky,ikz)=merge(k+1,0,k>=0 .and. k<=nk_xyz-1)
+      endif
+      k=nint(sqrt(kx(ikx+ipx*nx)**2+ky(iky+ipy*ny)**2+kz(ikz+ipz*nz)**2))
+      ishell_hel(ikx,iky,ikz)=merge(k+1,0,k<=nxgrid/2-1)
+      k=nint(sqrt(kx(ikx+ipx*nx)**2+ky(iky+ipy*ny)**2))
+      ishell_cyl(ikx,iky,ikz)=merge(k+1,0,k<=nxgrid/2-1)
+    enddo
+    enddo
+    enddo
+!
+  endsubroutine init_shell_indices
 !***********************************************************************
   subroutine read_power_spectrum_run_pars(iostat)
 !
@@ -454,7 +495,7 @@ outer:do ikz=1,nz
     real, dimension(nx,ny,nz) :: a1,b1
     integer :: nk
 
-    integer :: ivec,ikx,iky,ikz,k,k2
+    integer :: ivec,ikx,iky,ikz,k
 
     do ivec=1,3
 
@@ -522,31 +563,17 @@ outer:do ikz=1,nz
 !  integration over shells
 !
       if (ip<10) call information('power','fft done; now integrate over shells')
-      if (ltrue_binning) then
-!
-!  Sum spectral contributions into bins of k^2 - avoids rounding of k.
+!  With ltrue_binning, the shells are bins of k^2 - avoids rounding of k.
 !
-        !$omp do collapse(3)
-        do ikz=1,nz
-        do iky=1,ny
-        do ikx=1,nx
-          k2=get_k2(ikx+ipx*nx, iky+ipy*ny, ikz+ipz*nz)
-          where(int(k2)==k2s) spectrum=spectrum+a1(ikx,iky,ikz)**2+b1(ikx,iky,ikz)**2
-        enddo
-        enddo
-        enddo
-      else
-        !$omp do collapse(3)
-        do ikz=1,nz
-        do iky=1,ny
-        do ikx=1,nx
-          k=nint(get_k(ikx+ipx*nx, iky+ipy*ny, ikz+ipz*nz))
-          if (k>=0 .and. k<=(nk-1)) spectrum(k+1)=spectrum(k+1) &
-               +a1(ikx,iky,ikz)**2+b1(ikx,iky,ikz)**2
-        enddo
-        enddo
-        enddo
-      endif
+      !$omp do collapse(3)
+      do ikz=1,nz
+      do iky=1,ny
+      do ikx=1,nx
+        k=ishell_xyz(ikx,iky,ikz)
+        if (k>0) spectrum(k)=spectrum(k)+a1(ikx,iky,ikz)**2+b1(ikx,iky,ikz)**2
+      enddo
+      enddo
+      enddo
 !
     enddo !(loop over ivec)
 !
@@ -575,8 +602,6 @@ outer:do ikz=1,nz
     real, save, dimension(nx,ny,nz) :: a1,b1
     real :: k2
     real, dimension(:), save, allocatable :: spectrum,spectrum_sum
-    character(LEN=fnlen) :: filename
-    logical :: lwrite_ks
 !
 !  identify version
 !
@@ -589,6 +614,7 @@ outer:do ikz=1,nz
       nk=nk_xyz
     endif
     if(.not. allocated(spectrum)) allocate(spectrum(nk),spectrum_sum(nk))
+    if (.not. allocated(ishell_xyz)) call init_shell_indices
   
     spectrum=0.
 !
@@ -607,40 +633,100 @@ outer:do ikz=1,nz
 !  The result is available only on root
 !
     call mpireduce_sum(spectrum,spectrum_sum,nk)
-  
+    if (lroot) call write_power(sp,spectrum_sum,tspec,iapn_index)
 !
-!  on root processor, write global result to file
-!  multiply by 1/2, so \int E(k) dk = (1/2) <u^2>
+  endsubroutine power
+!***********************************************************************
+  subroutine write_power(sp,spectrum_sum,time,iapn_index)
 !
+!  On the root processor, appends the global spectrum of `sp' to the
+!  diagnostics file power<sp>.dat, with the 1/2 factor in the definition
+!  of energies, so \int E(k) dk = (1/2) <u^2>.
 !
-!  append to diagnostics file
+    use General, only: itoa
+    use File_io, only: file_exists
 !
-    if (lroot) then
+    character (len=*) :: sp
+    real, dimension(:) :: spectrum_sum
+    real :: time
+    integer, intent(in), optional :: iapn_index
 !
-!  1/2 factor in the definition of energies.
+    character(LEN=fnlen) :: filename
+    logical :: lwrite_ks
 !
-      spectrum_sum=.5*spectrum_sum
+    if (sp=='ud') then
+      filename=trim(datadir)//'/power_'//trim(sp)//'-'//trim(itoa(iapn_index))//'.dat'
+    else
+      filename=trim(datadir)//'/power'//trim(sp)//'.dat'
+    endif
+
+    lwrite_ks=ltrue_binning .and. .not.file_exists(filename)
+    open(1,file=filename,position='append')
+    if (ip<10) print*,'Writing power spectra of variable '//trim(sp)//' to '//trim(filename)
 !
-      if (sp=='ud') then
-        filename=trim(datadir)//'/power_'//trim(sp)//'-'//trim(itoa(iapn_index))//'.dat'
-      else
-        filename=trim(datadir)//'/power'//trim(sp)//'.dat'
-      endif
-  
-      lwrite_ks=ltrue_binning .and. .not.file_exists(filename)
-      open(1,file=filename,position='append')
-      if (ip<10) print*,'Writing power spectra of variable '//trim(sp)//' to '//trim(filename)
+    if (lwrite_ks) then
+      write(1,*) nk_truebin
+      write(1,*) real(k2s(:nk_truebin))
+    endif
+    write(1,*) time
+    write(1,power_format) .5*spectrum_sum
+    close(1)
 !
-      if (lwrite_ks) then
-        write(1,*) nk_truebin
-        write(1,*) real(k2s(:nk_truebin))
-      endif
-      write(1,*) tspec
-      write(1,power_format) spectrum_sum
-      close(1)
+  endsubroutine write_power
+!***********************************************************************
+  logical function lpower_on_GPU(sp)
+!
+!  True if the spectrum 'sp' requested by powersnap is taken on the GPU by
+!  power_GPU_spectra instead of by power after downloading f.
+!
+    character (len=*) :: sp
+!
+    lpower_on_GPU = lgpu .and. lpower_gpu .and. .not.(lstart .or. ltrue_binning) .and. &
+                    (sp=='u' .or. sp=='a' .or. sp=='b' .or. (sp=='o' .and. ivx==0))
+!
+  endfunction lpower_on_GPU
+!***********************************************************************
+  subroutine power_GPU_spectra
+!
+!  Shell spectra of the vector fields (vel_spec, oo_spec, mag_spec, vec_spec)
+!  from Fourier transforms on the GPU, so that only the 1D spectra leave the
+!  device. Has to be called from the main thread, before the helper thread
+!  takes over the remaining spectra in perform_powersnap.
+!
+    if (vel_spec .and. lpower_on_GPU('u')) call power_GPU('u')
+    if (oo_spec  .and. lpower_on_GPU('o')) call power_GPU('o')
+    if (mag_spec .and. lpower_on_GPU('b')) call power_GPU('b')
+    if (vec_spec .and. lpower_on_GPU('a')) call power_GPU('a')
+!
+  endsubroutine power_GPU_spectra
+!***********************************************************************
+  subroutine power_GPU(sp)
+!
+!  GPU counterpart of power for sp='u','o','a','b'. The transform on the
+!  device is assumed unnormalized, hence the factor 1/nwgrid^2 which makes
+!  the coefficients agree with those of fft_xyz_parallel.
+!
+    use Fourier, only: kx_fft, ky_fft, kz_fft
+    use Gpu, only: power_spectra_GPU
+    use Mpicomm, only: mpireduce_sum
+!
+    character (len=*) :: sp
+!
+    real, dimension(nk_xyz) :: spectrum, spectrum_sum, helicity
+    integer :: ivar
+!
+    if (sp=='u' .or. sp=='o') then
+      ivar=iux
+    else
+      ivar=iax
     endif
+    call power_spectra_GPU(ivar,sp=='o' .or. sp=='b',kx_fft(ipx*nx+1:(ipx+1)*nx), &
+                           ky_fft(ipy*ny+1:(ipy+1)*ny),kz_fft(ipz*nz+1:(ipz+1)*nz), &
+                           L_min/(2*pi),1./real(nwgrid)**2,spectrum,helicity)
+    call mpireduce_sum(spectrum,spectrum_sum,nk_xyz)
+    if (lroot) call write_power(sp,spectrum_sum,real(t))
 !
-  endsubroutine power
+  endsubroutine power_GPU
 !***********************************************************************
   subroutine power_2d_parallel_portion(f,sp,spectrum)
 !
@@ -1283,7 +1369,6 @@ outer:do ikz=1,nz
 !
     integer, parameter :: nk=nxgrid/2
     integer :: i, k, ikx, iky, ikz, jkz, im, in, ivec, ivec_jj
-    real :: k2
     real, dimension (mx,my,mz,mfarray) :: f
     real, dimension(nx) :: bbi, jji, b2, j2
     real, dimension(nx,3) :: bb, bbEP, hhEP, jj, gtmp1, gtmp2
@@ -1320,7 +1405,9 @@ outer:do ikz=1,nz
       call magnetic_calc_spectra(f,spectrum,spectrumhel,lfirstcall,sp)
     else
 !
-    !$omp parallel private(ivec,jji,bb,jj,b2,j2,gtmp1,gtmp2,bbEP,k2,k,jkz) num_threads(num_helper_threads) &
+    if (.not. allocated(ishell_hel)) call init_shell_indices
+!
+    !$omp parallel private(ivec,jji,bb,jj,b2,j2,gtmp1,gtmp2,bbEP,k,jkz) num_threads(num_helper_threads) &
     !$omp copyin(MPI_COMM_GRID,MPI_COMM_PENCIL,MPI_COMM_XBEAM,MPI_COMM_YBEAM,MPI_COMM_ZBEAM, &
     !$omp MPI_COMM_XYPLANE,MPI_COMM_XZPLANE,MPI_COMM_YZPLANE)
     !$ thread_id = omp_get_thread_num()+1
@@ -1741,66 +1828,53 @@ outer:do ikz=1,nz
 !  integration over shells
 !
       if (ip<10) call information('powerhel','fft done; now integrate over shells')
-      !$omp do collapse(3) reduction(+:spectrum,spectrumhel,k2m,nks)
+!
+!  One sweep for the spherical and, if requested, the cylindrical shells.
+!
+      !$omp do collapse(3) reduction(+:spectrum,spectrumhel,k2m,nks,cyl_spectrum,cyl_spectrumhel)
       do ikz=1,nz
         do iky=1,ny
           do ikx=1,nx
-            k2=kx(ikx+ipx*nx)**2+ky(iky+ipy*ny)**2+kz(ikz+ipz*nz)**2
-            k=nint(sqrt(k2))
-            if (k>=0 .and. k<=(nk-1)) then
+            k=ishell_hel(ikx,iky,ikz)
+            if (k>0) then
 !
 !  sum energy and helicity spectra
 !
-              spectrum(k+1)=spectrum(k+1) &
+              spectrum(k)=spectrum(k) &
                  +b_re(ikx,iky,ikz)**2 &
                  +b_im(ikx,iky,ikz)**2
-              spectrumhel(k+1)=spectrumhel(k+1) &
+              spectrumhel(k)=spectrumhel(k) &
                  +a_re(ikx,iky,ikz)*b_re(ikx,iky,ikz) &
                  +a_im(ikx,iky,ikz)*b_im(ikx,iky,ikz)
 !
 !  compute krms only once
 !
               if (lwrite_krms) then
-                k2m(k+1)=k2m(k+1)+k2
-                nks(k+1)=nks(k+1)+1.
+                k2m(k)=k2m(k)+kx(ikx+ipx*nx)**2+ky(iky+ipy*ny)**2+kz(ikz+ipz*nz)**2
+                nks(k)=nks(k)+1.
               endif
-!
-!  end of loop through all points
-!
             endif
-          enddo
-        enddo
-      enddo
 !
-!  allow for possibility of cylindrical spectral
+!  allow for possibility of cylindrical spectra
 !
-      if (lcylindrical_spectra) then
-        if (ip<10) call information('powerhel','fft done; now integrate over cylindrical shells')
-        !$omp do collapse(3) reduction(+:cyl_spectrum,cyl_spectrumhel)
-        do ikz=1,nz
-          do iky=1,ny
-            do ikx=1,nx
-              k2=kx(ikx+ipx*nx)**2+ky(iky+ipy*ny)**2
-              jkz=nint(kz(ikz+ipz*nz))+nzgrid/2+1
-              k=nint(sqrt(k2))
-              if (k>=0 .and. k<=(nk-1)) then
-!
-!  sum energy and helicity spectra
-!
-                cyl_spectrum(k+1,jkz)=cyl_spectrum(k+1,jkz) &
+            if (lcylindrical_spectra) then
+              k=ishell_cyl(ikx,iky,ikz)
+              if (k>0) then
+                jkz=nint(kz(ikz+ipz*nz))+nzgrid/2+1
+                cyl_spectrum(k,jkz)=cyl_spectrum(k,jkz) &
                    +b_re(ikx,iky,ikz)**2 &
                    +b_im(ikx,iky,ikz)**2
-                cyl_spectrumhel(k+1,jkz)=cyl_spectrumhel(k+1,jkz) &
+                cyl_spectrumhel(k,jkz)=cyl_spectrumhel(k,jkz) &
                    +a_re(ikx,iky,ikz)*b_re(ikx,iky,ikz) &
                    +a_im(ikx,iky,ikz)*b_im(ikx,iky,ikz)
+              endif
+            endif
 !
 !  end of loop through all points
 !
-              endif
-            enddo
           enddo
         enddo
-      endif
+      enddo
       !
     enddo ! loop over ivec
     !$omp end parallel
@@ -3682,13 +3756,12 @@ outer:do ikz=1,nz
     use SharedVariables, only: get_shared_variable
 !
     integer :: l,i_pdf
-    integer, parameter :: n_pdf=3001
+    integer, parameter :: n_pdf=n_pdf1d
     real, dimension (mx,my,mz,mfarray) :: f
     real, dimension (nx,3) :: gcc
     real, dimension (nx) :: pdf_var,gcc2
     integer, dimension (n_pdf) :: pdf_yy, pdf_yy_sum
     real :: pdf_mean, pdf_rms, pdf_dx, pdf_dx1, pdf_scl
-    character (len=120) :: pdf_file=''
     character (len=*) :: variabl
     logical :: logscale=.false.
     integer, pointer :: ispecial
@@ -3775,22 +3848,107 @@ outer:do ikz=1,nz
 !  Communicate and append from root processor.
 !
     call mpireduce_sum_int(pdf_yy,pdf_yy_sum,n_pdf)
-    if (lroot) then
-       pdf_file=trim(datadir)//'/pdf_'//trim(variabl)//'.dat'
-       open(1,file=trim(pdf_file),position='append')
-       if (logscale) then
-         write(1,10) t, n_pdf, pdf_dx, pdf_max_logscale, pdf_min_logscale, pdf_mean, pdf_rms
-       else
-         write(1,10) t, n_pdf, pdf_dx, pdf_max, pdf_min, pdf_mean, pdf_rms
-       endif
-       write(1,11) pdf_yy_sum
-       close(1)
+    if (lroot) call write_pdf(variabl,logscale,pdf_dx,pdf_mean,pdf_rms,pdf_yy_sum)
+!
+  endsubroutine pdf
+!***********************************************************************
+  subroutine write_pdf(variabl,logscale,pdf_dx,pdf_mean,pdf_rms,pdf_yy_sum)
+!
+!  On the root processor, appends the global pdf of 'variabl' to the file
+!  pdf_<variabl>.dat.
+!
+    character (len=*) :: variabl
+    logical :: logscale
+    real :: pdf_dx, pdf_mean, pdf_rms
+    integer, dimension(:) :: pdf_yy_sum
+!
+    character (len=120) :: pdf_file=''
+!
+    pdf_file=trim(datadir)//'/pdf_'//trim(variabl)//'.dat'
+    open(1,file=trim(pdf_file),position='append')
+    if (logscale) then
+      write(1,10) t, size(pdf_yy_sum), pdf_dx, pdf_max_logscale, pdf_min_logscale, pdf_mean, pdf_rms
+    else
+      write(1,10) t, size(pdf_yy_sum), pdf_dx, pdf_max, pdf_min, pdf_mean, pdf_rms
     endif
+    write(1,11) pdf_yy_sum
+    close(1)
 !
 10 format(1p,e12.5,0p,i6,1p,5e12.4)
 11 format(8i10)
 !
-  endsubroutine pdf
+  endsubroutine write_pdf
+!***********************************************************************
+  logical function lpdf_on_GPU(variabl)
+!
+!  True if the pdf of 'variabl' requested by powersnap is binned on the GPU by
+!  pdf_GPU_pdfs instead of by pdf after downloading f.
+!
+    character (len=*) :: variabl
+!
+    lpdf_on_GPU = lgpu .and. lpower_gpu .and. .not.lstart .and. &
+                  (variabl=='cc' .or. variabl=='lncc' .or. variabl=='special' .or. variabl=='lnspecial')
+!
+  endfunction lpdf_on_GPU
+!***********************************************************************
+  subroutine pdf_GPU_pdfs(cc_mean,cc_rms)
+!
+!  Pdfs of single f-array variables (cc_pdf, lncc_pdf, special_pdf,
+!  lnspecial_pdf) binned on the GPU, so that only the histograms leave the
+!  device. Has to be called from the main thread, like power_GPU_spectra.
+!
+    real :: cc_mean, cc_rms
+!
+    if (cc_pdf        .and. lpdf_on_GPU('cc'))        call pdf_GPU('cc',cc_mean,cc_rms)
+    if (lncc_pdf      .and. lpdf_on_GPU('lncc'))      call pdf_GPU('lncc',cc_mean,cc_rms)
+    if (special_pdf   .and. lpdf_on_GPU('special'))   call pdf_GPU('special',0.,1.)
+    if (lnspecial_pdf .and. lpdf_on_GPU('lnspecial')) call pdf_GPU('lnspecial',0.,1.)
+!
+  endsubroutine pdf_GPU_pdfs
+!***********************************************************************
+  subroutine pdf_GPU(variabl,pdf_mean,pdf_rms)
+!
+!  GPU counterpart of pdf for the variables of pdf_GPU_pdfs, with the same
+!  binning and output.
+!
+    use Gpu, only: histogram_GPU
+    use Mpicomm, only: mpireduce_sum_int
+    use SharedVariables, only: get_shared_variable
+!
+    character (len=*) :: variabl
+    real :: pdf_mean, pdf_rms
+!
+    integer, dimension (n_pdf1d) :: pdf_yy, pdf_yy_sum
+    real :: pdf_dx, pdf_dx1, pdf_scl
+    logical :: logscale
+    integer, pointer :: ispecial
+!
+    pdf_scl=1./pdf_rms
+    logscale=variabl=='lncc'
+    if (logscale) then
+      pdf_dx=(pdf_max_logscale-pdf_min_logscale)/n_pdf1d
+    else
+      pdf_dx=(pdf_max-pdf_min)/n_pdf1d
+    endif
+    pdf_dx1=1./pdf_dx
+!
+    select case (variabl)
+    case ('cc')
+      call histogram_GPU(ilncc,0,pdf_mean,pdf_scl,pdf_dx1,-pdf_dx1*pdf_min,pdf_yy)
+    case ('lncc')
+      call histogram_GPU(ilncc,1,pdf_mean,pdf_scl,pdf_dx1,-pdf_min_logscale,pdf_yy)
+    case ('special')
+      call get_shared_variable('ispecial', ispecial, caller='pdf_GPU')
+      call histogram_GPU(ispecial,0,0.,pdf_scl,pdf_dx1,-pdf_dx1*pdf_min,pdf_yy)
+    case ('lnspecial')
+      call get_shared_variable('ispecial', ispecial, caller='pdf_GPU')
+      call histogram_GPU(ispecial,2,0.,pdf_scl,pdf_dx1,-pdf_dx1*pdf_min,pdf_yy)
+    endselect
+!
+    call mpireduce_sum_int(pdf_yy,pdf_yy_sum,n_pdf1d)
+    if (lroot) call write_pdf(variabl,logscale,pdf_dx,pdf_mean,pdf_rms,pdf_yy_sum)
+!
+  endsubroutine pdf_GPU
 !***********************************************************************
   subroutine pdf_2d(f,variabl,pdf_mean,pdf_rms)
 !
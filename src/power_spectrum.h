@@ -2,7 +2,8 @@
  private
 
  public :: initialize_power_spectrum
- public :: power, powerhel, powerscl, power_1d, power_2d, power_xy, pdf
+ public :: power, power_GPU_spectra, lpower_on_GPU, powerhel, powerscl, power_1d, power_2d, power_xy, pdf
+ public :: pdf_GPU_pdfs, lpdf_on_GPU
  public :: pdf1d_ang, pdf_2d
  public :: powerLor, powerEMF, powerTra, powerGWs
  public :: power_phi,powerhel_phi, power_vec
@@ -1,123 +1,84 @@
 #define _GNU_SOURCE
 #include <assert.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <errno.h>
 #include <sched.h>
 #include <pthread.h>
+#include <unistd.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
 
 #include "headers_c.h"
 
-//PTHREAD MUTEX ERROR MESSAGE MEANINGS
-//	  [EINVAL]
-//The mutex was created with the protocol attribute having the value PTHREAD_PRIO_PROTECT and the calling thread's priority is higher than the mutex's current priority ceiling.
-//The pthread_mutex_trylock() function shall fail if:
-//
-//[EBUSY]
-//The mutex could not be acquired because it was already locked.
-//The pthread_mutex_lock(), pthread_mutex_trylock(), and pthread_mutex_unlock() functions may fail if:
-//
-//[EINVAL]
-//The value specified by mutex does not refer to an initialized mutex object.
-//[EAGAIN]
-//[XSI] [Option Start] The mutex could not be acquired because the maximum number of recursive locks for mutex has been exceeded. [Option End]
-//The pthread_mutex_lock() function may fail if:
-//
-//[EDEADLK]
-//A deadlock condition was detected or the current thread already owns the mutex.
-//The pthread_mutex_unlock() function may fail if:
-//
-//[EPERM]
-//The current thread does not own the mutex.
-pthread_mutex_t diag_mutex;
-pthread_mutexattr_t mutex_attr;
-//pthread_mutex_t diag_mutex = PTHREAD_MUTEX_INITIALIZER;
-pthread_cond_t diag_cond = PTHREAD_COND_INITIALIZER;
+// Handoff between the main loop and the diagnostics helper thread.
+// The logical flags passed in from Fortran (lhelper_perf, lhelper_run, ...) carry the state of the channel:
+// only the thread whose turn a flag indicates touches the f-array. Waiting and waking go through a
+// sequence number which every signal advances after its flag has been stored. A waiter rechecks its
+// flags whenever the sequence number moves and otherwise sleeps in the kernel (futex) on the value it
+// last saw, so that no wakeup can be lost and no thread ever blocks on a lock held by the other.
+static volatile uint32_t diag_seq = 0;
 #define DIAG_COND_HANDLE (1)
 /* ------------------------------------------------------------------------------------ */
-//extern "C" 
+static void
+futex_wait(volatile uint32_t* addr, const uint32_t seen)
+{
+	// Returns immediately if *addr is no longer seen (EAGAIN) and may wake up spuriously (EINTR);
+	// the callers recheck their flags in any case.
+	syscall(SYS_futex, (uint32_t*)addr, FUTEX_WAIT_PRIVATE, seen, NULL, NULL, 0);
+}
+/* ------------------------------------------------------------------------------------ */
+static void
+futex_wake_all(volatile uint32_t* addr)
+{
+	syscall(SYS_futex, (uint32_t*)addr, FUTEX_WAKE_PRIVATE, INT32_MAX, NULL, NULL, 0);
+}
+/* ------------------------------------------------------------------------------------ */
+static bool
+flags_match(volatile bool* flag, volatile bool* val, const int n)
+{
+	for (int i = 0; i < n; ++i)
+		if (__atomic_load_n(&flag[i], __ATOMIC_RELAXED) != __atomic_load_n(&val[i], __ATOMIC_RELAXED)) return false;
+	return true;
+}
+/* ------------------------------------------------------------------------------------ */
+static void
+wait_for_flags(const int cond_handle, volatile bool* flag, volatile bool* val, const int n)
+{
+   if (cond_handle != DIAG_COND_HANDLE)
+   {
+	  printf("Error - cond_wait: Incorrect cond_handle!!!\n");
+	  assert(false); //Incorrect cond var handle
+   }
+   while (true)
+   {
+	  const uint32_t seen = __atomic_load_n(&diag_seq, __ATOMIC_ACQUIRE);
+	  if (flags_match(flag, val, n)) break;
+	  futex_wait(&diag_seq, seen);
+   }
+   // Pairs with the release in cond_signal: everything the other thread wrote before the flag is visible now.
+   __atomic_thread_fence(__ATOMIC_ACQUIRE);
+}
+/* ------------------------------------------------------------------------------------ */
+//extern "C"
 //{
 void
 FTNIZE(cond_init)()
 {
-	pthread_mutexattr_settype(&mutex_attr, PTHREAD_MUTEX_ERRORCHECK);
-	int res = pthread_mutex_init(&diag_mutex, &mutex_attr);
-	if (res != 0)
-	{
-	  printf("Tried to init mutex: %d\n",res);
-  	  printf("EBUSY: %d\n",EBUSY);
-  	  printf("EAGAIN: %d\n",EAGAIN);
-  	  printf("EPERM: %d\n",EPERM);
-  	  printf("ENOMEM: %d\n",ENOMEM);
-  	  printf("EINVAL: %d\n",EINVAL);
-	  fflush(stdout);
-	}
-	assert(res == 0);
+	__atomic_store_n(&diag_seq, 0, __ATOMIC_RELEASE);
 }
 /* ------------------------------------------------------------------------------------ */
 void
 FTNIZE(cond_wait_single)(const int* cond_handle, volatile bool* flag, volatile bool* val)
 {
-   switch(*cond_handle)
-   {
-	case DIAG_COND_HANDLE:
-	{
-          const int res = pthread_mutex_lock(&diag_mutex);
-	  if (res != 0)
-	  {
-	    printf("lock error message: %d\n",res);
-	    printf("EBUSY: %d\n",EBUSY);   // only relevant for trylock
-	    printf("EINVAL: %d\n",EINVAL);
-	    printf("EAGAIN: %d\n",EAGAIN);
-	    printf("EDEADLK: %d\n",EDEADLK);
-	    printf("EPERM: %d\n",EPERM);   // only relevant for unlock
-	    fflush(stdout);
-	    assert(res == 0);
-	  }
-	  while (*flag != *val) pthread_cond_wait(&diag_cond, &diag_mutex);
-	}
-	return;
-	default:
-	  printf("Error - cond_wait: Incorrect cond_handle!!!\n");
-	  assert(false); //Incorrect cond var handle
-   }
+   wait_for_flags(*cond_handle, flag, val, 1);
 }
 /* ------------------------------------------------------------------------------------ */
 void
 FTNIZE(cond_wait_multi)(const int* cond_handle, volatile bool* flag, volatile bool* val, const int* n)
 {
-   switch(*cond_handle)
-   {
-	case DIAG_COND_HANDLE:
-		{
-          const int res = pthread_mutex_lock(&diag_mutex);
-	  if (res != 0)
-	  {
-	    printf("lock error message: %d\n",res);
-	    printf("EBUSY: %d\n",EBUSY);
-	    printf("EINVAL: %d\n",EINVAL);
-	    printf("EAGAIN: %d\n",EAGAIN);
-	    printf("EDEADLK: %d\n",EDEADLK);
-	    printf("EPERM: %d\n",EPERM);
-	    fflush(stdout);
-	    assert(res == 0);
-	  }
-	  bool condition = true;
-	  for (int i = 0; i < *n; ++i)
-	    condition &= flag[i] == val[i];
-
-	  while (!condition) 
-	  {
-		pthread_cond_wait(&diag_cond, &diag_mutex);
-	        for (int i = 0; i < *n; ++i)
-		  condition &= flag[i] == val[i];
-	  }
-		}
-	  return;
-	default:
-	  printf("Error - cond_wait: Incorrect cond_handle!!!\n");
-	  assert(false); //Incorrect cond var handle
-   }
+   wait_for_flags(*cond_handle, flag, val, *n);
 }
 /* ---------------------------------------------------------------------------- */
 void
@@ -126,23 +87,9 @@ FTNIZE(cond_signal)(const int* cond_handle)
    switch(*cond_handle)
    {
 	case DIAG_COND_HANDLE:
-	{
-	  pthread_cond_signal(&diag_cond);
-	  //pthread_cond_broadcast(&diag_cond);
-	  const int res = pthread_mutex_unlock(&diag_mutex);
-	  if (res != 0)
-	  {
-	    printf("unlock error message: %d\n",res);
-	    printf("EBUSY: %d\n",EBUSY);
-	    printf("EINVAL: %d\n",EINVAL);
-	    printf("EAGAIN: %d\n",EAGAIN);
-	    printf("EDEADLK: %d\n",EDEADLK);
-	    printf("EPERM: %d\n",EPERM);
-	    fflush(stdout);
-	    assert(res == 0);
-	  }
-	}
-	return;
+	  __atomic_add_fetch(&diag_seq, 1, __ATOMIC_RELEASE);
+	  futex_wake_all(&diag_seq);
+	  return;
 	default:
 	  printf("Error - cond_signal: Incorrect cond_handle!!!\n");
 	  assert(false); //Incorrect cond var handle
@@ -167,20 +114,21 @@ FTNIZE(set_cpu_c)(int* core_id_in)
     return (bool)(1-rc);
 }
 
+int
+FTNIZE(get_num_affinity_cpus_c)()
+{
+	// Number of CPUs in the affinity mask of the calling thread, i.e., what the launcher
+	// (srun, mpirun --bind-to, taskset) has granted this process; 0 if it cannot be queried.
+	cpu_set_t cpuset;
+	CPU_ZERO(&cpuset);
+	if (sched_getaffinity(0, sizeof(cpu_set_t), &cpuset) != 0) return 0;
+	return CPU_COUNT(&cpuset);
+}
+
 void
 FTNIZE(cond_wait)(const int* cond_handle, volatile bool* flag, volatile bool* val)
 {
-   switch(*cond_handle)
-   {
-   case DIAG_COND_HANDLE:
-           pthread_mutex_lock(&diag_mutex);
-	   while(*flag != *val)
-		   pthread_cond_wait(&diag_cond, &diag_mutex);
-	   return;
-   default:
-	   printf("Incorrect cond var handle\n");
-	   assert(false); //Incorrect cond var handle
-   }
+   wait_for_flags(*cond_handle, flag, val, 1);
 }
 //}
 
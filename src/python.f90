@@ -6,13 +6,13 @@
 !
   module Python
 
-    use Cparam, only: fnlen
+    use Cparam, only: fnlen, mx, my, mz, mfarray
     use Syscalls
 
     implicit none
 
     character(LEN=fnlen) :: pymodule='', pyfunction=''
-    integer(KIND=ikind8) :: pModule, pFunction
+    integer(KIND=ikind8) :: pModule=0, pFunction=0
 
     namelist /python_run_pars/ pymodule, pyfunction
 !
@@ -50,10 +50,18 @@
 
     endsubroutine write_python_run_pars
 !***************************************************************
-    subroutine python_call
-     
-      integer :: arg
-      call py_call(pFunction,arg)
+    subroutine python_call(f)
+!
+!  Calls pyfunction(f, x, y, z, t, it) of pymodule for in-situ analysis.
+!  f, x, y and z are NumPy views of the local arrays (ghost zones included),
+!  valid only during the call; nothing is copied.
+!
+      use Cdata, only: x, y, z, t, it
+
+      real, dimension (mx,my,mz,mfarray) :: f
+
+      if (pFunction==0) return
+      call py_call(pFunction,f,(/mx,my,mz,mfarray/),x,y,z,t,it)
 
     endsubroutine python_call
 !***************************************************************
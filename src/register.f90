@@ -455,6 +455,7 @@ module Register
       use Cdata
       use Deriv,          only: finalize_deriv
       use Gpu,            only: finalize_gpu
+      use HDF5_IO,        only: hdf5_flush_slices
       use IO,             only: finalize_io
       use Particles_main, only: particles_finalize
       use Special,        only: finalize_special
@@ -466,6 +467,7 @@ module Register
       call finalize_special(f)
       call finalize_boundcond(f)
       call finalize_deriv
+      call hdf5_flush_slices
       call finalize_io
       if (lrun.and.nt>0) then
         call finalize_gpu
@@ -61,6 +61,7 @@ subroutine helper_loop(f,p)
   use Diagnostics, only:  restore_diagnostic_controls
 !$ use General, only: signal_wait, signal_send
   use Snapshot, only: perform_powersnap, perform_wsnap_ext, perform_wsnap_down
+  use GPU, only: finish_copy_farray_from_GPU
 !
   real, dimension (mx,my,mz,mfarray) :: f
   type (pencil_case) :: p
@@ -70,6 +71,7 @@ subroutine helper_loop(f,p)
 !$  do while(lhelper_run)
 !$    call signal_wait(lhelper_perf,lhelper_run)
 !$    if (lhelper_run) call restore_diagnostic_controls
+!$    if (lhelper_run .and. lgpu) call finish_copy_farray_from_GPU(f)
 
 !$    if (lhelper_run) call update_ghosts(f)
 !$    if (lhelper_run .and. lhelperflags(PERF_DIAGS)) then 
@@ -176,7 +178,7 @@ subroutine gen_output(f)
 ! 5-sep-2024/TP: extracted from timeloop
 !
     use Equ,             only: write_diagnostics 
-    use Snapshot,        only: powersnap, powersnap_prepare, wsnap, wsnap_down, output_form
+    use Snapshot,        only: powersnap, powersnap_prepare, wsnap, wsnap_down, wsnap_delta, output_form
     use Particles_main,  only: write_snapshot_particles
     use PointMasses,     only: pointmasses_write_snapshot
     use Mpicomm,         only: mpiwtime
@@ -237,7 +239,11 @@ subroutine gen_output(f)
       if (lsave .or. (mod(it-isave_shift, isave) == 0)) then
         lsave = .false.
         if (ip<=12.and.lroot) tvar1=mpiwtime()
-        call wsnap('var.dat',f, mvar_io,ENUM=.false.,noghost=noghost_for_isave)
+        if (isave_base>0) then
+          call wsnap_delta('var.dat',f,mvar_io)
+        else
+          call wsnap('var.dat',f, mvar_io,ENUM=.false.,noghost=noghost_for_isave)
+        endif
         if (ip<=12.and.lroot) print*,'wsnap: written snapshot var.dat in ', &
                                      mpiwtime()-tvar1,' seconds'
         call wsnap_timeavgs('timeavg.dat',ENUM=.false.)
@@ -289,7 +295,7 @@ subroutine timeloop(f,df,p)
   use IO,              only: output_globals
   use Magnetic,        only: rescaling_magnetic
   use Messages,        only: timing, fatal_error_local_collect
-  use Mpicomm,         only: mpibcast_logical, mpiwtime, MPI_COMM_WORLD, mpibarrier
+  use Mpicomm,         only: mpibcast_logical, mpiwtime, MPI_COMM_WORLD, mpibarrier, mpiallreduce_or
   use Particles_main,  only: particles_rprint_list, particles_initialize_modules, & 
                              particles_load_balance, particles_stochastic
   use Signal_handling, only: emergency_stop
@@ -303,7 +309,8 @@ subroutine timeloop(f,df,p)
   use Solid_Cells,     only: time_step_ogrid
   use Streamlines,     only: tracers_prepare
   use Snapshot,        only: powersnap_prepare
-  use GPU,             only: gpu_set_dt
+  use GPU,             only: gpu_set_dt, copy_farray_from_GPU
+  use Farray_alloc,    only: begin_farray_update, end_farray_update, publish_farray
 !$ use OMP_lib
 !$ use General, only: signal_send, signal_wait
 !
@@ -312,7 +319,7 @@ subroutine timeloop(f,df,p)
   type (pencil_case) :: p
 !
   logical :: lstop=.false., timeover=.false., resubmit=.false., lreload_file, lreload_always_file, &
-             lonemorestep=.false.
+             lonemorestep=.false., lemergency=.false.
   real :: wall_clock_time=0., time_per_step=0.
   real(KIND=rkind8) :: time_this_diagnostic
   integer :: it_this_diagnostic
@@ -329,15 +336,21 @@ subroutine timeloop(f,df,p)
 !
     lout = (mod(it-1,it1) == 0) .and. (it > it1start)
 !
-    if (lout .or. emergency_stop) then
+!  A signal need not reach all ranks in the same step, so they agree on
+!  stopping before anyone leaves the loop. To keep the reduction out of the
+!  ordinary steps, this is done only every it1 steps, like the STOP check.
+!
+    if (lsignal.and.lout) call mpiallreduce_or(emergency_stop,lemergency)
+!
+    if (lout .or. lemergency) then
 !
 !  Exit do loop if file `STOP' exists.
 !
       lstop=control_file_exists('STOP',DELETE=.true.)
-      if (lstop .or. emergency_stop) then
+      if (lstop .or. lemergency) then
         if (lroot) then
           print*
-          if (emergency_stop) print*, 'Emergency stop requested'
+          if (lemergency) print*, 'Emergency stop requested'
           if (lstop) print*, 'Found STOP file'
         endif
         resubmit=control_file_exists('RESUBMIT',DELETE=.true.)
@@ -405,9 +418,11 @@ subroutine timeloop(f,df,p)
 !
     if (iwig/=0) then
       if (mod(it,iwig)==0) then
+        call begin_farray_update
         if (lrmwig_xyaverage) call rmwig_xyaverage(f,ilnrho)
         if (lrmwig_full) call rmwig(f,df,ilnrho,ilnrho,awig)
         if (lrmwig_rho) call rmwig(f,df,ilnrho,ilnrho,awig,explog=.true.)
+        call end_farray_update
       endif
     endif
 !
@@ -438,6 +453,11 @@ subroutine timeloop(f,df,p)
     if (lwrite_tracers) call tracers_prepare
     if (lwrite_fixed_points) call fixed_points_prepare
 !
+!  From here to the output, f is updated on the CPU; tell in-situ readers of
+!  the shared-memory f-array. On the GPU, only the downloads change the host f.
+!
+    if (.not.lgpu) call begin_farray_update
+!
 !  Find out which pencils to calculate at current time-step.
 !
     lpencil = lpenc_requested
@@ -526,6 +546,18 @@ subroutine timeloop(f,df,p)
       call save_name(time_per_step,idiag_timeperstep)
     endif
 
+    if (.not.lgpu) call end_farray_update
+!
+!  Publish a complete copy of f for in-situ consumers; on the GPU it has to be
+!  downloaded first.
+!
+    if (shared_mem_publish_name/='' .and. it_shared_mem_publish>0) then
+      if (mod(it,it_shared_mem_publish)==0) then
+        if (lgpu) call copy_farray_from_GPU(f)
+        call publish_farray(f)
+      endif
+    endif
+!
     call gen_output(f)
 !
 !  Do exit when timestep has become too short.
@@ -601,10 +633,10 @@ subroutine run_start() bind(C)
   use FArrayManager,   only: farray_clean_up
   use Farray_alloc
   use General,         only: random_seed_wrapper, touch_file, itoa
-!$ use General,        only: signal_init, get_cpu
+!$ use General,        only: signal_init, get_cpu, get_num_affinity_cpus
   use Grid,            only: construct_grid, box_vol, grid_bound_data, set_coorsys_dimmask, &
                              construct_serial_arrays, coarsegrid_interp
-  use Gpu,             only: load_farray_to_GPU, initialize_gpu
+  use Gpu,             only: load_farray_to_GPU, initialize_gpu, bind_thread_near_GPU
   use HDF5_IO,         only: init_hdf5, initialize_hdf5, wdim
   use IO,              only: rgrid, wgrid, directory_names, rproc_bounds, wproc_bounds, output_globals, input_globals
   use Messages
@@ -614,12 +646,12 @@ subroutine run_start() bind(C)
   use Particles_main
   use Pencil_check,    only: pencil_consistency_check
   use PointMasses,     only: pointmasses_read_snapshot, pointmasses_write_snapshot
-  use Python,          only: python_init, python_finalize
+  use Python,          only: python_init, python_initialize, python_finalize
   use Register
   use SharedVariables, only: sharedvars_clean_up
   use Signal_handling, only: signal_prepare
   use Slices,          only: setup_slices
-  use Snapshot,        only: powersnap, rsnap, wsnap
+  use Snapshot,        only: powersnap, rsnap, rsnap_delta, wsnap
   use Solid_Cells,     only: wsnap_ogrid
   use Special,         only: initialize_mult_special
   use Sub,             only: control_file_exists, get_nseed
@@ -677,6 +709,7 @@ subroutine run_start() bind(C)
 !  Read parameters and output parameter list.
 !
   call read_all_run_pars
+  if (lpython) call python_initialize
 !
 !  Initialize the message subsystem, eg. color setting etc.
 !
@@ -872,6 +905,7 @@ subroutine run_start() bind(C)
   if (lroot .and. ldebug) print*, 'memusage before rsnap=', memusage()/1024., 'MBytes'
   if (lroot) tvar1=mpiwtime()
   call rsnap('var.dat',f,mvar_in,lread_nogrid)
+  if (isave_base>0) call rsnap_delta('var.dat',f,mvar_in)
   if (lroot) print*,'rsnap: read snapshot var.dat in ',mpiwtime()-tvar1,' seconds'
 !
 !  If we decided to use a new grid, we need to overwrite the data
@@ -1053,6 +1087,7 @@ subroutine run_start() bind(C)
   
   !$ call mpibarrier
   !$omp parallel 
+  !$    if (lgpu) call bind_thread_near_GPU
   !$    core_ids(omp_get_thread_num()+1) = get_cpu()
   !$omp end parallel
   !$ call mpibarrier
@@ -1068,7 +1103,7 @@ subroutine run_start() bind(C)
 !$   tmp_core_ids = 0
 !$   tmp_core_ids(1) = helper_core_id
 !$   j = 2
-!$   do i = 1,20
+!$   do i = 1,num_helper_threads+1
 !$     if (core_ids(i) /= master_core_id .and. core_ids(i) /= helper_core_id) then
 !$       tmp_core_ids(j) = core_ids(i)
 !$       j = j +1
@@ -1202,6 +1237,10 @@ subroutine run_start() bind(C)
     print*
   endif
 !
+!  Halo traffic of the f-array boundary exchange.
+!
+  if (lhalo_traffic) call write_halo_traffic(trim(datadir)//'/halo_traffic.dat')
+!
 !  Give all modules the possibility to exit properly.
 !
   call finalize_modules(f)
@@ -1626,6 +1665,20 @@ call copy_addr(dt_incr,p_par(1323))
 call copy_addr(lfractional_tstep_advance,p_par(1324)) ! bool
 !TP: should not really have to push this but disp_current uses lpenc_requested in place of lpencil
 call copy_addr(lpenc_requested,p_par(1336)) ! bool (npencils)
+call copy_addr(lcopy_farray_async,p_par(1337)) ! bool
+call copy_addr(lpin_farray,p_par(1338)) ! bool
+call copy_addr(lgpu_timings,p_par(1339)) ! bool
+call copy_addr(lreproducible_reductions,p_par(1340)) ! bool
+call copy_addr(lgpu_numa_placement,p_par(1341)) ! bool
+call copy_addr(lhilbert_curve,p_par(1342)) ! bool
+call copy_addr(ipx,p_par(1343)) ! int
+call copy_addr(ipy,p_par(1344)) ! int
+call copy_addr(nprocx_node,p_par(1345)) ! int
+call copy_addr(nprocy_node,p_par(1346)) ! int
+call copy_addr(nprocz_node,p_par(1347)) ! int
+call copy_addr(lgpu_direct_snapshots,p_par(1348)) ! bool
+call copy_addr(ldt_limiter_report,p_par(1349)) ! bool
+call copy_addr(lgpu_lazy_autotuning,p_par(1350)) ! bool
 
 endsubroutine pushpars2c
 !***********************************************************************
@@ -47,11 +47,20 @@ module Selfgravity
   logical :: ljeans_stiffening = .false.
   integer :: nj_stiff = 8
   real :: stiff_gamma = 5./3.
+!
+!  Red-black SOR solver on the GPU: at most niter_sor_selfgrav sweeps; if tol_sor_selfgrav>0,
+!  stop as soon as max|del2(pot)-rhs| < tol_sor_selfgrav*max|rhs|, checked every nsor_check_selfgrav sweeps.
+!  Relaxation factor omega_sor_selfgrav (1: Gauss-Seidel); if <=0, the optimal one for the grid,
+!  with which the number of sweeps grows only linearly with the grid size.
+!
+  integer :: niter_sor_selfgrav=100, nsor_check_selfgrav=10
+  real :: tol_sor_selfgrav=0.0, omega_sor_selfgrav=1.0, omega_sor=1.0
 !
   namelist /selfgrav_run_pars/ &
       rhs_poisson_const, lselfgravity_gas, lselfgravity_dust, &
       lselfgravity_neutrals, tstart_selfgrav, gravitational_const, kappa, &
-      ljeans_stiffening, nj_stiff, stiff_gamma, tselfgrav_gentle
+      ljeans_stiffening, nj_stiff, stiff_gamma, tselfgrav_gentle, &
+      niter_sor_selfgrav, nsor_check_selfgrav, tol_sor_selfgrav, omega_sor_selfgrav
 !
 !  Diagnostic Indices
 !
@@ -117,6 +126,7 @@ module Selfgravity
       real, dimension (mx,my,mz,mfarray) :: f
       integer :: ierr=0
       integer :: i
+      real :: rho_jacobi
 !
 !  Initialize gravitational potential to zero.
 !
@@ -205,6 +215,36 @@ module Selfgravity
 !  Get the background density stratification, if any.
 !
       if (lstratz) call get_stratz(z, rho0z)
+!
+!  Optimal SOR factor 2/(1+sqrt(1-rho^2)) from the spectral radius rho of the Jacobi
+!  iteration, set by the longest wave fitting in the box.
+!
+      if (omega_sor_selfgrav>0.) then
+        omega_sor=omega_sor_selfgrav
+      else
+        rho_jacobi=(sor_mode(nxgrid,lperi(1))*dx_1(l1)**2+sor_mode(nygrid,lperi(2))*dy_1(m1)**2 &
+                   +sor_mode(nzgrid,lperi(3))*dz_1(n1)**2) &
+                  /(merge(dx_1(l1)**2,0.,nxgrid>1)+merge(dy_1(m1)**2,0.,nygrid>1)+merge(dz_1(n1)**2,0.,nzgrid>1))
+        omega_sor=2./(1.+sqrt(1.-rho_jacobi**2))
+        if (lroot) print*, 'initialize_selfgravity: SOR relaxation factor =', omega_sor
+      endif
+!
+      contains
+!
+      real function sor_mode(ngrid,lperiodic)
+!
+        integer, intent(in) :: ngrid
+        logical, intent(in) :: lperiodic
+!
+        if (ngrid==1) then
+          sor_mode=0.
+        elseif (lperiodic) then
+          sor_mode=cos(2.*pi/ngrid)
+        else
+          sor_mode=cos(pi/ngrid)
+        endif
+!
+      endfunction sor_mode
 !
     endsubroutine initialize_selfgravity
 !***********************************************************************
@@ -667,6 +707,10 @@ module Selfgravity
     call copy_addr(rho0z,p_par(14)) ! (mz)
     call copy_addr(rhs_poisson_const,p_par(15))
     call copy_addr(tselfgrav_gentle,p_par(16)) 
+    call copy_addr(niter_sor_selfgrav,p_par(17)) ! int
+    call copy_addr(nsor_check_selfgrav,p_par(18)) ! int
+    call copy_addr(tol_sor_selfgrav,p_par(19))
+    call copy_addr(omega_sor,p_par(20))
 
 
     endsubroutine pushpars2c
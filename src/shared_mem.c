@@ -4,14 +4,25 @@
 #include <sys/mman.h>        // For shm_open, mmap
 #include <sys/stat.h>        // For mode constants
 #include <unistd.h>          // For ftruncate
+#include <pthread.h>
+#include <string.h>          // For memcpy, strdup
 #include "headers_c.h"
 #include "shared_mem.h"
+#include "shared_mem_layout.h"
 
 #define EXIT_FAILURE 1
 
 const int READ_AND_WRITE_PERMISSIONS_TO_ALL = 0666;
 const char* global_shm_name = NULL;
 const char* global_sem_name = NULL;
+static pc_shm_header* shm_header = NULL;
+static int shm_writers = 0;
+static bool shm_async_open = false;
+static pthread_mutex_t shm_writer_lock = PTHREAD_MUTEX_INITIALIZER;
+static char* global_publish_name = NULL;
+static pc_shm_publish_header* publish_header = NULL;
+static REAL* publish_copies[2] = {NULL, NULL};
+static size_t publish_bytes = 0;
 
 typedef struct
 {
@@ -91,17 +102,73 @@ REAL* get_shm(const int n_elems, const char* name)
 			n_elems*sizeof(REAL)
 		    });
 }
-REAL* FTNIZE(allocate_shm)(const long long *n_elems, const char* name) {
+REAL* FTNIZE(allocate_shm)(const long long *n_elems, const int dims[4], const char* name) {
 
     register_exit_cleanup(name);
-    const off_t size = *n_elems*sizeof(REAL);
-    const shm shm_res  = create_shm(name, size);
+    const off_t f_bytes = *n_elems*sizeof(REAL);
+    const off_t header_offset = pc_shm_header_offset(f_bytes);
+    const shm shm_res  = create_shm(name, header_offset + sizeof(pc_shm_header));
     REAL* res = map_shm(shm_res);
+    //The pages are fresh and zero-filled, so seq starts even before the description becomes visible
+    shm_header = (pc_shm_header*)((char*)res + header_offset);
+    shm_header->real_size = sizeof(REAL);
+    for (int i = 0; i < 4; ++i) shm_header->dims[i] = dims[i];
+    shm_header->version = PC_SHM_VERSION;
+    __atomic_store_n(&shm_header->magic, PC_SHM_MAGIC, __ATOMIC_RELEASE);
     //TP: create a semaphore with a same name intended for synchronized access to the shared mem file
     create_sem(name);
     close(shm_res.fd);
     return res;
 }
+/* ---------------------------------------------------------------------------- */
+// Writer side of the seqlock, see shared_mem_layout.h. Updates may be nested; seq is odd as long
+// as any of them is open. At most one asynchronous update (a download from the GPU finished later,
+// possibly on the helper thread) can be open: beginning it again is ignored, as is ending it when
+// it is not open. No-ops if f is not in shared memory.
+void FTNIZE(shm_write_begin)(const bool* async)
+{
+    if (shm_header == NULL) return;
+    pthread_mutex_lock(&shm_writer_lock);
+    if (*async)
+    {
+        if (shm_async_open)
+        {
+            pthread_mutex_unlock(&shm_writer_lock);
+            return;
+        }
+        shm_async_open = true;
+    }
+    if (shm_writers++ == 0)
+    {
+        __atomic_store_n(&shm_header->seq, shm_header->seq+1, __ATOMIC_RELAXED);
+        // Readers must see the odd seq before any of the writes to f
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    }
+    pthread_mutex_unlock(&shm_writer_lock);
+}
+/* ---------------------------------------------------------------------------- */
+void FTNIZE(shm_write_end)(const bool* async, const double* t, const int* it)
+{
+    if (shm_header == NULL) return;
+    pthread_mutex_lock(&shm_writer_lock);
+    if (*async)
+    {
+        if (!shm_async_open)
+        {
+            pthread_mutex_unlock(&shm_writer_lock);
+            return;
+        }
+        shm_async_open = false;
+    }
+    if (--shm_writers == 0)
+    {
+        shm_header->t  = *t;
+        shm_header->it = *it;
+        __atomic_store_n(&shm_header->seq, shm_header->seq+1, __ATOMIC_RELEASE);
+    }
+    pthread_mutex_unlock(&shm_writer_lock);
+}
+/* ---------------------------------------------------------------------------- */
 sem_t* create_sem(const char* name)
 {
     sem_t* sem = sem_open(name, O_CREAT, 0666, 1);
@@ -121,3 +188,43 @@ sem_t* get_sem(const char* name)
     }
     return sem;
 }
+void cleanup_publish_shm() {
+    if (global_publish_name != NULL && shm_unlink(global_publish_name) == -1) perror("shm_unlink failed");
+}
+/* ---------------------------------------------------------------------------- */
+void FTNIZE(allocate_shm_publish)(const long long *n_elems, const int dims[4], const char* name)
+{
+    // The double-buffered publication segment, see shared_mem_layout.h.
+    global_publish_name = strdup(name);
+    atexit(cleanup_publish_shm);
+    publish_bytes = *n_elems*sizeof(REAL);
+    const off_t copy_offset = pc_shm_header_offset(publish_bytes);
+    const shm shm_res = create_shm(name, 2*copy_offset + sizeof(pc_shm_publish_header));
+    REAL* base = map_shm(shm_res);
+    close(shm_res.fd);
+    publish_copies[0] = base;
+    publish_copies[1] = (REAL*)((char*)base + copy_offset);
+    publish_header = (pc_shm_publish_header*)((char*)base + 2*copy_offset);
+    publish_header->real_size = sizeof(REAL);
+    for (int i = 0; i < 4; ++i) publish_header->dims[i] = dims[i];
+    publish_header->version = PC_SHM_VERSION;
+    // Nothing is published yet: slot 0 has it=-1
+    publish_header->slot[0].it = -1;
+    __atomic_store_n(&publish_header->magic, PC_SHM_PUBLISH_MAGIC, __ATOMIC_RELEASE);
+}
+/* ---------------------------------------------------------------------------- */
+void FTNIZE(shm_publish)(const REAL* f, const double* t, const int* it)
+{
+    // Copies f into the older copy and makes it the current one. Only ever called by one thread.
+    if (publish_header == NULL) return;
+    const int next = 1 - publish_header->current;
+    pc_shm_publish_slot* slot = &publish_header->slot[next];
+    __atomic_store_n(&slot->seq, slot->seq+1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    memcpy(publish_copies[next], f, publish_bytes);
+    slot->t  = *t;
+    slot->it = *it;
+    __atomic_store_n(&slot->seq, slot->seq+1, __ATOMIC_RELEASE);
+    __atomic_store_n(&publish_header->current, next, __ATOMIC_RELEASE);
+}
+/* ---------------------------------------------------------------------------- */
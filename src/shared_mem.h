@@ -2,7 +2,19 @@
 #include <semaphore.h>
 
 REAL*
-allocate_shm(const long long *n_elems, const char* name);
+allocate_shm(const long long *n_elems, const int dims[4], const char* name);
+
+void
+shm_write_begin(const bool* async);
+
+void
+shm_write_end(const bool* async, const double* t, const int* it);
+
+void
+allocate_shm_publish(const long long *n_elems, const int dims[4], const char* name);
+
+void
+shm_publish(const REAL* f, const double* t, const int* it);
 
 REAL*
 get_shm(const int n_elems, const char* name);
@@ -0,0 +1,59 @@
+/*                             shared_mem_layout.h
+                               --------------------
+
+   Description:
+           Layout of the POSIX shared-memory segment holding the f-array (shared_mem_name /= '').
+           The segment starts with f itself, in Fortran order (mx,my,mz,mfarray), so that it can be
+           mapped directly; its last sizeof(pc_shm_header) bytes are the header below.
+
+           Access is coordinated by a seqlock: the simulation makes seq odd before it starts to modify f
+           and even again when f (and t, it) are consistent. A reader remembers an even seq, copies
+           or analyses the data, and accepts the result only if seq is still the same afterwards.
+           The writer never waits for readers.
+
+           The optional publication segment (shared_mem_publish_name) holds two copies of f, at 0 and at
+           pc_shm_header_offset(f_bytes), followed by a pc_shm_publish_header. Every it_shared_mem_publish
+           steps the simulation copies a complete f into the older copy, under that copy's own seqlock,
+           and then switches current to it. Readers take the current copy and check its seq as above,
+           which fails only if they are slower than two publications.
+
+           Shared by the writer (shared_mem.c) and the stand-alone reader (shared_mem_reader.c).
+*/
+#pragma once
+#include <stdint.h>
+
+#define PC_SHM_MAGIC   (0x48534350u)   // "PCSH"
+#define PC_SHM_VERSION (1)
+#define PC_SHM_PUBLISH_MAGIC (0x42504350u)   // "PCPB"
+
+typedef struct
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t real_size;        // bytes per element of f (4 or 8)
+	uint32_t dims[4];          // mx, my, mz, mfarray
+	uint32_t padding;
+	volatile uint64_t seq;     // odd while f is being written
+	double t;                  // time of the data, valid with an even seq
+	int64_t it;                // time step of the data
+} pc_shm_header;
+
+typedef struct
+{
+	volatile uint64_t seq;     // odd while the copy is being written
+	double t;
+	int64_t it;
+} pc_shm_publish_slot;
+
+typedef struct
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t real_size;
+	uint32_t dims[4];
+	volatile uint32_t current; // copy last published, 0 or 1
+	pc_shm_publish_slot slot[2];
+} pc_shm_publish_header;
+
+// Offset of the header from the start of a segment of f_bytes bytes of data, aligned to a cache line.
+static inline uint64_t pc_shm_header_offset(const uint64_t f_bytes) { return (f_bytes + 63) & ~(uint64_t)63; }
@@ -0,0 +1,142 @@
+#include <fcntl.h>           // For O_* constants
+#include <string.h>
+#include <sched.h>
+#include <sys/mman.h>        // For shm_open, mmap
+#include <sys/stat.h>        // For fstat
+#include <unistd.h>
+#include "shared_mem_reader.h"
+
+/* ---------------------------------------------------------------------------- */
+int pc_shm_open(const char* name, pc_shm_reader* reader)
+{
+    const int fd = shm_open(name, O_RDONLY, 0);
+    if (fd == -1) return -1;
+    struct stat st;
+    if (fstat(fd, &st) == -1 || (size_t)st.st_size < sizeof(pc_shm_header)) {
+        close(fd);
+        return -1;
+    }
+    void* base = mmap(0, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) return -1;
+
+    const pc_shm_header* header = (const pc_shm_header*)((char*)base + st.st_size - sizeof(pc_shm_header));
+    if (__atomic_load_n(&header->magic, __ATOMIC_ACQUIRE) != PC_SHM_MAGIC || header->version != PC_SHM_VERSION) {
+        munmap(base, st.st_size);
+        return -1;
+    }
+    reader->base = base;
+    reader->size = st.st_size;
+    reader->header = header;
+    return 0;
+}
+/* ---------------------------------------------------------------------------- */
+void pc_shm_close(pc_shm_reader* reader)
+{
+    if (reader->base != NULL) munmap(reader->base, reader->size);
+    reader->base = NULL;
+    reader->header = NULL;
+}
+/* ---------------------------------------------------------------------------- */
+const void* pc_shm_data(const pc_shm_reader* reader)
+{
+    return reader->base;
+}
+/* ---------------------------------------------------------------------------- */
+size_t pc_shm_bytes(const pc_shm_reader* reader)
+{
+    const pc_shm_header* h = reader->header;
+    return (size_t)h->real_size*h->dims[0]*h->dims[1]*h->dims[2]*h->dims[3];
+}
+/* ---------------------------------------------------------------------------- */
+uint64_t pc_shm_read_begin(const pc_shm_reader* reader)
+{
+    uint64_t seq;
+    while ((seq = __atomic_load_n(&reader->header->seq, __ATOMIC_ACQUIRE)) & 1) sched_yield();
+    return seq;
+}
+/* ---------------------------------------------------------------------------- */
+bool pc_shm_read_valid(const pc_shm_reader* reader, const uint64_t seq)
+{
+    // The reads of the data must not move past the second read of seq
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    return __atomic_load_n(&reader->header->seq, __ATOMIC_RELAXED) == seq;
+}
+/* ---------------------------------------------------------------------------- */
+int pc_shm_snapshot(const pc_shm_reader* reader, void* dest, double* t, int64_t* it, const int max_tries)
+{
+    const size_t bytes = pc_shm_bytes(reader);
+    for (int try = 0; max_tries == 0 || try < max_tries; ++try) {
+        const uint64_t seq = pc_shm_read_begin(reader);
+        memcpy(dest, reader->base, bytes);
+        const double data_t = reader->header->t;
+        const int64_t data_it = reader->header->it;
+        if (pc_shm_read_valid(reader, seq)) {
+            if (t != NULL) *t = data_t;
+            if (it != NULL) *it = data_it;
+            return 0;
+        }
+    }
+    return -1;
+}
+/* ---------------------------------------------------------------------------- */
+int pc_shm_pub_open(const char* name, pc_shm_pub_reader* reader)
+{
+    const int fd = shm_open(name, O_RDONLY, 0);
+    if (fd == -1) return -1;
+    struct stat st;
+    if (fstat(fd, &st) == -1 || (size_t)st.st_size < sizeof(pc_shm_publish_header)) {
+        close(fd);
+        return -1;
+    }
+    void* base = mmap(0, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) return -1;
+
+    const size_t header_offset = st.st_size - sizeof(pc_shm_publish_header);
+    const pc_shm_publish_header* header = (const pc_shm_publish_header*)((char*)base + header_offset);
+    if (__atomic_load_n(&header->magic, __ATOMIC_ACQUIRE) != PC_SHM_PUBLISH_MAGIC || header->version != PC_SHM_VERSION) {
+        munmap(base, st.st_size);
+        return -1;
+    }
+    reader->base = base;
+    reader->size = st.st_size;
+    reader->copies[0] = base;
+    reader->copies[1] = (char*)base + header_offset/2;
+    reader->header = header;
+    return 0;
+}
+/* ---------------------------------------------------------------------------- */
+void pc_shm_pub_close(pc_shm_pub_reader* reader)
+{
+    if (reader->base != NULL) munmap(reader->base, reader->size);
+    reader->base = NULL;
+    reader->header = NULL;
+}
+/* ---------------------------------------------------------------------------- */
+const void* pc_shm_pub_latest(const pc_shm_pub_reader* reader, int* slot, uint64_t* seq, double* t, int64_t* it)
+{
+    while (true) {
+        const int current = __atomic_load_n(&reader->header->current, __ATOMIC_ACQUIRE);
+        const pc_shm_publish_slot* s = &reader->header->slot[current];
+        const uint64_t current_seq = __atomic_load_n(&s->seq, __ATOMIC_ACQUIRE);
+        // Odd only if the writer has gone around twice since current was read
+        if (current_seq & 1) continue;
+        const double data_t = s->t;
+        const int64_t data_it = s->it;
+        if (!pc_shm_pub_valid(reader, current, current_seq)) continue;
+        if (data_it < 0) return NULL;
+        *slot = current;
+        *seq = current_seq;
+        if (t != NULL) *t = data_t;
+        if (it != NULL) *it = data_it;
+        return reader->copies[current];
+    }
+}
+/* ---------------------------------------------------------------------------- */
+bool pc_shm_pub_valid(const pc_shm_pub_reader* reader, const int slot, const uint64_t seq)
+{
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    return __atomic_load_n(&reader->header->slot[slot].seq, __ATOMIC_RELAXED) == seq;
+}
+/* ---------------------------------------------------------------------------- */
@@ -0,0 +1,76 @@
+/*                             shared_mem_reader.h
+                               --------------------
+
+   Description:
+           Read-only access for in-situ analysis processes to the f-array which a run keeps in POSIX
+           shared memory (shared_mem_name in run.in). Independent of the Pencil Code build, e.g.
+
+             cc -O2 -c shared_mem_reader.c && cc my_analysis.c shared_mem_reader.o -lrt
+
+           Readers never block the simulation: a typical pattern is
+
+             uint64_t seq;
+             do {
+               seq = pc_shm_read_begin(&reader);
+               ... read from pc_shm_data(&reader) ...
+             } while (!pc_shm_read_valid(&reader, seq));
+
+           or pc_shm_snapshot, which copies f with this loop.
+
+           The double-buffered publication segment (shared_mem_publish_name) is read likewise through
+           the pc_shm_pub_* functions; there, the data seen are always those of a complete time step.
+*/
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "shared_mem_layout.h"
+
+typedef struct
+{
+	void* base;                     // start of the mapping, i.e. f(1,1,1,1)
+	size_t size;                    // size of the mapping in bytes
+	const pc_shm_header* header;
+} pc_shm_reader;
+
+// Maps the segment name (as given by shared_mem_name) read-only. Returns 0 on success, -1 otherwise
+// (segment missing, or not yet described by the writer).
+int pc_shm_open(const char* name, pc_shm_reader* reader);
+
+void pc_shm_close(pc_shm_reader* reader);
+
+// f in Fortran order, header->dims[0..3] = mx,my,mz,mfarray elements of header->real_size bytes.
+const void* pc_shm_data(const pc_shm_reader* reader);
+
+// Waits (spinning) until no update is in progress and returns the version to be checked afterwards.
+uint64_t pc_shm_read_begin(const pc_shm_reader* reader);
+
+// Whether the data read since pc_shm_read_begin returned seq are consistent.
+bool pc_shm_read_valid(const pc_shm_reader* reader, const uint64_t seq);
+
+// Copies the whole f into dest (at least pc_shm_bytes(reader) bytes), together with its t and it if these
+// are not NULL. Gives up after max_tries inconsistent copies (0 = never) and returns -1, 0 on success.
+int pc_shm_snapshot(const pc_shm_reader* reader, void* dest, double* t, int64_t* it, const int max_tries);
+
+// Size of f in bytes.
+size_t pc_shm_bytes(const pc_shm_reader* reader);
+
+typedef struct
+{
+	void* base;
+	size_t size;
+	const void* copies[2];
+	const pc_shm_publish_header* header;
+} pc_shm_pub_reader;
+
+// Maps the publication segment name read-only. Returns 0 on success, -1 otherwise.
+int pc_shm_pub_open(const char* name, pc_shm_pub_reader* reader);
+
+void pc_shm_pub_close(pc_shm_pub_reader* reader);
+
+// The copy of f published last, NULL if none is yet. *slot and *seq are to be passed to pc_shm_pub_valid
+// once done with the data; t and it (if not NULL) receive its time and time step.
+const void* pc_shm_pub_latest(const pc_shm_pub_reader* reader, int* slot, uint64_t* seq, double* t, int64_t* it);
+
+// Whether the copy returned by pc_shm_pub_latest has not been overwritten in the meantime.
+bool pc_shm_pub_valid(const pc_shm_pub_reader* reader, const int slot, const uint64_t seq);
@@ -501,7 +501,9 @@ module Shear
 !  time derivative (following Gammie 2001). Removes time-step constraint
 !  from shear motion.
 !
-      shear: if (lshearadvection_as_shift) then
+!  On the GPU the variables are shifted by shear_shift_GPU.
+!
+      shear: if (lshearadvection_as_shift .and. .not. lgpu) then
         comp: do ivar = 1, mvar
 !         bfield module handles its own shearing.
           if (lbfield .and. ibx <= ivar .and. ivar <= ibz) cycle comp
@@ -19,7 +19,7 @@ module Signal_handling
 
   include "signal_handling.h"
 !
-  logical :: emergency_stop=.false.
+  logical, volatile :: emergency_stop=.false.
   integer, dimension(2) :: sigval=-1  ! 2 is the max number of signal to catch
 !
 ! input parameters
@@ -10,7 +10,7 @@ module Snapshot
 !
   use Cdata
   use Messages
-  use Gpu, only: copy_farray_from_GPU
+  use Gpu, only: copy_farray_from_GPU, direct_snapshot_possible_GPU, lsnap_from_GPU, downsample_GPU
 !
   implicit none
 !
@@ -21,13 +21,24 @@ module Snapshot
     character(LEN=fnlen) :: file
   endtype
   type(pars_for_external) :: extpars
+!
+!  Base image of the delta checkpoints (isave_base>0) and number of deltas written since.
+!
+  real, dimension(:,:,:,:), allocatable :: f_base
+  real :: t_base
+  integer :: ndelta=0
+  integer, parameter :: lun_delta=95
+!
+!  Inner points of the next downsampled snapshot, if gathered on the GPU.
+!
+  real, dimension(:,:,:,:), allocatable :: f_down_GPU
 
   interface output_form
     module procedure output_form_int_0D
   endinterface
 !
   public :: rsnap, wsnap, wsnap_down, powersnap, output_form, powersnap_prepare, perform_powersnap, &
-            perform_wsnap_ext, perform_wsnap_down
+            perform_wsnap_ext, perform_wsnap_down, wsnap_delta, rsnap_delta
 !
   contains
 !***********************************************************************
@@ -66,7 +77,15 @@ module Snapshot
 
       if (lsnap_down) then
 !
-        if (.not.lstart.and.lgpu) call copy_farray_from_GPU(a)
+!  Without auxiliaries, only the downsampled points need to leave the GPU.
+!
+        if (.not.lstart.and.lgpu) then
+          if (maux_down==0) then
+            call downsample_from_GPU
+          else
+            call copy_farray_from_GPU(a)
+          endif
+        endif
         if (lmultithread) then
 !$        lmasterflags(PERF_WSNAP_DOWN) = .true.
         else
@@ -77,6 +96,21 @@ module Snapshot
       endif
 !
     endsubroutine wsnap_down
+!***********************************************************************
+    subroutine downsample_from_GPU
+!
+!  Gathers the inner points of the downsampled snapshot (variables
+!  1..mvar_down) on the GPU into f_down_GPU, for perform_wsnap_down.
+!
+      integer :: iv
+!
+      if (allocated(f_down_GPU)) deallocate(f_down_GPU)
+      allocate(f_down_GPU(ndown(1),ndown(2),ndown(3),mvar_down))
+      do iv=1,mvar_down
+        call downsample_GPU(iv,firstind,downsampl,f_down_GPU(:,:,:,iv))
+      enddo
+!
+    endsubroutine downsample_from_GPU
 !***********************************************************************
     subroutine perform_wsnap_down(a)
 !
@@ -141,7 +175,12 @@ module Snapshot
 !
 !  Copy downsampled data from *inner* grid points
 !
-        buffer(ifirstx:ilastx,ifirsty:ilasty,ifirstz:ilastz,:) = a(ifx:l2:isx,ify:m2:isy,ifz:n2:isz,nv1:nv2)
+        if (allocated(f_down_GPU)) then
+          buffer(ifirstx:ilastx,ifirsty:ilasty,ifirstz:ilastz,:) = f_down_GPU
+          deallocate(f_down_GPU)
+        else
+          buffer(ifirstx:ilastx,ifirsty:ilasty,ifirstz:ilastz,:) = a(ifx:l2:isx,ify:m2:isy,ifz:n2:isz,nv1:nv2)
+        endif
 !
 !  Generate ghost zone data
 !  TBDone: periodic BC
@@ -277,6 +316,7 @@ module Snapshot
       use Syscalls, only: system_cmd
       use Mpicomm, only: mpibarrier
       use Chemistry, only: make_flame_index, make_mixture_fraction
+      use File_io, only: delete_file
 !
 !  The dimension msnap can either be mfarray (for f-array in run.f90)
 !  or just mvar (for f-array in start.f90 or df-array in run.f90
@@ -295,6 +335,7 @@ module Snapshot
       character (len=fnlen) :: file
       character (len=intlen) :: ch
       integer :: nv1_capitalvar
+      logical :: lfrom_GPU, lasync
 !
 ! Prepare auxilliaries that are used only for later visualization
 !
@@ -337,11 +378,19 @@ module Snapshot
 !        endif
 !
         if (lsnap) then
-          if (.not.lstart .and. lgpu .and. nt>0) call copy_farray_from_GPU(a)
-          call update_ghosts(a)
-          if (msnap==mfarray) call update_auxiliaries(a)
+          lfrom_GPU=snap_from_GPU(chsnap,msnap,nv1_capitalvar,noghost)
+          lasync=lmultithread .and. .not.lfrom_GPU .and. snap_async_from_GPU(chsnap,msnap)
+          if (.not.lfrom_GPU) then
+            if (.not.lstart .and. lgpu .and. nt>0) call copy_farray_from_GPU(a,async_=lasync)
+            if (.not.lasync) then
+              call update_ghosts(a)
+              if (msnap==mfarray) call update_auxiliaries(a)
+            endif
+          endif
           call safe_character_assign(file,trim(chsnap)//ch)
-          if (lmultithread) then
+          if (lfrom_GPU) then
+            call perform_wsnap_from_GPU(a,msnap,file)
+          elseif (lmultithread) then
             extpars%ind1=nv1_capitalvar; extpars%ind2=msnap; extpars%file=file
 !$          lmasterflags(PERF_WSNAP) = .true.
           else
@@ -357,18 +406,32 @@ module Snapshot
 !  Write snapshot without label (typically, var.dat). For dvar.dat we need to
 !  make sure that ghost zones are not set on df!
 !
-        if (.not.lstart .and. lgpu .and. nt>0) call copy_farray_from_GPU(a)
-        if (msnap==mfarray) then
-          if (.not. loptest(noghost)) call update_ghosts(a)
-          call update_auxiliaries(a) ! Not if e.g. dvar.dat.
+        lfrom_GPU=snap_from_GPU(chsnap,msnap,1,noghost)
+        lasync=lmultithread .and. .not.lfrom_GPU .and. snap_async_from_GPU(chsnap,msnap) .and. .not.loptest(noghost)
+        if (lasync) then
+          call copy_farray_from_GPU(a,async_=.true.)
+        elseif (.not.lfrom_GPU) then
+          if (.not.lstart .and. lgpu .and. nt>0) call copy_farray_from_GPU(a)
+          if (msnap==mfarray) then
+            if (.not. loptest(noghost)) call update_ghosts(a)
+            call update_auxiliaries(a) ! Not if e.g. dvar.dat.
+          endif
+          ! update ghosts, because 'update_auxiliaries' may change the data
+          if (.not. loptest(noghost).or.ncoarse>1) call update_ghosts(a)
         endif
-        ! update ghosts, because 'update_auxiliaries' may change the data
-        if (.not. loptest(noghost).or.ncoarse>1) call update_ghosts(a)
         call safe_character_assign(file,trim(chsnap))
+!
+!  An incremental checkpoint of chsnap (wsnap_delta) does not refer to the new one,
+!  also if it was left by an earlier run, whatever isave_base is now.
+!
+        call delete_file(trim(directory_dist)//'/'//trim(chsnap)//'.delta')
+        if (allocated(f_base)) deallocate(f_base)
         if (lbackup_snap .and. .not.lstart .and. .not.(chsnap=='crash.dat' .or. chsnap(1:1)=='d' )) &
             call system_cmd('mv -f '//trim(directory_snap)//'/'//trim(file)//' '// &
                             trim(directory_snap)//'/'//trim(file)//'.bck '//' >& /dev/null')
-        if (lmultithread.and.nt>0) then
+        if (lfrom_GPU) then
+          call perform_wsnap_from_GPU(a,msnap,file)
+        elseif (lmultithread.and.nt>0) then
           extpars%ind1=1; extpars%ind2=msnap; extpars%file=file
 !$        lmasterflags(PERF_WSNAP) = .true.
         else
@@ -382,6 +445,169 @@ module Snapshot
       if (ltec) call output_snap_tec (file,a,msnap)
 !
     endsubroutine wsnap
+!***********************************************************************
+    logical function snap_from_GPU(chsnap,msnap,nv1,noghost)
+!
+!  Whether the data of the snapshot chsnap of the f-array can be written
+!  straight from device memory (lgpu_direct_snapshots): the ghost zones are
+!  then set on the GPU, and anything that needs f on the CPU is excluded.
+!
+      use General, only: loptest
+      use IO, only: IO_strategy
+
+      character(len=*), intent(in) :: chsnap
+      integer, intent(in) :: msnap, nv1
+      logical, intent(in), optional :: noghost
+
+      snap_from_GPU=.false.
+      if (.not.lgpu .or. lstart .or. nt<=0 .or. IO_strategy/='dist') return
+      if (chsnap(1:1)=='d' .or. loptest(noghost) .or. nv1/=1 .or. ncoarse>1) return
+      if (lformat .or. ltec .or. lwrite_2d .or. lastaroth_output .or. iFlameInd>0 .or. iMixFrac>0) return
+      snap_from_GPU=direct_snapshot_possible_GPU(msnap)
+
+    endfunction snap_from_GPU
+!***********************************************************************
+    logical function snap_async_from_GPU(chsnap,msnap)
+!
+!  Whether the helper thread, which writes the snapshot, can also complete the
+!  download of f started here (lcopy_farray_async) and set the ghost zones, so
+!  that the time stepping on the GPU continues right away. Not if f is needed
+!  on the CPU before, as for the auxiliaries or the formatted output.
+!
+      character(len=*), intent(in) :: chsnap
+      integer, intent(in) :: msnap
+
+      snap_async_from_GPU=lgpu .and. lcopy_farray_async .and. .not.lstart .and. nt>0 .and. msnap/=mfarray &
+                          .and. chsnap(1:1)/='d' .and. ncoarse<=1 &
+                          .and. .not.(lformat .or. ltec .or. iFlameInd>0 .or. iMixFrac>0)
+
+    endfunction snap_async_from_GPU
+!***********************************************************************
+    subroutine perform_wsnap_from_GPU(a,msnap,file)
+!
+!  Writes a snapshot whose data record output_snap takes from the GPU.
+!  Synchronous, as it needs the device, whose f is advanced right after.
+!
+      real, dimension(:,:,:,:), intent(in) :: a
+      integer, intent(in) :: msnap
+      character (len=fnlen), intent(in) :: file
+
+      lsnap_from_GPU=.true.
+      call perform_wsnap(a,1,msnap,file)
+      lsnap_from_GPU=.false.
+
+    endsubroutine perform_wsnap_from_GPU
+!***********************************************************************
+    subroutine wsnap_delta(chsnap,a,msnap)
+!
+!  Incremental checkpoints (isave_base>0): every isave_base-th call writes the
+!  full snapshot chsnap as base and keeps a copy of it. The calls in between
+!  write to chsnap//'.delta' in the processor directory only the blocks a(:,:,n,iv)
+!  which differ from the base by more than delta_threshold times the largest
+!  modulus of variable iv in the base, so the deltas are exact for delta_threshold=0.
+!  Each delta refers to the base, not to the previous delta; it replaces the
+!  previous one only when it is complete. rsnap_delta applies it on restart.
+!
+      use Boundcond, only: update_ghosts
+      use File_io, only: delete_file
+      use Mpicomm, only: mpibarrier
+      use Syscalls, only: rename_file
+!
+      integer, intent(in) :: msnap
+      real, dimension(mx,my,mz,msnap), intent(inout) :: a
+      character(len=*), intent(in) :: chsnap
+!
+      character (len=fnlen) :: file, file_tmp, file_snap
+      real, dimension(msnap) :: threshold
+      logical, dimension(mz,msnap) :: lchanged
+      integer :: iv, n
+!
+      if (.not.lstart .and. lgpu .and. nt>0) call copy_farray_from_GPU(a)
+      call update_ghosts(a)
+      if (msnap==mfarray) call update_auxiliaries(a)
+!
+      file=trim(directory_dist)//'/'//trim(chsnap)//'.delta'
+      if (.not.allocated(f_base) .or. ndelta+1>=isave_base) then
+!
+!  New base; the delta referring to the old one must go first.
+!
+        call delete_file(file)
+        file_snap=chsnap
+        call perform_wsnap(a,1,msnap,file_snap)
+        if (.not.allocated(f_base)) allocate(f_base(mx,my,mz,msnap))
+        f_base=a
+        t_base=real(t)
+        ndelta=0
+      else
+        do iv=1,msnap
+          threshold(iv)=delta_threshold*maxval(abs(f_base(:,:,:,iv)))
+          do n=1,mz
+            lchanged(n,iv)=any(abs(a(:,:,n,iv)-f_base(:,:,n,iv))>threshold(iv))
+          enddo
+        enddo
+        file_tmp=trim(file)//'.tmp'
+        open(lun_delta,FILE=file_tmp,FORM='unformatted',status='replace')
+        write(lun_delta) mx, my, mz, msnap, count(lchanged), t, t_base
+        do iv=1,msnap
+          do n=1,mz
+            if (lchanged(n,iv)) write(lun_delta) n, iv, a(:,:,n,iv)
+          enddo
+        enddo
+        close(lun_delta)
+        if (.not.rename_file(file_tmp,file)) call fatal_error('wsnap_delta','could not write '//trim(file))
+        ndelta=ndelta+1
+      endif
+      call mpibarrier
+!
+    endsubroutine wsnap_delta
+!***********************************************************************
+    subroutine rsnap_delta(chsnap,f,msnap)
+!
+!  Applies the incremental checkpoint chsnap//'.delta' written by wsnap_delta,
+!  if any, to f just read from the base chsnap, and sets t to its time.
+!  The delta is skipped if its base was written at a different time than
+!  chsnap (as t is stored in chsnap), i.e. it belongs to another base.
+!
+      use File_io, only: file_exists
+      use Mpicomm, only: mpiallreduce_or
+!
+      character(len=*), intent(in) :: chsnap
+      integer, intent(in) :: msnap
+      real, dimension(mx,my,mz,msnap), intent(inout) :: f
+!
+      character (len=fnlen) :: file
+      integer :: mx_in, my_in, mz_in, mv_in, nblocks, iblock, n, iv
+      real, dimension(mx,my) :: block
+      real(KIND=rkind8) :: t_delta
+      real :: t_base_in
+      logical :: lexists, lany, lstale, lstale_any
+!
+      file=trim(directory_dist)//'/'//trim(chsnap)//'.delta'
+      lexists=file_exists(file)
+      call mpiallreduce_or(lexists,lany)
+      if (.not.lany) return
+      if (.not.lexists) call fatal_error('rsnap_delta',trim(file)//' missing')
+!
+      open(lun_delta,FILE=file,FORM='unformatted',status='old')
+      read(lun_delta) mx_in, my_in, mz_in, mv_in, nblocks, t_delta, t_base_in
+      if (mx_in/=mx .or. my_in/=my .or. mz_in/=mz) &
+        call fatal_error('rsnap_delta','dimensions of '//trim(file)//' do not match')
+      lstale=t_base_in/=real(t)
+      call mpiallreduce_or(lstale,lstale_any)
+      if (lstale_any) then
+        close(lun_delta)
+        if (lroot) call warning('rsnap_delta','ignoring '//trim(chsnap)//'.delta, which belongs to another base')
+        return
+      endif
+      do iblock=1,nblocks
+        read(lun_delta) n, iv, block
+        if (iv<=msnap) f(:,:,n,iv)=block
+      enddo
+      close(lun_delta)
+      t=t_delta
+      if (lroot) print*, 'rsnap_delta: applied incremental checkpoint, t=', t
+!
+    endsubroutine rsnap_delta
 !***********************************************************************
     subroutine perform_wsnap_ext(a)
 
@@ -773,7 +999,9 @@ module Snapshot
 !  22-apr-11/MR: added possibility to get xy-power-spectrum from xy_specs
 !
       use Boundcond, only: update_ghosts
-      use Power_spectrum, only: powerhel
+      use Power_spectrum, only: powerhel, power_GPU_spectra, pdf_GPU_pdfs
+      use Pscalar, only: cc2m, rhoccm
+      use Struct_func, only: structure_GPU, lstructure_on_GPU
       use Sub, only: update_snaptime
       use Diagnostics, only: save_diagnostic_controls
 !
@@ -781,6 +1009,7 @@ module Snapshot
       logical, optional :: lwrite_only
 !
       logical :: llwrite_only=.false.,ldo_all,lfirstcall_powerhel
+      integer :: ivec
       real, dimension (2) :: sumspec=0.
 !
 !  Set llwrite_only.
@@ -809,7 +1038,16 @@ module Snapshot
 !  update ghost zones for var.dat (cheap, since done infrequently).
 !
       if (lspec.or.llwrite_only) then
-        if (.not.lstart.and.lgpu) call copy_farray_from_GPU(f)
+        if (.not.lstart.and.lgpu) then
+          call power_GPU_spectra
+          call pdf_GPU_pdfs(rhoccm,sqrt(cc2m))
+          if (lsfu .and. lstructure_on_GPU()) then
+            do ivec=1,3
+              call structure_GPU(ivec)
+            enddo
+          endif
+          call copy_farray_from_GPU(f)
+        endif
         if (ldo_all .and. .not. lmultithread) call update_ghosts(f)
 !
         if (lmultithread) then
@@ -835,7 +1073,7 @@ module Snapshot
       use Particles_main, only: particles_powersnap
       use Power_spectrum
       use Pscalar, only: cc2m, gcc2m, rhoccm
-      use Struct_func, only: structure
+      use Struct_func, only: structure, lstructure_on_GPU
       use Sub, only: curli
       use Chemistry, only: make_flame_index, make_mixture_fraction
 !$    use OMP_lib
@@ -851,13 +1089,13 @@ module Snapshot
         lsqrt=.true.
         lfirstcall_powerhel=.true.
 
-        if (vel_spec) call power(f,'u')
+        if (vel_spec .and. .not.lpower_on_GPU('u')) call power(f,'u')
         if (r2u_spec) call power(f,'r2u')
         if (r3u_spec) call power(f,'r3u')
-        if (oo_spec)  call power(f,'o')
+        if (oo_spec  .and. .not.lpower_on_GPU('o')) call power(f,'o')
         if (relvel_spec) call power(f,'v')
-        if (mag_spec) call power(f,'b')
-        if (vec_spec) call power(f,'a')
+        if (mag_spec .and. .not.lpower_on_GPU('b')) call power(f,'b')
+        if (vec_spec .and. .not.lpower_on_GPU('a')) call power(f,'a')
         if (j_spec)   call power_vec(f,'j')
         if (jb_spec)  call powerhel(f,'j.b',lfirstcall_powerhel) !(not ready yet) ! ready now
         if (ja_spec)  call powerhel(f,'j.a',lfirstcall_powerhel) !(for now, use this instead) ! now does j.b spectra
@@ -1040,20 +1278,21 @@ module Snapshot
             if (lpdfz1)  call structure(f,ivec,b_vec,'pdfz1')
             if (lpdfz2)  call structure(f,ivec,b_vec,'pdfz2')
           endif
-          if (lsfu)  call structure(f,ivec,f(l1:l2,m1:m2,n1:n2,iuu+ivec-1),'u')
+          if (lsfu .and. .not.lstructure_on_GPU()) &
+                     call structure(f,ivec,f(l1:l2,m1:m2,n1:n2,iuu+ivec-1),'u')
           if (lpdfu) call structure(f,ivec,f(l1:l2,m1:m2,n1:n2,iuu+ivec-1),'pdfu')
         enddo
 !
 !  Do pdf of passive scalar field (if present).
 !
         if (rhocc_pdf)     call pdf(f,'rhocc',rhoccm,sqrt(cc2m))
-        if (cc_pdf)        call pdf(f,'cc'   ,rhoccm,sqrt(cc2m))
-        if (lncc_pdf)      call pdf(f,'lncc' ,rhoccm,sqrt(cc2m))
+        if (cc_pdf   .and. .not.lpdf_on_GPU('cc'))   call pdf(f,'cc'   ,rhoccm,sqrt(cc2m))
+        if (lncc_pdf .and. .not.lpdf_on_GPU('lncc')) call pdf(f,'lncc' ,rhoccm,sqrt(cc2m))
         if (gcc_pdf)       call pdf(f,'gcc'  ,0.    ,sqrt(gcc2m))
         if (lngcc_pdf)     call pdf(f,'lngcc',0.    ,sqrt(gcc2m))
         if (cosEB_pdf)     call pdf(f,'cosEB',0.    ,1.)
-        if (lnspecial_pdf) call pdf(f,'lnspecial',0.,1.)
-        if (special_pdf)   call pdf(f,'special',0.,1.)
+        if (lnspecial_pdf .and. .not.lpdf_on_GPU('lnspecial')) call pdf(f,'lnspecial',0.,1.)
+        if (special_pdf   .and. .not.lpdf_on_GPU('special'))   call pdf(f,'special',0.,1.)
 !
 !  Do k-dependent pdf
 !
@@ -303,19 +303,86 @@ module struct_func
           close(1)
         endif
         !
-        if (llsf) then
-          if (ip<10) print*,'Writing structure functions of variable ',&
-               trim(itoa(ivec)), &
-               ' to ',trim(datadir)//trim(prefix)//trim(itoa(ivec))//'.dat'
-          open(1,file=trim(datadir)//trim(prefix)//trim(itoa(ivec))//'.dat', &
-               position='append')
-          write(1,*) t,qmax
-          write(1,'(1p,8e10.2)') sf_sum(:,:,:)
-          close(1)
-        endif
+        if (llsf) call write_structure(prefix,ivec,sf_sum)
       endif
       !
     endsubroutine structure
 !***********************************************************************
+    logical function lstructure_on_GPU()
+      !
+      !  True if the structure functions of u (lsfu) are formed on the GPU
+      !  by structure_GPU instead of by structure after downloading f.
+      !  Only the x direction is done there, hence nr_directions=1.
+      !
+      use Cdata, only: lgpu, lstart, nr_directions
+      !
+      lstructure_on_GPU = lgpu .and. .not.lstart .and. nr_directions==1
+      !
+    endfunction lstructure_on_GPU
+!***********************************************************************
+    subroutine structure_GPU(ivec)
+      !
+      !  GPU counterpart of structure(f,ivec,...,'u') for nr_directions=1:
+      !  only the sums for the separations leave the device. Has to be
+      !  called from the main thread, before f is downloaded.
+      !
+      use Cdata
+      use Gpu, only: structure_functions_GPU
+      use Messages, only: fatal_error
+      use Mpicomm, only: mpireduce_sum
+      !
+      integer :: ivec
+      !
+      integer, parameter :: qmax=8+1, imax=lb_nxgrid*2-2
+      real, dimension (imax,qmax,3) :: sf,sf_sum
+      integer, dimension (imax) :: separations
+      integer :: lb_ll,exp1,exp2
+      integer(KIND=ikind8) :: ndiv
+      !
+      if (2**lb_nxgrid/=nxgrid) call fatal_error('structure_GPU','nxgrid is not a power of 2')
+      !
+      do lb_ll=1,imax
+        if (lb_ll == 1) then
+          exp2=0
+        else
+          exp2=mod(lb_ll,2)
+        endif
+        exp1=int(lb_ll/2)-exp2
+        separations(lb_ll)=(2**exp1)*(3**exp2)
+      enddo
+      !
+      sf=0.
+      call structure_functions_GPU(iuu+ivec-1,separations,sf(:,:,1))
+      call mpireduce_sum(sf,sf_sum,(/imax,qmax,3/))
+      ndiv=nwgrid*2
+      sf_sum=sf_sum/ndiv
+      !
+      if (lroot) call write_structure('/sfu-',ivec,sf_sum)
+      !
+    endsubroutine structure_GPU
+!***********************************************************************
+    subroutine write_structure(prefix,ivec,sf_sum)
+      !
+      !  Appends the structure functions sf_sum(separation,moment,direction)
+      !  of component ivec to datadir/<prefix><ivec>.dat.
+      !
+      use Cdata, only: datadir, ip, t
+      use General, only: itoa
+      !
+      character (len=*) :: prefix
+      integer :: ivec
+      real, dimension (:,:,:) :: sf_sum
+      !
+      if (ip<10) print*,'Writing structure functions of variable ',&
+           trim(itoa(ivec)), &
+           ' to ',trim(datadir)//trim(prefix)//trim(itoa(ivec))//'.dat'
+      open(1,file=trim(datadir)//trim(prefix)//trim(itoa(ivec))//'.dat', &
+           position='append')
+      write(1,*) t,size(sf_sum,2)
+      write(1,'(1p,8e10.2)') sf_sum(:,:,:)
+      close(1)
+      !
+    endsubroutine write_structure
+!***********************************************************************
 
 endmodule struct_func
@@ -1,4 +1,4 @@
 !  -*-f90-*-  (for emacs)    vim:set filetype=fortran:  (for vim)
   private 
 
-  public :: structure 
+  public :: structure, structure_GPU, lstructure_on_GPU
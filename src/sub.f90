@@ -76,7 +76,7 @@ module Sub
   public :: noform
 !
   public :: update_snaptime, read_snaptime
-  public :: shift_dt, set_dt
+  public :: shift_dt, set_dt, set_dt_global
   public :: parse_shell
   public :: get_radial_distance, power_law
 !
@@ -4055,19 +4055,47 @@ module Sub
     endsubroutine shift_dt
 !***********************************************************************
     subroutine set_dt(dt1_)
+!
+!  dt1_ (the inverse limiting time step) is the one of each processor.
+!
+      real :: dt1_
+!
+      call set_dt_reduce(dt1_,.true.)
+!
+    endsubroutine set_dt
+!***********************************************************************
+    subroutine set_dt_global(dt1_)
+!
+!  As set_dt, but dt1_ is already the maximum over all processors, as the
+!  reductions of the GPU task graphs return it, so the allreduce on the
+!  host is skipped.
+!
+      real :: dt1_
+!
+      call set_dt_reduce(dt1_,.false.)
+!
+    endsubroutine set_dt_global
+!***********************************************************************
+    subroutine set_dt_reduce(dt1_,lreduce)
 
       use Mpicomm, only: mpiallreduce_max, MPI_COMM_WORLD
 
       real :: dt1_
+      logical :: lreduce
       real :: dt1, dt1_local
       real, save :: dt1_last=0.0
 !
-!  dt1_local (or dt1_) is the inverse limiting time step at each processor.
+!  dt1_local (or dt1_) is the inverse limiting time step at each processor,
+!  unless lreduce=F.
 !
       dt1_local=dt1_
       ! Timestep growth limiter
       if (ddt > 0.) dt1_local=max(dt1_local,dt1_last)
-      call mpiallreduce_max(dt1_local,dt1,MPI_COMM_WORLD)
+      if (lreduce) then
+        call mpiallreduce_max(dt1_local,dt1,MPI_COMM_WORLD)
+      else
+        dt1=dt1_local
+      endif
 !
 !  now set the actual time step, based on dt1
 !
@@ -4076,7 +4104,7 @@ module Sub
       ! Timestep growth limiter
       if (ddt > 0.) dt1_last=dt1_local/ddt
 
-    endsubroutine set_dt
+    endsubroutine set_dt_reduce
 !***********************************************************************
     subroutine vecout(lun,file,vv,thresh,nvec)
 !
@@ -22,6 +22,11 @@ module Syscalls
   external copy_addr_c_bool
   external extract_string_c
   external mem_usage_c
+  external write_binary_file_long_c
+  external write_binary_file_async_c
+  external wait_binary_file_c
+  external write_snapshot_file_c
+  external rename_file_c
 !
   interface is_nan
     module procedure is_nan_0D
@@ -30,6 +35,30 @@ module Syscalls
     module procedure is_nan_3D
     module procedure is_nan_4D
   endinterface
+!
+  interface crc32c
+    module procedure crc32c_sg
+    module procedure crc32c_db
+  endinterface
+!
+!  Explicit interfaces of the C routine for either precision,
+!  to avoid type mismatches between the calls.
+!
+  interface
+    subroutine crc32c_c_sg(buffer,bytes,crc) bind(C,name='crc32c_c')
+      use iso_c_binding, only: c_float, c_long_long
+      real(KIND=c_float), dimension(*), intent(in) :: buffer
+      integer(KIND=c_long_long), intent(in) :: bytes
+      integer(KIND=c_long_long), intent(inout) :: crc
+    endsubroutine crc32c_c_sg
+!
+    subroutine crc32c_c_db(buffer,bytes,crc) bind(C,name='crc32c_c')
+      use iso_c_binding, only: c_double, c_long_long
+      real(KIND=c_double), dimension(*), intent(in) :: buffer
+      integer(KIND=c_long_long), intent(in) :: bytes
+      integer(KIND=c_long_long), intent(inout) :: crc
+    endsubroutine crc32c_c_db
+  endinterface
 !
   interface copy_addr
     module procedure copy_addr_int
@@ -347,6 +376,146 @@ module Syscalls
     result(index(result,char(0))-1:) = ''  ! as last char is newline
 
     endsubroutine extract_str
+!***********************************************************************
+    function write_binary_file_long(file,bytes,buffer,direct)
+!
+!  Writes the first bytes bytes of buffer (of any type, contiguous) to a new
+!  binary file. Sizes beyond 2 GiB are fine. With direct=T, the file is
+!  written bypassing the page cache (O_DIRECT) if buffer is aligned to 4096 bytes.
+!
+!  Returns:
+!  * the number of bytes written
+!  * -2 if the file could not be opened
+!  * -1 if writing failed
+!
+      character(len=*), intent(in) :: file
+      integer(KIND=ikind8), intent(in) :: bytes
+      real, dimension(*), intent(in) :: buffer
+      logical, optional, intent(in) :: direct
+      integer(KIND=ikind8) :: write_binary_file_long
+!
+      integer :: idirect
+!
+      idirect=0
+      if (present(direct)) then
+        if (direct) idirect=1
+      endif
+      call write_binary_file_long_c(trim(file)//char(0),bytes,buffer,idirect,write_binary_file_long)
+!
+    endfunction write_binary_file_long
+!***********************************************************************
+    function write_binary_file_async(file,bytes,buffer,direct)
+!
+!  As write_binary_file_long, but the writing is done by a separate thread
+!  while the caller continues. buffer must neither be a temporary (i.e., an
+!  actual argument that is not contiguous) nor be modified until
+!  wait_binary_file has been called with the returned handle.
+!
+!  Returns:
+!  * a non-negative handle
+!  * -1 if the write could not be started
+!
+      character(len=*), intent(in) :: file
+      integer(KIND=ikind8), intent(in) :: bytes
+      real, dimension(*), intent(in) :: buffer
+      logical, optional, intent(in) :: direct
+      integer :: write_binary_file_async
+!
+      integer :: idirect
+!
+      idirect=0
+      if (present(direct)) then
+        if (direct) idirect=1
+      endif
+      call write_binary_file_async_c(trim(file)//char(0),bytes,buffer,idirect,write_binary_file_async)
+!
+    endfunction write_binary_file_async
+!***********************************************************************
+    function wait_binary_file(handle)
+!
+!  Completes the write started by write_binary_file_async with handle.
+!  Returns the result as write_binary_file_long, -3 for an invalid handle.
+!
+      integer, intent(in) :: handle
+      integer(KIND=ikind8) :: wait_binary_file
+!
+      call wait_binary_file_c(handle,wait_binary_file)
+!
+    endfunction wait_binary_file
+!***********************************************************************
+    function write_snapshot_file(file,tail,bytes,buffer,handle)
+!
+!  Writes the first bytes bytes of buffer as the data record of snapshot file,
+!  followed by the unformatted records in file tail, which is removed. file is
+!  replaced only when complete. With handle present, the writing is done by a
+!  separate thread as in write_binary_file_async; handle is then -1 if it was
+!  nevertheless done immediately. The record must be smaller than 2 GiB.
+!
+!  Returns the result as write_binary_file_long if the write was done
+!  immediately, else 0.
+!
+      character(len=*), intent(in) :: file, tail
+      integer(KIND=ikind8), intent(in) :: bytes
+      real, dimension(*), intent(in) :: buffer
+      integer, optional, intent(out) :: handle
+      integer(KIND=ikind8) :: write_snapshot_file
+!
+      integer :: iasync, ihandle
+!
+      iasync=0
+      if (present(handle)) iasync=1
+      call write_snapshot_file_c(trim(file)//char(0),trim(tail)//char(0),bytes,buffer,iasync,ihandle,write_snapshot_file)
+      if (present(handle)) handle=ihandle
+!
+    endfunction write_snapshot_file
+!***********************************************************************
+    logical function rename_file(from,to)
+!
+!  Renames file from to to, replacing to atomically if it exists.
+!  Returns .true. on success.
+!
+      character(len=*), intent(in) :: from, to
+!
+      integer :: result
+!
+      call rename_file_c(trim(from)//char(0),trim(to)//char(0),result)
+      rename_file = result==0
+!
+    endfunction rename_file
+!***********************************************************************
+    function crc32c_sg(buffer,crc)
+!
+!  CRC-32C of buffer, continuing from crc (default: 0, i.e. start).
+!
+      real(KIND=selected_real_kind(6)), dimension(:,:,:), intent(in) :: buffer
+      integer(KIND=ikind8), optional, intent(in) :: crc
+      integer(KIND=ikind8) :: crc32c_sg
+!
+      integer(KIND=ikind8) :: bytes
+!
+      crc32c_sg=0
+      if (present(crc)) crc32c_sg=crc
+      bytes=4*int(size(buffer),ikind8)
+      call crc32c_c_sg(buffer,bytes,crc32c_sg)
+!
+    endfunction crc32c_sg
+!***********************************************************************
+    function crc32c_db(buffer,crc)
+!
+!  As crc32c_sg, for double precision.
+!
+      real(KIND=rkind8), dimension(:,:,:), intent(in) :: buffer
+      integer(KIND=ikind8), optional, intent(in) :: crc
+      integer(KIND=ikind8) :: crc32c_db
+!
+      integer(KIND=ikind8) :: bytes
+!
+      crc32c_db=0
+      if (present(crc)) crc32c_db=crc
+      bytes=8*int(size(buffer),ikind8)
+      call crc32c_c_db(buffer,bytes,crc32c_db)
+!
+    endfunction crc32c_db
 !***********************************************************************
     subroutine copy_addr_int(var, caddr)
 
@@ -9,6 +9,12 @@
  Written to compensate for inadequatenesses in the Fortran95/2003 standards.
 */
 #define _GNU_SOURCE
+#ifdef PYTHONPATH
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+#define NPY_NO_DEPRECATED_API NPY_1_7_API_VERSION
+#include <numpy/arrayobject.h>
+#endif
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdarg.h>
@@ -19,9 +25,17 @@
 #include <sys/stat.h>
 #include <fcntl.h>
 #include <dlfcn.h>
+#include <errno.h>
+#include <pthread.h>
 
 #include "headers_c.h"
 #include <stdbool.h>
+#include <stdint.h>
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <nmmintrin.h>
+#elif defined(__ARM_FEATURE_CRC32)
+#include <arm_acle.h>
+#endif
 
 /* ---------------------------------------------------------------------- */
 void FTNIZE(extract_string_c)(char *extract_cmd, char *result, const FINT *size)
@@ -244,6 +258,67 @@ void FTNIZE(dlerror_c)(void)
  printf("error = %s\n", error);
 }       
 /* ---------------------------------------------------------------------- */
+// Largest chunk handed to a single write(); Linux transfers at most 0x7ffff000 bytes per call anyway.
+#define WRITE_CHUNK ((size_t)1 << 30)
+// Alignment of address, offset and length required by O_DIRECT on any common file system.
+#define DIRECT_ALIGN ((size_t)4096)
+
+static long long write_all(const int file, const char *buffer, const size_t bytes)
+/* Writes bytes bytes of buffer, repeating after short or interrupted writes.
+   Returns the number of bytes written, -1 on error.
+*/
+{
+  size_t done = 0;
+  while (done < bytes) {
+    const size_t chunk = bytes-done < WRITE_CHUNK ? bytes-done : WRITE_CHUNK;
+    const ssize_t written = write (file, buffer+done, chunk);
+    if (written < 0) {
+      if (errno == EINTR) continue;
+      return -1;
+    }
+    if (written == 0) break;
+    done += written;
+  }
+  return (long long) done;
+}
+/* ---------------------------------------------------------------------- */
+static long long write_file(const char *filename, const char *buffer, const size_t bytes, const bool direct)
+/* Writes buffer to a new file. With direct, the part of buffer consisting of whole DIRECT_ALIGN blocks
+   bypasses the page cache (O_DIRECT) if buffer is aligned accordingly; the remainder is written normally.
+   Returns the number of bytes written, -2 if the file could not be opened and -1 if writing failed.
+*/
+{
+  bool aligned = direct && ((size_t) buffer % DIRECT_ALIGN == 0);
+  int file = open (filename, O_WRONLY|O_CREAT|O_TRUNC|(aligned ? O_DIRECT : 0), S_IRUSR|S_IWUSR);
+  // Some file systems (tmpfs) do not support O_DIRECT
+  if (file == -1 && aligned && errno == EINVAL) {
+    aligned = false;
+    file = open (filename, O_WRONLY|O_CREAT|O_TRUNC, S_IRUSR|S_IWUSR);
+  }
+  if (file == -1) return -2;
+
+  long long written = 0;
+  size_t bulk = 0;
+  if (aligned) {
+    bulk = bytes - bytes % DIRECT_ALIGN;
+    written = write_all (file, buffer, bulk);
+    // The tail is not a whole block
+    if (written == (long long) bulk) fcntl (file, F_SETFL, fcntl (file, F_GETFL) & ~O_DIRECT);
+    // Some file systems accept O_DIRECT on open, but not the write; start over buffered
+    else if (written < 0 && errno == EINVAL) {
+      fcntl (file, F_SETFL, fcntl (file, F_GETFL) & ~O_DIRECT);
+      if (lseek (file, 0, SEEK_SET) == 0) written = bulk = 0;
+    }
+  }
+  if (written == (long long) bulk) {
+    const long long tail = write_all (file, buffer+bulk, bytes-bulk);
+    written = tail < 0 ? -1 : written+tail;
+  }
+  if (close (file) != 0) written = -1;
+  if (written != (long long) bytes) return -1;
+  return written;
+}
+/* ---------------------------------------------------------------------- */
 void FTNIZE(write_binary_file_c)
      (char *filename, FINT *bytes, char *buffer, FINT *result)
 /* Writes a given buffer to a binary file.
@@ -253,22 +328,245 @@ void FTNIZE(write_binary_file_c)
    * -1 if writing the buffer failed
 */
 {
-  int file = -1;
-  int written = 0;
+  *result = (FINT) write_file (filename, buffer, (size_t) *bytes, false);
+}
+/* ---------------------------------------------------------------------- */
+void FTNIZE(rename_file_c)
+     (char *from, char *to, FINT *result)
+/* Atomically replaces 'to' by 'from' (within one file system).
+   Returns 0 on success, -1 otherwise.
+*/
+{
+  *result = rename (from, to) == 0 ? 0 : -1;
+}
+/* ---------------------------------------------------------------------- */
+void FTNIZE(write_binary_file_long_c)
+     (char *filename, long long *bytes, char *buffer, FINT *direct, long long *result)
+/* As write_binary_file_c, for buffers of any size; direct/=0 requests O_DIRECT (see write_file).
+*/
+{
+  *result = write_file (filename, buffer, (size_t) *bytes, *direct != 0);
+}
+/* ---------------------------------------------------------------------- */
+// Writes in progress in writer threads, see write_binary_file_async_c.
+#define MAX_ASYNC_WRITES 16
 
-  *result = -2;
-  file = open (filename, O_WRONLY|O_CREAT|O_TRUNC, S_IRUSR|S_IWUSR);
+typedef struct
+{
+  pthread_t thread;
+  bool busy;
+  char *filename;
+  char *tailname;
+  const char *buffer;
+  size_t bytes;
+  bool direct;
+  long long result;
+} async_write;
+
+static async_write async_writes[MAX_ASYNC_WRITES];
+static pthread_mutex_t async_writes_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static long long write_snapshot(const char *filename, const char *tailname, const char *buffer, const size_t bytes);
+
+static void *async_writer(void *arg)
+{
+  async_write *job = (async_write *) arg;
+  if (job->tailname != NULL)
+    job->result = write_snapshot (job->filename, job->tailname, job->buffer, job->bytes);
+  else
+    job->result = write_file (job->filename, job->buffer, job->bytes, job->direct);
+  return NULL;
+}
 
-  if(file == -1) return;
+static void start_async_write(char *filename, char *tailname, const char *buffer, const size_t bytes,
+                              const bool direct, FINT *handle)
+{
+  *handle = -1;
+  pthread_mutex_lock (&async_writes_lock);
+  for (int i = 0; i < MAX_ASYNC_WRITES; ++i) {
+    if (async_writes[i].busy) continue;
+    async_write *job = &async_writes[i];
+    *job = (async_write) {.busy = true, .filename = strdup (filename), .tailname = NULL, .buffer = buffer,
+                          .bytes = bytes, .direct = direct, .result = -1};
+    if (tailname != NULL) job->tailname = strdup (tailname);
+    if (job->filename != NULL && (tailname == NULL || job->tailname != NULL) &&
+        pthread_create (&job->thread, NULL, async_writer, job) == 0) {
+      *handle = i;
+    } else {
+      free (job->filename);
+      free (job->tailname);
+      job->busy = false;
+    }
+    break;
+  }
+  pthread_mutex_unlock (&async_writes_lock);
+}
+/* ---------------------------------------------------------------------- */
+void FTNIZE(write_binary_file_async_c)
+     (char *filename, long long *bytes, char *buffer, FINT *direct, FINT *handle)
+/* Starts writing a given buffer to a binary file in a separate thread; buffer must not be modified or
+   freed before wait_binary_file_c has been called with the returned handle.
+   Returns:
+   * a non-negative handle
+   * -1 if no further write can be started (all MAX_ASYNC_WRITES in progress, or no thread available)
+*/
+{
+  start_async_write (filename, NULL, buffer, (size_t) *bytes, *direct != 0, handle);
+}
+/* ---------------------------------------------------------------------- */
+void FTNIZE(wait_binary_file_c)(FINT *handle, long long *result)
+/* Waits for the write started with handle and releases the handle.
+   Returns the result of write_binary_file_long_c, or -3 for an invalid handle.
+*/
+{
+  *result = -3;
+  if (*handle < 0 || *handle >= MAX_ASYNC_WRITES) return;
+  async_write *job = &async_writes[*handle];
+  pthread_mutex_lock (&async_writes_lock);
+  const bool busy = job->busy;
+  pthread_mutex_unlock (&async_writes_lock);
+  if (!busy) return;
+
+  pthread_join (job->thread, NULL);
+  *result = job->result;
+  free (job->filename);
+  free (job->tailname);
+  pthread_mutex_lock (&async_writes_lock);
+  job->busy = false;
+  pthread_mutex_unlock (&async_writes_lock);
+}
+/* ---------------------------------------------------------------------- */
+static long long write_snapshot(const char *filename, const char *tailname, const char *buffer, const size_t bytes)
+/* Writes buffer as one unformatted sequential record (4-byte markers as gfortran; below 2 GiB only),
+   followed by the contents of tailname, to filename.tmp, which then replaces filename; tailname is removed.
+   Returns the number of bytes of filename, -2 if a file could not be opened and -1 if writing failed.
+*/
+{
+  const size_t len = strlen (filename) + 5;
+  char *tmpname = malloc (len);
+  if (tmpname == NULL) return -1;
+  snprintf (tmpname, len, "%s.tmp", filename);
+
+  long long written = -2;
+  const int file = open (tmpname, O_WRONLY|O_CREAT|O_TRUNC, S_IRUSR|S_IWUSR);
+  const int tail = open (tailname, O_RDONLY);
+  if (bytes > INT32_MAX) written = -1;
+  else if (file != -1 && tail != -1) {
+    const int32_t marker = (int32_t) bytes;
+    written = -1;
+    if (write_all (file, (const char *) &marker, sizeof (marker)) == (long long) sizeof (marker) &&
+        write_all (file, buffer, bytes) == (long long) bytes &&
+        write_all (file, (const char *) &marker, sizeof (marker)) == (long long) sizeof (marker)) {
+      written = (long long) (bytes + 2*sizeof (marker));
+      char chunk[65536];
+      ssize_t got;
+      while ((got = read (tail, chunk, sizeof (chunk))) != 0) {
+        if (got < 0 && errno == EINTR) continue;
+        if (got < 0 || write_all (file, chunk, (size_t) got) != got) {
+          written = -1;
+          break;
+        }
+        written += got;
+      }
+    }
+  }
+  if (tail != -1) close (tail);
+  if (file != -1 && close (file) != 0) written = -1;
+  if (written >= 0 && rename (tmpname, filename) == 0) {
+    unlink (tailname);
+  } else {
+    if (written >= 0) written = -1;
+    unlink (tmpname);
+  }
+  free (tmpname);
+  return written;
+}
+/* ---------------------------------------------------------------------- */
+void FTNIZE(write_snapshot_file_c)
+     (char *filename, char *tailname, long long *bytes, char *buffer, FINT *async, FINT *handle, long long *result)
+/* Writes buffer as the data record of snapshot filename, followed by the records in file tailname
+   (see write_snapshot). With async/=0, this is done in a separate thread, as by write_binary_file_async_c;
+   then handle is returned for wait_binary_file_c, or -1 if the write was done immediately (no thread available).
+   result is as for write_binary_file_long_c if the write was done immediately.
+*/
+{
+  *handle = -1;
+  *result = 0;
+  if (*async != 0) start_async_write (filename, tailname, buffer, (size_t) *bytes, false, handle);
+  if (*handle < 0) *result = write_snapshot (filename, tailname, buffer, (size_t) *bytes);
+}
+/* ---------------------------------------------------------------------- */
+// CRC-32C (Castagnoli polynomial, as in iSCSI and ext4). With SSE4.2 (checked at run time) or the
+// ARMv8 CRC extension it is computed by the crc32 instructions, eight bytes at a time, else bytewise by table.
+static uint32_t crc32c_table[256];
+static pthread_once_t crc32c_once = PTHREAD_ONCE_INIT;
 
-  *result = -1;
+static void crc32c_init_table(void)
+{
+  for (uint32_t i = 0; i < 256; i++)
+  {
+    uint32_t crc = i;
+    for (int k = 0; k < 8; k++) crc = crc & 1 ? (crc >> 1) ^ 0x82F63B78u : crc >> 1;
+    crc32c_table[i] = crc;
+  }
+}
 
-  written = (int) write (file, buffer, (size_t) *bytes);
-  close (file);
-  if (written != *bytes) return;
-  *result = written;
+static uint32_t crc32c_table_update(uint32_t crc, const unsigned char *buf, size_t len)
+{
+  pthread_once (&crc32c_once, crc32c_init_table);
+  while (len--) crc = crc32c_table[(crc ^ *buf++) & 0xff] ^ (crc >> 8);
+  return crc;
+}
+
+#if defined(__x86_64__) && defined(__GNUC__)
+__attribute__((target("sse4.2")))
+static uint32_t crc32c_hw_update(uint32_t crc, const unsigned char *buf, size_t len)
+{
+  uint64_t crc64 = crc, word;
+  for (; len >= 8; buf += 8, len -= 8)
+  {
+    memcpy (&word, buf, 8);
+    crc64 = _mm_crc32_u64 (crc64, word);
+  }
+  crc = (uint32_t) crc64;
+  while (len--) crc = _mm_crc32_u8 (crc, *buf++);
+  return crc;
+}
+#elif defined(__ARM_FEATURE_CRC32)
+static uint32_t crc32c_hw_update(uint32_t crc, const unsigned char *buf, size_t len)
+{
+  uint64_t word;
+  for (; len >= 8; buf += 8, len -= 8)
+  {
+    memcpy (&word, buf, 8);
+    crc = __crc32cd (crc, word);
+  }
+  while (len--) crc = __crc32cb (crc, *buf++);
+  return crc;
 }
+#endif
 
+void crc32c_c(const void *buffer, const long long *bytes, long long *crc)
+/* Continues the CRC-32C in crc (0 to start) over bytes bytes of buffer.
+   Called through an explicit bind(C) interface, hence not FTNIZEd.
+*/
+{
+  uint32_t c = ~(uint32_t) *crc;
+  const unsigned char *buf = (const unsigned char *) buffer;
+  const size_t len = (size_t) *bytes;
+
+#if defined(__x86_64__) && defined(__GNUC__)
+  if (__builtin_cpu_supports ("sse4.2"))
+    c = crc32c_hw_update (c, buf, len);
+  else
+    c = crc32c_table_update (c, buf, len);
+#elif defined(__ARM_FEATURE_CRC32)
+  c = crc32c_hw_update (c, buf, len);
+#else
+  c = crc32c_table_update (c, buf, len);
+#endif
+  *crc = (long long) (uint32_t) ~c;
+}
 /* ---------------------------------------------------------------------- */
 
 void FTNIZE(get_pid_c)
@@ -391,45 +689,68 @@ void FTNIZE(sizeof_real_c)
 void FTNIZE(py_init)()
   {
 #ifdef PYTHONPATH
-    #include <Python.h>
     Py_Initialize();
+    if (_import_array() < 0) PyErr_Print();
+    // py_call may run on the diagnostics helper thread, so the GIL is taken per call.
+    PyEval_SaveThread();
 #endif
   }
 /* ---------------------------------------------------------------------- */
-void FTNIZE(py_initialize)(const char *pymodule,const char *pyfunction,void *pModule,void *pFunction)
+void FTNIZE(py_initialize)(const char *pymodule,const char *pyfunction,void **pModule,void **pFunction)
   {
 #ifdef PYTHONPATH
-    #include <Python.h>
+    PyGILState_STATE gstate = PyGILState_Ensure();
 
     // Import the Python module
-    pModule = (void*) PyImport_ImportModule(pymodule);
-    if (pModule != NULL) {
+    *pModule = (void*) PyImport_ImportModule(pymodule);
+    *pFunction = NULL;
+    if (*pModule != NULL) {
         // Get a reference to the Python function
-        pFunction = (void*) PyObject_GetAttrString((PyObject*) pModule,pyfunction);
+        *pFunction = (void*) PyObject_GetAttrString((PyObject*) *pModule,pyfunction);
+        if (*pFunction == NULL) PyErr_Print();
     } else {
         PyErr_Print();
     }
+    PyGILState_Release(gstate);
 #endif
   }
 /* ---------------------------------------------------------------------- */
-void FTNIZE(py_call)(void *pFunction, int *arg)
+void FTNIZE(py_call)(void **pFunction, REAL *f, FINT *dims, REAL *x, REAL *y, REAL *z, double *t, FINT *it)
   {
-#ifdef PYTHONPATH
-    #include <Python.h>
+//  Calls pFunction(f, x, y, z, t, it) with NumPy arrays wrapping the f-array
+//  (dims = mx, my, mz, mfarray; Fortran order, writable) and the local coordinates.
+//  No data are copied, so the arrays must not be kept beyond the call.
 
-    // Call the Python function with the provided file path
-    PyObject *pArgs = NULL;  //PyTuple_Pack(1, Py_BuildValue("s", file_path));
-    PyObject_CallObject((PyObject *) pFunction, pArgs);
+#ifdef PYTHONPATH
+    if (*pFunction == NULL) return;
+    PyGILState_STATE gstate = PyGILState_Ensure();
+
+    const int typenum = sizeof(REAL) == sizeof(double) ? NPY_DOUBLE : NPY_FLOAT;
+    npy_intp shape[4] = {dims[0], dims[1], dims[2], dims[3]};
+    PyObject *farr = PyArray_New(&PyArray_Type, 4, shape, typenum, NULL, f, 0, NPY_ARRAY_FARRAY, NULL);
+    PyObject *xarr = PyArray_SimpleNewFromData(1, &shape[0], typenum, x);
+    PyObject *yarr = PyArray_SimpleNewFromData(1, &shape[1], typenum, y);
+    PyObject *zarr = PyArray_SimpleNewFromData(1, &shape[2], typenum, z);
+
+    PyObject *result = PyObject_CallFunction((PyObject *) *pFunction, "OOOOdi", farr, xarr, yarr, zarr, *t, (int) *it);
+    if (result == NULL) PyErr_Print();
+
+    Py_XDECREF(result);
+    Py_XDECREF(farr);
+    Py_XDECREF(xarr);
+    Py_XDECREF(yarr);
+    Py_XDECREF(zarr);
+    PyGILState_Release(gstate);
 #endif
   }
 /* ---------------------------------------------------------------------- */
-void FTNIZE(py_finalize)(void *pModule,void *pFunction)
+void FTNIZE(py_finalize)(void **pModule,void **pFunction)
   {
 #ifdef PYTHONPATH
-    #include <Python.h>
+    PyGILState_Ensure();
 
-    if (pFunction != NULL) Py_XDECREF((PyObject*) pFunction);
-    if (pModule != NULL) Py_XDECREF((PyObject*) pModule);
+    if (*pFunction != NULL) Py_XDECREF((PyObject*) *pFunction);
+    if (*pModule != NULL) Py_XDECREF((PyObject*) *pModule);
 
     Py_Finalize();
 #endif
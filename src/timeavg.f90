@@ -59,12 +59,18 @@ module Timeavg
 !  With optional argument INIT=.true., initialize to a.
 !
 !  7-oct-02/wolf: coded
+!
+!  In GPU runs a is not up to date, so the averages are kept and updated
+!  on the device instead, starting from the values set up here.
+!
+      use Gpu, only: init_timeavgs_GPU, update_timeavgs_GPU
 !
       real, dimension(mx,my,mz,mfarray) :: a
       real :: dt,weight
       integer :: i,idx
       logical, optional :: init
       logical :: init1=.false.
+      logical, save :: lfirst_gpu=.true.
 
       intent (in) :: a
 !
@@ -74,6 +80,14 @@ module Timeavg
       if (present(init)) init1=init
 !
       weight = min(dt/tavg,1.)
+      if (lgpu.and..not.init1) then
+        if (lfirst_gpu) then
+          call init_timeavgs_GPU(idx_tavg,f_tavg)
+          lfirst_gpu=.false.
+        endif
+        call update_timeavgs_GPU(weight)
+        return
+      endif
       do i=1,mtavg
         idx = idx_tavg(i)
         if (idx > 0) then       ! should always be the case; MR: if so then idx_tavg is not needed
@@ -101,6 +115,7 @@ module Timeavg
 !
       use Cdata
       use General
+      use Gpu, only: copy_timeavgs_from_GPU
       use IO, only: log_filename_to_file, output_globals
       use Mpicomm
       use Sub
@@ -133,6 +148,7 @@ module Timeavg
 !
         call update_snaptime(file,tsnap,nsnap,tavg,t,lsnap,ch)
         if (lsnap) then
+          if (lgpu) call copy_timeavgs_from_GPU(f_tavg)
           call output_globals(chsnap//ch,f_tavg,mtavg,'timeavg')
           if (present(flist)) call log_filename_to_file(chsnap//ch,flist)
         endif
@@ -141,6 +157,7 @@ module Timeavg
 !
 !  write snapshot without label (typically, timeavg.dat)
 !
+        if (lgpu) call copy_timeavgs_from_GPU(f_tavg)
         call output_globals(chsnap,f_tavg,mtavg,'timeavg')
       endif
 !
@@ -81,7 +81,9 @@ module Timestep
           solid_cells_timestep_second
       use Shear, only: advance_shear
       use Sub, only: set_dt, shift_dt
-      use GPU, only: after_timestep_gpu
+      use GPU, only: after_timestep_gpu, nonfinite_on_GPU, copy_farray_from_GPU, shear_shift_GPU, &
+                     save_rollback_state_GPU, rollback_GPU
+      use Snapshot, only: wsnap
 !
       real, dimension (mx,my,mz,mfarray) :: f
       real, dimension (mx,my,mz,mvar) :: df
@@ -187,14 +189,31 @@ module Timestep
 !  Advance deltay of the shear (and, optionally, perform shear advection
 !  by shifting all variables and their derivatives).
 !
-        if (lshear .and. .not. lgpu) then
-          call impose_floors_ceilings(f)
-          call update_ghosts(f)  ! Necessary for non-FFT advection but unnecessarily overloading FFT advection
-          call advance_shear(f, df, dtsub)
+        if (lshear) then
+          if (lgpu) then
+            call advance_shear(f, df, dtsub)   ! only advances deltay
+            call shear_shift_GPU(dtsub, llast)
+          else
+            call impose_floors_ceilings(f)
+            call update_ghosts(f)  ! Necessary for non-FFT advection but unnecessarily overloading FFT advection
+            call advance_shear(f, df, dtsub)
+          endif
         endif
 !
       if (.not. lgpu) call update_after_substep(f,df,dtsub,llast)
       if (lgpu) call after_timestep_gpu
+!
+!  Stop diverging GPU runs early, keeping the last state as crash.dat,
+!  unless they can go back to a state kept with nrollback_gpu>0.
+!
+      if (lgpu .and. llast) then
+        if (nonfinite_on_GPU()) then
+          if (rollback_GPU(f)) return
+          call copy_farray_from_GPU(f)
+          call wsnap('crash.dat',f,mvar_io,ENUM=.false.)
+          call fatal_error('time_step','NaN/Inf found on the GPU, crash.dat written')
+        endif
+      endif
 !
         ! [PAB] according to MR this breaks the autotest.
         ! @Piyali: there must be a reason to add an additional global communication,
@@ -206,6 +225,8 @@ module Timestep
         t = t + dtsub
 !
       enddo   ! substep loop
+!
+      if (lgpu) call save_rollback_state_GPU(f)
 !
 !  Integrate operator split terms.
 !
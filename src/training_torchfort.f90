@@ -24,6 +24,8 @@
 
     integer :: model_device=0
     integer :: it_train=-1, it_train_chkpt=-1, it_train_start=1,it_train_end=-1
+    integer :: ntrain_replay=1
+    logical :: ltrain_async=.false., ltrain_interior=.false., ltrain_single=.false.
 
     !real(KIND=rkind4), dimension(:,:,:,:,:), allocatable, device :: input, label, output
     real, dimension(:,:,:,:,:), allocatable, device :: input, label, output
@@ -41,7 +43,7 @@
 
     namelist /training_run_pars/ config_file, model, it_train, it_train_start, it_train_chkpt, &
                                  luse_trained_tau, lscale, lwrite_sample, max_loss, lroute_via_cpu,&
-                                 it_train_end
+                                 it_train_end, ltrain_async, ntrain_replay, ltrain_interior, ltrain_single
 !
     character(LEN=fnlen) :: model_output_dir, checkpoint_output_dir
     integer :: istat, train_step_ckpt, val_step_ckpt
@@ -549,6 +551,10 @@
     call copy_addr(itauyz,p_par(5)) ! int
     call copy_addr(itauzz,p_par(6)) ! int
     call copy_addr(lscale,p_par(7)) ! bool
+    call copy_addr(ltrain_async,p_par(8)) ! bool
+    call copy_addr(ntrain_replay,p_par(9)) ! int
+    call copy_addr(ltrain_interior,p_par(10)) ! bool
+    call copy_addr(ltrain_single,p_par(11)) ! bool
 
     endsubroutine pushpars2c
 !***********************************************************************
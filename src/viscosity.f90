@@ -233,6 +233,7 @@ module Viscosity
 !
   real, dimension(mz) :: eth0z = 0.0
   real, dimension(nx) :: diffus_nu, diffus_nu3
+  !$omp threadprivate(diffus_nu,diffus_nu3)
 !
   integer :: enum_nnewton_type = 0
   integer :: enum_div_sld_visc = 0
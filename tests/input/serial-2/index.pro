@@ -0,0 +1,21 @@
+ iuu=1
+ iux=1
+ iuy=2
+ iuz=3
+ ilnrho=4
+ iss=5
+ nname=11
+ nnamev=2
+ nnamex=-1
+ nnamey=-1
+ nnamez=3
+ nnamer=0
+ nnamexy=2
+ nnamexz=-1
+ nnamerz=-1
+ nname_sound=0
+ ncoords_sound=0
+ irho=0
+ iyH=0
+ ilnTT=0
+ iTT=0